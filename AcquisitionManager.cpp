@@ -0,0 +1,166 @@
+#include "AcquisitionManager.h"
+#include "DspWorker.h"
+#include "SerialHandler.h"
+#include <QDebug>
+#include <QThread>
+#include <algorithm>
+
+AcquisitionManager::AcquisitionManager(QObject* parent) : QObject(parent) {}
+
+AcquisitionManager::~AcquisitionManager() {
+    closeAll();
+}
+
+int AcquisitionManager::openPorts(const QStringList& ports, const QStringList& exclude) {
+    int added = 0;
+    for (const QString& port : ports) {
+        if (exclude.contains(port)) continue;
+        const bool open = std::any_of(devices.begin(), devices.end(),
+                                      [&port](const Device* d) { return d->port == port; });
+        if (open) continue;
+        addDevice(port);
+        ++added;
+    }
+    if (added > 0) {
+        qDebug() << "[AcquisitionManager] Opened" << added << "more device(s)," << devices.size() << "in total";
+        emit deviceCountChanged(devices.size());
+    }
+    return added;
+}
+
+void AcquisitionManager::addDevice(const QString& port) {
+    Device* d = new Device;
+    d->port = port;
+    d->acquisitionThread = new QThread(this);
+    d->handler = new SerialHandler();
+    d->handler->moveToThread(d->acquisitionThread);
+    connect(d->acquisitionThread, &QThread::finished, d->handler, &QObject::deleteLater);
+    d->acquisitionThread->start();
+    d->dspThread = new QThread(this);
+    d->dsp = new DspWorker(d->handler->frameRing());
+    d->dsp->moveToThread(d->dspThread);
+    connect(d->dspThread, &QThread::finished, d->dsp, &QObject::deleteLater);
+    d->dspThread->start();
+
+    const int index = devices.size();
+    connect(d->handler, &SerialHandler::framesAvailable, d->dsp, &DspWorker::processFrames);
+    connect(d->dsp, &DspWorker::framesReady, this, [this, index]() { drain(index); });
+    connect(d->handler, &SerialHandler::errorOccurred, this, [port](const QString& msg) {
+        qWarning() << "[AcquisitionManager]" << port << ":" << msg;
+    });
+    devices.append(d);
+    for (int ch = 0; ch < 2; ++ch) {
+        DeviceChannel channel;
+        channel.name = QString("Dev%1 CH%2").arg(index + 2).arg(ch + 1);
+        extraChannels.append(channel);
+    }
+
+    configure(d);
+    d->handler->connectPort(port);
+    // Starts after the link handshake
+    if (running) startDevice(d);
+}
+
+void AcquisitionManager::closeAll() {
+    if (devices.isEmpty()) return;
+    for (Device* d : devices) {
+        // The DSP worker reads the handler's frame ring, so it stops first
+        d->dspThread->quit();
+        d->dspThread->wait();
+        d->acquisitionThread->quit();
+        d->acquisitionThread->wait();
+        delete d->dspThread;
+        delete d->acquisitionThread;
+        delete d;
+    }
+    devices.clear();
+    extraChannels.clear();
+    emit deviceCountChanged(0);
+}
+
+void AcquisitionManager::configure(Device* d) {
+    d->handler->setProtocolParams(protocol.ch1Offset, protocol.ch2Offset, protocol.trigLevel,
+                                  protocol.trigSource, protocol.trigPolarity, protocol.sampleRateIdx);
+    d->dsp->setDecoderParams(decoder.ch1Gain, decoder.ch1Offset, decoder.ch2Gain, decoder.ch2Offset);
+    d->dsp->setChainConfig(0, chainConfigs[0]);
+    d->dsp->setChainConfig(1, chainConfigs[1]);
+    d->handler->setFrameRecorder(recorder, devices.indexOf(d) + 1);
+}
+
+void AcquisitionManager::setProtocolParams(int ch1Offset, int ch2Offset, int trigLevel, int trigSource,
+                                           int trigPolarity, int sampleRateIdx) {
+    protocol = {ch1Offset, ch2Offset, trigLevel, trigSource, trigPolarity, sampleRateIdx};
+    for (Device* d : devices) {
+        d->handler->setProtocolParams(ch1Offset, ch2Offset, trigLevel, trigSource, trigPolarity, sampleRateIdx);
+    }
+}
+
+void AcquisitionManager::setDecoderParams(double ch1Gain, int ch1Offset, double ch2Gain, int ch2Offset) {
+    decoder = {ch1Gain, ch2Gain, ch1Offset, ch2Offset};
+    for (Device* d : devices) d->dsp->setDecoderParams(ch1Gain, ch1Offset, ch2Gain, ch2Offset);
+}
+
+void AcquisitionManager::setChainConfig(int channel, const DspChain::Config& config) {
+    if (channel < 0 || channel > 1) return;
+    chainConfigs[channel] = config;
+    for (Device* d : devices) d->dsp->setChainConfig(channel, config);
+}
+
+void AcquisitionManager::setFrameRecorder(FrameRecorder* frameRecorder) {
+    recorder = frameRecorder;
+    for (int i = 0; i < devices.size(); ++i) devices[i]->handler->setFrameRecorder(recorder, i + 1);
+}
+
+void AcquisitionManager::start(int mode, int dataLength, bool dualChannel) {
+    running = true;
+    runMode = mode;
+    runLength = dataLength;
+    runDualChannel = dualChannel;
+    for (Device* d : devices) startDevice(d);
+}
+
+void AcquisitionManager::startDevice(Device* d) {
+    d->dsp->resetChains();
+    d->meters[0].reset();
+    d->meters[1].reset();
+    // Queued in order on the device's thread: streaming first, so every
+    // completed capture arms the next one
+    d->handler->setStreaming(true);
+    d->handler->startOscilloscopeAcquisition(runMode, runLength, runDualChannel);
+}
+
+void AcquisitionManager::stop() {
+    running = false;
+    for (Device* d : devices) {
+        d->handler->setStreaming(false);
+        d->handler->resetAcquisitionState();
+    }
+}
+
+// Keeps the newest frame of the device; anything older that queued up
+// behind it is released unread
+void AcquisitionManager::drain(int index) {
+    if (index >= devices.size()) return; // queued from before closeAll()
+    Device* d = devices[index];
+    DecodedFrameRing& ring = d->dsp->output();
+    ring.clearNotified();
+    bool updated = false;
+    while (const DecodedFrame* frame = ring.peek()) {
+        for (int ch = 0; ch < 2; ++ch) {
+            const QVector<double>& src = ch == 0 ? frame->ch1 : frame->ch2;
+            DeviceChannel& out = extraChannels[2 * index + ch];
+            out.samples.resize(src.size());
+            std::copy(src.constData(), src.constData() + src.size(), out.samples.data());
+            out.timestampNs = frame->timestampNs;
+        }
+        ring.release();
+        updated = true;
+    }
+    if (!updated) return;
+    for (int ch = 0; ch < 2; ++ch) {
+        DeviceChannel& out = extraChannels[2 * index + ch];
+        out.measurements = out.samples.isEmpty() ? ChannelMeasurements()
+                                                 : d->meters[ch].measure(out.samples, sampleInterval);
+    }
+    emit channelsUpdated();
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "DspChain.h"
+#include "MeasurementKernel.h"
+
+class QThread;
+class SerialHandler;
+class DspWorker;
+class FrameRecorder;
+
+// Latest frame of one channel of a secondary device
+struct DeviceChannel {
+    QString name;             // e.g. "Dev2 CH1"
+    QVector<double> samples;  // volts; empty if the channel is not captured
+    qint64 timestampNs = 0;   // acquisitionClockNs() of the frame
+    ChannelMeasurements measurements;
+};
+
+// The other boards on the bench. MainWindow's SerialHandler stays the
+// primary, triggered device; every further board with the same VID/PID is
+// opened here with its own acquisition thread (SerialHandler) and DSP
+// thread (DspWorker), so the boards capture free-running in parallel and
+// throughput grows with the number attached. Each device contributes two
+// channels holding its latest frame, timestamped against the shared
+// acquisition clock and measured on arrival.
+class AcquisitionManager : public QObject {
+    Q_OBJECT
+public:
+    explicit AcquisitionManager(QObject* parent = nullptr);
+    ~AcquisitionManager();
+
+    // Opens every one of ports not already open and not in exclude;
+    // returns how many devices were added
+    int openPorts(const QStringList& ports, const QStringList& exclude);
+    void closeAll();
+    int deviceCount() const { return devices.size(); }
+
+    // Applied to every device, including ones opened later
+    void setProtocolParams(int ch1Offset, int ch2Offset, int trigLevel, int trigSource, int trigPolarity, int sampleRateIdx);
+    void setDecoderParams(double ch1Gain, int ch1Offset, double ch2Gain, int ch2Offset);
+    void setChainConfig(int channel, const DspChain::Config& config);
+    void setSampleInterval(double seconds) { sampleInterval = seconds; }
+    // Device n records as device n + 1; the primary board is 0
+    void setFrameRecorder(FrameRecorder* frameRecorder);
+
+    // Every device re-arms its own captures until stop()
+    void start(int mode, int dataLength, bool dualChannel);
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Two per device, CH1 then CH2
+    const QVector<DeviceChannel>& channels() const { return extraChannels; }
+
+signals:
+    void channelsUpdated();
+    void deviceCountChanged(int count);
+
+private:
+    struct Device {
+        QString port;
+        QThread* acquisitionThread = nullptr;
+        SerialHandler* handler = nullptr;  // lives on acquisitionThread
+        QThread* dspThread = nullptr;
+        DspWorker* dsp = nullptr;          // lives on dspThread
+        MeasurementKernel meters[2];
+    };
+
+    void addDevice(const QString& port);
+    void configure(Device* device);
+    void startDevice(Device* device);
+    void drain(int index);
+
+    QVector<Device*> devices;
+    QVector<DeviceChannel> extraChannels;
+
+    struct ProtocolParams {
+        int ch1Offset = 0, ch2Offset = 0;
+        int trigLevel = 0, trigSource = 0, trigPolarity = 0;
+        int sampleRateIdx = 3;
+    } protocol;
+    struct DecoderParams {
+        double ch1Gain = 1.0, ch2Gain = 1.0;
+        int ch1Offset = 0, ch2Offset = 0;
+    } decoder;
+    DspChain::Config chainConfigs[2];
+    double sampleInterval = 1.0;
+    FrameRecorder* recorder = nullptr;
+
+    bool running = false;
+    int runMode = 1;
+    int runLength = 200;
+    bool runDualChannel = true;
+};
@@ -0,0 +1,67 @@
+#include "AdcDecoder.h"
+
+namespace {
+// --- ADC to Voltage Conversion (Legacy/Calibrated Equations) ---
+/*
+ * For CH1 (Channel 1):
+ *   read_temp = (((ADC_CH1 * 10.0 / 128.0) - 10.0 + OC1) * scaleFactor / ch1Gain) + OC1 + 3.78V + UI_offset
+ * For CH2 (Channel 2):
+ *   read_temp = (((ADC_CH2 * 10.0 / 128.0) - 10.0) * scaleFactor / ch2Gain) + 3.78V + UI_offset
+ * Where:
+ *   ADC_CH1, ADC_CH2: Raw ADC value (0–255)
+ *   OC1: Offset correction for CH1 (set to 0.0 if not used)
+ *   scaleFactor: Calibration factor (5.0 / 4.8)
+ *   ch1Gain, ch2Gain: Gain for each channel
+ *   3.78V: Fixed baseline offset
+ *   UI_offset: User-adjustable offset from slider (ch1Offset/ch2Offset converted to voltage)
+ */
+const double scaleFactor = 5.0 / 4.8;
+const double OC1 = 0.0; // Set to nonzero if you want to apply offset correction
+const double fixedOffset = 4.00; // Fixed baseline offset
+const double baselineCorrection = 3.78;
+}
+
+AdcDecoder::AdcDecoder() {
+    setParams(1.0, 0, 1.0, 0);
+}
+
+void AdcDecoder::buildTable(Channel channel, ChannelTable& table) {
+    double uiOffset = (table.uiOffset / 100.0) / 2.0; // Reduce offset effect by half
+    for (int adc = 0; adc < 256; ++adc) {
+        double adcValue = adc;
+        double voltage;
+        if (channel == Ch1) {
+            voltage = (((adcValue * 10.0 / 128.0) - 10.0 + OC1) * scaleFactor / table.gain) + OC1 + fixedOffset + uiOffset;
+        } else {
+            voltage = (((adcValue * 10.0 / 128.0) - 10.0) * scaleFactor / table.gain) + fixedOffset + uiOffset;
+        }
+        table.lut[adc] = voltage - baselineCorrection;
+    }
+    table.valid = true;
+}
+
+void AdcDecoder::setChannelParams(Channel channel, double gain, int uiOffset) {
+    ChannelTable& table = tables[channel];
+    if (table.valid && table.gain == gain && table.uiOffset == uiOffset) return;
+    table.gain = gain;
+    table.uiOffset = uiOffset;
+    buildTable(channel, table);
+}
+
+void AdcDecoder::setParams(double ch1Gain, int ch1Offset, double ch2Gain, int ch2Offset) {
+    setChannelParams(Ch1, ch1Gain, ch1Offset);
+    setChannelParams(Ch2, ch2Gain, ch2Offset);
+}
+
+void AdcDecoder::decode(Channel channel, const QByteArray& raw, QVector<double>& out) const {
+    const int n = raw.size();
+    out.resize(n);
+    decode(channel, reinterpret_cast<const quint8*>(raw.constData()), n, out.data());
+}
+
+void AdcDecoder::decode(Channel channel, const quint8* raw, int count, double* out) const {
+    const double* lut = tables[channel].lut;
+    for (int i = 0; i < count; ++i) {
+        out[i] = lut[raw[i]];
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <QVector>
+#include <QByteArray>
+
+// Bulk ADC-to-volts decoder. Samples are 8-bit, so for a given gain/offset
+// setting the whole calibrated transform collapses to a 256-entry table per
+// channel. Tables are only rebuilt when a channel's gain or offset changes;
+// decoding a frame is then a single branch-free table lookup per sample.
+class AdcDecoder {
+public:
+    enum Channel { Ch1 = 0, Ch2 = 1 };
+
+    AdcDecoder();
+
+    // Rebuilds a channel's table only if gain or offset differ from the cached ones
+    void setChannelParams(Channel channel, double gain, int uiOffset);
+    void setParams(double ch1Gain, int ch1Offset, double ch2Gain, int ch2Offset);
+
+    // Decodes a whole raw frame into out (resized to raw.size())
+    void decode(Channel channel, const QByteArray& raw, QVector<double>& out) const;
+    // Decodes count samples from raw into out[0..count), e.g. straight out of a ring buffer
+    void decode(Channel channel, const quint8* raw, int count, double* out) const;
+
+    // Single-sample conversion for callers that only need a few values
+    double toVolts(Channel channel, quint8 adc) const { return tables[channel].lut[adc]; }
+
+private:
+    struct ChannelTable {
+        bool valid = false;
+        double gain = 0.0;
+        int uiOffset = 0;
+        double lut[256];
+    };
+    static void buildTable(Channel channel, ChannelTable& table);
+
+    ChannelTable tables[2];
+};
@@ -0,0 +1,183 @@
+#include "AutoSetup.h"
+#include "TimeBase.h"
+#include <cmath>
+
+namespace {
+constexpr double FILL = 0.8;                 // of the ADC window the signal may reach
+constexpr double CLIP_MARGIN = 0.01;         // of the span, counted as the rail
+constexpr double FLAT_LSBS = 4.0;            // pk-pk below this many codes is no signal
+constexpr double OFFSET_TOLERANCE = 0.02;    // of the span, off centre before moving
+constexpr double MIN_SAMPLES_PER_PERIOD = 4.0; // fewer and the frequency may be an alias
+constexpr double MIN_PERIODS = 3.0;          // shown in a record
+constexpr double MAX_PERIODS = 10.0;
+
+double span(const AutoSetupChannel& c) {
+    return c.clipHigh - c.clipLow;
+}
+
+bool isClipped(const AutoSetupChannel& c) {
+    const double margin = CLIP_MARGIN * span(c);
+    return c.meas.min <= c.clipLow + margin || c.meas.max >= c.clipHigh - margin;
+}
+
+bool isFlat(const AutoSetupChannel& c) {
+    return c.meas.pkpk < FLAT_LSBS * span(c) / 255.0;
+}
+
+double periodsInRecord(int index, double frequency, int samples) {
+    return frequency * samples / timeBase(index).sampleRate;
+}
+
+// Slowest rate that holds no more than MAX_PERIODS; adjacent rates are at
+// most 2.5x apart, so that is still at least MIN_PERIODS
+int timeBaseForPeriods(double frequency, int samples) {
+    for (int i = TIME_BASE_COUNT - 1; i > 0; --i) {
+        if (periodsInRecord(i, frequency, samples) <= MAX_PERIODS) return i;
+    }
+    return 0;
+}
+}
+
+void AutoSetup::start(const AutoSetupSettings& from, const Config& config) {
+    cfg = config;
+    if (cfg.gains.isEmpty()) cfg.gains.append(1.0);
+    initial = from;
+    current = from;
+    // Pre-scan: the fastest rate and the least sensitive gain
+    current.timeBase = 0;
+    rateLo = 0;
+    rateHi = TIME_BASE_COUNT - 1;
+    timeBaseDone = false;
+    for (int ch = 0; ch < 2; ++ch) {
+        current.gainIndex[ch] = 0;
+        gain[ch] = GainSearch{0, int(cfg.gains.size()) - 1, false};
+    }
+    running = true;
+    settled = false;
+    toneFound = false;
+    captureCount = 0;
+}
+
+bool AutoSetup::step(const AutoSetupChannel (&channels)[2]) {
+    if (!running) return false;
+    ++captureCount;
+    const AutoSetupSettings measured = current;
+    stepTimeBase(channels);
+    for (int ch = 0; ch < 2; ++ch) {
+        stepGain(ch, channels[ch]);
+        stepOffset(ch, channels[ch]);
+    }
+    // A new time base may show more of the signal than the last one did
+    if (current.timeBase != measured.timeBase) {
+        for (GainSearch& g : gain) {
+            g.lo = 0;
+            g.done = false;
+        }
+    }
+    bool changed = current.timeBase != measured.timeBase;
+    for (int ch = 0; ch < 2; ++ch) {
+        changed |= current.gainIndex[ch] != measured.gainIndex[ch] || current.offset[ch] != measured.offset[ch];
+    }
+    if (changed && captureCount < cfg.maxCaptures) return true;
+
+    // The trigger goes on what was measured, so the result is those settings
+    settled = !changed;
+    current = measured;
+    chooseTrigger(channels);
+    running = false;
+    return false;
+}
+
+void AutoSetup::stepTimeBase(const AutoSetupChannel (&channels)[2]) {
+    if (timeBaseDone) return;
+    const int tone = toneChannel(channels);
+    if (tone >= 0) {
+        const ChannelMeasurements& m = channels[tone].meas;
+        if (current.timeBase == 0 || timeBase(current.timeBase).sampleRate >= MIN_SAMPLES_PER_PERIOD * m.frequency) {
+            const double periods = periodsInRecord(current.timeBase, m.frequency, m.samples);
+            const int target = timeBaseForPeriods(m.frequency, m.samples);
+            if (target == current.timeBase || (periods >= MIN_PERIODS && periods <= MAX_PERIODS)) timeBaseDone = true;
+            else current.timeBase = target;
+            return;
+        }
+        rateHi = current.timeBase - 1;
+    } else {
+        rateLo = current.timeBase + 1;
+    }
+    if (rateLo > rateHi) {
+        // Nothing repeats at any rate: DC, or too slow to matter
+        timeBaseDone = true;
+        current.timeBase = initial.timeBase;
+        return;
+    }
+    current.timeBase = (rateLo + rateHi) / 2;
+}
+
+void AutoSetup::stepGain(int channel, const AutoSetupChannel& c) {
+    GainSearch& g = gain[channel];
+    if (g.done || !c.present || !c.meas.valid) return;
+    int& k = current.gainIndex[channel];
+    if (isClipped(c)) {
+        g.hi = k - 1;
+        if (g.hi < 0) {
+            // Over range even at the least sensitive gain
+            g.hi = 0;
+            g.done = true;
+            return;
+        }
+        g.lo = qMin(g.lo, g.hi);
+        k = (g.lo + g.hi) / 2;
+        return;
+    }
+    g.lo = k;
+    g.hi = qMax(g.hi, g.lo);
+    // The ADC window narrows about its midpoint as the gain goes up; how far
+    // the signal reaches from that midpoint, in volts, does not change
+    const double mid = 0.5 * (c.clipLow + c.clipHigh);
+    const double reach = qMax(c.meas.max - mid, mid - c.meas.min);
+    int best = g.lo;
+    for (int i = g.hi; i > g.lo; --i) {
+        if (reach <= FILL * 0.5 * span(c) * cfg.gains[k] / cfg.gains[i]) {
+            best = i;
+            break;
+        }
+    }
+    if (best == k) g.done = true;
+    else k = best;
+}
+
+void AutoSetup::stepOffset(int channel, const AutoSetupChannel& c) {
+    if (!gain[channel].done || !c.present || !c.meas.valid || isFlat(c) || isClipped(c)) return;
+    const double centre = 0.5 * (c.meas.min + c.meas.max);
+    if (std::fabs(centre) <= OFFSET_TOLERANCE * span(c)) return;
+    const int steps = int(std::lround(centre / cfg.voltsPerOffsetStep));
+    current.offset[channel] = qBound(cfg.offsetMin, current.offset[channel] - steps, cfg.offsetMax);
+}
+
+void AutoSetup::chooseTrigger(const AutoSetupChannel (&channels)[2]) {
+    const int tone = toneChannel(channels);
+    toneFound = tone >= 0;
+    if (!toneFound) {
+        current.triggerSource = 0;
+        return;
+    }
+    const ChannelMeasurements& m = channels[tone].meas;
+    current.triggerSource = tone + 1;
+    current.triggerLevel = 0.5 * (m.min + m.max);
+}
+
+// The periodic channel filling the most of its span; CH1 on a tie
+int AutoSetup::toneChannel(const AutoSetupChannel (&channels)[2]) const {
+    int best = -1;
+    double bestFill = 0.0;
+    for (int ch = 0; ch < 2; ++ch) {
+        const AutoSetupChannel& c = channels[ch];
+        if (!c.present || !c.meas.valid || !c.meas.periodic || c.meas.frequency <= 0.0 || isFlat(c)) continue;
+        const double fill = c.meas.pkpk / span(c);
+        if (best < 0 || fill > bestFill) {
+            best = ch;
+            bestFill = fill;
+        }
+    }
+    return best;
+}
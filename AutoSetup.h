@@ -0,0 +1,81 @@
+#pragma once
+#include <QVector>
+#include "MeasurementKernel.h"
+
+// Scope settings auto-set works on, in the UI's own units
+struct AutoSetupSettings {
+    int timeBase = 3;          // TimeBase index
+    int gainIndex[2] = {0, 0}; // into AutoSetup::Config::gains
+    int offset[2] = {0, 0};    // offset slider steps
+    int triggerSource = 0;     // 0 Auto, 1 CH1, 2 CH2, as the trigger radios
+    double triggerLevel = 0.0; // V on the source channel
+};
+
+// What one capture showed of a channel
+struct AutoSetupChannel {
+    bool present = false;
+    ChannelMeasurements meas;
+    double clipLow = 0.0;  // V the ADC's ends decode to with the capture's settings
+    double clipHigh = 0.0;
+};
+
+// Finds a time base, per-channel gain and offset and a trigger in as few
+// captures as it can, starting from a pre-scan at the fastest rate and the
+// least sensitive gain. Each step() takes the capture made with settings()
+// and moves to the next ones:
+// - time base: a trusted frequency jumps straight to the slowest rate that
+//   still holds only a few periods; without one the untried rates are
+//   bisected toward slower ones. A signal that never repeats keeps the time
+//   base auto-set started from.
+// - gain: clipping bisects the less sensitive untried gains, otherwise it
+//   goes straight to the most sensitive gain whose ADC window the signal
+//   reaches to at most FILL of either end.
+// - offset: centres the trace once its gain is settled.
+// It is done when a capture changes nothing (or after maxCaptures); the
+// trigger then goes to the midpoint of the periodic channel, or to Auto.
+class AutoSetup {
+public:
+    struct Config {
+        QVector<double> gains = {1.0, 2.0, 4.0, 8.0, 16.0, 32.0}; // least sensitive first
+        double voltsPerOffsetStep = 0.005;
+        int offsetMin = -1694;
+        int offsetMax = 1695;
+        int maxCaptures = 16;
+    };
+
+    void start(const AutoSetupSettings& current, const Config& config);
+    // False once finished; settings() then holds the result
+    bool step(const AutoSetupChannel (&channels)[2]);
+    void cancel() { running = false; }
+
+    bool isRunning() const { return running; }
+    const AutoSetupSettings& settings() const { return current; }
+    const AutoSetupSettings& startSettings() const { return initial; }
+    int captures() const { return captureCount; }
+    bool converged() const { return settled; }   // false if maxCaptures ran out
+    bool foundTone() const { return toneFound; } // false for DC or nothing connected
+
+private:
+    struct GainSearch {
+        int lo = 0; // most sensitive gain known not to clip
+        int hi = 0; // most sensitive gain not known to clip
+        bool done = false;
+    };
+
+    void stepTimeBase(const AutoSetupChannel (&channels)[2]);
+    void stepGain(int channel, const AutoSetupChannel& c);
+    void stepOffset(int channel, const AutoSetupChannel& c);
+    void chooseTrigger(const AutoSetupChannel (&channels)[2]);
+    int toneChannel(const AutoSetupChannel (&channels)[2]) const;
+
+    Config cfg;
+    AutoSetupSettings initial;
+    AutoSetupSettings current;
+    int rateLo = 0, rateHi = 0; // untried time bases
+    bool timeBaseDone = false;
+    GainSearch gain[2];
+    bool running = false;
+    bool settled = false;
+    bool toneFound = false;
+    int captureCount = 0;
+};
@@ -0,0 +1,149 @@
+#include "BodeSweep.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double PI = 3.14159265358979323846;
+// The first samples of a capture are unreliable; the old analysis skipped them too
+constexpr int LEADING_SAMPLES_SKIPPED = 20;
+// Below this the stimulus is lost in ADC noise (about one code at gain 1)
+constexpr double MIN_INPUT_AMPLITUDE = 0.01;
+// A reliable single-bin estimate needs a couple of periods in the record
+constexpr double MIN_CYCLES = 2.0;
+
+// Phase difference folded into -180..180
+double phaseStep(double a, double b) {
+    double d = std::fmod(b - a, 360.0);
+    if (d > 180.0) d -= 360.0;
+    if (d < -180.0) d += 360.0;
+    return d;
+}
+}
+
+void BodeSweep::start(double startHz, double endHz, int points) {
+    adaptive = false;
+    startGrid(startHz, endHz, points);
+}
+
+void BodeSweep::startAdaptive(double startHz, double endHz, int maxPoints, const AdaptiveOptions& adaptiveOptions) {
+    options = adaptiveOptions;
+    pointBudget = maxPoints;
+    startGrid(startHz, endHz, qMin(maxPoints, qMax(2, options.coarsePoints)));
+    adaptive = running;
+    frequencies.reserve(maxPoints);
+    results.reserve(maxPoints);
+    clock.start();
+}
+
+void BodeSweep::startGrid(double startHz, double endHz, int points) {
+    frequencies.clear();
+    results.clear();
+    if (points < 1 || startHz <= 0.0 || endHz <= 0.0) {
+        running = false;
+        return;
+    }
+    frequencies.reserve(points);
+    results.reserve(points);
+    const double logStart = std::log10(startHz);
+    const double step = points > 1 ? (std::log10(endHz) - logStart) / (points - 1) : 0.0;
+    for (int i = 0; i < points; ++i) {
+        frequencies.append(std::pow(10.0, logStart + i * step));
+    }
+    running = true;
+}
+
+double BodeSweep::currentFrequency() const {
+    return currentIndex() < frequencies.size() ? frequencies[currentIndex()] : 0.0;
+}
+
+bool BodeSweep::addCapture(const QVector<double>& input, const QVector<double>& output, double sampleRate) {
+    if (!running || currentIndex() >= frequencies.size()) return false;
+    const Point p = measurePoint(input, output, frequencies[currentIndex()], sampleRate);
+    const auto at = std::upper_bound(results.begin(), results.end(), p.frequency,
+                                     [](double f, const Point& q) { return f < q.frequency; });
+    lastMeasured = static_cast<int>(at - results.begin());
+    results.insert(at, p);
+    if (adaptive && currentIndex() >= frequencies.size()) refine();
+    if (currentIndex() >= frequencies.size()) running = false;
+    return running;
+}
+
+BodeSweep::Point BodeSweep::measurePoint(const QVector<double>& input, const QVector<double>& output, double frequency,
+                                        double sampleRate, std::complex<double>* response) {
+    Point p;
+    p.frequency = frequency;
+    if (response) *response = {};
+    int skip = LEADING_SAMPLES_SKIPPED;
+    int n = qMin(input.size(), output.size());
+    if (n <= 2 * skip) skip = 0;
+    n -= skip;
+    const double cyclesPerSample = sampleRate > 0.0 ? frequency / sampleRate : 0.0;
+    if (n <= 0 || n * cyclesPerSample < MIN_CYCLES) return p;
+    const std::complex<double> in = toneAt(input.constData() + skip, n, cyclesPerSample);
+    const std::complex<double> out = toneAt(output.constData() + skip, n, cyclesPerSample);
+    p.inputAmplitude = std::abs(in);
+    p.outputAmplitude = std::abs(out);
+    if (p.inputAmplitude < MIN_INPUT_AMPLITUDE) return p;
+    const std::complex<double> h = out / in;
+    p.magnitudeDb = 20.0 * std::log10(qMax(std::abs(h), 1e-12));
+    p.phaseDeg = std::arg(h) * 180.0 / PI;
+    p.valid = true;
+    if (response) *response = h;
+    return p;
+}
+
+// Queues the midpoints of the intervals that changed too much, steepest first
+void BodeSweep::refine() {
+    const int budget = pointBudget - frequencies.size();
+    if (budget <= 0) return;
+    if (options.timeBudgetMs > 0 && clock.elapsed() >= options.timeBudgetMs) return;
+
+    struct Split {
+        double score;
+        double frequency;
+    };
+    QVector<Split> splits;
+    for (int i = 1; i < results.size(); ++i) {
+        const Point& a = results[i - 1];
+        const Point& b = results[i];
+        if (!a.valid || !b.valid) continue;
+        if (b.frequency - a.frequency < 2.0 * options.minSpacingHz) continue;
+        const double gain = std::abs(b.magnitudeDb - a.magnitudeDb) / options.maxGainStepDb;
+        const double phase = std::abs(phaseStep(a.phaseDeg, b.phaseDeg)) / options.maxPhaseStepDeg;
+        const double score = qMax(gain, phase);
+        if (score > 1.0) splits.append({score, std::sqrt(a.frequency * b.frequency)});
+    }
+    if (splits.size() > budget) {
+        std::partial_sort(splits.begin(), splits.begin() + budget, splits.end(),
+                          [](const Split& x, const Split& y) { return x.score > y.score; });
+        splits.resize(budget);
+    }
+    // Measure each round low to high so the sample rate only steps one way
+    std::sort(splits.begin(), splits.end(), [](const Split& x, const Split& y) { return x.frequency < y.frequency; });
+    for (const Split& split : splits) frequencies.append(split.frequency);
+}
+
+std::complex<double> BodeSweep::toneAt(const double* samples, int n, double cyclesPerSample) {
+    if (n <= 1) return {};
+    double mean = 0.0;
+    for (int i = 0; i < n; ++i) mean += samples[i];
+    mean /= n;
+
+    // Goertzel recurrence over the Hann-windowed, mean-free samples
+    const double w = 2.0 * PI * cyclesPerSample;
+    const double coeff = 2.0 * std::cos(w);
+    const double windowStep = 2.0 * PI / (n - 1);
+    double s1 = 0.0, s2 = 0.0, windowSum = 0.0;
+    for (int i = 0; i < n; ++i) {
+        const double window = 0.5 - 0.5 * std::cos(windowStep * i);
+        windowSum += window;
+        const double s0 = (samples[i] - mean) * window + coeff * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    // s1 - e^{-jw} s2 is the DFT referenced to the last sample; rotate it
+    // back so the phase is that of the first sample
+    const std::complex<double> last = std::complex<double>(s1, 0.0) - std::polar(1.0, -w) * s2;
+    const std::complex<double> first = last * std::polar(1.0, -w * (n - 1));
+    return first * (2.0 / windowSum);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <QVector>
+#include <QElapsedTimer>
+#include <complex>
+
+// Frequency-response sweep over log-spaced stimulus frequencies. Each
+// capture of the stimulus (CH1) and the response (CH2) is reduced as it
+// arrives to one phasor per channel at the known stimulus frequency: a
+// Goertzel filter over the Hann-windowed record with its mean removed. The
+// ratio of the two is the transfer function at that frequency; noise and
+// harmonics away from the stimulus barely move it, and since both channels
+// see the same window and the same (possibly slightly off-nominal) DDS
+// frequency those errors cancel in the ratio. Only the per-point results
+// are kept, so memory does not grow with the number of captures.
+//
+// In adaptive mode the sweep starts on a coarse log grid and, each time the
+// queued points are done, bisects (geometrically) every neighbour pair whose
+// gain or phase differs by more than a threshold, steepest first, until
+// nothing is left to refine or the point or time budget is spent. Flat
+// regions stay coarse and peaks, notches and corners get the points.
+class BodeSweep {
+public:
+    struct Point {
+        double frequency = 0.0;       // Hz
+        double magnitudeDb = 0.0;     // 20 log10 |out / in|
+        double phaseDeg = 0.0;        // arg(out / in), -180..180
+        double inputAmplitude = 0.0;  // V peak at the stimulus frequency
+        double outputAmplitude = 0.0; // V peak at the stimulus frequency
+        bool valid = false;           // false if the stimulus was too small or too short to measure
+    };
+
+    struct AdaptiveOptions {
+        int coarsePoints = 12;         // initial log grid
+        double maxGainStepDb = 1.0;    // refine neighbours further apart than this...
+        double maxPhaseStepDeg = 10.0; // ...or this
+        double minSpacingHz = 1.0;     // never place points closer (DDS resolution)
+        int timeBudgetMs = 0;          // no new refinement rounds after this; 0 = no limit
+    };
+
+    // Log-spaced points from startHz to endHz inclusive
+    void start(double startHz, double endHz, int points);
+    // Coarse grid first, then refinement up to maxPoints in total
+    void startAdaptive(double startHz, double endHz, int maxPoints, const AdaptiveOptions& options);
+    void stop() { running = false; }
+    bool isRunning() const { return running; }
+    bool isAdaptive() const { return adaptive; }
+
+    int pointCount() const { return frequencies.size(); } // planned so far; grows while refining
+    int maxPointCount() const { return adaptive ? pointBudget : pointCount(); }
+    int currentIndex() const { return results.size(); }
+    double currentFrequency() const;
+
+    // Analyses the capture taken for the current point and moves on; false
+    // once the last point has been measured (or the sweep was stopped)
+    bool addCapture(const QVector<double>& input, const QVector<double>& output, double sampleRate);
+
+    // Sorted by frequency
+    const QVector<Point>& points() const { return results; }
+    // The point measured by the last addCapture()
+    const Point& lastPoint() const { return results[lastMeasured]; }
+
+    // One point from a capture of the stimulus at frequency, as addCapture()
+    // takes it: the first samples skipped, and invalid if the record holds
+    // too few periods or the stimulus is too small. response, if given,
+    // gets out / in (zero when invalid).
+    static Point measurePoint(const QVector<double>& input, const QVector<double>& output, double frequency,
+                              double sampleRate, std::complex<double>* response = nullptr);
+
+    // Windowed single-bin DFT of n samples at cyclesPerSample (f / fs),
+    // scaled so the magnitude is the tone's peak amplitude
+    static std::complex<double> toneAt(const double* samples, int n, double cyclesPerSample);
+
+private:
+    void startGrid(double startHz, double endHz, int points);
+    void refine();
+
+    QVector<double> frequencies; // measurement order
+    QVector<Point> results;
+    int lastMeasured = 0;
+    bool running = false;
+
+    bool adaptive = false;
+    AdaptiveOptions options;
+    int pointBudget = 0;
+    QElapsedTimer clock;
+};
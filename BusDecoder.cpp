@@ -0,0 +1,81 @@
+#include "BusDecoder.h"
+#include <algorithm>
+
+const char* protocolName(BusConfig::Protocol protocol) {
+    switch (protocol) {
+    case BusConfig::Protocol::Uart: return "UART";
+    case BusConfig::Protocol::Spi: return "SPI";
+    case BusConfig::Protocol::I2c: return "I2C";
+    }
+    return "?";
+}
+
+void BusDecoder::setBuses(const QVector<BusConfig>& buses, double analogRate, double digitalRate) {
+    configs = buses;
+    rates[int(BusConfig::Source::Analog)] = analogRate > 0.0 ? analogRate : 1.0;
+    rates[int(BusConfig::Source::Digital)] = digitalRate > 0.0 ? digitalRate : 1.0;
+    active.clear();
+    active.resize(buses.size());
+    for (int i = 0; i < buses.size(); ++i) {
+        Bus& bus = active[i];
+        bus.config = buses[i];
+        const double rate = rates[int(bus.config.source)];
+        switch (bus.config.protocol) {
+        case BusConfig::Protocol::Uart: bus.decoder.reset(new UartDecoder(bus.config.uart, rate)); break;
+        case BusConfig::Protocol::Spi: bus.decoder.reset(new SpiDecoder(bus.config.spi)); break;
+        case BusConfig::Protocol::I2c: bus.decoder.reset(new I2cDecoder(bus.config.i2c)); break;
+        }
+        for (LogicSlicer& slicer : bus.slicers) slicer.setLevels(bus.config.threshold, bus.config.hysteresis);
+    }
+}
+
+bool BusDecoder::hasSource(BusConfig::Source source) const {
+    for (const BusConfig& config : configs) {
+        if (config.source == source) return true;
+    }
+    return false;
+}
+
+void BusDecoder::breakStream(BusConfig::Source source) {
+    for (Bus& bus : active) {
+        if (bus.config.source != source) continue;
+        bus.decoder->reset();
+        for (LogicSlicer& slicer : bus.slicers) slicer.reset();
+    }
+}
+
+void BusDecoder::decodeAnalog(const double* ch1, const double* ch2, int count, quint64 position, qint64 firstNs,
+                              QVector<ProtocolAnnotation>& out) {
+    if (count <= 0) return;
+    lines.resize(count);
+    for (int b = 0; b < int(active.size()); ++b) {
+        Bus& bus = active[b];
+        if (bus.config.source != BusConfig::Source::Analog) continue;
+        std::fill(lines.begin(), lines.end(), quint8(0));
+        if (ch1) bus.slicers[0].slice(ch1, count, 1, lines.data());
+        if (ch2) bus.slicers[1].slice(ch2, count, 2, lines.data());
+        const int from = out.size();
+        bus.decoder->decode(lines.constData(), count, position, out);
+        stamp(out, from, b, position, firstNs);
+    }
+}
+
+void BusDecoder::decodeDigital(const quint8* inputs, int count, quint64 position, qint64 firstNs,
+                               QVector<ProtocolAnnotation>& out) {
+    for (int b = 0; b < int(active.size()); ++b) {
+        Bus& bus = active[b];
+        if (bus.config.source != BusConfig::Source::Digital) continue;
+        const int from = out.size();
+        bus.decoder->decode(inputs, count, position, out);
+        stamp(out, from, b, position, firstNs);
+    }
+}
+
+void BusDecoder::stamp(QVector<ProtocolAnnotation>& out, int from, int bus, quint64 position, qint64 firstNs) const {
+    const double nsPerSample = 1e9 / rates[int(active[bus].config.source)];
+    for (int i = from; i < out.size(); ++i) {
+        out[i].bus = quint8(bus);
+        // A word may have started in an earlier block
+        out[i].timeNs = firstNs + qint64(qint64(out[i].startSample - position) * nsPerSample);
+    }
+}
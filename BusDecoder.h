@@ -0,0 +1,63 @@
+#pragma once
+#include <QVector>
+#include <memory>
+#include <vector>
+#include "ProtocolDecoder.h"
+
+// One bus to decode: which protocol, where its lines come from, and the
+// protocol's settings
+struct BusConfig {
+    enum class Protocol { Uart, Spi, I2c };
+    // Analog: CH1 and CH2 thresholded into lines 0 and 1.
+    // Digital: the DigitalIO inputs D0..D3 as lines 0..3, one sample per poll.
+    enum class Source { Analog, Digital };
+
+    Protocol protocol = Protocol::Uart;
+    Source source = Source::Analog;
+    double threshold = 1.4;  // V, analog source only
+    double hysteresis = 0.2; // V
+    UartDecoder::Config uart;
+    SpiDecoder::Config spi;
+    I2cDecoder::Config i2c;
+};
+
+const char* protocolName(BusConfig::Protocol protocol);
+
+// The configured set of bus decoders. Analog blocks are sliced into logic
+// lines per bus (each with its own threshold) and run through that bus's
+// decoder; digital samples go straight to the buses reading them. Events
+// come back tagged with the bus index and stamped with the acquisition
+// clock from the time of the block's first sample. Not thread-safe: it
+// lives on the DSP worker.
+class BusDecoder {
+public:
+    // Replaces the decoders; rates are the samples per second of each source
+    void setBuses(const QVector<BusConfig>& buses, double analogRate, double digitalRate);
+    const QVector<BusConfig>& buses() const { return configs; }
+    bool isEmpty() const { return configs.isEmpty(); }
+    bool hasSource(BusConfig::Source source) const;
+
+    // The next block of this source does not follow the last one
+    void breakStream(BusConfig::Source source);
+
+    // Either channel may be nullptr (held low). position is the stream index
+    // of the first sample and firstNs its time.
+    void decodeAnalog(const double* ch1, const double* ch2, int count, quint64 position, qint64 firstNs,
+                      QVector<ProtocolAnnotation>& out);
+    void decodeDigital(const quint8* inputs, int count, quint64 position, qint64 firstNs,
+                       QVector<ProtocolAnnotation>& out);
+
+private:
+    struct Bus {
+        BusConfig config;
+        std::unique_ptr<ProtocolDecoder> decoder;
+        LogicSlicer slicers[2];
+    };
+
+    void stamp(QVector<ProtocolAnnotation>& out, int from, int bus, quint64 position, qint64 firstNs) const;
+
+    QVector<BusConfig> configs;
+    std::vector<Bus> active;
+    double rates[2] = {1.0, 1.0}; // by Source
+    QVector<quint8> lines;        // scratch
+};
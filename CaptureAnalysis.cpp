@@ -0,0 +1,166 @@
+#include "CaptureAnalysis.h"
+#include "BodeSweep.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double PI = 3.14159265358979323846;
+// Tone bins per natural-log unit of frequency: records within ~1 % average together
+constexpr double TONE_BINS_PER_LOG = 100.0;
+}
+
+void CaptureAnalysis::addRecord(const QVector<double>& ch1, const QVector<double>& ch2, double sampleRate) {
+    if (sampleRate <= 0.0 || (ch1.isEmpty() && ch2.isEmpty())) return;
+    ++records;
+    // Spectra are averaged over records of one length and rate
+    const int length = !ch1.isEmpty() ? ch1.size() : ch2.size();
+    if (spectrumLength == 0) {
+        spectrumLength = length;
+        spectrumRate = sampleRate;
+    }
+    ChannelMeasurements m[2];
+    for (int ch = 0; ch < 2; ++ch) {
+        const QVector<double>& samples = ch == 0 ? ch1 : ch2;
+        if (samples.isEmpty()) continue;
+        m[ch] = meters[ch].measure(samples, 1.0 / sampleRate);
+        addChannel(ch, samples, m[ch], sampleRate);
+    }
+    if (!ch1.isEmpty() && !ch2.isEmpty() && m[0].periodic) {
+        addTransfer(ch1, ch2, m[0].frequency, sampleRate);
+    }
+}
+
+void CaptureAnalysis::addChannel(int ch, const QVector<double>& samples, const ChannelMeasurements& m, double sampleRate) {
+    ChannelAccumulator& acc = channels[ch];
+    if (acc.records == 0) {
+        acc.min = m.min;
+        acc.max = m.max;
+    } else {
+        acc.min = std::min(acc.min, m.min);
+        acc.max = std::max(acc.max, m.max);
+    }
+    ++acc.records;
+    acc.samples += m.samples;
+    acc.sumSquares += m.rms * m.rms * m.samples;
+    acc.sumMean += m.mean;
+    acc.sumPkpk += m.pkpk;
+    if (m.periodic) {
+        ++acc.periodic;
+        acc.sumFrequency += m.frequency;
+        acc.sumDuty += m.duty;
+    }
+
+    if (samples.size() != spectrumLength || sampleRate != spectrumRate) return;
+    fft.magnitudeSpectrum(samples, magnitude, window);
+    if (acc.spectrumSum.size() != magnitude.size()) acc.spectrumSum.fill(0.0, magnitude.size());
+    for (int i = 0; i < magnitude.size(); ++i) acc.spectrumSum[i] += magnitude[i];
+    ++acc.spectrumRecords;
+}
+
+void CaptureAnalysis::addTransfer(const QVector<double>& ch1, const QVector<double>& ch2, double frequency, double sampleRate) {
+    // Gated exactly as a sweep point is
+    std::complex<double> response;
+    if (!BodeSweep::measurePoint(ch1, ch2, frequency, sampleRate, &response).valid) return;
+    ToneAccumulator& tone = tones[qint64(std::llround(std::log(frequency) * TONE_BINS_PER_LOG))];
+    tone.sumFrequency += frequency;
+    tone.sumResponse += response;
+    ++tone.records;
+}
+
+void CaptureAnalysis::merge(const CaptureAnalysis& other) {
+    if (other.records == 0) return;
+    // Spectra only combine when taken over the same record shape; otherwise
+    // the one with more records wins
+    const bool sameSpectrum = spectrumLength == other.spectrumLength && spectrumRate == other.spectrumRate;
+    const bool takeSpectrum = !sameSpectrum &&
+        other.channels[0].spectrumRecords + other.channels[1].spectrumRecords >
+        channels[0].spectrumRecords + channels[1].spectrumRecords;
+    for (int ch = 0; ch < 2; ++ch) {
+        ChannelAccumulator& acc = channels[ch];
+        const ChannelAccumulator& o = other.channels[ch];
+        if (o.records > 0) {
+            acc.min = acc.records > 0 ? std::min(acc.min, o.min) : o.min;
+            acc.max = acc.records > 0 ? std::max(acc.max, o.max) : o.max;
+            acc.records += o.records;
+            acc.periodic += o.periodic;
+            acc.samples += o.samples;
+            acc.sumSquares += o.sumSquares;
+            acc.sumMean += o.sumMean;
+            acc.sumPkpk += o.sumPkpk;
+            acc.sumFrequency += o.sumFrequency;
+            acc.sumDuty += o.sumDuty;
+        }
+        if (takeSpectrum) {
+            acc.spectrumSum = o.spectrumSum;
+            acc.spectrumRecords = o.spectrumRecords;
+        } else if (sameSpectrum && o.spectrumRecords > 0) {
+            if (acc.spectrumSum.size() != o.spectrumSum.size()) acc.spectrumSum.fill(0.0, o.spectrumSum.size());
+            for (int i = 0; i < o.spectrumSum.size(); ++i) acc.spectrumSum[i] += o.spectrumSum[i];
+            acc.spectrumRecords += o.spectrumRecords;
+        }
+    }
+    if (takeSpectrum || spectrumLength == 0) {
+        spectrumLength = other.spectrumLength;
+        spectrumRate = other.spectrumRate;
+    }
+    for (auto it = other.tones.cbegin(); it != other.tones.cend(); ++it) {
+        ToneAccumulator& tone = tones[it.key()];
+        tone.sumFrequency += it->sumFrequency;
+        tone.sumResponse += it->sumResponse;
+        tone.records += it->records;
+    }
+    records += other.records;
+}
+
+CaptureAnalysis::ChannelSummary CaptureAnalysis::channel(int ch) const {
+    ChannelSummary s;
+    const ChannelAccumulator& acc = channels[ch];
+    if (acc.records == 0) return s;
+    s.records = acc.records;
+    s.periodicRecords = acc.periodic;
+    s.min = acc.min;
+    s.max = acc.max;
+    s.rms = acc.samples > 0 ? std::sqrt(acc.sumSquares / acc.samples) : 0.0;
+    s.mean = acc.sumMean / acc.records;
+    s.pkpk = acc.sumPkpk / acc.records;
+    if (acc.periodic > 0) {
+        s.frequency = acc.sumFrequency / acc.periodic;
+        s.duty = acc.sumDuty / acc.periodic;
+    }
+    const QVector<double> averaged = spectrum(ch);
+    for (int i = 1; i < averaged.size(); ++i) {
+        if (averaged[i] > s.peakMagnitude) {
+            s.peakMagnitude = averaged[i];
+            s.peakFrequency = i * spectrumBinHz();
+        }
+    }
+    return s;
+}
+
+QVector<double> CaptureAnalysis::spectrum(int ch) const {
+    const ChannelAccumulator& acc = channels[ch];
+    QVector<double> averaged;
+    if (acc.spectrumRecords == 0) return averaged;
+    averaged.resize(acc.spectrumSum.size());
+    for (int i = 0; i < averaged.size(); ++i) averaged[i] = acc.spectrumSum[i] / acc.spectrumRecords;
+    return averaged;
+}
+
+double CaptureAnalysis::spectrumBinHz() const {
+    return spectrumLength > 0 ? spectrumRate / spectrumLength : 0.0;
+}
+
+QVector<CaptureAnalysis::TransferPoint> CaptureAnalysis::transfer() const {
+    QVector<TransferPoint> points;
+    points.reserve(tones.size());
+    for (const ToneAccumulator& tone : tones) {
+        const std::complex<double> h = tone.sumResponse / double(tone.records);
+        TransferPoint p;
+        p.frequency = tone.sumFrequency / tone.records;
+        p.magnitudeDb = 20.0 * std::log10(std::max(std::abs(h), 1e-12));
+        p.phaseDeg = std::arg(h) * 180.0 / PI;
+        p.records = tone.records;
+        points.append(p);
+    }
+    return points; // QMap keys are increasing log frequencies
+}
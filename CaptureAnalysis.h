@@ -0,0 +1,93 @@
+#pragma once
+#include <QMap>
+#include <QVector>
+#include <QtGlobal>
+#include <complex>
+#include "FFTEngine.h"
+#include "MeasurementKernel.h"
+
+// Offline analysis of decoded records, for reprocessing capture files and
+// frame recordings without the GUI. Every record is measured per channel
+// (MeasurementKernel), added to an averaged magnitude spectrum per channel
+// (FFTEngine) and, when both channels are there and CH1 is periodic,
+// reduced to the CH2/CH1 transfer function at CH1's frequency the way
+// BodeSweep measures a point. Records of a stimulus at the same frequency
+// (within ~1 %) are averaged into one transfer point, so a recorded sweep
+// comes back as its Bode plot.
+//
+// The records of one file can be split over several instances, one per
+// thread, and merged afterwards. An instance is not thread-safe.
+class CaptureAnalysis {
+public:
+    struct ChannelSummary {
+        quint64 records = 0;         // records with samples
+        quint64 periodicRecords = 0; // records with a measurable period
+        double min = 0.0;            // over every record
+        double max = 0.0;
+        double rms = 0.0;            // over every sample
+        double mean = 0.0;           // per-record values, averaged
+        double pkpk = 0.0;
+        double frequency = 0.0;      // Hz, periodic records only
+        double duty = 0.0;
+        double peakFrequency = 0.0;  // strongest non-DC bin of the averaged spectrum, Hz
+        double peakMagnitude = 0.0;  // V
+    };
+
+    struct TransferPoint {
+        double frequency = 0.0;   // Hz, mean over the records
+        double magnitudeDb = 0.0; // 20 log10 |CH2 / CH1|
+        double phaseDeg = 0.0;    // arg(CH2 / CH1), -180..180
+        quint64 records = 0;
+    };
+
+    void setWindow(FFTEngine::Window w) { window = w; }
+
+    // Either channel may be empty. Consecutive records of one file share
+    // the measurement edge reference, so feed them in order.
+    void addRecord(const QVector<double>& ch1, const QVector<double>& ch2, double sampleRate);
+    void merge(const CaptureAnalysis& other);
+
+    quint64 recordCount() const { return records; }
+    ChannelSummary channel(int ch) const;
+    // Averaged single-sided spectrum of the records that share the first
+    // record's length and sample rate, binHz apart; empty if none
+    QVector<double> spectrum(int ch) const;
+    double spectrumBinHz() const;
+    // Sorted by frequency
+    QVector<TransferPoint> transfer() const;
+
+private:
+    struct ChannelAccumulator {
+        quint64 records = 0;
+        quint64 periodic = 0;
+        quint64 samples = 0;
+        double min = 0.0;
+        double max = 0.0;
+        double sumSquares = 0.0; // over samples
+        double sumMean = 0.0;    // over records
+        double sumPkpk = 0.0;
+        double sumFrequency = 0.0;
+        double sumDuty = 0.0;
+        QVector<double> spectrumSum;
+        quint64 spectrumRecords = 0;
+    };
+    struct ToneAccumulator {
+        double sumFrequency = 0.0;
+        std::complex<double> sumResponse;
+        quint64 records = 0;
+    };
+
+    void addChannel(int ch, const QVector<double>& samples, const ChannelMeasurements& m, double sampleRate);
+    void addTransfer(const QVector<double>& ch1, const QVector<double>& ch2, double frequency, double sampleRate);
+
+    FFTEngine::Window window = FFTEngine::Window::Hann;
+    FFTEngine fft;
+    MeasurementKernel meters[2];
+    QVector<double> magnitude; // scratch
+
+    quint64 records = 0;
+    ChannelAccumulator channels[2];
+    int spectrumLength = 0;   // samples per record the spectra are taken over
+    double spectrumRate = 0.0;
+    QMap<qint64, ToneAccumulator> tones; // by ~1 % wide log-frequency bin
+};
@@ -0,0 +1,289 @@
+#include "CaptureFile.h"
+#include "CaptureHistory.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr char MAGIC[8] = {'O', 'S', 'C', 'C', 'A', 'P', '0', '1'};
+constexpr quint32 VERSION = 1;
+constexpr int HEADER_BYTES = 128;
+constexpr quint32 BLOCK_MAGIC = 0x314B4C42; // "BLK1"
+constexpr int BLOCK_HEADER_BYTES = 24;
+constexpr int BLOCK_SAMPLES = 1 << 16;      // per channel, per block
+constexpr int DRAIN_INTERVAL_MS = 20;
+
+template <typename T>
+void put(uchar* dst, int offset, T value) { qToLittleEndian(value, dst + offset); }
+template <typename T>
+T get(const uchar* src, int offset) { return qFromLittleEndian<T>(src + offset); }
+
+void putDouble(uchar* dst, int offset, double value) {
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put<quint64>(dst, offset, bits);
+}
+double getDouble(const uchar* src, int offset) {
+    const quint64 bits = get<quint64>(src, offset);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+int channelsIn(int mask) { return ((mask & 1) ? 1 : 0) + ((mask & 2) ? 1 : 0); }
+
+// Fixed header layout; unused bytes up to HEADER_BYTES stay zero
+void encodeHeader(const CaptureInfo& info, uchar* h) {
+    std::memset(h, 0, HEADER_BYTES);
+    std::memcpy(h, MAGIC, sizeof(MAGIC));
+    put<quint32>(h, 8, VERSION);
+    put<quint32>(h, 12, HEADER_BYTES);
+    encodeCaptureInfo(info, h + 16);
+}
+
+bool decodeHeader(const uchar* h, qint64 size, CaptureInfo& info, int& headerBytes) {
+    if (size < HEADER_BYTES || std::memcmp(h, MAGIC, sizeof(MAGIC)) != 0) return false;
+    if (get<quint32>(h, 8) != VERSION) return false;
+    headerBytes = static_cast<int>(get<quint32>(h, 12));
+    if (headerBytes < HEADER_BYTES || headerBytes > size) return false;
+    decodeCaptureInfo(h + 16, info);
+    return info.channelMask != 0;
+}
+}
+
+void encodeCaptureInfo(const CaptureInfo& info, uchar* out) {
+    std::memset(out, 0, CAPTURE_INFO_BYTES);
+    putDouble(out, 0, info.sampleRate);
+    putDouble(out, 8, info.ch1Gain);
+    putDouble(out, 16, info.ch2Gain);
+    put<qint32>(out, 24, info.ch1Offset);
+    put<qint32>(out, 28, info.ch2Offset);
+    put<qint32>(out, 32, info.channelMask);
+    put<qint32>(out, 36, info.trigSource);
+    put<qint32>(out, 40, info.trigSlope);
+    put<qint32>(out, 44, info.trigLevel);
+    put<qint32>(out, 48, info.preTrigger);
+    put<qint32>(out, 52, info.holdoff);
+    put<qint32>(out, 56, info.recordLength);
+    put<qint64>(out, 64, info.startTime);
+    put<qint64>(out, 72, info.endTime);
+    put<quint64>(out, 80, info.totalSamples);
+}
+
+void decodeCaptureInfo(const uchar* in, CaptureInfo& info) {
+    info.sampleRate = getDouble(in, 0);
+    info.ch1Gain = getDouble(in, 8);
+    info.ch2Gain = getDouble(in, 16);
+    info.ch1Offset = get<qint32>(in, 24);
+    info.ch2Offset = get<qint32>(in, 28);
+    info.channelMask = get<qint32>(in, 32) & 3;
+    info.trigSource = get<qint32>(in, 36);
+    info.trigSlope = get<qint32>(in, 40);
+    info.trigLevel = get<qint32>(in, 44);
+    info.preTrigger = get<qint32>(in, 48);
+    info.holdoff = get<qint32>(in, 52);
+    info.recordLength = get<qint32>(in, 56);
+    info.startTime = get<qint64>(in, 64);
+    info.endTime = get<qint64>(in, 72);
+    info.totalSamples = get<quint64>(in, 80);
+}
+
+// --- Writer ---
+
+CaptureFileWriter::CaptureFileWriter(QObject* parent) : QObject(parent) {}
+
+CaptureFileWriter::~CaptureFileWriter() {
+    stop();
+}
+
+bool CaptureFileWriter::start(const QString& path, const CaptureInfo& info, const CaptureHistory* source) {
+    stop();
+    if (!source || channelsIn(info.channelMask) == 0) return false;
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "[CaptureFileWriter] Failed to open" << path << ":" << file.errorString();
+        return false;
+    }
+    header = info;
+    header.startTime = QDateTime::currentMSecsSinceEpoch();
+    header.endTime = 0;
+    header.totalSamples = 0;
+    uchar h[HEADER_BYTES];
+    encodeHeader(header, h);
+    if (file.write(reinterpret_cast<const char*>(h), HEADER_BYTES) != HEADER_BYTES) {
+        qWarning() << "[CaptureFileWriter] Failed to write header:" << file.errorString();
+        file.close();
+        return false;
+    }
+    history = source;
+    nextIndex = history->totalSamples();
+    startMs = header.startTime;
+    written.store(0, std::memory_order_relaxed);
+    lost.store(0, std::memory_order_relaxed);
+    blockBuffer.resize(BLOCK_HEADER_BYTES + 2 * BLOCK_SAMPLES);
+    stopRequested.store(false, std::memory_order_release);
+    worker = QThread::create([this]() { run(); });
+    worker->start();
+    qDebug() << "[CaptureFileWriter] Recording to" << path;
+    return true;
+}
+
+void CaptureFileWriter::stop() {
+    if (!worker) return;
+    stopRequested.store(true, std::memory_order_release);
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+
+    // Header totals are only known now; readers do not depend on them
+    header.endTime = QDateTime::currentMSecsSinceEpoch();
+    header.totalSamples = samplesWritten();
+    uchar h[HEADER_BYTES];
+    encodeHeader(header, h);
+    if (file.seek(0)) file.write(reinterpret_cast<const char*>(h), HEADER_BYTES);
+    file.close();
+    qDebug() << "[CaptureFileWriter] Closed capture:" << samplesWritten() << "samples written,"
+             << samplesLost() << "lost";
+}
+
+void CaptureFileWriter::run() {
+    while (!stopRequested.load(std::memory_order_acquire)) {
+        if (!drain()) QThread::msleep(DRAIN_INTERVAL_MS);
+    }
+    // Flush whatever the acquisition appended before the stop
+    while (drain()) {}
+    file.flush();
+}
+
+// Writes at most one block; true if it wrote something
+bool CaptureFileWriter::drain() {
+    quint64 total = history->totalSamples();
+    if (total < nextIndex) {
+        // The history was reset (a new stream started); follow it
+        nextIndex = 0;
+    }
+    if (!history->isIntact(nextIndex)) {
+        const quint64 oldest = total - history->capacity();
+        lost.fetch_add(oldest - nextIndex, std::memory_order_relaxed);
+        nextIndex = oldest;
+    }
+    const int count = static_cast<int>(qMin<quint64>(total - nextIndex, BLOCK_SAMPLES));
+    if (count <= 0) return false;
+
+    uchar* block = blockBuffer.data();
+    put<quint32>(block, 0, BLOCK_MAGIC);
+    put<quint32>(block, 4, static_cast<quint32>(count));
+    put<quint64>(block, 8, nextIndex);
+    put<qint64>(block, 16, QDateTime::currentMSecsSinceEpoch() - startMs);
+    int bytes = BLOCK_HEADER_BYTES;
+    for (int ch = 0; ch < 2; ++ch) {
+        if (!(header.channelMask & (1 << ch))) continue;
+        CaptureHistory::Span span;
+        if (!history->window(ch, nextIndex, count, span)) return false;
+        std::memcpy(block + bytes, span.first, span.firstLength);
+        if (span.secondLength > 0) std::memcpy(block + bytes + span.firstLength, span.second, span.secondLength);
+        bytes += count;
+    }
+    // Copied while the producer kept writing; only keep it if it was not lapped
+    if (!history->isIntact(nextIndex)) return true;
+
+    if (file.write(reinterpret_cast<const char*>(block), bytes) != bytes) {
+        qWarning() << "[CaptureFileWriter] Write failed:" << file.errorString();
+        emit errorOccurred(file.errorString());
+        stopRequested.store(true, std::memory_order_release);
+        return false;
+    }
+    nextIndex += count;
+    written.fetch_add(count, std::memory_order_relaxed);
+    return true;
+}
+
+// --- Reader ---
+
+bool CaptureFileReader::open(const QString& path) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "[CaptureFileReader] Failed to open" << path << ":" << file.errorString();
+        return false;
+    }
+    size = file.size();
+    base = size > 0 ? file.map(0, size) : nullptr;
+    int headerBytes = 0;
+    if (!base || !decodeHeader(base, size, header, headerBytes)) {
+        qWarning() << "[CaptureFileReader] Not a capture file:" << path;
+        close();
+        return false;
+    }
+
+    // Index the blocks; a torn last block (crash while recording) is ignored
+    const int channels = channelsIn(header.channelMask);
+    qint64 offset = headerBytes;
+    while (offset + BLOCK_HEADER_BYTES <= size) {
+        const uchar* h = base + offset;
+        if (get<quint32>(h, 0) != BLOCK_MAGIC) break;
+        const int count = static_cast<int>(get<quint32>(h, 4));
+        const qint64 payload = qint64(count) * channels;
+        if (count <= 0 || offset + BLOCK_HEADER_BYTES + payload > size) break;
+        Block block;
+        block.offset = offset + BLOCK_HEADER_BYTES;
+        block.firstSample = samples;
+        block.streamIndex = get<quint64>(h, 8);
+        block.count = count;
+        if (!blocks.isEmpty()) {
+            const Block& previous = blocks.last();
+            if (block.streamIndex != previous.streamIndex + quint64(previous.count)) gapStarts.append(samples);
+        }
+        blocks.append(block);
+        samples += count;
+        offset += BLOCK_HEADER_BYTES + payload;
+    }
+    qDebug() << "[CaptureFileReader] Opened" << path << ":" << samples << "samples in" << blocks.size() << "blocks,"
+             << gapStarts.size() << "gaps";
+    return true;
+}
+
+void CaptureFileReader::close() {
+    if (base) file.unmap(base);
+    base = nullptr;
+    size = 0;
+    if (file.isOpen()) file.close();
+    header = CaptureInfo();
+    blocks.clear();
+    gapStarts.clear();
+    samples = 0;
+}
+
+bool CaptureFileReader::isContiguous(quint64 first, int count) const {
+    // First gap after first; the range is contiguous if it ends by then
+    const auto it = std::upper_bound(gapStarts.begin(), gapStarts.end(), first);
+    return it == gapStarts.end() || first + quint64(qMax(count, 0)) <= *it;
+}
+
+bool CaptureFileReader::read(int channel, quint64 first, int count, quint8* out) const {
+    if (!base || channel < 0 || channel > 1 || !hasChannel(channel) || count < 0) return false;
+    if (first + count > samples) return false;
+    // Also covers a file without blocks, where there is nothing to search
+    if (count == 0) return true;
+    // Last block starting at or before first
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), first,
+                               [](quint64 index, const Block& b) { return index < b.firstSample; });
+    --it;
+    // CH2 follows CH1 within a block when both are stored
+    const bool afterCh1 = (channel == 1) && hasChannel(0);
+    while (count > 0) {
+        const int skip = static_cast<int>(first - it->firstSample);
+        const int n = qMin(count, it->count - skip);
+        const uchar* src = base + it->offset + (afterCh1 ? it->count : 0) + skip;
+        std::memcpy(out, src, n);
+        out += n;
+        first += n;
+        count -= n;
+        ++it;
+    }
+    return true;
+}
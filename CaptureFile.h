@@ -0,0 +1,122 @@
+#pragma once
+#include <QObject>
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+#include <atomic>
+
+class CaptureHistory;
+class QThread;
+
+// Acquisition settings stored in the header of a binary capture file
+struct CaptureInfo {
+    double sampleRate = 0.0;   // samples per second per channel
+    double ch1Gain = 1.0;
+    double ch2Gain = 1.0;
+    int ch1Offset = 0;
+    int ch2Offset = 0;
+    int channelMask = 3;       // bit 0 = CH1, bit 1 = CH2
+    int trigSource = 0;        // 0=Auto, 1=CH1, 2=CH2, 3=External
+    int trigSlope = 0;         // 0=L->H, 1=H->L
+    int trigLevel = 0;         // raw 12-bit level as sent to the device
+    int preTrigger = 0;        // samples
+    int holdoff = 0;           // samples
+    int recordLength = 0;      // samples per triggered record, 0 = continuous stream
+    qint64 startTime = 0;      // ms since epoch (UTC)
+    qint64 endTime = 0;        // 0 if the recording was not closed cleanly
+    quint64 totalSamples = 0;  // per channel; 0 if not closed cleanly
+};
+
+// CaptureInfo as stored in file headers: CAPTURE_INFO_BYTES, little endian
+constexpr int CAPTURE_INFO_BYTES = 88;
+void encodeCaptureInfo(const CaptureInfo& info, uchar* out);
+void decodeCaptureInfo(const uchar* in, CaptureInfo& info);
+
+// Binary capture layout, all fields little endian: a fixed-size file
+// header, then blocks of [block header + count raw 8-bit samples for each
+// channel in channelMask, CH1 first]. Blocks are self-delimiting, so a file
+// cut short by a crash is still readable up to its last complete block.
+
+// Writes a capture file on its own thread, draining the acquisition
+// history as it fills. The acquisition thread only appends to the history;
+// file I/O never blocks it or the GUI. If the disk falls so far behind that
+// the history laps the writer, the overwritten samples are counted as lost
+// and the next block starts at the oldest sample still held.
+class CaptureFileWriter : public QObject {
+    Q_OBJECT
+public:
+    explicit CaptureFileWriter(QObject* parent = nullptr);
+    ~CaptureFileWriter();
+
+    // Starts recording everything appended to source from now on
+    bool start(const QString& path, const CaptureInfo& info, const CaptureHistory* source);
+    // Writes what is left in the history, finalises the header and closes the file
+    void stop();
+    bool isActive() const { return worker != nullptr; }
+
+    quint64 samplesWritten() const { return written.load(std::memory_order_relaxed); }
+    quint64 samplesLost() const { return lost.load(std::memory_order_relaxed); }
+
+signals:
+    void errorOccurred(const QString& msg);
+
+private:
+    void run();
+    bool drain();
+
+    QFile file;
+    CaptureInfo header;
+    const CaptureHistory* history = nullptr;
+    QThread* worker = nullptr;
+    std::atomic<bool> stopRequested{false};
+    quint64 nextIndex = 0;      // next history sample to write
+    qint64 startMs = 0;
+    QVector<quint8> blockBuffer;
+    std::atomic<quint64> written{0};
+    std::atomic<quint64> lost{0};
+};
+
+// Read-only view of a capture file through a memory mapping: opening only
+// walks the block headers, and sample reads copy straight out of the page
+// cache, so multi-GB captures reopen instantly.
+class CaptureFileReader {
+public:
+    ~CaptureFileReader() { close(); }
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return base != nullptr; }
+    QString fileName() const { return file.fileName(); }
+
+    const CaptureInfo& info() const { return header; }
+    quint64 sampleCount() const { return samples; }
+    bool hasChannel(int channel) const { return header.channelMask & (1 << channel); }
+
+    // Copies samples [first, first + count) of a channel in file order;
+    // false if the range is outside the file or the channel is not stored.
+    // File order joins the blocks end to end, across gaps too.
+    bool read(int channel, quint64 first, int count, quint8* out) const;
+
+    // File-order indices of the samples that do not follow on from the one
+    // before, because the recorder lost samples (or the stream restarted)
+    const QVector<quint64>& gaps() const { return gapStarts; }
+    // False if [first, first + count) spans a gap
+    bool isContiguous(quint64 first, int count) const;
+
+private:
+    struct Block {
+        qint64 offset = 0;       // file offset of the first sample
+        quint64 firstSample = 0; // in file order
+        quint64 streamIndex = 0; // in the acquisition history, as written
+        int count = 0;
+    };
+
+    QFile file;
+    uchar* base = nullptr;
+    qint64 size = 0;
+    CaptureInfo header;
+    QVector<Block> blocks;
+    QVector<quint64> gapStarts;
+    quint64 samples = 0;
+};
@@ -0,0 +1,66 @@
+#include "CaptureHistory.h"
+#include <cstring>
+
+CaptureHistory::CaptureHistory(int capacityPerChannel) {
+    setCapacity(capacityPerChannel);
+}
+
+void CaptureHistory::setCapacity(int capacityPerChannel) {
+    // Round up to a power of two so indices can wrap with a mask
+    int size = 1;
+    while (size < capacityPerChannel) size <<= 1;
+    for (int ch = 0; ch < 2; ++ch) {
+        storage[ch].fill(0x80, size); // Mid-scale until real samples arrive
+        data[ch] = storage[ch].data();
+    }
+    mask = static_cast<quint64>(size - 1);
+    reset();
+}
+
+void CaptureHistory::reset() {
+    written.store(0, std::memory_order_release);
+    notifyPending.store(false, std::memory_order_release);
+}
+
+bool CaptureHistory::append(const char* ch1, const char* ch2, int count) {
+    if (count <= 0) return false;
+    const quint64 w = written.load(std::memory_order_relaxed);
+    const quint64 cap = mask + 1;
+    // A block longer than the ring only leaves its tail behind
+    int skip = 0;
+    if (static_cast<quint64>(count) > cap) skip = count - static_cast<int>(cap);
+    const quint64 pos = (w + skip) & mask;
+    const int n = count - skip;
+    const int firstPart = static_cast<int>(qMin<quint64>(n, cap - pos));
+    const char* sources[2] = {ch1, ch2};
+    for (int ch = 0; ch < 2; ++ch) {
+        if (!sources[ch]) continue;
+        const char* src = sources[ch] + skip;
+        std::memcpy(data[ch] + pos, src, firstPart);
+        if (n > firstPart) std::memcpy(data[ch], src + firstPart, n - firstPart);
+    }
+    written.store(w + count, std::memory_order_release);
+    return !notifyPending.exchange(true, std::memory_order_acq_rel);
+}
+
+bool CaptureHistory::window(int channel, quint64 start, int count, Span& out) const {
+    out = Span();
+    if (channel < 0 || channel > 1 || count < 0) return false;
+    const quint64 w = totalSamples();
+    if (start + count > w || !isIntact(start)) return false;
+    if (count == 0) return true;
+    const quint64 cap = mask + 1;
+    const quint64 pos = start & mask;
+    out.first = data[channel] + pos;
+    out.firstLength = static_cast<int>(qMin<quint64>(count, cap - pos));
+    if (count > out.firstLength) {
+        out.second = data[channel];
+        out.secondLength = count - out.firstLength;
+    }
+    return true;
+}
+
+bool CaptureHistory::isIntact(quint64 start) const {
+    const quint64 w = totalSamples();
+    return w <= mask + 1 || start >= w - (mask + 1);
+}
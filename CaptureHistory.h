@@ -0,0 +1,53 @@
+#pragma once
+#include <QVector>
+#include <QtGlobal>
+#include <atomic>
+
+// Fixed-capacity history of raw 8-bit samples per channel, filled by the
+// acquisition thread while streaming and read by the GUI thread. Storage is
+// allocated once; the producer overwrites the oldest samples, and readers
+// get windows into the buffer itself (at most two contiguous pieces when
+// the window wraps) rather than copies. Both channels share one sample
+// counter, so index i refers to the same instant on CH1 and CH2.
+class CaptureHistory {
+public:
+    // A window into the ring; second is empty unless the window wraps
+    struct Span {
+        const quint8* first = nullptr;
+        int firstLength = 0;
+        const quint8* second = nullptr;
+        int secondLength = 0;
+
+        int size() const { return firstLength + secondLength; }
+        quint8 operator[](int i) const { return i < firstLength ? first[i] : second[i - firstLength]; }
+    };
+
+    explicit CaptureHistory(int capacityPerChannel = 1 << 20);
+
+    // Reallocates and empties the history. Not thread-safe: call only while
+    // no stream is running.
+    void setCapacity(int capacityPerChannel);
+    void reset();
+    int capacity() const { return static_cast<int>(mask + 1); }
+
+    // Producer side (acquisition thread). Either channel may be nullptr when
+    // it is not being streamed; its history is then left untouched.
+    // Returns true if the consumer needs a wake-up.
+    bool append(const char* ch1, const char* ch2, int count);
+
+    // Consumer side (GUI thread)
+    void clearNotified() { notifyPending.store(false, std::memory_order_release); }
+    quint64 totalSamples() const { return written.load(std::memory_order_acquire); }
+    // Samples [start, start + count); false if any part is not (or no longer) held
+    bool window(int channel, quint64 start, int count, Span& out) const;
+    // True while samples from start onwards have not been overwritten; check
+    // after reading a window to detect that the producer lapped the reader
+    bool isIntact(quint64 start) const;
+
+private:
+    QVector<quint8> storage[2];
+    quint8* data[2] = {nullptr, nullptr};
+    quint64 mask = 0;
+    std::atomic<quint64> written{0};
+    std::atomic<bool> notifyPending{false};
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+// Tables and commands for the board's DDS generator. The firmware plays up
+// to 512 8-bit samples on a timer divided down from its 32 MHz clock; the
+// host picks the table, timer period and length for a waveform and
+// frequency and uploads them as 'p', 'N' and 'r' commands, then 'f' to run.
+
+enum class DdsWaveform { Sine, Square, Triangle, RampUp, RampDown };
+
+// One period of a built-in waveform, as in the VB.NET application
+const QVector<quint8>& ddsWaveformTable(DdsWaveform shape);
+
+struct DdsUpload {
+    QByteArray period;  // 'p', timer period (hi, lo)
+    QByteArray samples; // 'N', table length (hi, lo)
+    QByteArray table;   // 'r', 0, 0, then the table
+};
+
+// Commands that play one period of waveform (256 samples; shorter ones are
+// padded with 0) at frequency Hz; false if no usable table comes out
+bool buildDdsUpload(const QVector<quint8>& waveform, int frequency, DdsUpload& out);
+// 'f', 0, 0: starts the generator on the uploaded table
+QByteArray ddsRunCommand();
+// Overwrites the start of waveform with the first column of up to 256 CSV
+// lines (an arbitrary waveform file); false if the file cannot be opened
+bool readDdsCsv(const QString& path, QVector<quint8>& waveform);
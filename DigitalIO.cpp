@@ -1,19 +1,120 @@
 #include "DigitalIO.h"
+#include "FrameRing.h"
+#include "SerialHandler.h"
 #include <QDebug>
+#include <QThread>
+#include <QTimer>
 
-DigitalIO::DigitalIO(QObject *parent) : QObject(parent) {}
+namespace {
+constexpr int INPUT_REPLY_BYTES = 2; // 'I', pin states
+// The generator latches the count before it takes the prescaler index
+constexpr int FREQ_INDEX_DELAY_MS = 30;
+constexpr int FREQ_CLOCK_HZ = 32000000;
+}
+
+DigitalIO::DigitalIO(SerialHandler *link, QObject *parent) : QObject(parent), link(link) {}
 
 void DigitalIO::setDigitalOut(int value) {
-    // Send digital out command to device via SerialHandler
-    // ...
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setDigitalOut(value); }, Qt::QueuedConnection);
+        return;
+    }
+    outState = static_cast<quint8>(value);
+    flushOutputs();
+}
+
+void DigitalIO::setBit(int bit, bool high) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setBit(bit, high); }, Qt::QueuedConnection);
+        return;
+    }
+    if (bit < 0 || bit > 7) return;
+    if (high) outState |= (1 << bit);
+    else outState &= ~(1 << bit);
+    // Toggles arriving in the same pass go out as one command
+    if (outPending) return;
+    outPending = true;
+    QTimer::singleShot(0, this, &DigitalIO::flushOutputs);
 }
+
+void DigitalIO::flushOutputs() {
+    outPending = false;
+    // Only the newest output state matters if the link is busy
+    link->queueAuxCommand(QByteArray(1, 'h') + char(outState), 0, true);
+}
+
 void DigitalIO::readDigitalIn() {
-    // Send digital in read command to device via SerialHandler
-    // ...
+    link->queueAuxCommand(QByteArray(1, 'i'), INPUT_REPLY_BYTES, true);
 }
+
+void DigitalIO::setPollInterval(int ms) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setPollInterval(ms); }, Qt::QueuedConnection);
+        return;
+    }
+    if (!pollTimer) {
+        pollTimer = new QTimer(this);
+        connect(pollTimer, &QTimer::timeout, this, &DigitalIO::readDigitalIn);
+    }
+    if (ms <= 0) {
+        pollTimer->stop();
+        return;
+    }
+    pollTimer->start(ms);
+}
+
 void DigitalIO::runDigitalFreq(int frequency) {
-    // Send digital frequency generator command to device via SerialHandler
-    // ...
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { runDigitalFreq(frequency); }, Qt::QueuedConnection);
+        return;
+    }
+    if (frequency <= 0) return;
+    // Prescalers of the generator timer, by index
+    static const int dividers[] = {1, 2, 4, 8, 64, 256, 1024};
+    int index = 0;
+    int count = FREQ_CLOCK_HZ / frequency;
+    while (count > 65535 && index < 6) {
+        ++index;
+        count = FREQ_CLOCK_HZ / dividers[index] / frequency;
+    }
+    QByteArray countCmd(1, 'c');
+    countCmd.append(static_cast<char>(count / 256));
+    countCmd.append(static_cast<char>(count % 256));
+    link->queueAuxCommand(countCmd, 0, true);
+    QTimer::singleShot(FREQ_INDEX_DELAY_MS, this, [this, index]() {
+        // 3 bytes like the other opcodes; the last one is unused
+        QByteArray indexCmd(1, 'd');
+        indexCmd.append(static_cast<char>(index));
+        indexCmd.append('\0');
+        link->queueAuxCommand(indexCmd, 0, true);
+    });
+    qDebug() << "[DigitalIO] Frequency" << frequency << "Hz: count" << count << "prescaler index" << index;
+}
+
+void DigitalIO::runSequence(const QVector<quint8> &states) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { runSequence(states); }, Qt::QueuedConnection);
+        return;
+    }
+    // Queued without coalescing, so every step reaches the pins
+    for (quint8 state : states) {
+        link->queueAuxCommand(QByteArray(1, 'h') + char(state));
+    }
+    if (!states.isEmpty()) outState = states.last();
+}
+
+void DigitalIO::onAuxReply(const QByteArray &cmd, const QByteArray &reply) {
+    if (cmd.isEmpty() || cmd[0] != 'i') return;
+    if (reply.size() < INPUT_REPLY_BYTES || reply[0] != 'I') {
+        qWarning() << "[DigitalIO] Bad input reply" << reply.toHex();
+        return;
+    }
+    const quint8 inputs = static_cast<quint8>(reply[1]);
+    const quint8 changed = inputsKnown ? quint8(inputs ^ lastInputs) : quint8(0xFF);
+    lastInputs = inputs;
+    inputsKnown = true;
+    emit inputsSampled(inputs, acquisitionClockNs());
+    if (changed) emit inputsChanged(inputs, changed);
 }
 
-DigitalIO::~DigitalIO() {} 
\ No newline at end of file
+DigitalIO::~DigitalIO() {}
\ No newline at end of file
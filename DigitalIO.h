@@ -1,13 +1,49 @@
 #pragma once
 #include <QObject>
+#include <QByteArray>
+#include <QVector>
 
+class QTimer;
+class SerialHandler;
+
+// Digital outputs, inputs and the digital frequency generator. Lives on the
+// acquisition thread next to its SerialHandler and sends everything through
+// SerialHandler::queueAuxCommand(), so commands go out between scope
+// captures instead of racing them. Output changes made within one event-loop
+// pass are coalesced into a single 'h' command, inputs can be polled on a
+// fixed interval, and inputsChanged() fires only when a pin actually moves.
+// Every public method may be called from any thread.
 class DigitalIO : public QObject {
     Q_OBJECT
 public:
-    explicit DigitalIO(QObject *parent = nullptr);
+    explicit DigitalIO(SerialHandler *link, QObject *parent = nullptr);
     ~DigitalIO();
     void setDigitalOut(int value);
+    void setBit(int bit, bool high);
     void readDigitalIn();
+    // 0 stops polling
+    void setPollInterval(int ms);
     void runDigitalFreq(int frequency);
-    // TODO: Add digital I/O methods
-}; 
\ No newline at end of file
+    // One output state per step, written back to back at link speed
+    void runSequence(const QVector<quint8> &states);
+
+public slots:
+    void onAuxReply(const QByteArray &cmd, const QByteArray &reply);
+
+signals:
+    // changed has a bit set for every input that differs from the last read
+    void inputsChanged(quint8 inputs, quint8 changed);
+    // Every read, changed or not, stamped with acquisitionClockNs(); the
+    // poll interval makes these a sample stream for the bus decoders
+    void inputsSampled(quint8 inputs, qint64 timestampNs);
+
+private:
+    void flushOutputs();
+
+    SerialHandler *link;
+    QTimer *pollTimer = nullptr;
+    quint8 outState = 0;
+    bool outPending = false;
+    quint8 lastInputs = 0;
+    bool inputsKnown = false;
+};
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "DspChain.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double PI = 3.14159265358979323846;
+}
+
+void DspChain::setConfig(const Config& config) {
+    if (config == settings) return;
+    settings = config;
+    settings.movingAverage = qMax(1, settings.movingAverage);
+    settings.frameAverage = qMax(1, settings.frameAverage);
+    settings.lowPassCutoff = qBound(0.0, settings.lowPassCutoff, 0.49);
+    if (settings.lowPassCutoff > 0.0) {
+        // Bilinear transform of the analogue Butterworth prototype
+        const double k = std::tan(PI * settings.lowPassCutoff);
+        const double q = std::sqrt(0.5);
+        const double norm = 1.0 / (1.0 + k / q + k * k);
+        b0 = k * k * norm;
+        b1 = 2.0 * b0;
+        b2 = b0;
+        a1 = 2.0 * (k * k - 1.0) * norm;
+        a2 = (1.0 - k / q + k * k) * norm;
+    }
+    reset();
+}
+
+void DspChain::reset() {
+    historyCount = 0;
+    historyNext = 0;
+    historyLength = 0;
+}
+
+void DspChain::process(QVector<double>& samples, int frameLength) {
+    if (samples.isEmpty()) return;
+    if (settings.interpolate && frameLength > 0) interpolate(samples, frameLength);
+    if (settings.movingAverage > 1) movingAverage(samples);
+    if (settings.lowPassCutoff > 0.0) lowPass(samples);
+    if (settings.frameAverage > 1) averageFrames(samples);
+    if (settings.trimLeading > 0 && samples.size() > settings.trimLeading) {
+        std::copy(samples.constData() + settings.trimLeading, samples.constData() + samples.size(), samples.data());
+        samples.resize(samples.size() - settings.trimLeading);
+    }
+}
+
+// out[0] = in[0], out[2k+1] = (in[k] + in[k+1]) / 2, out[2k+2] = in[k+1].
+// Runs from the end so every input is read before its slot is overwritten.
+void DspChain::interpolate(QVector<double>& x, int length) const {
+    const int n = qMin(x.size(), length); // inputs that survive the resize
+    x.resize(length);
+    double* d = x.data();
+    for (int i = (length - 1) | 1; i >= 1; i -= 2) {
+        if (i >= length) continue;
+        const int k = i / 2;
+        const double a = d[k];
+        const double b = (k + 1 < n) ? d[k + 1] : a;
+        if (i + 1 < length) d[i + 1] = b;
+        d[i] = (a + b) / 2.0;
+    }
+}
+
+// Mean of x[i - w/2, i + w/2], clipped at the ends, from one running sum
+void DspChain::movingAverage(QVector<double>& x) {
+    const int n = x.size();
+    const int half = settings.movingAverage / 2;
+    // Inputs behind the window's trailing edge have been overwritten; keep them here
+    window.resize(half + 1);
+    double* d = x.data();
+    double sum = 0.0;
+    int count = 0;
+    for (int j = 0; j <= half && j < n; ++j) {
+        sum += d[j];
+        ++count;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (i > 0) {
+            if (i + half < n) {
+                sum += d[i + half];
+                ++count;
+            }
+            if (i - half - 1 >= 0) {
+                sum -= window[i % (half + 1)];
+                --count;
+            }
+        }
+        window[i % (half + 1)] = d[i];
+        d[i] = sum / count;
+    }
+}
+
+// Forward then backward pass: zero phase, so edges stay where the trigger put them
+void DspChain::lowPass(QVector<double>& x) const {
+    const int n = x.size();
+    double* d = x.data();
+    auto pass = [&](int first, int step) {
+        // Start from the steady state for the first sample so there is no step transient
+        const double x0 = d[first];
+        double z2 = (b2 - a2) * x0;
+        double z1 = (b1 - a1) * x0 + z2;
+        for (int i = first, k = 0; k < n; i += step, ++k) {
+            const double in = d[i];
+            const double out = b0 * in + z1;
+            z1 = b1 * in - a1 * out + z2;
+            z2 = b2 * in - a2 * out;
+            d[i] = out;
+        }
+    };
+    pass(0, 1);
+    pass(n - 1, -1);
+}
+
+void DspChain::averageFrames(QVector<double>& x) {
+    const int n = x.size();
+    const int frames = settings.frameAverage;
+    if (n != historyLength) {
+        // New record length: start over
+        historyLength = n;
+        historyCount = 0;
+        historyNext = 0;
+        history.resize(frames * n);
+        sums.resize(n);
+        std::fill(sums.begin(), sums.end(), 0.0);
+    }
+    double* slot = history.data() + historyNext * n;
+    double* s = sums.data();
+    double* d = x.data();
+    const bool full = historyCount == frames;
+    for (int i = 0; i < n; ++i) {
+        if (full) s[i] -= slot[i];
+        slot[i] = d[i];
+        s[i] += d[i];
+    }
+    if (!full) ++historyCount;
+    historyNext = (historyNext + 1) % frames;
+    const double scale = 1.0 / historyCount;
+    for (int i = 0; i < n; ++i) d[i] = s[i] * scale;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <QVector>
+
+// Per-channel filter chain applied to decoded frames, in this order:
+// 2x interpolation (the 2 Mbps "averaging"), centred moving average,
+// low-pass, N-frame averaging and trimming of the leading samples. Every
+// stage works in place on the frame's buffer; the only other storage is
+// the chain's own scratch and frame history, which keep their capacity,
+// so once a frame size has been seen process() does not allocate.
+class DspChain {
+public:
+    struct Config {
+        bool interpolate = false;   // 2x linear interpolation up to the frame's requested length
+        int movingAverage = 1;      // centred running-sum window in samples; 1 = off
+        double lowPassCutoff = 0.0; // 2nd-order Butterworth, zero phase; fraction of the sample rate (0..0.5), 0 = off
+        int frameAverage = 1;       // mean of the last N frames; 1 = off
+        int trimLeading = 0;        // samples dropped from the start once filtered
+
+        bool operator==(const Config& o) const {
+            return interpolate == o.interpolate && movingAverage == o.movingAverage
+                   && lowPassCutoff == o.lowPassCutoff && frameAverage == o.frameAverage
+                   && trimLeading == o.trimLeading;
+        }
+        bool operator!=(const Config& o) const { return !(*this == o); }
+    };
+
+    // Takes effect on the next frame; a changed config restarts frame averaging
+    void setConfig(const Config& config);
+    const Config& config() const { return settings; }
+    // Forgets the frames held for averaging
+    void reset();
+
+    // frameLength is the record length the capture was requested with
+    void process(QVector<double>& samples, int frameLength);
+
+private:
+    void interpolate(QVector<double>& x, int length) const;
+    void movingAverage(QVector<double>& x);
+    void lowPass(QVector<double>& x) const;
+    void averageFrames(QVector<double>& x);
+
+    Config settings;
+    // Butterworth biquad, transposed direct form II
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    QVector<double> window;   // originals still inside the moving-average window
+    QVector<double> history;  // frameAverage frames of historyLength samples
+    QVector<double> sums;     // per-sample sum over history
+    int historyLength = 0;
+    int historyCount = 0;
+    int historyNext = 0;
+};
@@ -0,0 +1,400 @@
+#include "DspWorker.h"
+#include "CaptureHistory.h"
+#include "FrameRecording.h"
+#include "PerfTrace.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+
+namespace {
+// Spectrum updates reach the GUI at most this often
+constexpr int SPECTRUM_PUBLISH_MS = 50;
+// History samples decoded per pass
+constexpr int HISTORY_CHUNK = 16384;
+// Streamed bus events waiting for the GUI; the oldest go first beyond this
+constexpr int MAX_PENDING_ANNOTATIONS = 65536;
+// A full decoded ring is warned about on the first drop and every this many after
+constexpr int DROP_WARNING_INTERVAL = 100;
+}
+
+DecodedFrameRing::DecodedFrameRing(int capacity, int maxFrameSamples) : SpscRing<DecodedFrame>(capacity) {
+    for (DecodedFrame& frame : storage()) {
+        frame.ch1.reserve(maxFrameSamples);
+        frame.ch2.reserve(maxFrameSamples);
+    }
+}
+
+DspWorker::DspWorker(FrameRing& input, QObject* parent) : QObject(parent), input(input) {}
+
+void DspWorker::setDecoderParams(double ch1Gain, int ch1Offset, double ch2Gain, int ch2Offset) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setDecoderParams(ch1Gain, ch1Offset, ch2Gain, ch2Offset); },
+                                  Qt::QueuedConnection);
+        return;
+    }
+    decoder.setParams(ch1Gain, ch1Offset, ch2Gain, ch2Offset);
+}
+
+void DspWorker::setChainConfig(int channel, const DspChain::Config& config) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setChainConfig(channel, config); }, Qt::QueuedConnection);
+        return;
+    }
+    if (channel < 0 || channel > 1) return;
+    chains[channel].setConfig(config);
+}
+
+void DspWorker::resetChains() {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this]() { resetChains(); }, Qt::QueuedConnection);
+        return;
+    }
+    chains[0].reset();
+    chains[1].reset();
+}
+
+void DspWorker::setSpectrumConfig(const SpectrumAnalyzer::Config& config, double sampleRate, bool enabled) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setSpectrumConfig(config, sampleRate, enabled); }, Qt::QueuedConnection);
+        return;
+    }
+    spectrumEnabled = enabled;
+    for (SpectrumAnalyzer& analyzer : analyzers) {
+        analyzer.setConfig(config);
+        analyzer.setSampleRate(sampleRate);
+    }
+    QMutexLocker lock(&snapshotMutex);
+    snapshotValid = false;
+}
+
+void DspWorker::setStreamSource(const CaptureHistory* history) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setStreamSource(history); }, Qt::QueuedConnection);
+        return;
+    }
+    streamHistory = history;
+    historyCursor = history ? history->totalSamples() : 0;
+    breakHistory();
+}
+
+void DspWorker::breakHistory() {
+    for (SpectrumAnalyzer& analyzer : analyzers) analyzer.breakStream();
+    buses.breakStream(BusConfig::Source::Analog);
+}
+
+void DspWorker::setBusDecoders(const QVector<BusConfig>& configs, double analogRate, double digitalRate) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setBusDecoders(configs, analogRate, digitalRate); },
+                                  Qt::QueuedConnection);
+        return;
+    }
+    buses.setBuses(configs, analogRate, digitalRate);
+    busAnalogRate = analogRate > 0.0 ? analogRate : 1.0;
+    digitalPosition = 0;
+    QMutexLocker lock(&annotationMutex);
+    pendingAnnotations.clear();
+}
+
+void DspWorker::takeAnnotations(QVector<ProtocolAnnotation>& out) {
+    annotationsPending.store(false, std::memory_order_release);
+    QMutexLocker lock(&annotationMutex);
+    out.swap(pendingAnnotations);
+    pendingAnnotations.clear();
+}
+
+void DspWorker::publishAnnotations() {
+    if (streamAnnotations.isEmpty()) return;
+    {
+        QMutexLocker lock(&annotationMutex);
+        pendingAnnotations += streamAnnotations;
+        const int excess = pendingAnnotations.size() - MAX_PENDING_ANNOTATIONS;
+        if (excess > 0) pendingAnnotations.remove(0, excess);
+    }
+    streamAnnotations.clear();
+    if (!annotationsPending.exchange(true, std::memory_order_acq_rel)) emit annotationsReady();
+}
+
+// One sample per read of the inputs, so the poll interval is the sample period
+void DspWorker::processDigitalInputs(quint8 inputs, qint64 timestampNs) {
+    if (!buses.hasSource(BusConfig::Source::Digital)) return;
+    buses.decodeDigital(&inputs, 1, digitalPosition++, timestampNs, streamAnnotations);
+    publishAnnotations();
+}
+
+void DspWorker::setMask(const WaveformMask& newMask) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setMask(newMask); }, Qt::QueuedConnection);
+        return;
+    }
+    mask = newMask;
+    maskLearnRemaining = 0;
+    publishMask();
+    resetMaskStats();
+}
+
+void DspWorker::learnMask(int records, double marginVolts, int marginSamples) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { learnMask(records, marginVolts, marginSamples); },
+                                  Qt::QueuedConnection);
+        return;
+    }
+    mask.beginLearning();
+    maskLearnRemaining = qMax(1, records);
+    maskMarginVolts = marginVolts;
+    maskMarginSamples = qMax(0, marginSamples);
+    publishMask();
+    resetMaskStats();
+}
+
+void DspWorker::setMaskAlignment(const MaskAlignment& alignment) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setMaskAlignment(alignment); }, Qt::QueuedConnection);
+        return;
+    }
+    maskAlignment = alignment;
+    maskTrigger.setLevel(alignment.level);
+    maskTrigger.setHysteresis(alignment.hysteresis);
+    maskTrigger.setSlope(alignment.slope);
+}
+
+void DspWorker::setMaskOptions(bool stopOnFail, FrameRecorder* failRecorder) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setMaskOptions(stopOnFail, failRecorder); }, Qt::QueuedConnection);
+        return;
+    }
+    maskStopOnFail = stopOnFail;
+    maskFailRecorder = failRecorder;
+    if (!stopOnFail) maskHaltFlag.store(false, std::memory_order_relaxed);
+}
+
+// The counters are only written on the worker thread; a reset from
+// elsewhere can race a frame in flight, which at worst counts it
+void DspWorker::resetMaskStats() {
+    maskTested.store(0, std::memory_order_relaxed);
+    maskPassed.store(0, std::memory_order_relaxed);
+    maskFailed.store(0, std::memory_order_relaxed);
+    maskUntriggered.store(0, std::memory_order_relaxed);
+    maskViolations.store(0, std::memory_order_relaxed);
+    maskDropBase.store(input.droppedFrames(), std::memory_order_relaxed);
+    maskHaltFlag.store(false, std::memory_order_release);
+}
+
+void DspWorker::resumeMaskTest() {
+    maskHaltFlag.store(false, std::memory_order_release);
+}
+
+MaskStats DspWorker::maskStats() const {
+    MaskStats stats;
+    stats.tested = maskTested.load(std::memory_order_relaxed);
+    stats.passed = maskPassed.load(std::memory_order_relaxed);
+    stats.failed = maskFailed.load(std::memory_order_relaxed);
+    stats.untriggered = maskUntriggered.load(std::memory_order_relaxed);
+    stats.violations = maskViolations.load(std::memory_order_relaxed);
+    stats.untested = quint64(qMax(0, input.droppedFrames() - maskDropBase.load(std::memory_order_relaxed)));
+    stats.halted = maskHaltFlag.load(std::memory_order_acquire);
+    return stats;
+}
+
+WaveformMask DspWorker::currentMask() {
+    QMutexLocker lock(&maskMutex);
+    return publishedMask;
+}
+
+void DspWorker::publishMask() {
+    QMutexLocker lock(&maskMutex);
+    publishedMask = mask;
+}
+
+// Cuts the frame the way the GUI's trigger does, then learns from it or
+// tests it
+void DspWorker::testMask(const AcquisitionFrame& raw, DecodedFrame& frame) {
+    const QVector<double>* ch1 = &frame.ch1;
+    const QVector<double>* ch2 = &frame.ch2;
+    if (maskAlignment.source >= 0) {
+        const QVector<double>& source = maskAlignment.source == 0 ? frame.ch1 : frame.ch2;
+        const int length = qMax(2, int(source.size() * maskAlignment.viewFraction));
+        maskTrigger.setPreTrigger(length * maskAlignment.preTriggerPercent / 100);
+        TriggerEngine::Event event;
+        if (source.isEmpty() || !maskTrigger.findInRecord(source, length, event)) {
+            if (maskLearnRemaining == 0) maskUntriggered.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        const QVector<double>* channels[2] = {&frame.ch1, &frame.ch2};
+        for (int ch = 0; ch < 2; ++ch) {
+            if (channels[ch]->isEmpty()) maskWindow[ch].clear();
+            else maskTrigger.extractWindow(channels[ch]->constData(), channels[ch]->size(), 0, event, length, maskWindow[ch]);
+        }
+        ch1 = &maskWindow[0];
+        ch2 = &maskWindow[1];
+    }
+    if (maskLearnRemaining > 0) {
+        if (mask.learn(*ch1, *ch2) && --maskLearnRemaining == 0) {
+            mask.finishLearning(maskMarginVolts, maskMarginSamples);
+            publishMask();
+            qDebug() << "[DspWorker] Mask learned from" << mask.learnedRecords() << "frames," << mask.length() << "samples";
+            emit maskLearned();
+        }
+        return;
+    }
+    frame.mask = mask.test(*ch1, *ch2);
+    frame.maskTested = true;
+    maskTested.fetch_add(1, std::memory_order_relaxed);
+    if (frame.mask.pass()) {
+        maskPassed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    maskFailed.fetch_add(1, std::memory_order_relaxed);
+    maskViolations.fetch_add(frame.mask.violations, std::memory_order_relaxed);
+    if (maskFailRecorder) maskFailRecorder->record(raw);
+    if (maskStopOnFail && !maskHaltFlag.exchange(true, std::memory_order_acq_rel)) emit maskHalted();
+}
+
+void DspWorker::resetSpectrum() {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this]() { resetSpectrum(); }, Qt::QueuedConnection);
+        return;
+    }
+    for (SpectrumAnalyzer& analyzer : analyzers) analyzer.reset();
+    QMutexLocker lock(&snapshotMutex);
+    snapshotValid = false;
+}
+
+bool DspWorker::spectrumSnapshot(SpectrumSnapshot& out) {
+    spectrumPending.store(false, std::memory_order_release);
+    QMutexLocker lock(&snapshotMutex);
+    if (!snapshotValid) return false;
+    out = snapshot;
+    return true;
+}
+
+void DspWorker::publishSpectrum() {
+    if (sincePublished.isValid() && sincePublished.elapsed() < SPECTRUM_PUBLISH_MS) return;
+    sincePublished.start();
+    {
+        QMutexLocker lock(&snapshotMutex);
+        for (int ch = 0; ch < 2; ++ch) {
+            analyzers[ch].averageDb(snapshot.average[ch]);
+            analyzers[ch].peakDb(snapshot.peak[ch]);
+        }
+        const SpectrumAnalyzer& first = analyzers[0].segmentCount() > 0 ? analyzers[0] : analyzers[1];
+        snapshot.firstHz = first.firstBinHz();
+        snapshot.binHz = first.binHz();
+        snapshot.segments = first.segmentCount();
+        snapshotValid = true;
+    }
+    if (!spectrumPending.exchange(true, std::memory_order_acq_rel)) emit spectrumReady();
+}
+
+// Follows the stream with its own cursor; the GUI, which also reads the
+// history, is the one that clears its notification
+void DspWorker::processHistory() {
+    const bool decodeBuses = buses.hasSource(BusConfig::Source::Analog);
+    if (!streamHistory || (!spectrumEnabled && !decodeBuses)) return;
+    const CaptureHistory& history = *streamHistory;
+    const quint64 total = history.totalSamples();
+    const quint64 cap = history.capacity();
+    const quint64 oldest = total > cap ? total - cap : 0;
+    if (historyCursor < oldest || historyCursor > total) {
+        // Lapped by the stream, or the history was restarted
+        historyCursor = oldest;
+        breakHistory();
+    }
+    // Stream positions are put on the acquisition clock from how far behind
+    // the newest sample they are
+    const qint64 nowNs = acquisitionClockNs();
+    const double nsPerSample = 1e9 / busAnalogRate;
+    bool added = false;
+    CaptureHistory::Span span;
+    while (historyCursor < total) {
+        const int n = int(qMin<quint64>(HISTORY_CHUNK, total - historyCursor));
+        bool present[2] = {false, false};
+        for (int ch = 0; ch < 2; ++ch) {
+            const AdcDecoder::Channel channel = ch == 0 ? AdcDecoder::Ch1 : AdcDecoder::Ch2;
+            QVector<double>& volts = historyVolts[ch];
+            if (!history.window(channel, historyCursor, n, span)) continue;
+            volts.resize(n);
+            decoder.decode(channel, span.first, span.firstLength, volts.data());
+            decoder.decode(channel, span.second, span.secondLength, volts.data() + span.firstLength);
+            present[ch] = true;
+        }
+        if (!history.isIntact(historyCursor)) {
+            // Overwritten while decoding: skip ahead to live data
+            historyCursor = history.totalSamples();
+            breakHistory();
+            break;
+        }
+        if (spectrumEnabled) {
+            for (int ch = 0; ch < 2; ++ch) {
+                if (present[ch]) added |= analyzers[ch].add(historyVolts[ch].constData(), n) > 0;
+            }
+        }
+        if (decodeBuses) {
+            const qint64 firstNs = nowNs - qint64((total - historyCursor) * nsPerSample);
+            buses.decodeAnalog(present[0] ? historyVolts[0].constData() : nullptr,
+                               present[1] ? historyVolts[1].constData() : nullptr,
+                               n, historyCursor, firstNs, streamAnnotations);
+        }
+        historyCursor += n;
+    }
+    if (added) publishSpectrum();
+    publishAnnotations();
+}
+
+void DspWorker::processFrames() {
+    input.clearNotified();
+    bool notify = false;
+    const bool spectrumFromFrames = spectrumEnabled && !streamHistory;
+    const bool busesFromFrames = !streamHistory && buses.hasSource(BusConfig::Source::Analog);
+    const bool maskActive = !mask.isEmpty() || maskLearnRemaining > 0;
+    bool spectrumAdded = false;
+    while (const AcquisitionFrame* frame = input.peek()) {
+        if (maskHaltFlag.load(std::memory_order_acquire)) {
+            // Stopped on a failure: the failing frame stays the last one shown
+            input.release();
+            continue;
+        }
+        DecodedFrame* out = decoded.beginWrite();
+        const bool publish = out != nullptr;
+        if (!publish) {
+            decoded.noteDropped();
+            const int dropped = decoded.droppedFrames();
+            qCDebug(lcFrame) << "[DspWorker] Decoded ring full, dropped frame. Total dropped:" << dropped;
+            if (dropped % DROP_WARNING_INTERVAL == 1)
+                qWarning() << "[DspWorker] Decoded ring full, frames are being dropped. Total dropped:" << dropped;
+            // Still decoded for the mask test, which has to see every frame
+            if (maskActive) out = &unpublished;
+        }
+        if (out) {
+            out->dataLength = frame->dataLength;
+            out->dualChannel = frame->dualChannel;
+            out->timestampNs = frame->timestampNs;
+            [[maybe_unused]] qint64 stageNs = PERF_NOW();
+            decoder.decode(AdcDecoder::Ch1, frame->ch1, out->ch1);
+            decoder.decode(AdcDecoder::Ch2, frame->ch2, out->ch2);
+            PERF_LAP(PerfStage::Decode, stageNs);
+            chains[0].process(out->ch1, frame->dataLength);
+            chains[1].process(out->ch2, frame->dataLength);
+            PERF_LAP(PerfStage::Dsp, stageNs);
+            out->maskTested = false;
+            if (maskActive) testMask(*frame, *out);
+            if (spectrumFromFrames) {
+                spectrumAdded |= analyzers[0].addRecord(out->ch1.constData(), out->ch1.size()) > 0;
+                spectrumAdded |= analyzers[1].addRecord(out->ch2.constData(), out->ch2.size()) > 0;
+            }
+            out->annotations.clear();
+            if (busesFromFrames) {
+                // Frames are separate captures: decode each from a clean state
+                const int n = qMax(out->ch1.size(), out->ch2.size());
+                const qint64 firstNs = frame->timestampNs - qint64(n * 1e9 / busAnalogRate);
+                buses.breakStream(BusConfig::Source::Analog);
+                buses.decodeAnalog(out->ch1.size() == n ? out->ch1.constData() : nullptr,
+                                   out->ch2.size() == n ? out->ch2.constData() : nullptr,
+                                   n, 0, firstNs, out->annotations);
+            }
+            if (publish) notify |= decoded.commitWrite();
+        }
+        input.release();
+    }
+    if (spectrumAdded) publishSpectrum();
+    if (notify) emit framesReady();
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+#include <atomic>
+#include "AdcDecoder.h"
+#include "BusDecoder.h"
+#include "DspChain.h"
+#include "FrameRing.h"
+#include "SpectrumAnalyzer.h"
+#include "SpscRing.h"
+#include "TriggerEngine.h"
+#include "WaveformMask.h"
+
+class CaptureHistory;
+class FrameRecorder;
+
+// A capture converted to volts and filtered, ready to measure and plot
+struct DecodedFrame {
+    QVector<double> ch1; // empty if the channel was not captured
+    QVector<double> ch2;
+    int dataLength = 0;
+    bool dualChannel = true;
+    qint64 timestampNs = 0; // from the raw frame
+    QVector<ProtocolAnnotation> annotations; // bus events, samples from the frame start
+    bool maskTested = false;
+    MaskResult mask; // against the mask, if maskTested
+};
+
+// How frames are cut before the mask test: the GUI's software trigger
+// alignment, so the mask lines up with what is shown
+struct MaskAlignment {
+    int source = -1; // channel the edge is searched on; -1 tests whole frames
+    double level = 0.0;
+    double hysteresis = 0.0;
+    TriggerEngine::Slope slope = TriggerEngine::Slope::Rising;
+    double viewFraction = 0.5;  // window length, of the frame length
+    int preTriggerPercent = 10; // of the window
+
+    bool operator==(const MaskAlignment& o) const {
+        return source == o.source && level == o.level && hysteresis == o.hysteresis && slope == o.slope
+               && viewFraction == o.viewFraction && preTriggerPercent == o.preTriggerPercent;
+    }
+    bool operator!=(const MaskAlignment& o) const { return !(*this == o); }
+};
+
+// Mask test counters since the last reset
+struct MaskStats {
+    quint64 tested = 0;
+    quint64 passed = 0;
+    quint64 failed = 0;
+    quint64 untriggered = 0; // frames without a trigger to align them on
+    quint64 untested = 0;    // frames the acquisition ring dropped before decoding
+    quint64 violations = 0;  // samples outside the mask, over all failures
+    bool halted = false;     // stopped on a failure
+};
+
+// Hands decoded frames from the DSP worker to the GUI thread
+class DecodedFrameRing : public SpscRing<DecodedFrame> {
+public:
+    explicit DecodedFrameRing(int capacity = 8, int maxFrameSamples = 400);
+};
+
+// Decode and filter stage between the acquisition thread and the GUI. It
+// lives on its own thread, drains the raw frame ring, converts each frame
+// with its own AdcDecoder, runs the per-channel DspChain in place on the
+// output slot and publishes the result. GUI work per frame is then
+// measuring and plotting only. When the GUI falls behind, frames are
+// dropped here rather than queued.
+//
+// When the spectrum analyser is enabled it also averages the Welch
+// spectrum of both channels here, out of the decoded frames (one
+// zero-padded record each) or, while streaming, out of the capture
+// history, which is contiguous and gives segments of the full FFT size.
+// Results are published at most every few tens of milliseconds.
+//
+// Bus decoders (BusDecoder) run here too, from the same sources: each
+// frame's events travel with it in DecodedFrame::annotations, while events
+// from the stream, which keep their decoder state from block to block, and
+// from the DigitalIO inputs are queued for takeAnnotations().
+//
+// Mask testing runs on every frame, right after the filters, including the
+// frames the GUI is too slow to take (those are decoded into a scratch
+// frame instead of being dropped before decoding). Frames the acquisition
+// ring drops never get here; they are counted as untested. The Roll stream
+// is not tested at all.
+class DspWorker : public QObject {
+    Q_OBJECT
+public:
+    explicit DspWorker(FrameRing& input, QObject* parent = nullptr);
+
+    // May be called from any thread; applied on the worker thread ahead of
+    // the next frame it decodes
+    void setDecoderParams(double ch1Gain, int ch1Offset, double ch2Gain, int ch2Offset);
+    void setChainConfig(int channel, const DspChain::Config& config);
+    // Restarts frame averaging, e.g. after a time base change
+    void resetChains();
+
+    // Any thread. The sample rate is the decoded frames' (or the stream's);
+    // a new configuration restarts the averages.
+    void setSpectrumConfig(const SpectrumAnalyzer::Config& config, double sampleRate, bool enabled);
+    // Analyse and decode the stream in history from its current end instead
+    // of the frames; nullptr goes back to frames
+    void setStreamSource(const CaptureHistory* history);
+    void resetSpectrum();
+    // Any thread: copies the last published averages; false if there are none yet
+    bool spectrumSnapshot(SpectrumSnapshot& out);
+
+    // Any thread. analogRate is the sample rate of frames and stream,
+    // digitalRate the DigitalIO poll rate; an empty list stops decoding.
+    void setBusDecoders(const QVector<BusConfig>& buses, double analogRate, double digitalRate);
+    // Any thread: moves out the stream and digital events queued so far
+    void takeAnnotations(QVector<ProtocolAnnotation>& out);
+
+    // Any thread. Frames are tested against mask from the next one on; an
+    // empty mask stops testing. Both restart the counters.
+    void setMask(const WaveformMask& mask);
+    // Learns a mask from the next `records` frames, then tests against it
+    void learnMask(int records, double marginVolts, int marginSamples);
+    void setMaskAlignment(const MaskAlignment& alignment);
+    // stopOnFail: after a failing frame no more frames are published until
+    // resetMaskStats(). failRecorder, if not nullptr, gets every failing
+    // frame as acquired.
+    void setMaskOptions(bool stopOnFail, FrameRecorder* failRecorder);
+    void resetMaskStats();
+    // Publishes frames again after a stop on fail, keeping the counters
+    void resumeMaskTest();
+    // Any thread
+    MaskStats maskStats() const;
+    WaveformMask currentMask();
+
+    // Consumer side belongs to the GUI thread
+    DecodedFrameRing& output() { return decoded; }
+
+public slots:
+    // Connected to SerialHandler::framesAvailable
+    void processFrames();
+    // Connected to SerialHandler::historyAvailable
+    void processHistory();
+    // Connected to DigitalIO::inputsSampled
+    void processDigitalInputs(quint8 inputs, qint64 timestampNs);
+
+signals:
+    void framesReady();
+    // Coalesced: emitted again only after spectrumSnapshot() has been called
+    void spectrumReady();
+    // Coalesced: emitted again only after takeAnnotations() has been called
+    void annotationsReady();
+    // Learning finished; currentMask() has the result
+    void maskLearned();
+    // A frame failed with stop on fail set; it is the last one published
+    void maskHalted();
+
+private:
+    FrameRing& input;
+    DecodedFrameRing decoded;
+    AdcDecoder decoder;
+    DspChain chains[2];
+
+    void publishSpectrum();
+    void publishAnnotations();
+    void breakHistory();
+    void testMask(const AcquisitionFrame& raw, DecodedFrame& frame);
+    void publishMask();
+
+    SpectrumAnalyzer analyzers[2];
+    bool spectrumEnabled = false;
+    const CaptureHistory* streamHistory = nullptr;
+    quint64 historyCursor = 0;
+    QVector<double> historyVolts[2]; // scratch
+    QElapsedTimer sincePublished;
+
+    QMutex snapshotMutex;
+    SpectrumSnapshot snapshot;
+    bool snapshotValid = false;
+    std::atomic<bool> spectrumPending{false};
+
+    BusDecoder buses;
+    double busAnalogRate = 1.0;
+    quint64 digitalPosition = 0;
+    QVector<ProtocolAnnotation> streamAnnotations; // this pass's events
+    QMutex annotationMutex;
+    QVector<ProtocolAnnotation> pendingAnnotations;
+    std::atomic<bool> annotationsPending{false};
+
+    WaveformMask mask;
+    int maskLearnRemaining = 0;
+    double maskMarginVolts = 0.0;
+    int maskMarginSamples = 0;
+    MaskAlignment maskAlignment;
+    TriggerEngine maskTrigger;
+    QVector<double> maskWindow[2]; // aligned copies, reused
+    DecodedFrame unpublished;      // frames the ring has no room for
+    bool maskStopOnFail = false;
+    FrameRecorder* maskFailRecorder = nullptr;
+    std::atomic<bool> maskHaltFlag{false};
+    std::atomic<quint64> maskTested{0};
+    std::atomic<quint64> maskPassed{0};
+    std::atomic<quint64> maskFailed{0};
+    std::atomic<quint64> maskUntriggered{0};
+    std::atomic<quint64> maskViolations{0};
+    std::atomic<int> maskDropBase{0}; // input.droppedFrames() at the last reset
+    QMutex maskMutex;
+    WaveformMask publishedMask;
+};
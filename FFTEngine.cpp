@@ -0,0 +1,180 @@
+#include "FFTEngine.h"
+#include <cmath>
+
+namespace {
+const double PI = 3.14159265358979323846;
+
+bool isPowerOfTwo(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+int nextPowerOfTwo(int n) {
+    int p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+}
+
+const FFTEngine::Radix2Plan& FFTEngine::radix2Plan(int n) {
+    auto it = radix2Plans.find(n);
+    if (it != radix2Plans.end()) return it.value();
+
+    Radix2Plan plan;
+    int bits = 0;
+    while ((1 << bits) < n) ++bits;
+    plan.bitReverse.resize(n);
+    for (int i = 0; i < n; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) {
+            if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        }
+        plan.bitReverse[i] = r;
+    }
+    plan.twiddles.resize(n / 2);
+    for (int k = 0; k < n / 2; ++k) {
+        double angle = -2.0 * PI * k / n;
+        plan.twiddles[k] = Complex(std::cos(angle), std::sin(angle));
+    }
+    return radix2Plans.insert(n, plan).value();
+}
+
+const FFTEngine::BluesteinPlan& FFTEngine::bluesteinPlan(int n) {
+    auto it = bluesteinPlans.find(n);
+    if (it != bluesteinPlans.end()) return it.value();
+
+    BluesteinPlan plan;
+    plan.paddedLength = nextPowerOfTwo(2 * n - 1);
+    plan.chirp.resize(n);
+    for (int k = 0; k < n; ++k) {
+        // Reduce k^2 modulo 2n before scaling to keep the angle accurate for long records
+        long long k2 = (static_cast<long long>(k) * k) % (2LL * n);
+        double angle = -PI * k2 / n;
+        plan.chirp[k] = Complex(std::cos(angle), std::sin(angle));
+    }
+
+    QVector<Complex> filter(plan.paddedLength, Complex(0.0, 0.0));
+    filter[0] = std::conj(plan.chirp[0]);
+    for (int k = 1; k < n; ++k) {
+        filter[k] = std::conj(plan.chirp[k]);
+        filter[plan.paddedLength - k] = std::conj(plan.chirp[k]);
+    }
+    radix2(filter, radix2Plan(plan.paddedLength), false);
+    plan.filterSpectrum = filter;
+    return bluesteinPlans.insert(n, plan).value();
+}
+
+void FFTEngine::radix2(QVector<Complex>& data, const Radix2Plan& plan, bool inverse) const {
+    const int n = data.size();
+    Complex* d = data.data();
+    for (int i = 0; i < n; ++i) {
+        int j = plan.bitReverse[i];
+        if (i < j) std::swap(d[i], d[j]);
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        const int half = len / 2;
+        const int step = n / len;
+        for (int start = 0; start < n; start += len) {
+            for (int j = 0; j < half; ++j) {
+                Complex w = plan.twiddles[j * step];
+                if (inverse) w = std::conj(w);
+                Complex u = d[start + j];
+                Complex v = d[start + j + half] * w;
+                d[start + j] = u + v;
+                d[start + j + half] = u - v;
+            }
+        }
+    }
+}
+
+void FFTEngine::bluestein(QVector<Complex>& data) {
+    const int n = data.size();
+    const BluesteinPlan& plan = bluesteinPlan(n);
+    const Radix2Plan& inner = radix2Plan(plan.paddedLength);
+    const int m = plan.paddedLength;
+
+    convolutionBuffer.resize(m);
+    for (int k = 0; k < n; ++k) convolutionBuffer[k] = data[k] * plan.chirp[k];
+    for (int k = n; k < m; ++k) convolutionBuffer[k] = Complex(0.0, 0.0);
+
+    radix2(convolutionBuffer, inner, false);
+    for (int k = 0; k < m; ++k) convolutionBuffer[k] *= plan.filterSpectrum[k];
+    radix2(convolutionBuffer, inner, true);
+
+    const double scale = 1.0 / m;
+    for (int k = 0; k < n; ++k) data[k] = convolutionBuffer[k] * plan.chirp[k] * scale;
+}
+
+void FFTEngine::transform(QVector<Complex>& data) {
+    const int n = data.size();
+    if (n <= 1) return;
+    if (isPowerOfTwo(n)) {
+        radix2(data, radix2Plan(n), false);
+    } else {
+        bluestein(data);
+    }
+}
+
+const QVector<double>& FFTEngine::windowCoefficients(int n, Window window) {
+    quint64 key = (static_cast<quint64>(n) << 8) | static_cast<quint64>(window);
+    auto it = windowCache.find(key);
+    if (it != windowCache.end()) return it.value();
+
+    QVector<double> w(n, 1.0);
+    // Periodic (DFT-even) windows, which is what spectral analysis wants
+    for (int i = 0; i < n; ++i) {
+        double x = 2.0 * PI * i / n;
+        switch (window) {
+        case Window::Rectangular:
+            break;
+        case Window::Hann:
+            w[i] = 0.5 - 0.5 * std::cos(x);
+            break;
+        case Window::Blackman:
+            w[i] = 0.42 - 0.5 * std::cos(x) + 0.08 * std::cos(2.0 * x);
+            break;
+        case Window::FlatTop:
+            w[i] = 0.21557895 - 0.41663158 * std::cos(x) + 0.277263158 * std::cos(2.0 * x)
+                 - 0.083578947 * std::cos(3.0 * x) + 0.006947368 * std::cos(4.0 * x);
+            break;
+        }
+    }
+    return windowCache.insert(key, w).value();
+}
+
+void FFTEngine::magnitudeSpectrum(const QVector<double>& input, QVector<double>& output, Window window) {
+    const int n = input.size();
+    if (n == 0) {
+        output.clear();
+        return;
+    }
+
+    const QVector<double>& w = windowCoefficients(n, window);
+    double coherentGain = 0.0;
+    workBuffer.resize(n);
+    for (int i = 0; i < n; ++i) {
+        workBuffer[i] = Complex(input[i] * w[i], 0.0);
+        coherentGain += w[i];
+    }
+    if (coherentGain <= 0.0) coherentGain = n;
+
+    transform(workBuffer);
+
+    output.resize(n / 2);
+    for (int k = 0; k < n / 2; ++k) {
+        output[k] = std::abs(workBuffer[k]) / coherentGain;
+    }
+}
+
+QVector<double> FFTEngine::magnitudeSpectrum(const QVector<double>& input, Window window) {
+    QVector<double> output;
+    magnitudeSpectrum(input, output, window);
+    return output;
+}
+
+void FFTEngine::clearCache() {
+    radix2Plans.clear();
+    bluesteinPlans.clear();
+    windowCache.clear();
+    workBuffer.clear();
+    convolutionBuffer.clear();
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <QVector>
+#include <QHash>
+#include <complex>
+
+// Reusable FFT shared by the DFT display modes and MainWindow::performFFT.
+// Twiddle factors, bit-reversal permutations and window coefficients are
+// computed once per length and cached, so repeated frames of the same size
+// cost no trig calls. Power-of-two lengths use an iterative radix-2
+// transform; any other length (e.g. the 200/400 point frames) goes through
+// Bluestein's chirp-z algorithm on top of a cached power-of-two plan.
+class FFTEngine {
+public:
+    typedef std::complex<double> Complex;
+
+    enum class Window {
+        Rectangular,
+        Hann,
+        Blackman,
+        FlatTop
+    };
+
+    // In-place forward DFT of any length
+    void transform(QVector<Complex>& data);
+
+    // Single-sided magnitude spectrum (N/2 bins). Normalised by the window's
+    // coherent gain, so Rectangular matches the old |X[k]| / N output.
+    void magnitudeSpectrum(const QVector<double>& input, QVector<double>& output, Window window = Window::Rectangular);
+    QVector<double> magnitudeSpectrum(const QVector<double>& input, Window window = Window::Rectangular);
+
+    // Cached window coefficients for a given length
+    const QVector<double>& windowCoefficients(int n, Window window);
+
+    void clearCache();
+
+private:
+    struct Radix2Plan {
+        QVector<int> bitReverse;
+        QVector<Complex> twiddles; // exp(-2*pi*i*k/n), k < n/2
+    };
+    struct BluesteinPlan {
+        int paddedLength = 0;
+        QVector<Complex> chirp;          // exp(-i*pi*k^2/n)
+        QVector<Complex> filterSpectrum; // FFT of the conjugate chirp filter
+    };
+
+    const Radix2Plan& radix2Plan(int n);
+    const BluesteinPlan& bluesteinPlan(int n);
+    void radix2(QVector<Complex>& data, const Radix2Plan& plan, bool inverse) const;
+    void bluestein(QVector<Complex>& data);
+
+    QHash<int, Radix2Plan> radix2Plans;
+    QHash<int, BluesteinPlan> bluesteinPlans;
+    QHash<quint64, QVector<double>> windowCache;
+    QVector<Complex> workBuffer;
+    QVector<Complex> convolutionBuffer;
+};
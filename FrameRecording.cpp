@@ -0,0 +1,352 @@
+#include "FrameRecording.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QThread>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+constexpr char MAGIC[8] = {'O', 'S', 'C', 'R', 'E', 'C', '0', '1'};
+constexpr quint32 VERSION = 1;
+constexpr int HEADER_BYTES = 64;
+constexpr quint32 FILE_COMPRESSED = 1;
+
+constexpr quint32 CHUNK_MAGIC = 0x314B4843; // "CHK1"
+constexpr int CHUNK_HEADER_BYTES = 20;
+constexpr quint32 CHUNK_COMPRESSED = 1;
+
+constexpr quint8 RECORD_SETTINGS = 1;
+constexpr quint8 RECORD_FRAME = 2;
+constexpr int RECORD_HEADER_BYTES = 8;
+constexpr int FRAME_FIELDS_BYTES = 24;
+
+// Two of these are all the memory a recording uses
+constexpr int BUFFER_BYTES = 1 << 20;
+// A quiet stream still reaches the disk this often
+constexpr qint64 FLUSH_INTERVAL_NS = 250000000;
+// zlib's fastest level; raw 8-bit ADC samples compress by about half
+constexpr int COMPRESSION_LEVEL = 1;
+
+template <typename T>
+void put(uchar* dst, int offset, T value) { qToLittleEndian(value, dst + offset); }
+template <typename T>
+T get(const uchar* src, int offset) { return qFromLittleEndian<T>(src + offset); }
+
+void putRecordHeader(uchar* dst, quint8 type, int device, int payloadBytes) {
+    dst[0] = type;
+    dst[1] = static_cast<quint8>(device);
+    put<quint16>(dst, 2, 0);
+    put<quint32>(dst, 4, static_cast<quint32>(payloadBytes));
+}
+}
+
+// --- Recorder ---
+
+FrameRecorder::FrameRecorder(QObject* parent) : QObject(parent) {}
+
+FrameRecorder::~FrameRecorder() {
+    stop();
+}
+
+bool FrameRecorder::start(const QString& path, const CaptureInfo& info, bool compressChunks) {
+    stop();
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "[FrameRecorder] Failed to open" << path << ":" << file.errorString();
+        return false;
+    }
+    compress = compressChunks;
+    startMs = QDateTime::currentMSecsSinceEpoch();
+    written.store(0, std::memory_order_relaxed);
+    dropped.store(0, std::memory_order_relaxed);
+    fileBytes.store(0, std::memory_order_relaxed);
+    failed.store(false, std::memory_order_relaxed);
+    writeHeader(false);
+    if (failed.load(std::memory_order_relaxed)) {
+        file.close();
+        return false;
+    }
+
+    for (QByteArray& buffer : buffers) buffer.resize(BUFFER_BYTES);
+    fullIndex.store(-1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(producerMutex);
+        fillIndex = 0;
+        fillBytes = 0;
+        fillFrames = 0;
+        settings = info;
+        settingsPending = true;
+        accepting = true;
+    }
+    stopRequested.store(false, std::memory_order_release);
+    worker = QThread::create([this]() { run(); });
+    worker->start();
+    qDebug() << "[FrameRecorder] Recording frames to" << path << (compress ? "(compressed)" : "");
+    return true;
+}
+
+void FrameRecorder::stop() {
+    if (!worker) return;
+    {
+        std::lock_guard<std::mutex> lock(producerMutex);
+        accepting = false;
+    }
+    stopRequested.store(true, std::memory_order_release);
+    wakeWriter();
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+
+    // Producers are shut out and the writer is gone; the fill buffer is ours
+    if (fillFrames > 0 && !failed.load(std::memory_order_relaxed)) writeChunk(fillIndex, fillBytes, fillFrames);
+    fillBytes = 0;
+    fillFrames = 0;
+    writeHeader(true);
+    file.close();
+    for (QByteArray& buffer : buffers) buffer = QByteArray();
+    qDebug() << "[FrameRecorder] Closed recording:" << framesWritten() << "frames written,"
+             << framesDropped() << "dropped";
+}
+
+void FrameRecorder::setSettings(const CaptureInfo& info) {
+    std::lock_guard<std::mutex> lock(producerMutex);
+    settings = info;
+    settingsPending = true;
+}
+
+void FrameRecorder::record(const AcquisitionFrame& frame, int device) {
+    std::lock_guard<std::mutex> lock(producerMutex);
+    if (!accepting) return;
+    if (failed.load(std::memory_order_relaxed)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const int ch1Bytes = frame.ch1.size();
+    const int ch2Bytes = frame.ch2.size();
+    const int payload = FRAME_FIELDS_BYTES + ch1Bytes + ch2Bytes;
+    const int settingsBytes = RECORD_HEADER_BYTES + CAPTURE_INFO_BYTES;
+    const int needed = RECORD_HEADER_BYTES + payload + settingsBytes;
+
+    // Best effort when the buffer has been open a while; a must when it is full
+    if (fillFrames > 0 && frame.timestampNs - fillStartNs >= FLUSH_INTERVAL_NS) handOff();
+    if (fillBytes + needed > BUFFER_BYTES && !handOff()) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (fillBytes == 0) {
+        fillStartNs = frame.timestampNs;
+        settingsPending = true; // every chunk starts with the settings in force
+    }
+    if (settingsPending) appendSettings();
+
+    uchar* dst = reinterpret_cast<uchar*>(buffers[fillIndex].data()) + fillBytes;
+    putRecordHeader(dst, RECORD_FRAME, device, payload);
+    dst += RECORD_HEADER_BYTES;
+    put<qint64>(dst, 0, frame.timestampNs);
+    put<quint64>(dst, 8, dropped.load(std::memory_order_relaxed));
+    put<quint16>(dst, 16, static_cast<quint16>(frame.dataLength));
+    dst[18] = frame.dualChannel ? 1 : 0;
+    dst[19] = 0;
+    put<quint16>(dst, 20, static_cast<quint16>(ch1Bytes));
+    put<quint16>(dst, 22, static_cast<quint16>(ch2Bytes));
+    std::memcpy(dst + FRAME_FIELDS_BYTES, frame.ch1.constData(), ch1Bytes);
+    std::memcpy(dst + FRAME_FIELDS_BYTES + ch1Bytes, frame.ch2.constData(), ch2Bytes);
+    fillBytes += RECORD_HEADER_BYTES + payload;
+    ++fillFrames;
+}
+
+void FrameRecorder::appendSettings() {
+    uchar* dst = reinterpret_cast<uchar*>(buffers[fillIndex].data()) + fillBytes;
+    putRecordHeader(dst, RECORD_SETTINGS, 0, CAPTURE_INFO_BYTES);
+    encodeCaptureInfo(settings, dst + RECORD_HEADER_BYTES);
+    fillBytes += RECORD_HEADER_BYTES + CAPTURE_INFO_BYTES;
+    settingsPending = false;
+}
+
+// Gives the fill buffer to the writer if it is done with the other one
+bool FrameRecorder::handOff() {
+    if (fullIndex.load(std::memory_order_acquire) != -1) return false;
+    fullBytes = fillBytes;
+    fullFrames = fillFrames;
+    fullIndex.store(fillIndex, std::memory_order_release);
+    fillIndex ^= 1;
+    fillBytes = 0;
+    fillFrames = 0;
+    wakeWriter();
+    return true;
+}
+
+void FrameRecorder::wakeWriter() {
+    // Taking the lock orders this against the writer's check before it sleeps
+    { std::lock_guard<std::mutex> lock(wakeMutex); }
+    wake.notify_one();
+}
+
+void FrameRecorder::run() {
+    for (;;) {
+        const int index = fullIndex.load(std::memory_order_acquire);
+        if (index >= 0) {
+            if (!failed.load(std::memory_order_relaxed)) writeChunk(index, fullBytes, fullFrames);
+            fullIndex.store(-1, std::memory_order_release);
+            continue;
+        }
+        if (stopRequested.load(std::memory_order_acquire)) {
+            // A hand-off can land between the load above and the stop
+            if (fullIndex.load(std::memory_order_acquire) >= 0) continue;
+            break;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait(lock, [this]() {
+            return fullIndex.load(std::memory_order_acquire) >= 0 || stopRequested.load(std::memory_order_acquire);
+        });
+    }
+    file.flush();
+}
+
+bool FrameRecorder::writeChunk(int index, int bytes, int frames) {
+    const char* payload = buffers[index].constData();
+    int stored = bytes;
+    quint32 flags = 0;
+    QByteArray packed;
+    if (compress) {
+        packed = qCompress(reinterpret_cast<const uchar*>(payload), bytes, COMPRESSION_LEVEL);
+        if (!packed.isEmpty() && packed.size() < bytes) {
+            payload = packed.constData();
+            stored = packed.size();
+            flags |= CHUNK_COMPRESSED;
+        }
+    }
+    uchar h[CHUNK_HEADER_BYTES];
+    put<quint32>(h, 0, CHUNK_MAGIC);
+    put<quint32>(h, 4, flags);
+    put<quint32>(h, 8, static_cast<quint32>(bytes));
+    put<quint32>(h, 12, static_cast<quint32>(stored));
+    put<quint32>(h, 16, static_cast<quint32>(frames));
+    if (file.write(reinterpret_cast<const char*>(h), CHUNK_HEADER_BYTES) != CHUNK_HEADER_BYTES ||
+        file.write(payload, stored) != stored) {
+        qWarning() << "[FrameRecorder] Write failed:" << file.errorString();
+        failed.store(true, std::memory_order_relaxed);
+        // The frames of the lost chunk count as dropped too
+        dropped.fetch_add(frames, std::memory_order_relaxed);
+        emit errorOccurred(file.errorString());
+        return false;
+    }
+    written.fetch_add(frames, std::memory_order_relaxed);
+    fileBytes.fetch_add(CHUNK_HEADER_BYTES + stored, std::memory_order_relaxed);
+    return true;
+}
+
+// Totals are only final once the writer has stopped; readers do not depend on them
+void FrameRecorder::writeHeader(bool closed) {
+    uchar h[HEADER_BYTES];
+    std::memset(h, 0, HEADER_BYTES);
+    std::memcpy(h, MAGIC, sizeof(MAGIC));
+    put<quint32>(h, 8, VERSION);
+    put<quint32>(h, 12, HEADER_BYTES);
+    put<quint32>(h, 16, compress ? FILE_COMPRESSED : 0);
+    put<qint64>(h, 24, startMs);
+    put<qint64>(h, 32, closed ? QDateTime::currentMSecsSinceEpoch() : 0);
+    put<quint64>(h, 40, closed ? framesWritten() : 0);
+    put<quint64>(h, 48, closed ? framesDropped() : 0);
+    if (!file.seek(0) || file.write(reinterpret_cast<const char*>(h), HEADER_BYTES) != HEADER_BYTES) {
+        qWarning() << "[FrameRecorder] Failed to write header:" << file.errorString();
+        failed.store(true, std::memory_order_relaxed);
+    }
+}
+
+// --- Reader ---
+
+bool FrameRecordingReader::open(const QString& path) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "[FrameRecordingReader] Failed to open" << path << ":" << file.errorString();
+        return false;
+    }
+    uchar h[HEADER_BYTES];
+    if (file.read(reinterpret_cast<char*>(h), HEADER_BYTES) != HEADER_BYTES ||
+        std::memcmp(h, MAGIC, sizeof(MAGIC)) != 0 || get<quint32>(h, 8) != VERSION) {
+        qWarning() << "[FrameRecordingReader] Not a frame recording:" << path;
+        close();
+        return false;
+    }
+    headerBytes = static_cast<int>(get<quint32>(h, 12));
+    startMs = get<qint64>(h, 24);
+    endMs = get<qint64>(h, 32);
+    recorded = get<quint64>(h, 40);
+    droppedTotal = get<quint64>(h, 48);
+    if (headerBytes < HEADER_BYTES || !file.seek(headerBytes)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void FrameRecordingReader::close() {
+    if (file.isOpen()) file.close();
+    headerBytes = 0;
+    startMs = endMs = 0;
+    recorded = droppedTotal = 0;
+    current = CaptureInfo();
+    chunk.clear();
+    chunkPos = 0;
+}
+
+bool FrameRecordingReader::rewind() {
+    if (!file.isOpen() || !file.seek(headerBytes)) return false;
+    chunk.clear();
+    chunkPos = 0;
+    return true;
+}
+
+// A torn last chunk (crash while recording) ends the file
+bool FrameRecordingReader::loadChunk() {
+    uchar h[CHUNK_HEADER_BYTES];
+    if (file.read(reinterpret_cast<char*>(h), CHUNK_HEADER_BYTES) != CHUNK_HEADER_BYTES) return false;
+    if (get<quint32>(h, 0) != CHUNK_MAGIC) return false;
+    const quint32 flags = get<quint32>(h, 4);
+    const int rawBytes = static_cast<int>(get<quint32>(h, 8));
+    const int stored = static_cast<int>(get<quint32>(h, 12));
+    if (rawBytes <= 0 || rawBytes > BUFFER_BYTES || stored <= 0) return false;
+    QByteArray data = file.read(stored);
+    if (data.size() != stored) return false;
+    chunk = (flags & CHUNK_COMPRESSED) ? qUncompress(data) : data;
+    chunkPos = 0;
+    return chunk.size() == rawBytes;
+}
+
+bool FrameRecordingReader::next(Record& out) {
+    for (;;) {
+        if (chunkPos + RECORD_HEADER_BYTES > chunk.size()) {
+            if (!loadChunk()) return false;
+            continue;
+        }
+        const uchar* rec = reinterpret_cast<const uchar*>(chunk.constData()) + chunkPos;
+        const quint8 type = rec[0];
+        const int payload = static_cast<int>(get<quint32>(rec, 4));
+        if (payload < 0 || chunkPos + RECORD_HEADER_BYTES + payload > chunk.size()) {
+            chunkPos = chunk.size(); // corrupt; try the next chunk
+            continue;
+        }
+        const uchar* p = rec + RECORD_HEADER_BYTES;
+        chunkPos += RECORD_HEADER_BYTES + payload;
+        if (type == RECORD_SETTINGS && payload >= CAPTURE_INFO_BYTES) {
+            decodeCaptureInfo(p, current);
+            continue;
+        }
+        if (type != RECORD_FRAME || payload < FRAME_FIELDS_BYTES) continue;
+        const int ch1Bytes = get<quint16>(p, 20);
+        const int ch2Bytes = get<quint16>(p, 22);
+        if (FRAME_FIELDS_BYTES + ch1Bytes + ch2Bytes > payload) continue;
+        out.device = rec[1];
+        out.frame.timestampNs = get<qint64>(p, 0);
+        out.droppedBefore = get<quint64>(p, 8);
+        out.frame.dataLength = get<quint16>(p, 16);
+        out.frame.dualChannel = p[18] != 0;
+        out.frame.ch1.resize(ch1Bytes);
+        out.frame.ch2.resize(ch2Bytes);
+        std::memcpy(out.frame.ch1.data(), p + FRAME_FIELDS_BYTES, ch1Bytes);
+        std::memcpy(out.frame.ch2.data(), p + FRAME_FIELDS_BYTES + ch1Bytes, ch2Bytes);
+        return true;
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <QObject>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include "CaptureFile.h"
+#include "FrameRing.h"
+
+class QThread;
+
+// Frame recording layout, all fields little endian: a fixed-size file
+// header, then chunks of [chunk header + records], the records optionally
+// compressed per chunk. A record is a settings snapshot (CaptureInfo) or one
+// acquired frame with its raw ADC bytes; every chunk starts with the
+// settings in force, so each chunk decodes on its own and a file cut short
+// by a crash is readable up to its last complete chunk.
+
+// Records every acquired frame, gap-free, for as long as the disk keeps up.
+// Producers copy frames into one of two fixed buffers; when it fills (or
+// has been open for a while) it is handed to a writer thread that
+// compresses and writes it while the other buffer fills. Memory is the two
+// buffers, however long the run. If the writer still holds the other buffer
+// when the fill buffer is full, the frame is dropped and counted instead of
+// waiting, and the next frame written carries the running drop count.
+class FrameRecorder : public QObject {
+    Q_OBJECT
+public:
+    explicit FrameRecorder(QObject* parent = nullptr);
+    ~FrameRecorder();
+
+    bool start(const QString& path, const CaptureInfo& settings, bool compress);
+    // Writes the partly filled buffer, finalises the header and closes the file
+    void stop();
+    bool isActive() const { return worker != nullptr; }
+
+    // Settings for the frames recorded from now on
+    void setSettings(const CaptureInfo& settings);
+    // Called on acquisition threads; copies the frame and returns without
+    // touching the disk. device tells boards on a shared recording apart.
+    void record(const AcquisitionFrame& frame, int device = 0);
+
+    quint64 framesWritten() const { return written.load(std::memory_order_relaxed); }
+    quint64 framesDropped() const { return dropped.load(std::memory_order_relaxed); }
+    quint64 bytesWritten() const { return fileBytes.load(std::memory_order_relaxed); }
+
+signals:
+    void errorOccurred(const QString& msg);
+
+private:
+    void run();
+    bool handOff();
+    void wakeWriter();
+    void appendSettings();
+    bool writeChunk(int index, int bytes, int frames);
+    void writeHeader(bool closed);
+
+    QFile file;
+    bool compress = false;
+    qint64 startMs = 0;
+    QThread* worker = nullptr;
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> failed{false};
+
+    // Producer side, under producerMutex: held only for a copy, never
+    // across I/O, and the writer thread never takes it
+    std::mutex producerMutex;
+    bool accepting = false;
+    QByteArray buffers[2];
+    int fillIndex = 0;
+    int fillBytes = 0;
+    int fillFrames = 0;
+    qint64 fillStartNs = 0;
+    CaptureInfo settings;
+    bool settingsPending = false;
+
+    // Hand-off: the buffer the writer owns, -1 if none
+    std::atomic<int> fullIndex{-1};
+    int fullBytes = 0;
+    int fullFrames = 0;
+    // The writer sleeps on this until a hand-off or stop
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+
+    std::atomic<quint64> written{0};
+    std::atomic<quint64> dropped{0};
+    std::atomic<quint64> fileBytes{0};
+};
+
+// Sequential reader for frame recordings, one chunk in memory at a time
+class FrameRecordingReader {
+public:
+    struct Record {
+        AcquisitionFrame frame;
+        int device = 0;
+        quint64 droppedBefore = 0; // frames the recorder had dropped before this one
+    };
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+    // Back to the first chunk
+    bool rewind();
+
+    // Next frame in recording order; false at the end of the file
+    bool next(Record& out);
+    // Settings in force for the last frame returned
+    const CaptureInfo& settings() const { return current; }
+
+    qint64 startTime() const { return startMs; } // ms since epoch (UTC)
+    qint64 endTime() const { return endMs; }     // 0 if not closed cleanly
+    // Totals from the header; 0 if not closed cleanly
+    quint64 framesRecorded() const { return recorded; }
+    quint64 framesDropped() const { return droppedTotal; }
+
+private:
+    bool loadChunk();
+
+    QFile file;
+    int headerBytes = 0;
+    qint64 startMs = 0;
+    qint64 endMs = 0;
+    quint64 recorded = 0;
+    quint64 droppedTotal = 0;
+    CaptureInfo current;
+    QByteArray chunk;
+    int chunkPos = 0;
+};
@@ -0,0 +1,18 @@
+#include "FrameRing.h"
+#include <QElapsedTimer>
+
+qint64 acquisitionClockNs() {
+    static const QElapsedTimer clock = []() {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock.nsecsElapsed();
+}
+
+FrameRing::FrameRing(int capacity, int maxFrameBytes) : SpscRing<AcquisitionFrame>(capacity) {
+    for (AcquisitionFrame& frame : storage()) {
+        frame.ch1.reserve(maxFrameBytes);
+        frame.ch2.reserve(maxFrameBytes);
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <QByteArray>
+#include <QtGlobal>
+#include "SpscRing.h"
+
+// One completed capture as it comes off the serial link
+struct AcquisitionFrame {
+    QByteArray ch1;
+    QByteArray ch2;
+    int dataLength = 0;
+    bool dualChannel = true;
+    qint64 timestampNs = 0; // acquisitionClockNs() when the last byte was in
+};
+
+// Monotonic clock shared by every acquisition thread, so frames from
+// different devices can be lined up
+qint64 acquisitionClockNs();
+
+// Hands raw captures from the acquisition thread to the DSP worker. Slot
+// buffers are reserved for maxFrameBytes up front.
+class FrameRing : public SpscRing<AcquisitionFrame> {
+public:
+    explicit FrameRing(int capacity = 8, int maxFrameBytes = 400);
+};
@@ -3,6 +3,10 @@
 #include "PlotManager.h"
 #include "DDSGenerator.h"
 #include "DigitalIO.h"
+#include "FrameRecording.h"
+#include "PerfTrace.h"
+#include "PortWatcher.h"
+#include "TimeBase.h"
 #include "WaveformExporter.h"
 #include <QApplication>
 #include <QMessageBox>
@@ -12,7 +16,6 @@
 #include <QThread>
 #include <cmath>
 #include <complex>
-#include <valarray>
 #include <algorithm>
 #include <numeric>
 #include <QToolButton>
@@ -21,6 +24,48 @@
 #include <QHBoxLayout>
 #include "qcustomplot.h"
 #include <QSharedPointer>
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#endif
+
+// Length of the roll-mode view, read from the end of the capture history
+static constexpr double ROLL_WINDOW_SECONDS = 1.0;
+// Trigger hysteresis at gain 1, about 2.5 ADC codes
+static constexpr double TRIGGER_HYSTERESIS_VOLTS = 0.2;
+// A triggered frame shows this fraction of the record, so the trigger
+// point can move within the rest while the view stays aligned
+static constexpr double TRIGGER_VIEW_FRACTION = 0.5;
+// Samples decoded per step when scanning the capture history for triggers
+static constexpr int STREAM_TRIGGER_CHUNK = 65536;
+// Stimulus periods a sweep point waits after the DDS retune before capturing
+static constexpr int SWEEP_SETTLE_CYCLES = 3;
+// Upper bound on the traces one Add set accumulates (one more per Run)
+static constexpr int MAX_ADD_TRACES = 1000;
+// Initial log grid of an adaptive sweep
+static constexpr int SWEEP_COARSE_POINTS = 12;
+// Distinct DDS settings kept before the cache starts over (~520 bytes each)
+static constexpr int DDS_CACHE_LIMIT = 1024;
+// Samples shown when a capture file is opened; the LOD path keeps it cheap
+static constexpr int CAPTURE_VIEW_SAMPLES = 1 << 20;
+// Refresh period of the performance overlay; its percentiles cover one period
+static constexpr int PERF_OVERLAY_INTERVAL_MS = 1000;
+// Decoded bus events kept for export, and rows shown in the Digital tab's list
+static constexpr int MAX_DECODE_EVENTS = 200000;
+static constexpr int DECODE_LIST_ROWS = 200;
+// A board that appeared but would not open (still enumerating, busy) is retried
+static constexpr int AUTO_CONNECT_ATTEMPTS = 5;
+static constexpr int AUTO_CONNECT_RETRY_MS = 1000;
+// Refresh of the mask test counters while testing
+static constexpr int MASK_STATUS_INTERVAL_MS = 250;
+// Samples per channel of an auto-set capture, and how long past the
+// record's own duration it may take to arrive
+static constexpr int AUTO_SETUP_SAMPLES = 200;
+static constexpr int AUTO_SETUP_TIMEOUT_MS = 1000;
+// USB IDs of the scope board
+static constexpr quint16 BOARD_VID = 0x03EB;
+static constexpr quint16 BOARD_PID = 0x2404;
+// Port list entry that connects to a SimulatedDevice instead of a board
+static constexpr char SIMULATOR_PORT[] = "Simulator";
 
 // Define static constants
 const int MainWindow::MAX_DATA_LENGTH;
@@ -28,28 +73,16 @@ const int MainWindow::MAX_DUAL_CHANNEL_LENGTH;
 
 const double PI = 3.14159265358979323846;
 
-// Simple, reliable DFT implementation
-QVector<double> simpleDFT(const QVector<double>& inputData) {
-    if (inputData.isEmpty()) return QVector<double>();
-
-    int N = inputData.size();
-    QVector<double> magnitude(N/2);
-
-    // Simple DFT calculation
-    for (int k = 0; k < N/2; ++k) {
-        double real = 0.0;
-        double imag = 0.0;
-
-        for (int n = 0; n < N; ++n) {
-            double angle = 2.0 * PI * k * n / N;
-            real += inputData[n] * cos(angle);
-            imag += inputData[n] * sin(angle);
-        }
-
-        magnitude[k] = sqrt(real * real + imag * imag) / N;
-    }
+static QString formatNs(qint64 ns) {
+    if (ns < 1000) return QString("%1 ns").arg(ns);
+    if (ns < 1000000) return QString("%1 us").arg(ns / 1e3, 0, 'f', 1);
+    return QString("%1 ms").arg(ns / 1e6, 0, 'f', 1);
+}
 
-    return magnitude;
+// Reuses dst's allocation when it is already large enough
+static void copySamples(QVector<double>& dst, const QVector<double>& src) {
+    dst.resize(src.size());
+    std::copy(src.constData(), src.constData() + src.size(), dst.data());
 }
 
 // DraggableWidget implementation
@@ -99,19 +132,13 @@ void DraggableWidget::mouseReleaseEvent(QMouseEvent* event) {
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       DDS_Waveform(256, 0),
-      DDS_Table(512, 0),
       arb_data(256, 0),
-      SetPeriodCmd(3, 0),
-      SamplesCmd(3, 0),
-      DDS_OutCmd(),
-      RunDDSCmd(3, 0),
       Frequency(1000),
-      serialHandler(new SerialHandler(this)),
+      serialHandler(new SerialHandler()), // No parent: moved to acquisitionThread below
       plotManager(new PlotManager(this)),
       ddsGenerator(nullptr),      // These will be implemented later
       digitalIO(nullptr),        // or integrated directly if simple
       waveformExporter(new WaveformExporter(this)), //
-      portScanTimer(nullptr),
       lastConnectedPort("")
 {
     // Initialize all UI pointers to nullptr
@@ -176,14 +203,52 @@ MainWindow::MainWindow(QWidget *parent)
     oscTab = nullptr;
     settingsTab = nullptr;
 
+    // Serial I/O and the acquisition state machine run on their own thread
+    acquisitionThread = new QThread(this);
+    serialHandler->moveToThread(acquisitionThread);
+    connect(acquisitionThread, &QThread::finished, serialHandler, &QObject::deleteLater);
+    acquisitionThread->start();
+    // Decoding and filtering run on a third thread, between acquisition and the GUI
+    dspThread = new QThread(this);
+    dspWorker = new DspWorker(serialHandler->frameRing());
+    dspWorker->moveToThread(dspThread);
+    connect(dspThread, &QThread::finished, dspWorker, &QObject::deleteLater);
+    dspThread->start();
+    // Digital I/O shares the serial link's thread so its commands interleave with captures
+    digitalIO = new DigitalIO(serialHandler);
+    digitalIO->moveToThread(acquisitionThread);
+    connect(acquisitionThread, &QThread::finished, digitalIO, &QObject::deleteLater);
+    connect(serialHandler, &SerialHandler::auxReplyReceived, digitalIO, &DigitalIO::onAuxReply);
+    connect(digitalIO, &DigitalIO::inputsChanged, this, [this](quint8 inputs, quint8) {
+        for (int i = 0; i < 4; ++i) {
+            if (digitalInLabels[i]) digitalInLabels[i]->setText((inputs >> i) & 1 ? "H" : "L");
+        }
+    });
+    acquisitionManager = new AcquisitionManager(this);
+    captureWriter = new CaptureFileWriter(this);
+    frameRecorder = new FrameRecorder(this);
+    frameRecordStatusTimer = new QTimer(this);
+    frameRecordStatusTimer->setInterval(1000);
+    maskFailRecorder = new FrameRecorder(this);
+    maskStatusTimer = new QTimer(this);
+    maskStatusTimer->setInterval(MASK_STATUS_INTERVAL_MS);
+    autoSetupTimer = new QTimer(this);
+    autoSetupTimer->setSingleShot(true);
+    perfOverlayTimer = new QTimer(this);
+    perfOverlayTimer->setInterval(PERF_OVERLAY_INTERVAL_MS);
+
     // Initialize timers
     plotTimer = new QTimer(this);
     dataRequestTimer = new QTimer(this);
     sweepTimer = new QTimer(this);
 
-    portScanTimer = new QTimer(this);
-    connect(portScanTimer, &QTimer::timeout, this, &MainWindow::autoDetectAndConnectBoard);
-    portScanTimer->start(1000); // Check every second
+    // Port discovery scans on its own thread, and only when devices change
+    portThread = new QThread(this);
+    portWatcher = new PortWatcher(BOARD_VID, BOARD_PID);
+    portWatcher->moveToThread(portThread);
+    connect(portThread, &QThread::started, portWatcher, &PortWatcher::start);
+    connect(portThread, &QThread::finished, portWatcher, &QObject::deleteLater);
+    connect(portWatcher, &PortWatcher::portsChanged, this, &MainWindow::onPortsChanged);
 
     plotRateLimitTimer = new QTimer(this);
     plotRateLimitTimer->setSingleShot(true);
@@ -193,7 +258,6 @@ MainWindow::MainWindow(QWidget *parent)
     overwriteAcquisitionCount = 0;
     addModeAcquisitionCount = 0;
 
-    initializeWaveformTables();
     setupUi();
     setupConnections();
 
@@ -227,16 +291,30 @@ MainWindow::MainWindow(QWidget *parent)
         qDebug() << "[MainWindow] SerialHandler gains - CH1:" << static_cast<int>(ch1Gain) << "CH2:" << static_cast<int>(ch2Gain);
     }
 
+    syncDspSettings();
     updateUiState();
-    updateSerialPortList();
 
     // plotTimer->start(33); // ~30 FPS
-    autoDetectAndConnectBoard();
+    // The first scan connects to a board already plugged in
+    portThread->start();
 }
 
 MainWindow::~MainWindow()
 {
-    // Qt's parent-child mechanism handles deletion of UI elements
+    // Qt's parent-child mechanism handles deletion of UI elements.
+    // SerialHandler is deleted on its own thread once the loop exits.
+    // The capture writer reads its history, so it has to finish first.
+    captureWriter->stop();
+    frameRecorder->stop();
+    maskFailRecorder->stop();
+    acquisitionManager->closeAll();
+    portThread->quit();
+    portThread->wait();
+    // The DSP worker reads SerialHandler's frame ring
+    dspThread->quit();
+    dspThread->wait();
+    acquisitionThread->quit();
+    acquisitionThread->wait();
 }
 
 void MainWindow::setupUi()
@@ -253,8 +331,15 @@ void MainWindow::setupUi()
     QHBoxLayout *serialLayout = new QHBoxLayout(serialGroup);
     serialPortCombo = new QComboBox();
     connectButton = new QPushButton("Connect");
+    // Upper limit for the baud rate negotiated with framed-protocol firmware
+    linkSpeedCombo = new QComboBox();
+    linkSpeedCombo->addItem("Auto", 0);
+    for (int baud : {115200, 460800, 921600, 2000000}) linkSpeedCombo->addItem(QString::number(baud), baud);
+    linkSpeedCombo->setToolTip("Highest baud rate to switch to after connecting (firmware permitting); applies on the next connect");
     serialLayout->addWidget(new QLabel("Port:"));
     serialLayout->addWidget(serialPortCombo);
+    serialLayout->addWidget(new QLabel("Link:"));
+    serialLayout->addWidget(linkSpeedCombo);
     serialLayout->addWidget(connectButton);
     topBarLayout->addWidget(serialGroup);
 
@@ -266,8 +351,26 @@ void MainWindow::setupUi()
     runLayout->addWidget(runBtn);
     runLayout->addWidget(stopBtn);
     runLayout->addWidget(abortBtn);
+    autoSetBtn = new QPushButton("Auto Set");
+    autoSetBtn->setToolTip("Pick the sample rate, gains, offsets and trigger from a few quick captures");
+    runLayout->addWidget(autoSetBtn);
     topBarLayout->addWidget(runGroup);
 
+    QGroupBox *diagGroup = new QGroupBox("Diagnostics");
+    QHBoxLayout *diagLayout = new QHBoxLayout(diagGroup);
+    perfOverlayBtn = new QPushButton("Stats");
+    perfOverlayBtn->setCheckable(true);
+    perfOverlayBtn->setToolTip("Frame rate, dropped frames and per-stage latency over the plot");
+    logVerbosityCombo = new QComboBox();
+    logVerbosityCombo->addItem("Quiet", int(LogVerbosity::Quiet));
+    logVerbosityCombo->addItem("Frames", int(LogVerbosity::Frames));
+    logVerbosityCombo->addItem("Samples", int(LogVerbosity::Samples));
+    logVerbosityCombo->setToolTip("Debug log detail; per-frame and per-sample messages are off when Quiet");
+    diagLayout->addWidget(perfOverlayBtn);
+    diagLayout->addWidget(new QLabel("Log:"));
+    diagLayout->addWidget(logVerbosityCombo);
+    topBarLayout->addWidget(diagGroup);
+
     // --- Add Low-pass Filter Checkbox ---
     QCheckBox *lpfCheckBox = new QCheckBox("Low-pass filter (no ripples)");
     lpfCheckBox->setToolTip("Enable low-pass filtering to remove ripples. First 10 points will be ignored.");
@@ -283,6 +386,12 @@ void MainWindow::setupUi()
     mainAreaLayout = new QHBoxLayout();
     plot = static_cast<QCustomPlot*>(plotManager->plotWidget());
     mainAreaLayout->addWidget(plot, 1); // Always add oscilloscope plot at startup
+    perfOverlay = new QLabel(plot);
+    perfOverlay->setStyleSheet("QLabel { background-color: rgba(0, 0, 0, 170); color: #e0e0e0;"
+                               " font-family: monospace; font-size: 10px; padding: 4px; }");
+    perfOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+    perfOverlay->move(60, 10);
+    perfOverlay->hide();
     rightPanelTabs = new QTabWidget();
     rightPanelTabs->setFixedWidth(350);
     QWidget *scopeTab = new QWidget();
@@ -315,9 +424,112 @@ void MainWindow::setupUi()
     modeLayout->addWidget(fftCh1Radio, 1, 1);
     modeLayout->addWidget(fftCh2Radio, 2, 1);
     modeLayout->addWidget(fftBothRadio, 3, 1); // NEW
+    spectrumRadio = new QRadioButton("Spectrum Analyzer");
+    spectrumRadio->setToolTip("Averaged spectra of both channels, long records and zoom");
+    modeLayout->addWidget(spectrumRadio, 3, 0);
+    fftWindowCombo = new QComboBox();
+    fftWindowCombo->addItem("Rectangular", static_cast<int>(FFTEngine::Window::Rectangular));
+    fftWindowCombo->addItem("Hann", static_cast<int>(FFTEngine::Window::Hann));
+    fftWindowCombo->addItem("Blackman", static_cast<int>(FFTEngine::Window::Blackman));
+    fftWindowCombo->addItem("Flat-top", static_cast<int>(FFTEngine::Window::FlatTop));
+    modeLayout->addWidget(new QLabel("FFT Window:"), 4, 0);
+    modeLayout->addWidget(fftWindowCombo, 4, 1);
+    // Digital phosphor for Both / CH1 / CH2, fading earlier frames in XY;
+    // the value is the fade time constant
+    persistenceCombo = new QComboBox();
+    persistenceCombo->addItem("Off", 0.0);
+    persistenceCombo->addItem("0.5 s", 0.5);
+    persistenceCombo->addItem("2 s", 2.0);
+    persistenceCombo->addItem("10 s", 10.0);
+    persistenceCombo->addItem("Infinite", -1.0);
+    persistenceCombo->setToolTip("Accumulate frames into an intensity-graded display to reveal jitter and rare glitches");
+    QPushButton *clearPersistenceBtn = new QPushButton("Clear");
+    QHBoxLayout *persistenceLayout = new QHBoxLayout();
+    persistenceLayout->addWidget(persistenceCombo);
+    persistenceLayout->addWidget(clearPersistenceBtn);
+    modeLayout->addWidget(new QLabel("Persistence:"), 5, 0);
+    modeLayout->addLayout(persistenceLayout, 5, 1);
+    connect(clearPersistenceBtn, &QPushButton::clicked, this, [this]() {
+        if (plotManager) plotManager->clearPersistence();
+    });
     bothChRadio->setChecked(true);
     scopeTabLayout->addWidget(modeGroup);
 
+    // Spectrum analyser, used by the Spectrum Analyzer display mode
+    QGroupBox *spectrumGroup = new QGroupBox("Spectrum Analyzer");
+    QGridLayout *spectrumLayout = new QGridLayout(spectrumGroup);
+    spectrumSizeCombo = new QComboBox();
+    for (int size = 1024; size <= 65536; size *= 2) {
+        spectrumSizeCombo->addItem(QString("%1k").arg(size / 1024), size);
+    }
+    spectrumSizeCombo->setCurrentIndex(2); // 4k
+    spectrumSizeCombo->setToolTip("FFT length per segment; full resolution needs a contiguous (Roll) stream");
+    spectrumOverlapCombo = new QComboBox();
+    spectrumOverlapCombo->addItem("0 %", 0.0);
+    spectrumOverlapCombo->addItem("50 %", 0.5);
+    spectrumOverlapCombo->addItem("75 %", 0.75);
+    spectrumOverlapCombo->setCurrentIndex(1);
+    spectrumAveragingCombo = new QComboBox();
+    spectrumAveragingCombo->addItem("Linear", 0);
+    for (int n : {4, 8, 16, 32, 64}) spectrumAveragingCombo->addItem(QString("Exponential %1").arg(n), n);
+    spectrumAveragingCombo->setCurrentIndex(2); // Exponential 8
+    spectrumPeakHoldCheckBox = new QCheckBox("Peak hold");
+    spectrumZoomCombo = new QComboBox();
+    spectrumZoomCombo->addItem("Off", 1);
+    for (int zoom = 2; zoom <= 256; zoom *= 2) spectrumZoomCombo->addItem(QString("%1x").arg(zoom), zoom);
+    spectrumCenterSpin = new QDoubleSpinBox();
+    spectrumCenterSpin->setRange(0.0, 1e6);
+    spectrumCenterSpin->setDecimals(1);
+    spectrumCenterSpin->setSuffix(" Hz");
+    spectrumCenterSpin->setToolTip("Centre of the zoomed band");
+    QPushButton *spectrumResetBtn = new QPushButton("Reset");
+    spectrumLayout->addWidget(new QLabel("FFT size:"), 0, 0);
+    spectrumLayout->addWidget(spectrumSizeCombo, 0, 1);
+    spectrumLayout->addWidget(new QLabel("Overlap:"), 0, 2);
+    spectrumLayout->addWidget(spectrumOverlapCombo, 0, 3);
+    spectrumLayout->addWidget(new QLabel("Average:"), 1, 0);
+    spectrumLayout->addWidget(spectrumAveragingCombo, 1, 1);
+    spectrumLayout->addWidget(spectrumPeakHoldCheckBox, 1, 2);
+    spectrumLayout->addWidget(spectrumResetBtn, 1, 3);
+    spectrumLayout->addWidget(new QLabel("Zoom:"), 2, 0);
+    spectrumLayout->addWidget(spectrumZoomCombo, 2, 1);
+    spectrumLayout->addWidget(new QLabel("Centre:"), 2, 2);
+    spectrumLayout->addWidget(spectrumCenterSpin, 2, 3);
+    connect(spectrumResetBtn, &QPushButton::clicked, this, [this]() {
+        if (dspWorker) dspWorker->resetSpectrum();
+    });
+    scopeTabLayout->addWidget(spectrumGroup);
+
+    // Per-channel filtering, run on the DSP thread
+    QGroupBox *filterGroup = new QGroupBox("Filters");
+    QGridLayout *filterLayout = new QGridLayout(filterGroup);
+    ch1LowPassCombo = new QComboBox();
+    ch2LowPassCombo = new QComboBox();
+    ch1AverageCombo = new QComboBox();
+    ch2AverageCombo = new QComboBox();
+    for (QComboBox *combo : {ch1LowPassCombo, ch2LowPassCombo}) {
+        combo->addItem("Off", 0.0);
+        combo->addItem("fs/4", 0.25);
+        combo->addItem("fs/10", 0.1);
+        combo->addItem("fs/20", 0.05);
+        combo->addItem("fs/50", 0.02);
+        combo->setToolTip("Zero-phase low-pass cutoff as a fraction of the sample rate");
+    }
+    for (QComboBox *combo : {ch1AverageCombo, ch2AverageCombo}) {
+        combo->addItem("Off", 1);
+        for (int frames : {2, 4, 8, 16, 64}) combo->addItem(QString("%1 frames").arg(frames), frames);
+        combo->setToolTip("Average consecutive frames to reduce noise on repetitive signals");
+    }
+    filterLayout->addWidget(new QLabel("CH1"), 0, 1);
+    filterLayout->addWidget(new QLabel("CH2"), 0, 2);
+    filterLayout->addWidget(new QLabel("Low-pass:"), 1, 0);
+    filterLayout->addWidget(ch1LowPassCombo, 1, 1);
+    filterLayout->addWidget(ch2LowPassCombo, 1, 2);
+    filterLayout->addWidget(new QLabel("Average:"), 2, 0);
+    filterLayout->addWidget(ch1AverageCombo, 2, 1);
+    filterLayout->addWidget(ch2AverageCombo, 2, 2);
+    scopeTabLayout->addWidget(filterGroup);
+
     // Sample Rate
     QGroupBox *sampleRateGroup = new QGroupBox("Sample Rate");
     QHBoxLayout *sampleRateLayout = new QHBoxLayout(sampleRateGroup);
@@ -339,9 +551,12 @@ void MainWindow::setupUi()
     continuousRadio = new QRadioButton("Continuous");
     overwriteRadio = new QRadioButton("Overwrite");
     addRadio = new QRadioButton("ADD");
+    rollRadio = new QRadioButton("Roll");
+    rollRadio->setToolTip("Stream gap-free into the capture history and show the last second");
     runModeLayout->addWidget(continuousRadio);
     runModeLayout->addWidget(overwriteRadio);
     runModeLayout->addWidget(addRadio);
+    runModeLayout->addWidget(rollRadio);
     // Default to Overwrite mode for proper trigger functionality
     overwriteRadio->setChecked(true);
     continuousRadio->setChecked(false);
@@ -424,10 +639,87 @@ void MainWindow::setupUi()
     trigLayout->addWidget(new QLabel("Level:"), 3, 0);
     trigLayout->addWidget(trigLevelSlider, 3, 1);
     trigLayout->addWidget(trigLevelEdit, 3, 2);
+
+    preTriggerSpin = new QSpinBox();
+    preTriggerSpin->setRange(0, 90);
+    preTriggerSpin->setValue(10);
+    preTriggerSpin->setSuffix(" %");
+    holdoffSpin = new QSpinBox();
+    holdoffSpin->setRange(0, 1000000);
+    holdoffSpin->setValue(0);
+    holdoffSpin->setSuffix(" samples");
+    trigLayout->addWidget(new QLabel("Pre-trigger:"), 4, 0);
+    trigLayout->addWidget(preTriggerSpin, 4, 1);
+    trigLayout->addWidget(new QLabel("Holdoff:"), 5, 0);
+    trigLayout->addWidget(holdoffSpin, 5, 1);
     scopeTabLayout->addWidget(trigGroup);
 
+    // Mask test: every frame, cut like the trigger cuts the display, is
+    // checked against a tolerance envelope on the DSP thread
+    QGroupBox *maskGroup = new QGroupBox("Mask Test");
+    QGridLayout *maskLayout = new QGridLayout(maskGroup);
+    maskTestCheckBox = new QCheckBox("Test frames");
+    maskStopOnFailCheckBox = new QCheckBox("Stop on fail");
+    maskLayout->addWidget(maskTestCheckBox, 0, 0);
+    maskLayout->addWidget(maskStopOnFailCheckBox, 0, 1);
+    maskLearnSpin = new QSpinBox();
+    maskLearnSpin->setRange(1, 10000);
+    maskLearnSpin->setValue(16);
+    maskLearnSpin->setSuffix(" frames");
+    QPushButton *maskLearnBtn = new QPushButton("Learn");
+    maskLearnBtn->setToolTip("Build the mask from the next golden frames, then test against it");
+    maskLayout->addWidget(maskLearnSpin, 1, 0);
+    maskLayout->addWidget(maskLearnBtn, 1, 1);
+    maskMarginSpin = new QDoubleSpinBox();
+    maskMarginSpin->setRange(0.0, 20.0);
+    maskMarginSpin->setSingleStep(0.05);
+    maskMarginSpin->setValue(0.2);
+    maskMarginSpin->setSuffix(" V");
+    maskMarginSamplesSpin = new QSpinBox();
+    maskMarginSamplesSpin->setRange(0, 100);
+    maskMarginSamplesSpin->setValue(2);
+    maskMarginSamplesSpin->setSuffix(" samples");
+    maskLayout->addWidget(new QLabel("Margin:"), 2, 0);
+    maskLayout->addWidget(maskMarginSpin, 2, 1);
+    maskLayout->addWidget(maskMarginSamplesSpin, 3, 1);
+    QPushButton *maskLoadBtn = new QPushButton("Load...");
+    QPushButton *maskSaveBtn = new QPushButton("Save...");
+    maskLayout->addWidget(maskLoadBtn, 4, 0);
+    maskLayout->addWidget(maskSaveBtn, 4, 1);
+    maskSaveFailuresBtn = new QPushButton("Record Failures...");
+    maskSaveFailuresBtn->setCheckable(true);
+    maskSaveFailuresBtn->setToolTip("Write every failing frame, raw, to a frame recording");
+    QPushButton *maskResetBtn = new QPushButton("Reset Counts");
+    maskLayout->addWidget(maskSaveFailuresBtn, 5, 0);
+    maskLayout->addWidget(maskResetBtn, 5, 1);
+    maskStatusLabel = new QLabel("No mask");
+    maskLayout->addWidget(maskStatusLabel, 6, 0, 1, 2);
+    connect(maskLearnBtn, &QPushButton::clicked, this, &MainWindow::onMaskLearnClicked);
+    connect(maskLoadBtn, &QPushButton::clicked, this, &MainWindow::onMaskLoadClicked);
+    connect(maskSaveBtn, &QPushButton::clicked, this, &MainWindow::onMaskSaveClicked);
+    connect(maskResetBtn, &QPushButton::clicked, this, [this]() {
+        dspWorker->resetMaskStats();
+        updateMaskStatus();
+    });
+    scopeTabLayout->addWidget(maskGroup);
+
     exportBtn = new QPushButton("Export to CSV");
     scopeTabLayout->addWidget(exportBtn);
+    QHBoxLayout* captureLayout = new QHBoxLayout();
+    recordBtn = new QPushButton("Record...");
+    recordBtn->setCheckable(true);
+    openCaptureBtn = new QPushButton("Open Capture...");
+    captureLayout->addWidget(recordBtn);
+    captureLayout->addWidget(openCaptureBtn);
+    scopeTabLayout->addLayout(captureLayout);
+    QHBoxLayout* frameRecordLayout = new QHBoxLayout();
+    frameRecordBtn = new QPushButton("Record Frames...");
+    frameRecordBtn->setCheckable(true);
+    frameRecordBtn->setToolTip("Write every acquired frame, raw, to disk");
+    frameCompressCheckBox = new QCheckBox("Compress");
+    frameRecordLayout->addWidget(frameRecordBtn);
+    frameRecordLayout->addWidget(frameCompressCheckBox);
+    scopeTabLayout->addLayout(frameRecordLayout);
 
     // Show Raw ADC Values Checkbox and Debug Terminal
     // showRawAdcCheckBox = new QCheckBox("Show Raw ADC Values");
@@ -473,6 +765,19 @@ void MainWindow::setupUi()
         });
     }
 
+    // The deepest spectrum zoom depends on streaming
+    if (rollRadio) connect(rollRadio, &QRadioButton::toggled, this, &MainWindow::onSpectrumSettingsChanged);
+    // The mask test runs on frames; the Roll stream is not tested
+    if (rollRadio) connect(rollRadio, &QRadioButton::toggled, this, [this](bool checked) {
+        if (!maskTestCheckBox) return;
+        if (checked && maskTestCheckBox->isChecked()) {
+            maskTestCheckBox->setChecked(false);
+            showStatus("Mask test stopped: not available in Roll");
+        }
+        maskTestCheckBox->setEnabled(!checked);
+        maskTestCheckBox->setToolTip(checked ? "Mask testing runs on frames, not on the Roll stream" : QString());
+    });
+
     if (continuousRadio) {
         connect(continuousRadio, &QRadioButton::toggled, this, [this](bool checked) {
             if (checked) {
@@ -484,6 +789,7 @@ void MainWindow::setupUi()
                     plotTimer->start(33); // ~30 FPS for smooth real-time updates
                 }
             }
+            updateStreamingState();
         });
     }
 
@@ -530,40 +836,7 @@ void MainWindow::setupUi()
     QGroupBox *bodePlotGroup = new QGroupBox("Bode Plot Display");
     QVBoxLayout *bodePlotLayout = new QVBoxLayout(bodePlotGroup);
 
-    // Create a separate plot for Bode plot
-    bodePlot = new QCustomPlot();
-    bodePlot->setMinimumHeight(300); // Increased from 200 to 300 for better visibility
-    bodePlot->xAxis->setLabel("Frequency (Hz)");
-    bodePlot->xAxis->setScaleType(QCPAxis::stLogarithmic);
-
-    // Setup left Y-axis for magnitude
-    bodePlot->yAxis->setLabel("Magnitude (dB)");
-    bodePlot->yAxis->setLabelColor(Qt::blue);
-    bodePlot->yAxis->setTickLabelColor(Qt::blue);
-    bodePlot->yAxis->setBasePen(QPen(Qt::blue));
-    bodePlot->yAxis->setTickPen(QPen(Qt::blue));
-    bodePlot->yAxis->setSubTickPen(QPen(Qt::blue));
-
-    // Setup right Y-axis for phase (when we add phase data later)
-    bodePlot->yAxis2->setVisible(true);
-    bodePlot->yAxis2->setLabel("Phase (degrees)");
-    bodePlot->yAxis2->setLabelColor(Qt::red);
-    bodePlot->yAxis2->setTickLabelColor(Qt::red);
-    bodePlot->yAxis2->setBasePen(QPen(Qt::red));
-    bodePlot->yAxis2->setTickPen(QPen(Qt::red));
-    bodePlot->yAxis2->setSubTickPen(QPen(Qt::red));
-            // Ensure phase axis shows tick values
-        bodePlot->yAxis2->setTickLabelFont(QFont("Arial", 8));
-        bodePlot->yAxis2->setTickLength(5, 3); // Main tick length, sub-tick length
-        bodePlot->yAxis2->setNumberFormat("f"); // Show decimal format
-        bodePlot->yAxis2->setNumberPrecision(1); // Precision for tick labels
-    bodePlot->legend->setVisible(true);
-
-    bodePlot->axisRect()->setupFullAxesBox(true);
-    bodePlot->axisRect()->setMargins(QMargins(60, 20, 20, 60)); // Left, Top, Right, Bottom
-    bodePlotLayout->addWidget(bodePlot);
-
-    // Bode plot controls
+    // Bode plot controls; the plot itself is built on first use, in the main area
     QHBoxLayout *bodeControlLayout = new QHBoxLayout();
     clearBodeBtn = new QPushButton("Clear Plot");
     exportBodeBtn = new QPushButton("Export Bode Data");
@@ -596,10 +869,18 @@ void MainWindow::setupUi()
     sweepSamplesSpin->setSuffix(" points");
 
     sweepDelaySpin = new QSpinBox();
-    sweepDelaySpin->setRange(100, 1000);
-    sweepDelaySpin->setValue(100);
+    sweepDelaySpin->setRange(0, 1000);
+    sweepDelaySpin->setValue(20);
     sweepDelaySpin->setSuffix(" ms");
 
+    sweepAdaptiveCheckBox = new QCheckBox("Adaptive (steps = max points)");
+    sweepAdaptiveCheckBox->setToolTip("Start coarse and add points where gain or phase changes quickly");
+    sweepTimeBudgetSpin = new QSpinBox();
+    sweepTimeBudgetSpin->setRange(0, 3600);
+    sweepTimeBudgetSpin->setValue(0);
+    sweepTimeBudgetSpin->setSuffix(" s");
+    sweepTimeBudgetSpin->setSpecialValueText("No limit");
+
     // Layout for automatic sweep controls
     ddsSweepLayout->addWidget(new QLabel("Start Frequency:"), 0, 0);
     ddsSweepLayout->addWidget(sweepStartSpin, 0, 1);
@@ -609,6 +890,9 @@ void MainWindow::setupUi()
     ddsSweepLayout->addWidget(sweepSamplesSpin, 2, 1);
     ddsSweepLayout->addWidget(new QLabel("Delay per Step:"), 3, 0);
     ddsSweepLayout->addWidget(sweepDelaySpin, 3, 1);
+    ddsSweepLayout->addWidget(sweepAdaptiveCheckBox, 4, 0, 1, 2);
+    ddsSweepLayout->addWidget(new QLabel("Refinement Time Limit:"), 5, 0);
+    ddsSweepLayout->addWidget(sweepTimeBudgetSpin, 5, 1);
 
     // Sweep control buttons
     sweepStartBtn = new QPushButton("Start Sweep");
@@ -620,12 +904,12 @@ void MainWindow::setupUi()
     QHBoxLayout *sweepBtnLayout = new QHBoxLayout();
     sweepBtnLayout->addWidget(sweepStartBtn);
     sweepBtnLayout->addWidget(stopSweepBtn);
-    ddsSweepLayout->addLayout(sweepBtnLayout, 4, 0, 1, 2);
+    ddsSweepLayout->addLayout(sweepBtnLayout, 6, 0, 1, 2);
 
     // Progress bar
     sweepProgress = new QProgressBar();
     sweepProgress->setVisible(false);
-    ddsSweepLayout->addWidget(sweepProgress, 5, 0, 1, 2);
+    ddsSweepLayout->addWidget(sweepProgress, 7, 0, 1, 2);
 
     bodeTabLayout->addWidget(ddsSweepGroup);
     bodeTabLayout->addStretch();
@@ -658,8 +942,78 @@ void MainWindow::setupUi()
     }
     readDigitalBtn = new QPushButton("Read Inputs");
     digIoLayout->addWidget(readDigitalBtn, 2, 0, 1, 5);
+    digitalPollSpin = new QSpinBox();
+    digitalPollSpin->setRange(0, 5000);
+    digitalPollSpin->setSingleStep(50);
+    digitalPollSpin->setSuffix(" ms");
+    digitalPollSpin->setSpecialValueText("Off");
+    digitalPollSpin->setValue(0);
+    digIoLayout->addWidget(new QLabel("Poll:"), 3, 0);
+    digIoLayout->addWidget(digitalPollSpin, 3, 1, 1, 4);
     digiTabLayout->addWidget(digIoGroup);
 
+    // Protocol decoding, run on the DSP thread over frames, the Roll stream
+    // or the polled digital inputs
+    QGroupBox *decodeGroup = new QGroupBox("Protocol Decode");
+    QGridLayout *decodeLayout = new QGridLayout(decodeGroup);
+    decodeProtocolCombo = new QComboBox();
+    decodeProtocolCombo->addItem("Off", -1);
+    decodeProtocolCombo->addItem("UART", static_cast<int>(BusConfig::Protocol::Uart));
+    decodeProtocolCombo->addItem("SPI", static_cast<int>(BusConfig::Protocol::Spi));
+    decodeProtocolCombo->addItem("I2C", static_cast<int>(BusConfig::Protocol::I2c));
+    decodeSourceCombo = new QComboBox();
+    decodeSourceCombo->addItem("CH1/CH2 (lines 0, 1)", static_cast<int>(BusConfig::Source::Analog));
+    decodeSourceCombo->addItem("Digital inputs (lines 0-3)", static_cast<int>(BusConfig::Source::Digital));
+    decodeSourceCombo->setToolTip("Digital inputs are sampled once per poll; only very slow buses decode from them");
+    decodeLayout->addWidget(new QLabel("Protocol:"), 0, 0);
+    decodeLayout->addWidget(decodeProtocolCombo, 0, 1);
+    decodeLayout->addWidget(new QLabel("Source:"), 0, 2);
+    decodeLayout->addWidget(decodeSourceCombo, 0, 3);
+    for (int i = 0; i < 4; ++i) {
+        decodeLineLabels[i] = new QLabel();
+        decodeLineSpins[i] = new QSpinBox();
+        decodeLineSpins[i]->setRange(-1, 3);
+        decodeLineSpins[i]->setSpecialValueText("None");
+        decodeLineSpins[i]->setValue(i < 2 ? i : -1);
+        decodeLayout->addWidget(decodeLineLabels[i], 1 + i / 2, 2 * (i % 2));
+        decodeLayout->addWidget(decodeLineSpins[i], 1 + i / 2, 2 * (i % 2) + 1);
+    }
+    decodeBaudSpin = new QSpinBox();
+    decodeBaudSpin->setRange(1, 2000000);
+    decodeBaudSpin->setValue(9600);
+    decodeParityCombo = new QComboBox();
+    decodeParityCombo->addItem("No parity", static_cast<int>(UartDecoder::Parity::None));
+    decodeParityCombo->addItem("Even", static_cast<int>(UartDecoder::Parity::Even));
+    decodeParityCombo->addItem("Odd", static_cast<int>(UartDecoder::Parity::Odd));
+    decodeSpiModeCombo = new QComboBox();
+    for (int mode = 0; mode < 4; ++mode) decodeSpiModeCombo->addItem(QString("Mode %1").arg(mode), mode);
+    decodeThresholdSpin = new QDoubleSpinBox();
+    decodeThresholdSpin->setRange(-10.0, 10.0);
+    decodeThresholdSpin->setSingleStep(0.1);
+    decodeThresholdSpin->setValue(1.4);
+    decodeThresholdSpin->setSuffix(" V");
+    decodeLayout->addWidget(new QLabel("Baud:"), 3, 0);
+    decodeLayout->addWidget(decodeBaudSpin, 3, 1);
+    decodeLayout->addWidget(decodeParityCombo, 3, 2);
+    decodeLayout->addWidget(decodeSpiModeCombo, 3, 3);
+    decodeLayout->addWidget(new QLabel("Threshold:"), 4, 0);
+    decodeLayout->addWidget(decodeThresholdSpin, 4, 1);
+    decodeLogList = new QListWidget();
+    decodeLogList->setMaximumHeight(120);
+    decodeLayout->addWidget(decodeLogList, 5, 0, 1, 4);
+    QPushButton *decodeClearBtn = new QPushButton("Clear");
+    QPushButton *decodeExportBtn = new QPushButton("Export Events...");
+    decodeLayout->addWidget(decodeClearBtn, 6, 0, 1, 2);
+    decodeLayout->addWidget(decodeExportBtn, 6, 2, 1, 2);
+    connect(decodeClearBtn, &QPushButton::clicked, this, [this]() {
+        decodeEvents.clear();
+        streamOverlay.clear();
+        decodeLogList->clear();
+        if (plotManager) plotManager->clearAnnotations();
+    });
+    connect(decodeExportBtn, &QPushButton::clicked, this, &MainWindow::onExportDecodedClicked);
+    digiTabLayout->addWidget(decodeGroup);
+
     QGroupBox *studentGroup = new QGroupBox("Student Info");
     QGridLayout *studentLayout = new QGridLayout(studentGroup);
     studentNameEdit = new QLineEdit("Student Name");
@@ -712,6 +1066,50 @@ void MainWindow::setupConnections()
     if (serialHandler) {
         connect(serialHandler, &SerialHandler::connectionStatus, this, &MainWindow::handleSerialConnectionStatus);
         connect(serialHandler, &SerialHandler::portError, this, &MainWindow::handleSerialPortError);
+        connect(serialHandler, &SerialHandler::statusMessage, this, &MainWindow::onStatusMessage);
+        connect(acquisitionManager, &AcquisitionManager::deviceCountChanged, this, [this](int count) {
+            if (plotManager) plotManager->setExtraChannelCount(2 * count);
+            if (count > 0) showStatus(QString("%1 additional board(s) acquiring in parallel").arg(count));
+        });
+        connect(acquisitionManager, &AcquisitionManager::channelsUpdated, this, [this]() {
+            if (!plotManager) return;
+            const QVector<DeviceChannel>& channels = acquisitionManager->channels();
+            for (int i = 0; i < channels.size(); ++i) plotManager->setExtraChannel(i, channels[i].samples);
+        });
+        connect(serialHandler, &SerialHandler::signatureReceived, this, [this](const QString &signature) {
+            deviceSignature = signature;
+            if (signatureEdit) signatureEdit->setText(signature);
+        });
+        if (linkSpeedCombo) {
+            connect(linkSpeedCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index) {
+                serialHandler->setMaxBaudRate(linkSpeedCombo->itemData(index).toInt());
+            });
+        }
+        connect(serialHandler, &SerialHandler::framesAvailable, dspWorker, &DspWorker::processFrames);
+        connect(dspWorker, &DspWorker::framesReady, this, &MainWindow::onFramesAvailable);
+        connect(serialHandler, &SerialHandler::historyAvailable, this, &MainWindow::onHistoryAvailable);
+        connect(serialHandler, &SerialHandler::historyAvailable, dspWorker, &DspWorker::processHistory);
+        connect(dspWorker, &DspWorker::spectrumReady, this, &MainWindow::onSpectrumReady);
+        connect(digitalIO, &DigitalIO::inputsSampled, dspWorker, &DspWorker::processDigitalInputs);
+        connect(dspWorker, &DspWorker::annotationsReady, this, &MainWindow::onAnnotationsReady);
+        connect(dspWorker, &DspWorker::maskLearned, this, &MainWindow::onMaskLearned);
+        connect(dspWorker, &DspWorker::maskHalted, this, &MainWindow::onMaskHalted);
+        connect(serialHandler, &SerialHandler::hardwareStreamingStatus, this, [this](bool active) {
+            showStatus(active ? "Roll: hardware streaming" : "Roll: firmware cannot stream, using pipelined captures");
+        });
+        connect(serialHandler, &SerialHandler::ddsUploaded, this, [this]() {
+            // A sweep step's settling time starts once the new frequency is out
+            if (sweepSettleMs < 0) return;
+            const int settle = sweepSettleMs;
+            sweepSettleMs = -1;
+            QTimer::singleShot(settle, this, &MainWindow::captureSweepPoint);
+        });
+        connect(serialHandler, &SerialHandler::ddsUploadFailed, this, [this]() {
+            // The sweep would wait for ddsUploaded forever
+            if (!sweepRunning) return;
+            showStatus("Sweep stopped: the DDS could not be set, port not open");
+            stopSweep();
+        });
     }
     // connect(serialHandler, &SerialHandler::dataReceived, this, &MainWindow::handleSerialData); // Disabled legacy data handling
 
@@ -722,8 +1120,69 @@ void MainWindow::setupConnections()
         connect(stopBtn, &QPushButton::clicked, this, &MainWindow::onStopClicked);
     if (abortBtn)
         connect(abortBtn, &QPushButton::clicked, this, &MainWindow::onAbortClicked);
+    if (autoSetBtn)
+        connect(autoSetBtn, &QPushButton::clicked, this, &MainWindow::onAutoSetClicked);
+    connect(autoSetupTimer, &QTimer::timeout, this, [this]() {
+        qWarning() << "[MainWindow] Auto-set capture timed out";
+        finishAutoSetup(AutoSetupEnd::Cancel);
+    });
     if (exportBtn)
         connect(exportBtn, &QPushButton::clicked, this, &MainWindow::onExportCSV);
+    if (recordBtn)
+        connect(recordBtn, &QPushButton::toggled, this, &MainWindow::onRecordToggled);
+    if (openCaptureBtn)
+        connect(openCaptureBtn, &QPushButton::clicked, this, &MainWindow::onOpenCapture);
+    connect(captureWriter, &CaptureFileWriter::errorOccurred, this, [this](const QString& msg) {
+        showStatus("Recording failed: " + msg);
+        if (recordBtn) recordBtn->setChecked(false);
+    });
+    if (frameRecordBtn)
+        connect(frameRecordBtn, &QPushButton::toggled, this, &MainWindow::onFrameRecordToggled);
+    if (perfOverlayBtn)
+        connect(perfOverlayBtn, &QPushButton::toggled, this, [this](bool on) {
+            if (!on) {
+                perfOverlayTimer->stop();
+                perfOverlay->hide();
+                return;
+            }
+            // Start a fresh interval so the first numbers are not stale
+            PerfCounters::StageStats discard[int(PerfStage::Count)];
+            PerfCounters::instance().stats(discard, true);
+            perfLastAcquired = PerfCounters::instance().framesAcquired();
+            perfLastDisplayed = PerfCounters::instance().framesDisplayed();
+            perfOverlayClock.start();
+            perfOverlay->setText("Collecting...");
+            perfOverlay->adjustSize();
+            perfOverlay->show();
+            perfOverlay->raise();
+            perfOverlayTimer->start();
+        });
+    connect(perfOverlayTimer, &QTimer::timeout, this, &MainWindow::updatePerfOverlay);
+    if (logVerbosityCombo)
+        connect(logVerbosityCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index) {
+            setLogVerbosity(static_cast<LogVerbosity>(logVerbosityCombo->itemData(index).toInt()));
+        });
+    // Emitted on the writer thread
+    connect(frameRecorder, &FrameRecorder::errorOccurred, this, [this](const QString& msg) {
+        showStatus("Frame recording failed: " + msg);
+        if (frameRecordBtn) frameRecordBtn->setChecked(false);
+    }, Qt::QueuedConnection);
+    if (maskTestCheckBox)
+        connect(maskTestCheckBox, &QCheckBox::toggled, this, &MainWindow::onMaskTestToggled);
+    if (maskStopOnFailCheckBox)
+        connect(maskStopOnFailCheckBox, &QCheckBox::toggled, this, &MainWindow::onMaskOptionsChanged);
+    if (maskSaveFailuresBtn)
+        connect(maskSaveFailuresBtn, &QPushButton::toggled, this, &MainWindow::onMaskSaveFailuresToggled);
+    connect(maskStatusTimer, &QTimer::timeout, this, &MainWindow::updateMaskStatus);
+    connect(maskFailRecorder, &FrameRecorder::errorOccurred, this, [this](const QString& msg) {
+        showStatus("Failure recording failed: " + msg);
+        if (maskSaveFailuresBtn) maskSaveFailuresBtn->setChecked(false);
+    }, Qt::QueuedConnection);
+    connect(frameRecordStatusTimer, &QTimer::timeout, this, [this]() {
+        showStatus(QString("Recording frames: %1 written, %2 dropped, %3 MB")
+                       .arg(frameRecorder->framesWritten()).arg(frameRecorder->framesDropped())
+                       .arg(frameRecorder->bytesWritten() / 1e6, 0, 'f', 1));
+    });
     if (sampleRateCombo)
         connect(sampleRateCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onSampleRateChanged);
 
@@ -783,7 +1242,25 @@ void MainWindow::setupConnections()
     if (fftCh1Radio) modeGroup->addButton(fftCh1Radio, 4);
     if (fftCh2Radio) modeGroup->addButton(fftCh2Radio, 5);
     if (fftBothRadio) modeGroup->addButton(fftBothRadio, 6); // NEW
+    if (spectrumRadio) modeGroup->addButton(spectrumRadio, 7);
     connect(modeGroup, &QButtonGroup::idClicked, this, &MainWindow::onModeChanged);
+    if (fftWindowCombo)
+        connect(fftWindowCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onFFTWindowChanged);
+    if (persistenceCombo)
+        connect(persistenceCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onPersistenceChanged);
+    for (QComboBox *combo : {spectrumSizeCombo, spectrumOverlapCombo, spectrumAveragingCombo, spectrumZoomCombo}) {
+        if (combo) connect(combo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onSpectrumSettingsChanged);
+    }
+    if (spectrumPeakHoldCheckBox)
+        connect(spectrumPeakHoldCheckBox, &QCheckBox::toggled, this, &MainWindow::onSpectrumSettingsChanged);
+    // Applied once editing is done; every change restarts the averages
+    if (spectrumCenterSpin)
+        connect(spectrumCenterSpin, &QDoubleSpinBox::editingFinished, this, &MainWindow::onSpectrumSettingsChanged);
+    for (QComboBox *combo : {ch1LowPassCombo, ch2LowPassCombo, ch1AverageCombo, ch2AverageCombo}) {
+        if (combo) connect(combo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::syncDspSettings);
+    }
+    if (lpfCheckBox)
+        connect(lpfCheckBox, &QCheckBox::toggled, this, &MainWindow::syncDspSettings);
 
     // DDS
     if (ddsStartStopBtn)
@@ -820,16 +1297,17 @@ void MainWindow::setupConnections()
         });
     if (exportBodeBtn)
         connect(exportBodeBtn, &QPushButton::clicked, this, [this]() {
-            if (!sweepFrequencies.isEmpty() && !sweepMagnitudes.isEmpty()) {
+            const QVector<BodeSweep::Point>& points = bodeSweep.points();
+            if (!points.isEmpty()) {
                 QString fileName = QFileDialog::getSaveFileName(this, "Export Bode Data", "", "CSV Files (*.csv)");
                 if (!fileName.isEmpty()) {
                     QFile file(fileName);
                     if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
                         QTextStream out(&file);
                         out << "Frequency(Hz),Magnitude(dB),Phase(degrees)\n";
-                        for (int i = 0; i < sweepFrequencies.size(); ++i) {
-                            double phase = (i < sweepPhases.size()) ? sweepPhases[i] : 0.0;
-                            out << sweepFrequencies[i] << "," << sweepMagnitudes[i] << "," << phase << "\n";
+                        for (const BodeSweep::Point& p : points) {
+                            if (!p.valid) continue;
+                            out << p.frequency << "," << p.magnitudeDb << "," << p.phaseDeg << "\n";
                         }
                         file.close();
                         showStatus("Bode data exported to " + fileName);
@@ -847,6 +1325,23 @@ void MainWindow::setupConnections()
         connect(digFreqStartBtn, &QPushButton::clicked, this, &MainWindow::onDigFreqStartClicked);
     if (readDigitalBtn)
         connect(readDigitalBtn, &QPushButton::clicked, this, &MainWindow::onReadDigitalClicked);
+    if (digitalPollSpin)
+        connect(digitalPollSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int ms) {
+            digitalIO->setPollInterval(isConnected ? ms : 0);
+            // The poll interval is the digital decoders' sample period
+            onDecodeSettingsChanged();
+        });
+    for (QComboBox *combo : {decodeProtocolCombo, decodeSourceCombo, decodeParityCombo, decodeSpiModeCombo}) {
+        if (combo) connect(combo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onDecodeSettingsChanged);
+    }
+    for (QSpinBox *spin : decodeLineSpins) {
+        if (spin) connect(spin, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::onDecodeSettingsChanged);
+    }
+    if (decodeBaudSpin)
+        connect(decodeBaudSpin, &QSpinBox::editingFinished, this, &MainWindow::onDecodeSettingsChanged);
+    if (decodeThresholdSpin)
+        connect(decodeThresholdSpin, &QDoubleSpinBox::editingFinished, this, &MainWindow::onDecodeSettingsChanged);
+    onDecodeSettingsChanged();
     for(int i=0; i<4; ++i) {
         if (digitalOutButtons[i])
             connect(digitalOutButtons[i], &QPushButton::clicked, this, [this, i](){ onDigitalOutToggled(i); });
@@ -901,12 +1396,14 @@ void MainWindow::updateUiState()
 
     // Connection controls
     if (serialPortCombo) serialPortCombo->setEnabled(!connected);
+    if (linkSpeedCombo) linkSpeedCombo->setEnabled(!connected);
     if (connectButton) connectButton->setText(connected ? "Disconnect" : "Connect");
 
     // Run/Stop controls
     if (runBtn) runBtn->setEnabled(connected && !running);
     if (stopBtn) stopBtn->setEnabled(connected && running);
     if (abortBtn) abortBtn->setEnabled(connected && running);
+    if (autoSetBtn) autoSetBtn->setEnabled(connected);
 
     // Keep all oscilloscope controls enabled even when running for real-time adjustments
     if (bothChRadio) bothChRadio->setEnabled(connected);
@@ -931,11 +1428,15 @@ void MainWindow::updateUiState()
     if (hlTrigRadio) hlTrigRadio->setEnabled(connected);
 
     if (continuousRadio) continuousRadio->setEnabled(connected);
+    if (rollRadio) rollRadio->setEnabled(connected);
     if (overwriteRadio) overwriteRadio->setEnabled(connected);
 
 
 
     if (exportBtn) exportBtn->setEnabled(connected);
+    if (recordBtn) recordBtn->setEnabled(connected || recordBtn->isChecked());
+    if (frameRecordBtn) frameRecordBtn->setEnabled(connected || frameRecordBtn->isChecked());
+    if (frameCompressCheckBox) frameCompressCheckBox->setEnabled(!frameRecordBtn || !frameRecordBtn->isChecked());
 
     // DDS controls
     if (ddsWaveformCombo) ddsWaveformCombo->setEnabled(connected);
@@ -948,6 +1449,7 @@ void MainWindow::updateUiState()
         if (digitalOutButtons[i]) digitalOutButtons[i]->setEnabled(connected);
     }
     if (readDigitalBtn) readDigitalBtn->setEnabled(connected);
+    if (digitalPollSpin) digitalPollSpin->setEnabled(connected);
     if (digFreqSpin) digFreqSpin->setEnabled(connected);
     if (digFreqStartBtn) digFreqStartBtn->setEnabled(connected);
 
@@ -974,26 +1476,58 @@ void MainWindow::onConnectButtonClicked()
             QMessageBox::warning(this, "Connection Error", "No serial port selected.");
             return;
         }
-        serialHandler->openPort(portName);
+        lastConnectedPort = portName;
+        autoConnectPort.clear();
+        if (portName == SIMULATOR_PORT) serialHandler->connectSimulated(SimulatedDevice::Config());
+        else serialHandler->openPort(portName);
     }
 }
 
 void MainWindow::handleSerialConnectionStatus(bool connected)
 {
     isConnected = connected;
+    updateStreamingState();
     updateUiState();
     showStatus(connected ? "Connected" : "Disconnected");
+    if (digitalIO && digitalPollSpin) digitalIO->setPollInterval(connected ? digitalPollSpin->value() : 0);
     if(connected) {
+        autoConnectPort.clear();
         onStudentNameChanged(); // Send name on connect
+        // Every other board on the bench becomes a secondary device
+        acquisitionManager->openPorts(boardPortsSeen, {lastConnectedPort});
     } else {
         lastConnectedPort.clear(); // Reset lastConnectedPort on disconnect
+        if (autoSetupRunning) finishAutoSetup(AutoSetupEnd::Cancel);
+        acquisitionManager->closeAll();
+        if (!autoConnectPort.isEmpty()) retryAutoConnect();
+    }
+}
+
+void MainWindow::retryAutoConnect()
+{
+    // The scan that found the board will not come again while it stays plugged in
+    if (++autoConnectAttempts >= AUTO_CONNECT_ATTEMPTS) {
+        showStatus(QString("Could not connect to %1").arg(autoConnectPort));
+        autoConnectPort.clear();
+        return;
     }
+    showStatus(QString("Could not open %1, retrying...").arg(autoConnectPort));
+    QTimer::singleShot(AUTO_CONNECT_RETRY_MS, this, [this]() {
+        // Gone, connected by hand or given up meanwhile
+        if (isConnected || autoConnectPort.isEmpty() || !boardPortsSeen.contains(autoConnectPort)) {
+            autoConnectPort.clear();
+            return;
+        }
+        lastConnectedPort = autoConnectPort;
+        serialHandler->openPort(autoConnectPort);
+    });
 }
 
 void MainWindow::handleSerialPortError(const QString &error)
 {
     QMessageBox::critical(this, "Serial Error", error);
     isConnected = false;
+    updateStreamingState();
     updateUiState();
     showStatus("Serial Port Error");
 }
@@ -1030,20 +1564,77 @@ void MainWindow::handleSerialData(const QByteArray &data)
     }
 }
 
-void MainWindow::updateSerialPortList()
+void MainWindow::onPortsChanged(const QStringList& ports, const QStringList& boardPorts)
 {
+    // Filled from the first scan on; keeps the selection across rebuilds
+    const QString selected = serialPortCombo->currentText();
     serialPortCombo->clear();
-    const auto ports = QSerialPortInfo::availablePorts();
-    for (const QSerialPortInfo &port : ports) {
-        serialPortCombo->addItem(port.portName());
+    serialPortCombo->addItems(ports);
+    serialPortCombo->addItem(SIMULATOR_PORT);
+    const int index = serialPortCombo->findText(selected);
+    if (index >= 0) serialPortCombo->setCurrentIndex(index);
+
+    // Connect when the board appears, not again after it was disconnected by hand
+    const QString boardPort = boardPorts.value(0);
+    const bool arrived = !boardPort.isEmpty() && boardPort != boardPortsSeen.value(0);
+    boardPortsSeen = boardPorts;
+    if (isConnected) {
+        // Boards plugged in later join as secondary devices
+        acquisitionManager->openPorts(boardPorts, {lastConnectedPort});
+        return;
     }
+    if (arrived) {
+        qDebug() << "[MainWindow] Board detected on" << boardPort;
+        showStatus(QString("Board detected, connecting to %1...").arg(boardPort));
+        lastConnectedPort = boardPort;
+        autoConnectPort = boardPort;
+        autoConnectAttempts = 0;
+        serialHandler->openPort(boardPort);
+    } else if (boardPort.isEmpty()) {
+        showStatus(ports.isEmpty() ? QString("No serial ports available")
+                                   : QString("Available ports: %1").arg(ports.join(", ")));
+    }
+}
+
+bool MainWindow::nativeEvent(const QByteArray& eventType, void* message, qintptr* result)
+{
+#ifdef Q_OS_WIN
+    // Windows tells top-level windows about device arrival and removal
+    if (portWatcher && eventType == "windows_generic_MSG" && static_cast<MSG*>(message)->message == WM_DEVICECHANGE)
+        portWatcher->rescan();
+#endif
+    return QMainWindow::nativeEvent(eventType, message, result);
 }
 
 void MainWindow::onRunClicked()
 {
     if (!isConnected) return;
+    if (autoSetupRunning) {
+        // Run as the controls are now
+        autoSetupResume = false;
+        finishAutoSetup(AutoSetupEnd::KeepCurrent);
+    }
+    if (viewingCapture) {
+        // Back to live data: restore the device's time base and gains
+        viewingCapture = false;
+        if (plotManager) {
+            plotManager->setMultiplier(multiplier);
+            plotManager->setGains(ch1Gain, ch2Gain);
+        }
+    }
     isRunning = true;
     updateUiState();
+    resetTraceCollection();
+    syncDspSettings();
+    if (dspWorker) {
+        dspWorker->resetChains();
+        dspWorker->resetSpectrum();
+        // After a stop on fail the next run carries on counting
+        dspWorker->resumeMaskTest();
+    }
+    if (addRadio && addRadio->isChecked()) {
+        targetTraceCount = qMin(++runCount + 1, MAX_ADD_TRACES);
+    }
     // --- PATCH: Restore working dataLength logic ---
     if (acquisitionMode == 0) {
         dataLength = 200;
@@ -1062,6 +1653,9 @@ void MainWindow::onRunClicked()
     bool dualChannel = (acquisitionMode == 0);
     qDebug() << "[MainWindow] onRunClicked: acquisitionMode=" << acquisitionMode
              << "-> serialMode=" << mode << "dataLength=" << len << "dualChannel=" << dualChannel;
+    // May fall back to Auto, so before the trigger settings are taken; they
+    // go out with the setup sequence
+    setTriggerMode();
     serialHandler->setProtocolParams(
         ch1Offset,
         ch2Offset,
@@ -1070,50 +1664,244 @@ void MainWindow::onRunClicked()
         trigPolarity,
         sampleRateCombo ? sampleRateCombo->currentIndex() : 3
     );
-    // Always configure trigger and start acquisition for all modes
-    setTriggerMode();
-    QThread::msleep(100);
-    connect(serialHandler, &SerialHandler::oscilloscopeRawDataReady, this, &MainWindow::onOscilloscopeRawDataReady, Qt::UniqueConnection);
+    if (rollRadio && rollRadio->isChecked() && !sweepRunning) {
+        rollActive = true;
+        rollDirty = false;
+        streamTrigger.reset();
+        streamTriggers.clear();
+        streamScanIndex = 0;
+        // The analyser and bus decoders follow the contiguous stream rather than frames
+        dspWorker->setStreamSource(&serialHandler->captureHistory());
+        streamOverlay.clear();
+        serialHandler->startHardwareStreaming(mode);
+        plotTimer->start(33);
+        return;
+    }
+    updateStreamingState();
     serialHandler->startOscilloscopeAcquisition(mode, len, dualChannel);
+    if (!sweepRunning && acquisitionManager->deviceCount() > 0) {
+        acquisitionManager->setProtocolParams(ch1Offset, ch2Offset, trigLevel, trigSource, trigPolarity,
+                                              sampleRateCombo ? sampleRateCombo->currentIndex() : 3);
+        acquisitionManager->start(mode, len, dualChannel);
+    }
     if (continuousRadio && continuousRadio->isChecked()) {
         plotTimer->start(33);
     }
 }
 
-void MainWindow::onOscilloscopeRawDataReady(const QByteArray &ch1, const QByteArray &ch2, int dataLength, bool dualChannel)
+// Continuous runs stream: SerialHandler arms the next capture as soon as a
+// frame is in, so this window only decodes and plots. Overwrite/Add and
+// sweeps need to inspect each frame first and keep re-arming from here.
+void MainWindow::updateStreamingState()
+{
+    // Roll mode re-arms inside SerialHandler until it is stopped
+    if (rollActive) return;
+    bool stream = isRunning && isConnected && !sweepRunning
+                  && continuousRadio && continuousRadio->isChecked();
+    if (stream == streamingActive) return;
+    streamingActive = stream;
+    serialHandler->setStreaming(stream);
+}
+
+void MainWindow::onHistoryAvailable()
+{
+    // Coalesce: plotTimer draws at most one roll window per tick
+    serialHandler->captureHistory().clearNotified();
+    rollDirty = true;
+}
+
+// Decodes the last ROLL_WINDOW_SECONDS straight out of the capture history
+void MainWindow::plotRollWindow()
+{
+    rollDirty = false;
+    if ((ch1TrigRadio && ch1TrigRadio->isChecked()) || (ch2TrigRadio && ch2TrigRadio->isChecked())) {
+        // Triggered view of the stream instead of a rolling one
+        plotTriggeredHistory();
+        return;
+    }
+    CaptureHistory& history = serialHandler->captureHistory();
+    const double sampleRate = 2.0 * maxFrequency;
+    const int windowSamples = qBound(1, int(ROLL_WINDOW_SECONDS * sampleRate), history.capacity());
+    adcDecoder.setParams(ch1Gain, ch1Offset, ch2Gain, ch2Offset);
+
+    // Both channels share one sample counter; read the same index range from each
+    const quint64 total = history.totalSamples();
+    const int n = int(qMin<quint64>(windowSamples, total));
+    const quint64 start = total - n;
+    CaptureHistory::Span span;
+    ch1Buffer.clear();
+    ch2Buffer.clear();
+    if (acquisitionMode != 2 && history.window(AdcDecoder::Ch1, start, n, span)) {
+        ch1Buffer.resize(n);
+        adcDecoder.decode(AdcDecoder::Ch1, span.first, span.firstLength, ch1Buffer.data());
+        adcDecoder.decode(AdcDecoder::Ch1, span.second, span.secondLength, ch1Buffer.data() + span.firstLength);
+    }
+    if (acquisitionMode != 1 && history.window(AdcDecoder::Ch2, start, n, span)) {
+        ch2Buffer.resize(n);
+        adcDecoder.decode(AdcDecoder::Ch2, span.first, span.firstLength, ch2Buffer.data());
+        adcDecoder.decode(AdcDecoder::Ch2, span.second, span.secondLength, ch2Buffer.data() + span.firstLength);
+    }
+    // The stream lapped us while decoding; the next tick gets a clean window
+    if (!history.isIntact(start)) {
+        rollDirty = true;
+        return;
+    }
+    if (!decodeBuses.isEmpty()) {
+        // Events that scrolled out of the window are not coming back
+        int expired = 0;
+        while (expired < streamOverlay.size() && streamOverlay[expired].endSample < start) ++expired;
+        streamOverlay.remove(0, expired);
+        plotManager->setAnnotations(streamOverlay, double(start), n);
+    }
+    plotManager->updateWaveform(ch1Buffer, ch2Buffer);
+}
+
+// Scans everything that reached the capture history since the last tick
+// and shows the newest trigger whose whole view has arrived, so no block
+// is skipped however fast the stream runs
+bool MainWindow::plotTriggeredHistory()
+{
+    CaptureHistory& history = serialHandler->captureHistory();
+    const AdcDecoder::Channel source = (ch2TrigRadio && ch2TrigRadio->isChecked()) ? AdcDecoder::Ch2 : AdcDecoder::Ch1;
+    const int viewLength = dataLength;
+    configureTrigger(streamTrigger, viewLength);
+    const int pre = streamTrigger.preTriggerSamples();
+    adcDecoder.setParams(ch1Gain, ch1Offset, ch2Gain, ch2Offset);
+
+    const quint64 total = history.totalSamples();
+    const quint64 cap = history.capacity();
+    const quint64 oldest = total > cap ? total - cap : 0;
+    if (streamScanIndex < oldest || streamScanIndex > total) {
+        // Lapped by the stream, or the history was restarted
+        streamScanIndex = oldest;
+        streamTrigger.reset();
+        streamTriggers.clear();
+    }
+    CaptureHistory::Span span;
+    while (streamScanIndex < total) {
+        const int chunk = int(qMin<quint64>(total - streamScanIndex, STREAM_TRIGGER_CHUNK));
+        if (!history.window(source, streamScanIndex, chunk, span)) break;
+        streamScratch.resize(chunk);
+        adcDecoder.decode(source, span.first, span.firstLength, streamScratch.data());
+        adcDecoder.decode(source, span.second, span.secondLength, streamScratch.data() + span.firstLength);
+        streamTrigger.process(streamScratch.constData(), chunk, qint64(streamScanIndex), streamTriggers);
+        streamScanIndex += chunk;
+    }
+
+    int pick = -1;
+    for (int i = streamTriggers.size() - 1; i >= 0; --i) {
+        const TriggerEngine::Event& e = streamTriggers[i];
+        if (e.position + (viewLength - pre) + 1 <= double(total) && e.position - pre - 1 >= double(oldest)) {
+            pick = i;
+            break;
+        }
+    }
+    if (pick < 0) {
+        // Drop triggers that fell out of the history
+        while (!streamTriggers.isEmpty() && streamTriggers.first().position - pre - 1 < double(oldest)) {
+            streamTriggers.removeFirst();
+        }
+        return false;
+    }
+    const TriggerEngine::Event event = streamTriggers[pick];
+    streamTriggers.remove(0, pick + 1);
+
+    // Decode just the samples around the view and resample onto the trigger
+    const qint64 first = qint64(std::floor(event.position)) - pre - 1;
+    const int count = viewLength + 3;
+    ch1Buffer.clear();
+    ch2Buffer.clear();
+    for (int ch = AdcDecoder::Ch1; ch <= AdcDecoder::Ch2; ++ch) {
+        if ((ch == AdcDecoder::Ch1 && acquisitionMode == 2) || (ch == AdcDecoder::Ch2 && acquisitionMode == 1)) continue;
+        if (!history.window(ch, quint64(first), count, span)) continue;
+        AdcDecoder::Channel channel = AdcDecoder::Channel(ch);
+        streamScratch.resize(count);
+        adcDecoder.decode(channel, span.first, span.firstLength, streamScratch.data());
+        adcDecoder.decode(channel, span.second, span.secondLength, streamScratch.data() + span.firstLength);
+        streamTrigger.extractWindow(streamScratch.constData(), count, first, event, viewLength,
+                                    ch == AdcDecoder::Ch1 ? ch1Buffer : ch2Buffer);
+    }
+    if (!history.isIntact(quint64(first)) || (ch1Buffer.isEmpty() && ch2Buffer.isEmpty())) {
+        return false;
+    }
+    plotManager->updateWaveform(ch1Buffer, ch2Buffer);
+    return true;
+}
+
+void MainWindow::onFramesAvailable()
+{
+    // A nested event loop inside frame processing (a dialog) can deliver
+    // this slot again; don't re-enter, but drain once more afterwards, since
+    // the ring only signals again once its notification is cleared
+    if (drainingFrames) {
+        redrainFrames = true;
+        return;
+    }
+    drainingFrames = true;
+    DecodedFrameRing& ring = dspWorker->output();
+    do {
+        redrainFrames = false;
+        ring.clearNotified();
+        while (const DecodedFrame* frame = ring.peek()) {
+            onOscilloscopeFrame(*frame);
+            ring.release();
+        }
+    } while (redrainFrames);
+    drainingFrames = false;
+}
+
+void MainWindow::onOscilloscopeFrame(const DecodedFrame& frame)
 {
-    qDebug() << "[MainWindow] Received oscilloscope data: CH1=" << ch1.size() << "bytes, CH2=" << ch2.size() << "bytes";
-    qDebug() << "[DEBUG] isRunning=" << isRunning << ", isConnected=" << isConnected;
+    const QVector<double>& ch1 = frame.ch1;
+    const QVector<double>& ch2 = frame.ch2;
+    const int dataLength = frame.dataLength;
+    const bool dualChannel = frame.dualChannel;
+    lastFrameTimestampNs = frame.timestampNs;
+    if (maskTestCheckBox && maskTestCheckBox->isChecked()) {
+        // Trigger settings change in many places; whatever the display uses, the test uses
+        const MaskAlignment alignment = currentMaskAlignment();
+        if (alignment != sentMaskAlignment) {
+            sentMaskAlignment = alignment;
+            dspWorker->setMaskAlignment(alignment);
+        }
+    }
+    if (!frame.annotations.isEmpty()) appendDecodeEvents(frame.annotations);
+    qCDebug(lcFrame) << "[MainWindow] Received oscilloscope data: CH1=" << ch1.size() << "samples, CH2=" << ch2.size() << "samples";
+    qCDebug(lcFrame) << "[DEBUG] isRunning=" << isRunning << ", isConnected=" << isConnected;
     // Only proceed if we have all required data for the current mode
     if (dualChannel) {
         if (ch1.isEmpty() || ch2.isEmpty()) {
-            qDebug() << "[MainWindow] Waiting for both channels to be ready before plotting.";
+            qCDebug(lcFrame) << "[MainWindow] Waiting for both channels to be ready before plotting.";
             return;
         }
     } else {
         // For single channel modes, check which channel data we expect
         // acquisitionMode: 1=CH1, 2=CH2 (from onModeChanged)
         if (acquisitionMode == 1 && ch1.isEmpty()) {
-            qDebug() << "[MainWindow] Waiting for CH1 data.";
+            qCDebug(lcFrame) << "[MainWindow] Waiting for CH1 data.";
             return;
         }
         if (acquisitionMode == 2 && ch2.isEmpty()) {
-            qDebug() << "[MainWindow] Waiting for CH2 data.";
+            qCDebug(lcFrame) << "[MainWindow] Waiting for CH2 data.";
             return;
         }
 
         // For single channel modes, ensure we don't have data from the wrong channel
         if (acquisitionMode == 1 && !ch2.isEmpty()) {
-            qDebug() << "[MainWindow] CH1 mode: ignoring CH2 data.";
+            qCDebug(lcFrame) << "[MainWindow] CH1 mode: ignoring CH2 data.";
             // Don't return, just ignore CH2 data
         }
         if (acquisitionMode == 2 && !ch1.isEmpty()) {
-            qDebug() << "[MainWindow] CH2 mode: ignoring CH1 data.";
+            qCDebug(lcFrame) << "[MainWindow] CH2 mode: ignoring CH1 data.";
             // Don't return, just ignore CH1 data
         }
     }
-    // Convert raw bytes to voltage values
-    QVector<double> ch1Volts, ch2Volts;
+    // Decoded and filtered on the DSP worker. The trigger cuts these down in
+    // place, so work on copies and let the ring slot go back to the worker
+    QVector<double>& ch1Volts = frameCh1;
+    QVector<double>& ch2Volts = frameCh2;
+    copySamples(ch1Volts, ch1);
+    copySamples(ch2Volts, ch2);
     QVector<double> timeValues;
     // Determine the number of points to plot (for x-axis)
     int N = 0;
@@ -1128,160 +1916,28 @@ void MainWindow::onOscilloscopeRawDataReady(const QByteArray &ch1, const QByteAr
     for (int i = 0; i < N; ++i) {
         timeValues[i] = i * multiplier;
     }
-    // --- ADC to Voltage Conversion (Legacy/Calibrated Equations) ---
-    /*
-     * For CH1 (Channel 1):
-     *   read_temp = (((ADC_CH1 * 10.0 / 128.0) - 10.0 + OC1) * scaleFactor / ch1Gain) + OC1 + 3.78V + UI_offset
-     * For CH2 (Channel 2):
-     *   read_temp = (((ADC_CH2 * 10.0 / 128.0) - 10.0) * scaleFactor / ch2Gain) + 3.78V + UI_offset
-     * Where:
-     *   ADC_CH1, ADC_CH2: Raw ADC value (0–255)
-     *   OC1: Offset correction for CH1 (set to 0.0 if not used)
-     *   scaleFactor: Calibration factor (5.0 / 4.8)
-     *   ch1Gain, ch2Gain: Gain for each channel
-     *   3.78V: Fixed baseline offset
-     *   UI_offset: User-adjustable offset from slider (ch1Offset/ch2Offset converted to voltage)
-     */
-    const double scaleFactor = 5.0 / 4.8;
-    const double OC1 = 0.0; // Set to nonzero if you want to apply offset correction
-    const double fixedOffset = 4.00; // Fixed baseline offset
-    double ch1UIOffset = (ch1Offset / 100.0) / 2.0; // Reduce offset effect by half
-    double ch2UIOffset = (ch2Offset / 100.0) / 2.0; // Reduce offset effect by half
-    // Convert CH1 data
-    if (!ch1.isEmpty()) {
-        ch1Volts.resize(ch1.size());
-        qDebug() << "[MainWindow] Converting CH1 data with gain:" << ch1Gain;
-        for (int i = 0; i < ch1.size(); ++i) {
-            double adcValue = static_cast<unsigned char>(ch1[i]);
-            double voltage = (((adcValue * 10.0 / 128.0) - 10.0 + OC1) * scaleFactor / ch1Gain) + OC1 + fixedOffset + ch1UIOffset;
-            voltage -= 3.78; // Apply fixed -8.89V offset
-            ch1Volts[i] = voltage;
-            if (i < 5) {
-                qDebug() << "[MainWindow] CH1[" << i << "]: ADC=" << adcValue << "->" << voltage << "V (gain=" << ch1Gain << ", UI_offset=" << ch1UIOffset << ")";
-            }
-        }
-    }
-    // Convert CH2 data
-    if (!ch2.isEmpty()) {
-        ch2Volts.resize(ch2.size());
-        qDebug() << "[MainWindow] Converting CH2 data with gain:" << ch2Gain;
-        for (int i = 0; i < ch2.size(); ++i) {
-            double adcValue = static_cast<unsigned char>(ch2[i]);
-            double voltage = (((adcValue * 10.0 / 128.0) - 10.0) * scaleFactor / ch2Gain) + fixedOffset + ch2UIOffset;
-            voltage -= 3.78; // Apply fixed -8.89V offset
-            ch2Volts[i] = voltage;
-            if (i < 5) {
-                qDebug() << "[MainWindow] CH2[" << i << "]: ADC=" << adcValue << "->" << voltage << "V (gain=" << ch2Gain << ", UI_offset=" << ch2UIOffset << ")";
-            }
-        }
-    }
-
-    // Apply averaging for 2Mbps rate (like VB.NET)
-    if (sampleRateCombo && sampleRateCombo->currentIndex() == 0) { // 2Mbps is index 0
-        qDebug() << "[MainWindow] 2Mbps detected, applying averaging";
-
-        // Store original data for averaging
-        QVector<double> originalCh1 = ch1Volts;
-        QVector<double> originalCh2 = ch2Volts;
-
-        // Apply averaging to the voltage data
-        if (!ch1Volts.isEmpty()) {
-            QVector<double> tempCh1 = ch1Volts;
-            ch1Volts.resize(dataLength);
-
-            // First data point stays the same
-            ch1Volts[0] = tempCh1[0];
 
-            // Average every 2 points and interpolate
-            for (int i = 1; i < dataLength; i += 2) {
-                if (i/2 + 1 < tempCh1.size()) {
-                    ch1Volts[i] = (tempCh1[i/2] + tempCh1[i/2 + 1]) / 2.0;
-                } else {
-                    ch1Volts[i] = tempCh1[i/2];
-                }
-
-                if (i + 1 < dataLength && i/2 + 1 < tempCh1.size()) {
-                    ch1Volts[i + 1] = tempCh1[i/2 + 1];
-                }
-            }
-        }
-
-        if (!ch2Volts.isEmpty()) {
-            QVector<double> tempCh2 = ch2Volts;
-            ch2Volts.resize(dataLength);
-
-            // First data point stays the same
-            ch2Volts[0] = tempCh2[0];
+    // --- MEASUREMENTS ---
+    // One pass per channel feeds the sweep, the trigger range check and the panel
+    const double sampleInterval = 1.0 / (2.0 * maxFrequency);
+    ch1Measurements = ch1Volts.isEmpty() ? ChannelMeasurements() : ch1Meter.measure(ch1Volts, sampleInterval);
+    ch2Measurements = ch2Volts.isEmpty() ? ChannelMeasurements() : ch2Meter.measure(ch2Volts, sampleInterval);
+    updateFloatingMeasurements(currentDisplayChannel == 1 ? ch1Measurements : ch2Measurements);
 
-            // Average every 2 points and interpolate
-            for (int i = 1; i < dataLength; i += 2) {
-                if (i/2 + 1 < tempCh2.size()) {
-                    ch2Volts[i] = (tempCh2[i/2] + tempCh2[i/2 + 1]) / 2.0;
-                } else {
-                    ch2Volts[i] = tempCh2[i/2];
-                }
-
-                if (i + 1 < dataLength && i/2 + 1 < tempCh2.size()) {
-                    ch2Volts[i + 1] = tempCh2[i/2 + 1];
-                }
-            }
-        }
-
-        qDebug() << "[MainWindow] Averaging applied for 2Mbps rate";
+    // Auto-set captures only choose the next settings
+    if (autoSetupRunning) {
+        handleAutoSetupCapture(frame.timestampNs, ch1Volts, ch2Volts);
+        return;
     }
-
-    // If we're in sweep mode, collect amplitude data for Bode plot
-    if (sweepRunning && sweepIndex < sweepFrequencies.size()) {
-        qDebug() << "[MainWindow] Processing sweep data for frequency" << sweepFrequencies[sweepIndex] << "Hz";
-
-        // Calculate RMS amplitude of the signal (use CH1 as input, CH2 as output for transfer function)
-        double inputAmplitude = 0.0;
-        double outputAmplitude = 0.0;
-
-        // Calculate input amplitude (CH1 - DDS signal)
-        if (!ch1Volts.isEmpty()) {
-            double sumSquares = 0.0;
-            for (double voltage : ch1Volts) {
-                sumSquares += voltage * voltage;
-            }
-            inputAmplitude = sqrt(sumSquares / ch1Volts.size());
-        }
-
-        // Calculate output amplitude (CH2 - system response)
-        if (!ch2Volts.isEmpty()) {
-            double sumSquares = 0.0;
-            for (double voltage : ch2Volts) {
-                sumSquares += voltage * voltage;
-            }
-            outputAmplitude = sqrt(sumSquares / ch2Volts.size());
-        }
-
-        // Use output amplitude for Bode plot (or input if output is not available)
-        double amplitude = outputAmplitude > 0 ? outputAmplitude : inputAmplitude;
-
-        sweepAmplitudes.append(amplitude);
-        // Store input/output waveforms for Bode plot
-        sweepInputWaves.append(ch1Volts);
-        sweepOutputWaves.append(ch2Volts);
-        qDebug() << "[MainWindow] Sweep frequency" << sweepFrequencies[sweepIndex] << "Hz:";
-        qDebug() << "  Input amplitude (CH1):" << inputAmplitude << "V RMS";
-        qDebug() << "  Output amplitude (CH2):" << outputAmplitude << "V RMS";
-        qDebug() << "  Using amplitude:" << amplitude << "V RMS";
-        qDebug() << "[MainWindow] Sweep progress:" << sweepIndex + 1 << "/" << sweepFrequencies.size() << "(" << ((sweepIndex + 1) * 100 / sweepFrequencies.size()) << "% )";
-        // Move to next frequency after a short delay
-        sweepIndex++;
-        // If this was the last frequency, stop sweep and return
-        if (sweepIndex >= sweepFrequencies.size()) {
-            stopSweep();
-            return;
-        }
-        // Stop continuous oscilloscope mode during sweep to prevent infinite loop
-        if (isRunning) {
-            qDebug() << "[MainWindow] Stopping oscilloscope for sweep progression";
-            onStopClicked();
-        }
-        // Continue to next frequency
-        QTimer::singleShot(sweepDelay, this, &MainWindow::setDDSForSweep);
+    // Sweep captures are reduced to one gain/phase point and not triggered
+    if (sweepRunning) {
+        handleSweepCapture(ch1Volts, ch2Volts);
+        return;
+    }
+    // The DSP worker has already averaged this frame into the spectrum
+    if (spectrumMode) {
+        rearmAcquisition();
+        return;
     }
 
     // --- UNIVERSAL TRIGGER LOGIC (ALL MODES) ---
@@ -1290,17 +1946,20 @@ void MainWindow::onOscilloscopeRawDataReady(const QByteArray &ch1, const QByteAr
     else if (ch2TrigRadio && ch2TrigRadio->isChecked()) gain = ch2Gain;
     double trigLine = (trigLevel * 10.0 / 2048.0 - 10.0) / gain;
     trigLine = std::round(trigLine * 100.0) / 100.0;
-    double waveformMin = 0, waveformMax = 0;
-    const QVector<double>* signalData = nullptr;
-    if (ch1TrigRadio && ch1TrigRadio->isChecked() && !ch1Volts.isEmpty()) signalData = &ch1Volts;
-    else if (ch2TrigRadio && ch2TrigRadio->isChecked() && !ch2Volts.isEmpty()) signalData = &ch2Volts;
-    if (signalData) {
-        waveformMin = *std::min_element(signalData->begin(), signalData->end());
-        waveformMax = *std::max_element(signalData->begin(), signalData->end());
+    const ChannelMeasurements* signalMeas = nullptr;
+    if (ch1TrigRadio && ch1TrigRadio->isChecked() && ch1Measurements.valid) signalMeas = &ch1Measurements;
+    else if (ch2TrigRadio && ch2TrigRadio->isChecked() && ch2Measurements.valid) signalMeas = &ch2Measurements;
+    if (signalMeas) {
+        const double waveformMin = signalMeas->min;
+        const double waveformMax = signalMeas->max;
         if (trigLine > waveformMax || trigLine < waveformMin) {
-            qDebug() << "[DEBUG] Trigger level outside signal range: trigLine=" << trigLine << ", min=" << waveformMin << ", max=" << waveformMax;
-            QMessageBox::warning(this, "Error", "Trigger level is outside signal range. Turning OFF Trigger.");
+            qCDebug(lcFrame) << "[DEBUG] Trigger level outside signal range: trigLine=" << trigLine << ", min=" << waveformMin << ", max=" << waveformMax;
+            // No modal dialog here: its event loop would run inside the frame drain
+            showStatus("Trigger level is outside signal range. Trigger set to Auto.");
             if (autoTrigRadio) autoTrigRadio->setChecked(true);
+            trigSource = 0; // setChecked does not emit idClicked
+            serialHandler->setProtocolParams(ch1Offset, ch2Offset, trigLevel, trigSource, trigPolarity,
+                                             sampleRateCombo ? sampleRateCombo->currentIndex() : 3);
             return;
         }
     }
@@ -1310,40 +1969,60 @@ void MainWindow::onOscilloscopeRawDataReady(const QByteArray &ch1, const QByteAr
         plotManager->updateTriggerLevel(trigLine, triggerOnCh2);
     }
     // --- TRIGGER CONDITION ---
+    [[maybe_unused]] qint64 stageNs = PERF_NOW();
     bool triggered = checkTriggerCondition(ch1Volts, ch2Volts);
-    qDebug() << "[DEBUG] Trigger condition result:" << triggered;
-    if (triggered) {
+    PERF_LAP(PerfStage::Trigger, stageNs);
+    qCDebug(lcFrame) << "[DEBUG] Trigger condition result:" << triggered;
+    if (triggered && isRunning && ((overwriteRadio && overwriteRadio->isChecked()) || (addRadio && addRadio->isChecked()))) {
+        // Overwrite/Add: the display updates once the whole set is in
+        collectTrace(ch1Volts, ch2Volts);
+    } else if (triggered) {
         // Always overwrite the buffers with the latest data
         ch1Buffer = ch1Volts;
         ch2Buffer = ch2Volts;
         timeBuffer = timeValues;
-        qDebug() << "[DEBUG] Updating plot with new data (triggered).";
+        timeBuffer.resize(qMax(ch1Buffer.size(), ch2Buffer.size()));
+        qCDebug(lcFrame) << "[DEBUG] Updating plot with new data (triggered).";
         // Directly update the plot regardless of isRunning
         if (plotManager) {
+            if (!decodeBuses.isEmpty()) {
+                plotManager->setAnnotations(frame.annotations, triggerViewStart, qMax(ch1Buffer.size(), ch2Buffer.size()));
+            }
             plotManager->updateWaveform(ch1Buffer, ch2Buffer);
-            qDebug() << "[DEBUG] Plot updated directly in onOscilloscopeRawDataReady.";
+            PERF_LAP(PerfStage::Plot, stageNs);
+            PERF_PLOTTED(frame.timestampNs);
+            qCDebug(lcFrame) << "[DEBUG] Plot updated directly in onOscilloscopeFrame.";
         }
         // Start next acquisition if still running and connected
-        if (isRunning && isConnected) {
-            qDebug() << "[DEBUG] Re-arming acquisition (isRunning && isConnected).";
+        if (streamingActive) {
+            // SerialHandler has already armed the next capture
+        } else if (isRunning && isConnected) {
+            qCDebug(lcFrame) << "[DEBUG] Re-arming acquisition (isRunning && isConnected).";
             int serialMode = (acquisitionMode == 0) ? 1 : (acquisitionMode + 1);
             bool serialDualChannel = (acquisitionMode == 0);
             serialHandler->startOscilloscopeAcquisition(serialMode, dataLength, serialDualChannel);
         } else {
-            qDebug() << "[DEBUG] Not re-arming acquisition (isRunning=" << isRunning << ", isConnected=" << isConnected << ")";
+            qCDebug(lcFrame) << "[DEBUG] Not re-arming acquisition (isRunning=" << isRunning << ", isConnected=" << isConnected << ")";
         }
     } else {
-        qDebug() << "[DEBUG] Not updating plot (not triggered).";
+        qCDebug(lcFrame) << "[DEBUG] Not updating plot (not triggered).";
     }
     // Always start the next acquisition, even if not triggered
-    if (isRunning && isConnected) {
-        qDebug() << "[DEBUG] Re-arming acquisition (isRunning && isConnected).";
+    rearmAcquisition();
+}
+
+void MainWindow::rearmAcquisition()
+{
+    if (streamingActive) {
+        // Already armed by SerialHandler
+    } else if (isRunning && isConnected) {
+        qCDebug(lcFrame) << "[DEBUG] Re-arming acquisition (isRunning && isConnected).";
         serialHandler->resetAcquisitionState();
         int serialMode = (acquisitionMode == 0) ? 1 : (acquisitionMode + 1);
         bool serialDualChannel = (acquisitionMode == 0);
         serialHandler->startOscilloscopeAcquisition(serialMode, dataLength, serialDualChannel);
     } else {
-        qDebug() << "[DEBUG] Not re-arming acquisition (isRunning=" << isRunning << ", isConnected=" << isConnected << ")";
+        qCDebug(lcFrame) << "[DEBUG] Not re-arming acquisition (isRunning=" << isRunning << ", isConnected=" << isConnected << ")";
     }
 }
 
@@ -1351,6 +2030,13 @@ void MainWindow::onStopClicked()
 {
     qDebug() << "[DEBUG] onStopClicked() called. Setting isRunning = false.";
     isRunning = false;
+    acquisitionManager->stop();
+    if (rollActive) {
+        serialHandler->stopHardwareStreaming();
+        rollActive = false;
+        dspWorker->setStreamSource(nullptr);
+    }
+    updateStreamingState();
     dataRequestTimer->stop();
     updateUiState();
     plotTimer->stop();
@@ -1395,6 +2081,12 @@ void MainWindow::onExportCSV()
         return;
     }
 
+    if (viewingCapture && captureReader.isOpen()) {
+        // Convert the whole capture file, not just the samples on screen
+        waveformExporter->exportCaptureToCSV(captureReader);
+        return;
+    }
+
     if (ch1Buffer.isEmpty() && ch2Buffer.isEmpty()) {
         qDebug() << "[MainWindow] No data to export";
         return;
@@ -1407,17 +2099,173 @@ void MainWindow::onExportCSV()
              << "CH2 FFT points:" << ch2FFT.size()
              << "Freq points:" << freqBuffer.size();
 
+    // Measure exactly what is written, which may be a trigger-aligned crop
+    // with a kernel per channel, since each keeps its own edge reference
+    MeasurementKernel ch1Meter, ch2Meter;
+    const double sampleInterval = 1.0 / (2.0 * maxFrequency);
+    const ChannelMeasurements ch1Meas = ch1Buffer.isEmpty() ? ChannelMeasurements() : ch1Meter.measure(ch1Buffer, sampleInterval);
+    const ChannelMeasurements ch2Meas = ch2Buffer.isEmpty() ? ChannelMeasurements() : ch2Meter.measure(ch2Buffer, sampleInterval);
+    waveformExporter->setMeasurements(ch1Meas, ch2Meas);
+
+    // Secondary boards' latest frames go alongside, with their offsets in time
+    waveformExporter->setExtraChannels(acquisitionManager->channels(), lastFrameTimestampNs);
+
     // Export the data using the waveformExporter
     // Include FFT data if available
     waveformExporter->exportToCSV(ch1Buffer, ch2Buffer, timeBuffer, ch1FFT, ch2FFT, freqBuffer);
 }
 
+CaptureInfo MainWindow::currentCaptureInfo() const
+{
+    CaptureInfo info;
+    info.sampleRate = 2.0 * maxFrequency;
+    info.ch1Gain = ch1Gain;
+    info.ch2Gain = ch2Gain;
+    info.ch1Offset = ch1Offset;
+    info.ch2Offset = ch2Offset;
+    info.channelMask = (acquisitionMode == 1) ? 1 : (acquisitionMode == 2) ? 2 : 3;
+    if (ch1TrigRadio && ch1TrigRadio->isChecked()) info.trigSource = 1;
+    else if (ch2TrigRadio && ch2TrigRadio->isChecked()) info.trigSource = 2;
+    else if (extTrigRadio && extTrigRadio->isChecked()) info.trigSource = 3;
+    info.trigSlope = (hlTrigRadio && hlTrigRadio->isChecked()) ? 1 : 0;
+    info.trigLevel = trigLevel;
+    info.preTrigger = dataLength * (preTriggerSpin ? preTriggerSpin->value() : 10) / 100;
+    info.holdoff = holdoffSpin ? holdoffSpin->value() : 0;
+    info.recordLength = (rollRadio && rollRadio->isChecked()) ? 0 : dataLength;
+    return info;
+}
+
+void MainWindow::onRecordToggled(bool checked)
+{
+    if (!checked) {
+        if (!captureWriter->isActive()) return;
+        serialHandler->setRecording(false);
+        captureWriter->stop();
+        showStatus(QString("Recording stopped: %1 samples, %2 lost")
+                       .arg(captureWriter->samplesWritten()).arg(captureWriter->samplesLost()));
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Record Capture"), "", tr("Capture Files (*.oscap)"));
+    if (fileName.isEmpty() ||
+        !captureWriter->start(fileName, currentCaptureInfo(), &serialHandler->captureHistory())) {
+        if (!fileName.isEmpty()) QMessageBox::warning(this, "Error", "Could not create capture file.");
+        QSignalBlocker block(recordBtn);
+        recordBtn->setChecked(false);
+        return;
+    }
+    serialHandler->setRecording(true);
+    showStatus("Recording to " + fileName);
+}
+
+void MainWindow::updatePerfOverlay()
+{
+    if (!PerfCounters::enabled()) {
+        perfOverlay->setText("Tracing not built in (SCOPE_PERF_TRACE is off)");
+        perfOverlay->adjustSize();
+        return;
+    }
+    PerfCounters& perf = PerfCounters::instance();
+    PerfCounters::StageStats stages[int(PerfStage::Count)];
+    perf.stats(stages, true);
+    const double seconds = qMax(1e-3, perfOverlayClock.restart() / 1000.0);
+    const quint64 acquired = perf.framesAcquired();
+    const quint64 displayed = perf.framesDisplayed();
+    const double acquiredRate = (acquired - perfLastAcquired) / seconds;
+    const double displayedRate = (displayed - perfLastDisplayed) / seconds;
+    perfLastAcquired = acquired;
+    perfLastDisplayed = displayed;
+
+    QString text = QString("Frames/s  %1 acquired  %2 shown\n").arg(acquiredRate, 0, 'f', 1).arg(displayedRate, 0, 'f', 1);
+    text += QString("Dropped   %1 acquisition  %2 dsp\n")
+                .arg(serialHandler->frameRing().droppedFrames()).arg(dspWorker->output().droppedFrames());
+    text += QString("%1 %2 %3 %4").arg(QString("Stage"), -12).arg(QString("n"), 6).arg(QString("p50"), 10).arg(QString("p99"), 10);
+    for (int s = 0; s < int(PerfStage::Count); ++s) {
+        const PerfCounters::StageStats& st = stages[s];
+        text += QString("\n%1 %2 %3 %4").arg(QString::fromLatin1(PerfCounters::stageName(static_cast<PerfStage>(s))), -12)
+                    .arg(st.count, 6)
+                    .arg(st.count ? formatNs(st.p50) : QString("-"), 10)
+                    .arg(st.count ? formatNs(st.p99) : QString("-"), 10);
+    }
+    perfOverlay->setText(text);
+    perfOverlay->adjustSize();
+}
+
+void MainWindow::onFrameRecordToggled(bool checked)
+{
+    if (!checked) {
+        if (!frameRecorder->isActive()) return;
+        serialHandler->setFrameRecorder(nullptr);
+        acquisitionManager->setFrameRecorder(nullptr);
+        frameRecordStatusTimer->stop();
+        frameRecorder->stop();
+        if (frameCompressCheckBox) frameCompressCheckBox->setEnabled(true);
+        showStatus(QString("Frame recording stopped: %1 frames, %2 dropped")
+                       .arg(frameRecorder->framesWritten()).arg(frameRecorder->framesDropped()));
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Record Frames"), "", tr("Frame Recordings (*.oscrec)"));
+    const bool compress = frameCompressCheckBox && frameCompressCheckBox->isChecked();
+    if (fileName.isEmpty() || !frameRecorder->start(fileName, currentCaptureInfo(), compress)) {
+        if (!fileName.isEmpty()) QMessageBox::warning(this, "Error", "Could not create recording file.");
+        QSignalBlocker block(frameRecordBtn);
+        frameRecordBtn->setChecked(false);
+        return;
+    }
+    serialHandler->setFrameRecorder(frameRecorder, 0);
+    acquisitionManager->setFrameRecorder(frameRecorder);
+    if (frameCompressCheckBox) frameCompressCheckBox->setEnabled(false);
+    frameRecordStatusTimer->start();
+    showStatus("Recording frames to " + fileName);
+}
+
+void MainWindow::onOpenCapture()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open Capture"), "", tr("Capture Files (*.oscap)"));
+    if (fileName.isEmpty()) return;
+    if (!captureReader.open(fileName)) {
+        QMessageBox::warning(this, "Error", "Not a valid capture file.");
+        return;
+    }
+    if (isRunning) onStopClicked();
+
+    // Decode the start of the capture with the settings it was taken with
+    const CaptureInfo& info = captureReader.info();
+    const int n = static_cast<int>(qMin<quint64>(captureReader.sampleCount(), CAPTURE_VIEW_SAMPLES));
+    AdcDecoder decoder;
+    decoder.setParams(info.ch1Gain, info.ch1Offset, info.ch2Gain, info.ch2Offset);
+    QVector<quint8> raw(n);
+    ch1Buffer.clear();
+    ch2Buffer.clear();
+    for (int ch = 0; ch < 2; ++ch) {
+        if (!captureReader.read(ch, 0, n, raw.data())) continue;
+        QVector<double>& out = (ch == 0) ? ch1Buffer : ch2Buffer;
+        out.resize(n);
+        decoder.decode(static_cast<AdcDecoder::Channel>(ch), raw.constData(), n, out.data());
+    }
+    const double sampleMicros = info.sampleRate > 0.0 ? 1e6 / info.sampleRate : multiplier;
+    timeBuffer.resize(n);
+    for (int i = 0; i < n; ++i) {
+        timeBuffer[i] = i * sampleMicros;
+    }
+    viewingCapture = true;
+    if (plotManager) {
+        plotManager->setMultiplier(sampleMicros);
+        plotManager->setGains(info.ch1Gain, info.ch2Gain);
+        plotManager->updateWaveform(ch1Buffer, ch2Buffer);
+    }
+    const int gaps = captureReader.gaps().size();
+    showStatus(gaps == 0 ? QString("Opened %1: %2 samples").arg(fileName).arg(captureReader.sampleCount())
+                         : QString("Opened %1: %2 samples, %3 gap(s) where samples were lost%4")
+                               .arg(fileName).arg(captureReader.sampleCount()).arg(gaps)
+                               .arg(captureReader.isContiguous(0, n) ? QString() : QString(", one on screen")));
+}
+
 void MainWindow::processOscilloscopeData(const QByteArray &data)
 {
     // LEGACY METHOD - DISABLED
     // This method used the old VB.NET-style voltage conversion formula with -10V offset
-    // Now replaced by onOscilloscopeRawDataReady which uses correct voltage conversion
-    qDebug() << "[MainWindow] processOscilloscopeData called but disabled - using onOscilloscopeRawDataReady instead";
+    // Now replaced by onOscilloscopeFrame which uses correct voltage conversion
+    qDebug() << "[MainWindow] processOscilloscopeData called but disabled - using onOscilloscopeFrame instead";
     return;
 
     /*
@@ -1466,23 +2314,28 @@ void MainWindow::processOscilloscopeData(const QByteArray &data)
         }
         timeBuffer[i] = i * multiplier;
     }
-    // Run mode logic handled in onOscilloscopeRawDataReady
+    // Run mode logic handled in onOscilloscopeFrame
     */
 }
 
 void MainWindow::updatePlot()
 {
-    qDebug() << "[DEBUG] updatePlot() called. isRunning=" << isRunning << ", isConnected=" << isConnected << ", ch1Buffer size=" << ch1Buffer.size() << ", ch2Buffer size=" << ch2Buffer.size();
+    if (rollActive) {
+        // Spectrum mode draws the DSP worker's averages instead
+        if (rollDirty && !spectrumMode) plotRollWindow();
+        return;
+    }
+    qCDebug(lcFrame) << "[DEBUG] updatePlot() called. isRunning=" << isRunning << ", isConnected=" << isConnected << ", ch1Buffer size=" << ch1Buffer.size() << ", ch2Buffer size=" << ch2Buffer.size();
     if (isRunning && isConnected && (!ch1Buffer.isEmpty() || !ch2Buffer.isEmpty())) {
         if (continuousRadio && continuousRadio->isChecked()) {
             plotManager->updateWaveform(ch1Buffer, ch2Buffer);
-            qDebug() << "[DEBUG] Plot updated (continuous mode).";
+            qCDebug(lcFrame) << "[DEBUG] Plot updated (continuous mode).";
         } else {
             plotManager->updateWaveform(ch1Buffer, ch2Buffer);
-            qDebug() << "[DEBUG] Plot updated (triggered mode).";
+            qCDebug(lcFrame) << "[DEBUG] Plot updated (triggered mode).";
         }
     } else {
-        qDebug() << "[DEBUG] Plot not updated (not running/connected or empty buffer).";
+        qCDebug(lcFrame) << "[DEBUG] Plot not updated (not running/connected or empty buffer).";
     }
 }
 
@@ -1490,9 +2343,10 @@ void MainWindow::onModeChanged(int index)
 {
     qDebug() << "[MainWindow] onModeChanged: Switching from mode" << currentMode << "to" << index;
 
-    // index: 0=Both, 1=CH1, 2=CH2, 3=XY, 4=DFT CH1, 5=DFT CH2, 6=DFT Both
+    // index: 0=Both, 1=CH1, 2=CH2, 3=XY, 4=DFT CH1, 5=DFT CH2, 6=DFT Both, 7=Spectrum
     dftMode = false;
     dftChannel = 0;
+    spectrumMode = false;
     switch (index) {
         case 0: // Both Channels
         case 3: // XY
@@ -1525,10 +2379,17 @@ void MainWindow::onModeChanged(int index)
             dftMode = true;
             dftChannel = 3; // NEW: 3 means both
             break;
+        case 7: // Spectrum analyser, both channels
+            dataLength = 200;
+            acquisitionMode = 0;
+            spectrumMode = true;
+            break;
     }
     currentMode = index; // Store the current mode
     qDebug() << "[MainWindow] Mode changed to:" << index << "dataLength:" << dataLength << "acquisitionMode:" << acquisitionMode << "dftMode:" << dftMode << "dftChannel:" << dftChannel;
 
+    onSpectrumSettingsChanged();
+
     // Update PlotManager with new mode
     if (plotManager) {
         plotManager->setDisplayMode(index);
@@ -1576,104 +2437,327 @@ void MainWindow::onModeChanged(int index)
     // Do not call plotScope() here; wait for new data to arrive
 }
 
-void MainWindow::onSampleRateChanged(int index)
+void MainWindow::syncDspSettings()
 {
-    // Convert UI index (0-13) to VB.NET style Sample_Rate_Selection (1-14)
-    int sampleRateSelection = index + 1;
-
-    // Use VB.NET style multipliers and parameters
-    double multiplier = 0.5;
-    double maxFrequency = 1000000;
-    QString heading1 = "Time(uSec)";
-
-    switch (sampleRateSelection) {
-        case 1: // 2Mbps  0.50us/sample
-            multiplier = 0.5;
-            maxFrequency = 1000000;
-            heading1 = "Time(uSec)";
-            break;
-        case 2: // 1Mbps   1.0us/sample
-            multiplier = 1.0;
-            maxFrequency = 500000;
-            heading1 = "Time(uSec)";
-            break;
-        case 3: // 500kbps 2.0us/sample
-            multiplier = 2.0;
-            maxFrequency = 250000;
-            heading1 = "Time(uSec)";
-            break;
-        case 4: // 200kbps 5.0us/sample
-            multiplier = 5.0;
-            maxFrequency = 100000;
-            heading1 = "Time(uSec)";
-            break;
-        case 5: // 100kbps  10us/sample
-            multiplier = 10.0;
-            maxFrequency = 50000;
-            heading1 = "Time(uSec)";
-            break;
-        case 6: // 50kbps   20us/sample
-            multiplier = 20.0;
-            maxFrequency = 25000;
-            heading1 = "Time(uSec)";
-            break;
-        case 7: // 20kbps   50us/sample
-            multiplier = 50.0;
-            maxFrequency = 10000;
-            heading1 = "Time(uSec)";
-            break;
-        case 8: // 10kbps  100us/sample
-            multiplier = 100.0;
-            maxFrequency = 5000;
-            heading1 = "Time(uSec)";
-            break;
-        case 9: // 5kbps   200us/sample
-            multiplier = 200.0;
-            maxFrequency = 2500;
-            heading1 = "Time(uSec)";
-            break;
-        case 10: // 2kbps   500us/sample
-            multiplier = 500.0;
-            maxFrequency = 1000;
-            heading1 = "Time(uSec)";
-            break;
-        case 11: // 1kbps   1.0ms/sample
-            multiplier = 1000.0;
-            maxFrequency = 500;
-            heading1 = "Time(mSec)";
-            break;
-        case 12: // 500Hz   2.0ms/sample
-            multiplier = 2000.0;
-            maxFrequency = 250;
-            heading1 = "Time(mSec)";
-            break;
-        case 13: // 200Hz   5.0ms/sample
-            multiplier = 5000.0;
-            maxFrequency = 100;
-            heading1 = "Time(mSec)";
-            break;
-        case 14: // 100Hz    10ms/sample
-            multiplier = 10000.0;
-            maxFrequency = 50;
-            heading1 = "Time(mSec)";
-            break;
-        default:
-            multiplier = 5.0;
-            maxFrequency = 100000;
-            heading1 = "Time(uSec)";
-            break;
+    if (!dspWorker) return;
+    dspWorker->setDecoderParams(ch1Gain, ch1Offset, ch2Gain, ch2Offset);
+    acquisitionManager->setDecoderParams(ch1Gain, ch1Offset, ch2Gain, ch2Offset);
+    acquisitionManager->setSampleInterval(1.0 / (2.0 * maxFrequency));
+    QComboBox *lowPass[2] = {ch1LowPassCombo, ch2LowPassCombo};
+    QComboBox *average[2] = {ch1AverageCombo, ch2AverageCombo};
+    for (int ch = 0; ch < 2; ++ch) {
+        DspChain::Config config;
+        // At 2 Mbps the device returns half the points; interpolate back up (as VB.NET did)
+        config.interpolate = sampleRateCombo && sampleRateCombo->currentIndex() == 0;
+        if (lpfCheckBox && lpfCheckBox->isChecked()) {
+            // Ripple filter: 5-point smoothing, first 10 points ignored
+            config.movingAverage = 5;
+            config.trimLeading = 10;
+        }
+        if (lowPass[ch]) config.lowPassCutoff = lowPass[ch]->currentData().toDouble();
+        if (average[ch]) config.frameAverage = average[ch]->currentData().toInt();
+        dspWorker->setChainConfig(ch, config);
+        acquisitionManager->setChainConfig(ch, config);
     }
+    // Later frames of a recording carry the new settings
+    if (frameRecorder && frameRecorder->isActive()) frameRecorder->setSettings(currentCaptureInfo());
+    if (maskFailRecorder && maskFailRecorder->isActive()) maskFailRecorder->setSettings(currentCaptureInfo());
+}
 
-    this->multiplier = multiplier;
-    this->maxFrequency = maxFrequency;
-    this->heading1 = heading1;
+void MainWindow::onPersistenceChanged(int index)
+{
+    const double seconds = persistenceCombo->itemData(index).toDouble();
+    if (plotManager) plotManager->setPersistence(seconds);
+    qDebug() << "[MainWindow] Persistence" << (seconds == 0.0 ? "off" : persistenceCombo->itemText(index));
+}
 
-    // Update plot manager's multiplier for x-axis scaling
-    plotManager->setMultiplier(multiplier);
-    // Update plot manager's X-axis title with correct time unit
-    plotManager->setXAxisTitle(heading1);
-    // Regenerate timeBuffer with new multiplier
-    timeBuffer.resize(dataLength);
+void MainWindow::onSpectrumSettingsChanged()
+{
+    if (!dspWorker || !spectrumSizeCombo) return;
+    SpectrumAnalyzer::Config config;
+    config.fftSize = spectrumSizeCombo->currentData().toInt();
+    config.overlap = spectrumOverlapCombo->currentData().toDouble();
+    config.window = fftWindow == FFTEngine::Window::Rectangular ? FFTEngine::Window::Hann : fftWindow;
+    const int averages = spectrumAveragingCombo->currentData().toInt();
+    config.averaging = averages > 0 ? SpectrumAnalyzer::Averaging::Exponential : SpectrumAnalyzer::Averaging::Linear;
+    config.averages = qMax(1, averages);
+    config.peakHold = spectrumPeakHoldCheckBox->isChecked();
+    config.zoomFactor = spectrumZoomCombo->currentData().toInt();
+    config.zoomCenter = spectrumCenterSpin->value();
+    // Outside Roll every frame is a record of its own, and the zoom filter
+    // warms up again on each; deep zooms only work on the stream
+    const int maxZoom = SpectrumAnalyzer::maxRecordZoom(dataLength);
+    if (!(rollRadio && rollRadio->isChecked()) && config.zoomFactor > maxZoom) {
+        config.zoomFactor = maxZoom;
+        showStatus(maxZoom > 1 ? tr("Spectrum zoom above %1x needs Roll mode; using %1x").arg(maxZoom)
+                               : tr("Spectrum zoom needs Roll mode; zoom off"));
+    }
+    dspWorker->setSpectrumConfig(config, 2.0 * maxFrequency, spectrumMode);
+}
+
+void MainWindow::onSpectrumReady()
+{
+    if (!dspWorker->spectrumSnapshot(spectrumView) || !spectrumMode || !plotManager) return;
+    plotManager->updateSpectrum(spectrumView);
+}
+
+void MainWindow::onDecodeSettingsChanged()
+{
+    if (!dspWorker || !decodeProtocolCombo) return;
+    const int protocol = decodeProtocolCombo->currentData().toInt();
+    // What each line selector means for the chosen protocol
+    static const char *const roles[3][4] = {{"RX:", "", "", ""},
+                                            {"SCLK:", "MOSI:", "MISO:", "CS:"},
+                                            {"SCL:", "SDA:", "", ""}};
+    for (int i = 0; i < 4; ++i) {
+        const char *role = protocol < 0 ? "" : roles[protocol][i];
+        decodeLineLabels[i]->setText(role);
+        decodeLineSpins[i]->setVisible(*role != '\0');
+    }
+    const bool uart = protocol == static_cast<int>(BusConfig::Protocol::Uart);
+    decodeBaudSpin->setEnabled(uart);
+    decodeParityCombo->setEnabled(uart);
+    decodeSpiModeCombo->setEnabled(protocol == static_cast<int>(BusConfig::Protocol::Spi));
+
+    decodeBuses.clear();
+    if (protocol >= 0) {
+        BusConfig bus;
+        bus.protocol = static_cast<BusConfig::Protocol>(protocol);
+        bus.source = static_cast<BusConfig::Source>(decodeSourceCombo->currentData().toInt());
+        bus.threshold = decodeThresholdSpin->value();
+        const int line[4] = {decodeLineSpins[0]->value(), decodeLineSpins[1]->value(),
+                             decodeLineSpins[2]->value(), decodeLineSpins[3]->value()};
+        bus.uart.rxLine = line[0];
+        bus.uart.baud = decodeBaudSpin->value();
+        bus.uart.parity = static_cast<UartDecoder::Parity>(decodeParityCombo->currentData().toInt());
+        bus.spi.clockLine = line[0];
+        bus.spi.mosiLine = line[1];
+        bus.spi.misoLine = line[2];
+        bus.spi.selectLine = line[3];
+        bus.spi.mode = decodeSpiModeCombo->currentData().toInt();
+        bus.i2c.sclLine = line[0];
+        bus.i2c.sdaLine = line[1];
+        decodeBuses.append(bus);
+    }
+    const int pollMs = digitalPollSpin ? digitalPollSpin->value() : 0;
+    dspWorker->setBusDecoders(decodeBuses, 2.0 * maxFrequency, pollMs > 0 ? 1000.0 / pollMs : 1.0);
+    streamOverlay.clear();
+    if (plotManager) plotManager->clearAnnotations();
+}
+
+void MainWindow::onAnnotationsReady()
+{
+    dspWorker->takeAnnotations(annotationScratch);
+    if (annotationScratch.isEmpty()) return;
+    appendDecodeEvents(annotationScratch);
+    // Analog stream events are overlaid on the Roll view while still in the history
+    if (!rollActive) return;
+    for (const ProtocolAnnotation& a : annotationScratch) {
+        if (a.bus < decodeBuses.size() && decodeBuses[a.bus].source == BusConfig::Source::Analog) streamOverlay.append(a);
+    }
+}
+
+void MainWindow::appendDecodeEvents(const QVector<ProtocolAnnotation>& events)
+{
+    decodeEvents += events;
+    const int excess = decodeEvents.size() - MAX_DECODE_EVENTS;
+    if (excess > 0) decodeEvents.remove(0, excess);
+    if (!decodeLogList || !decodeLogList->isVisible()) return;
+    // Only the newest rows are worth turning into list items
+    const int first = qMax(0, int(events.size()) - DECODE_LIST_ROWS);
+    for (int i = first; i < events.size(); ++i) {
+        const ProtocolAnnotation& a = events[i];
+        const char *protocol = a.bus < decodeBuses.size() ? protocolName(decodeBuses[a.bus].protocol) : "?";
+        decodeLogList->addItem(QString("%1 s  %2  %3").arg(a.timeNs * 1e-9, 0, 'f', 6).arg(protocol).arg(annotationText(a)));
+    }
+    while (decodeLogList->count() > DECODE_LIST_ROWS) delete decodeLogList->takeItem(0);
+    decodeLogList->scrollToBottom();
+}
+
+void MainWindow::onExportDecodedClicked()
+{
+    if (decodeEvents.isEmpty()) {
+        showStatus("No decoded events to export");
+        return;
+    }
+    waveformExporter->exportAnnotationsToCSV(decodeEvents, decodeBuses);
+}
+
+MaskAlignment MainWindow::currentMaskAlignment() const
+{
+    MaskAlignment alignment;
+    if (ch1TrigRadio && ch1TrigRadio->isChecked()) alignment.source = 0;
+    else if (ch2TrigRadio && ch2TrigRadio->isChecked()) alignment.source = 1;
+    TriggerEngine engine;
+    configureTrigger(engine, 0);
+    alignment.level = engine.level();
+    alignment.hysteresis = engine.hysteresisWidth();
+    alignment.slope = engine.edge();
+    alignment.viewFraction = TRIGGER_VIEW_FRACTION;
+    alignment.preTriggerPercent = preTriggerSpin ? preTriggerSpin->value() : 10;
+    return alignment;
+}
+
+void MainWindow::onMaskTestToggled(bool checked)
+{
+    if (checked && mask.isEmpty()) {
+        showStatus("Learn or load a mask first");
+        QSignalBlocker block(maskTestCheckBox);
+        maskTestCheckBox->setChecked(false);
+        return;
+    }
+    if (checked) {
+        sentMaskAlignment = currentMaskAlignment();
+        dspWorker->setMaskAlignment(sentMaskAlignment);
+        onMaskOptionsChanged();
+        dspWorker->setMask(mask);
+        maskStatusTimer->start();
+    } else {
+        dspWorker->setMask(WaveformMask());
+        maskStatusTimer->stop();
+    }
+    updateMaskStatus();
+}
+
+void MainWindow::onMaskLearnClicked()
+{
+    if (rollRadio && rollRadio->isChecked()) {
+        showStatus("Masks are learned from frames, not in Roll");
+        return;
+    }
+    sentMaskAlignment = currentMaskAlignment();
+    dspWorker->setMaskAlignment(sentMaskAlignment);
+    onMaskOptionsChanged();
+    mask = WaveformMask();
+    if (plotManager) plotManager->setMask(mask);
+    dspWorker->learnMask(maskLearnSpin->value(), maskMarginSpin->value(), maskMarginSamplesSpin->value());
+    {
+        // Testing starts by itself once the mask is learned
+        QSignalBlocker block(maskTestCheckBox);
+        maskTestCheckBox->setChecked(true);
+    }
+    maskStatusTimer->start();
+    maskStatusLabel->setText(QString("Learning from %1 frames...").arg(maskLearnSpin->value()));
+}
+
+void MainWindow::onMaskLearned()
+{
+    mask = dspWorker->currentMask();
+    if (plotManager) plotManager->setMask(mask);
+    showStatus(QString("Mask learned: %1 samples, testing").arg(mask.length()));
+}
+
+void MainWindow::onMaskLoadClicked()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Load Mask"), "", tr("CSV Files (*.csv)"));
+    if (fileName.isEmpty()) return;
+    WaveformMask loaded;
+    if (!loaded.load(fileName)) {
+        QMessageBox::warning(this, "Error", "No mask limits could be read from the file.");
+        return;
+    }
+    mask = loaded;
+    if (plotManager) plotManager->setMask(mask);
+    if (maskTestCheckBox && maskTestCheckBox->isChecked()) dspWorker->setMask(mask);
+    showStatus(QString("Mask loaded: %1 samples").arg(mask.length()));
+    updateMaskStatus();
+}
+
+void MainWindow::onMaskSaveClicked()
+{
+    if (mask.isEmpty()) {
+        showStatus("No mask to save");
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save Mask"), "", tr("CSV Files (*.csv)"));
+    if (fileName.isEmpty()) return;
+    if (!mask.save(fileName)) QMessageBox::warning(this, "Error", "Could not write the mask file.");
+    else showStatus("Mask saved to " + fileName);
+}
+
+void MainWindow::onMaskOptionsChanged()
+{
+    const bool stopOnFail = maskStopOnFailCheckBox && maskStopOnFailCheckBox->isChecked();
+    dspWorker->setMaskOptions(stopOnFail, maskFailRecorder->isActive() ? maskFailRecorder : nullptr);
+}
+
+void MainWindow::onMaskSaveFailuresToggled(bool checked)
+{
+    if (!checked) {
+        if (!maskFailRecorder->isActive()) return;
+        dspWorker->setMaskOptions(maskStopOnFailCheckBox->isChecked(), nullptr);
+        maskFailRecorder->stop();
+        showStatus(QString("Failure recording stopped: %1 frames").arg(maskFailRecorder->framesWritten()));
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Record Failing Frames"), "", tr("Frame Recordings (*.oscrec)"));
+    const bool compress = frameCompressCheckBox && frameCompressCheckBox->isChecked();
+    if (fileName.isEmpty() || !maskFailRecorder->start(fileName, currentCaptureInfo(), compress)) {
+        if (!fileName.isEmpty()) QMessageBox::warning(this, "Error", "Could not create recording file.");
+        QSignalBlocker block(maskSaveFailuresBtn);
+        maskSaveFailuresBtn->setChecked(false);
+        return;
+    }
+    onMaskOptionsChanged();
+    showStatus("Recording failing frames to " + fileName);
+}
+
+// The worker has stopped publishing after the failing frame; stop the
+// device too so the failure stays on screen
+void MainWindow::onMaskHalted()
+{
+    if (isRunning) onStopClicked();
+    updateMaskStatus();
+    showStatus("Mask test failed: acquisition stopped");
+}
+
+void MainWindow::updateMaskStatus()
+{
+    if (!maskStatusLabel) return;
+    if (mask.isEmpty() && !maskStatusTimer->isActive()) {
+        maskStatusLabel->setText("No mask");
+        return;
+    }
+    if (mask.isEmpty()) return; // still learning
+    const MaskStats stats = dspWorker->maskStats();
+    const double failPercent = stats.tested ? 100.0 * stats.failed / stats.tested : 0.0;
+    QString text = QString("Tested %1, passed %2, failed %3 (%4%)")
+                       .arg(stats.tested).arg(stats.passed).arg(stats.failed).arg(failPercent, 0, 'f', 2);
+    if (stats.untriggered) text += QString(", %1 untriggered").arg(stats.untriggered);
+    if (stats.untested) text += QString(", %1 dropped untested").arg(stats.untested);
+    if (stats.halted) text += " - stopped on fail";
+    maskStatusLabel->setText(text);
+    maskStatusLabel->setStyleSheet(stats.failed ? "color: red;" : "");
+}
+
+void MainWindow::onFFTWindowChanged(int index)
+{
+    fftWindow = static_cast<FFTEngine::Window>(fftWindowCombo->itemData(index).toInt());
+    if (plotManager) {
+        plotManager->setFFTWindow(fftWindow);
+        if (dftMode && (!ch1Buffer.isEmpty() || !ch2Buffer.isEmpty())) {
+            plotManager->updateWaveform(ch1Buffer, ch2Buffer);
+        }
+    }
+    onSpectrumSettingsChanged();
+}
+
+void MainWindow::onSampleRateChanged(int index)
+{
+    // Convert UI index (0-13) to VB.NET style Sample_Rate_Selection (1-14)
+    int sampleRateSelection = index + 1;
+
+    const TimeBase& base = timeBase(index);
+    multiplier = base.multiplier;
+    maxFrequency = base.maxFrequency;
+    heading1 = base.axisTitle;
+
+    // Update plot manager's multiplier for x-axis scaling
+    plotManager->setMultiplier(multiplier);
+    // Update plot manager's X-axis title with correct time unit
+    plotManager->setXAxisTitle(heading1);
+    // Regenerate timeBuffer with new multiplier
+    timeBuffer.resize(dataLength);
     for (int i = 0; i < dataLength; ++i) {
         timeBuffer[i] = i * multiplier;
     }
@@ -1706,22 +2790,21 @@ void MainWindow::onSampleRateChanged(int index)
         serialHandler->sendCommand(cmd);
         qDebug() << "[MainWindow] Applied sample rate change instantly - UI index:" << index << "device index:" << deviceIndex;
     }
+    syncDspSettings();
+    if (dspWorker) dspWorker->resetChains();
+    if (spectrumCenterSpin) spectrumCenterSpin->setMaximum(maxFrequency);
+    onSpectrumSettingsChanged();
+    onDecodeSettingsChanged();
 }
 
 void MainWindow::requestOscilloscopeData()
 {
-    // Setup and then capture
-    // Add delays between commands for reliability (VB.NET uses 20ms)
+    // Setup and then capture; the acquisition thread writes them in order
     sendGainCommand();
-    QThread::msleep(20);
     sendOffsetCommand();
-    QThread::msleep(20);
     sendTriggerCommand();
-    QThread::msleep(20);
     sendModeCommand();
-    QThread::msleep(20);
     sendSampleRateCommand();
-    QThread::msleep(20);
     // Send 3-byte capture command (VB.NET sends 3 bytes)
     QByteArray captureCmd;
     captureCmd.append('C');
@@ -1735,6 +2818,7 @@ void MainWindow::requestOscilloscopeData()
 
 void MainWindow::onCh1GainChanged(int idx) {
     ch1Gain = ch1GainCombo->itemData(idx).toDouble();
+    syncDspSettings();
     qDebug() << "[MainWindow] CH1 Gain changed to:" << ch1Gain;
 
     // Update PlotManager with new gain values
@@ -1760,6 +2844,7 @@ void MainWindow::onCh1GainChanged(int idx) {
 
 void MainWindow::onCh2GainChanged(int idx) {
     ch2Gain = ch2GainCombo->itemData(idx).toDouble();
+    syncDspSettings();
     qDebug() << "[MainWindow] CH2 Gain changed to:" << ch2Gain;
 
     // Update PlotManager with new gain values
@@ -1785,6 +2870,7 @@ void MainWindow::onCh2GainChanged(int idx) {
 
 void MainWindow::onCh1OffsetChanged(int value) {
     ch1Offset = value;
+    syncDspSettings();
 
     // Convert slider value to voltage and display in edit field
     double voltage = value / 100.0; // Convert from -1694 to +1695 range to -16.94 to +16.95V
@@ -1808,6 +2894,7 @@ void MainWindow::onCh1OffsetChanged(int value) {
 
 void MainWindow::onCh2OffsetChanged(int value) {
     ch2Offset = value;
+    syncDspSettings();
 
     // Convert slider value to voltage and display in edit field
     double voltage = value / 100.0; // Convert from -1694 to +1695 range to -16.94 to +16.95V
@@ -1833,10 +2920,7 @@ void MainWindow::onTrigLevelChanged(int value) {
     trigLevel = value;
     if (isRunning) {
         onStopClicked();
-        QTimer::singleShot(100, this, [this]() {
-            setTriggerMode();
-            onRunClicked();
-        });
+        QTimer::singleShot(100, this, &MainWindow::onRunClicked);
     } else {
         setTriggerMode();
     }
@@ -1846,10 +2930,7 @@ void MainWindow::onTrigSourceChanged(int idx) {
     trigSource = idx;
     if (isRunning) {
         onStopClicked();
-        QTimer::singleShot(100, this, [this]() {
-            setTriggerMode();
-            onRunClicked();
-        });
+        QTimer::singleShot(100, this, &MainWindow::onRunClicked);
     } else {
         setTriggerMode();
     }
@@ -1859,10 +2940,7 @@ void MainWindow::onTrigPolarityChanged(int idx) {
     trigPolarity = idx;
     if (isRunning) {
         onStopClicked();
-        QTimer::singleShot(100, this, [this]() {
-            setTriggerMode();
-            onRunClicked();
-        });
+        QTimer::singleShot(100, this, &MainWindow::onRunClicked);
     } else {
         setTriggerMode();
     }
@@ -1982,19 +3060,12 @@ void MainWindow::onDDSStartStopClicked() {
 void MainWindow::onDDSWaveformChanged(int index) { /* ... */ }
 void MainWindow::onDDSFreqChanged(double freq) { /* ... */ }
 void MainWindow::onDigitalOutToggled(int bit) {
-    digitalOutState |= (1 << bit); // Set bit (turn ON)
-    QByteArray cmd;
-    cmd.append('h'); cmd.append(digitalOutState);
-    serialHandler->sendCommand(cmd);
-    // Start a timer to turn OFF the LED after 200ms
-    QTimer::singleShot(200, this, [this, bit]() {
-        digitalOutState &= ~(1 << bit); // Clear bit (turn OFF)
-        QByteArray offCmd;
-        offCmd.append('h'); offCmd.append(digitalOutState);
-        serialHandler->sendCommand(offCmd);
-    });
+    // The button holds the level; DigitalIO coalesces quick toggles
+    const bool high = digitalOutButtons[bit]->isChecked();
+    digitalOutButtons[bit]->setText(QString("D%1 %2").arg(bit).arg(high ? "H" : "L"));
+    digitalIO->setBit(bit, high);
 }
-void MainWindow::refreshDigitalInputs() { serialHandler->sendCommand(QByteArray(1, 'i')); }
+void MainWindow::refreshDigitalInputs() { digitalIO->readDigitalIn(); }
 void MainWindow::onReadDigitalClicked() { refreshDigitalInputs(); }
 void MainWindow::onDigFreqStartClicked() { /* ... */ }
 void MainWindow::onDigFreqChanged(double freq) { /* ... */ }
@@ -2006,36 +3077,35 @@ void MainWindow::onSweepStartStopClicked() {
             return;
         }
 
-        // Create frequency array for sweep
-        createSweepFrequencyArray();
-
-        if (sweepFrequencies.isEmpty()) {
+        if (sweepAdaptiveCheckBox && sweepAdaptiveCheckBox->isChecked()) {
+            BodeSweep::AdaptiveOptions options;
+            options.coarsePoints = SWEEP_COARSE_POINTS;
+            options.timeBudgetMs = sweepTimeBudgetSpin ? sweepTimeBudgetSpin->value() * 1000 : 0;
+            bodeSweep.startAdaptive(sweepStartFreq, sweepEndFreq, sweepSamples, options);
+        } else {
+            bodeSweep.start(sweepStartFreq, sweepEndFreq, sweepSamples);
+        }
+        if (!bodeSweep.isRunning()) {
             qDebug() << "[MainWindow] No frequencies to sweep";
             return;
         }
-
+        // The sweep drives acquisition itself, one capture per point
+        if (isRunning) onStopClicked();
         sweepRunning = true;
-        sweepIndex = 0;
-
-        // Clear previous sweep data
-        sweepAmplitudes.clear();
-        sweepPhases.clear();
-        sweepMagnitudes.clear();
-        // Clear input/output waveform storage
-        sweepInputWaves.clear();
-        sweepOutputWaves.clear();
 
         // Update UI
         if (sweepStartBtn) sweepStartBtn->setText("Stop Sweep");
         if (sweepProgress) {
             sweepProgress->setVisible(true);
-            sweepProgress->setMaximum(sweepFrequencies.size());
+            sweepProgress->setMaximum(bodeSweep.maxPointCount());
             sweepProgress->setValue(0);
         }
+        if (bothChRadio) bothChRadio->setChecked(true);
+        if (ddsWaveformCombo) ddsWaveformCombo->setCurrentText("DDS Sin (1-50 kHz)");
 
-        qDebug() << "[MainWindow] Starting sweep with" << sweepFrequencies.size() << "frequencies";
-
-        // Set DDS to sine wave and first frequency
+        qDebug() << "[MainWindow] Starting" << (bodeSweep.isAdaptive() ? "adaptive" : "fixed") << "sweep with"
+                 << bodeSweep.pointCount() << "of up to" << bodeSweep.maxPointCount() << "frequencies from"
+                 << sweepStartFreq << "to" << sweepEndFreq << "Hz";
         setDDSForSweep();
 
     } else {
@@ -2043,92 +3113,50 @@ void MainWindow::onSweepStartStopClicked() {
         stopSweep();
     }
 }
-void MainWindow::createSweepFrequencyArray() {
-    sweepFrequencies.clear();
-
-    // Generate logarithmic sweep frequencies based on start, end, and number of steps
-    double startFreq = sweepStartFreq;
-    double endFreq = sweepEndFreq;
-    int samples = sweepSamples;
-
-    double logStart = log10(startFreq);
-    double logEnd = log10(endFreq);
-    double step = (logEnd - logStart) / (samples - 1);
-    for (int i = 0; i < samples; ++i) {
-        double freq = pow(10, logStart + i * step);
-        sweepFrequencies.append(freq);
-    }
-
-    qDebug() << "[MainWindow] Created sweep array with" << sweepFrequencies.size() << "frequencies";
-    qDebug() << "[MainWindow] Start:" << startFreq << "Hz, End:" << endFreq << "Hz, Steps:" << samples;
-    for (int i = 0; i < qMin(10, sweepFrequencies.size()); ++i) {
-        qDebug() << "  Freq" << i << ":" << sweepFrequencies[i] << "Hz";
-    }
-}
+// Retunes the DDS for the current sweep point; the capture follows once the
+// upload is out and the output has settled (see the ddsUploaded handler)
 void MainWindow::setDDSForSweep() {
-    if (sweepIndex >= sweepFrequencies.size()) {
-        // Sweep complete
+    if (!sweepRunning || !bodeSweep.isRunning()) {
         stopSweep();
         return;
     }
+    double currentFreq = bodeSweep.currentFrequency();
 
-    double currentFreq = sweepFrequencies[sweepIndex];
-
-    // Set DDS to sine wave
-    if (ddsWaveformCombo) {
-        ddsWaveformCombo->setCurrentText("DDS Sin (1-50 kHz)");
-    }
-
-    // Set frequency
-    if (ddsFreqSpin) {
-        ddsFreqSpin->setValue(currentFreq);
-    }
-
-    // Set sample rate to lowest > 15x the frequency
-    int srIdx = findSampleRateIndex(currentFreq);
-    static const double sampleRates[] = {
-        2000000, 1000000, 500000, 200000, 100000, 50000, 20000, 10000, 5000, 2000, 1000, 500, 200, 100
-    };
-    double chosenRate = sampleRates[srIdx];
-    qDebug() << "[Bode Sweep] Frequency:" << currentFreq << "Hz, Chosen Sample Rate:" << chosenRate << "Hz (Index:" << srIdx << ")";
-    if (sampleRateCombo) {
-        sampleRateCombo->setCurrentIndex(srIdx);
-        onSampleRateChanged(srIdx);
-    }
-
-    // Start DDS
-    if (ddsStartStopBtn) {
-        ddsStartStopBtn->click();
+    // Set sample rate to the lowest one > 9x the frequency
+    sweepRateIndex = timeBaseForTone(currentFreq);
+    sweepSampleRate = timeBase(sweepRateIndex).sampleRate;
+    if (sampleRateCombo && sampleRateCombo->currentIndex() != sweepRateIndex) {
+        sampleRateCombo->setCurrentIndex(sweepRateIndex); // updates the time base via onSampleRateChanged
     }
+    qDebug() << "[Bode Sweep] Step" << bodeSweep.currentIndex() + 1 << "/" << bodeSweep.maxPointCount()
+             << "Frequency:" << currentFreq << "Hz, Sample Rate:" << sweepSampleRate << "Hz (Index:" << sweepRateIndex << ")";
 
-    qDebug() << "[MainWindow] Sweep step" << sweepIndex + 1 << "/" << sweepFrequencies.size() << "Frequency:" << currentFreq << "Hz, SampleRateIdx:" << srIdx;
-
-    // Update progress
-    if (sweepProgress) {
-        sweepProgress->setValue(sweepIndex + 1);
-    }
-
-    // --- PATCH: Force Continuous mode for sweep (Bode plot) ---
-    if (continuousRadio) continuousRadio->setChecked(true);
-    if (overwriteRadio) overwriteRadio->setChecked(false);
-    if (addRadio) addRadio->setChecked(false);
-    // -------------------------------------------------------------
+    sweepSettleMs = qMax(sweepDelay, int(SWEEP_SETTLE_CYCLES * 1000.0 / currentFreq));
+    if (ddsFreqSpin) ddsFreqSpin->setValue(currentFreq);
+    runDDS();
+}
+void MainWindow::captureSweepPoint() {
+    if (!sweepRunning || !isConnected) return;
+    // Auto trigger: the single-bin analysis does not need an aligned record
+    serialHandler->setProtocolParams(ch1Offset, ch2Offset, trigLevel, 0, trigPolarity, sweepRateIndex + 1);
+    serialHandler->startOscilloscopeAcquisition(1, 200, true);
+}
+void MainWindow::handleSweepCapture(const QVector<double>& input, const QVector<double>& output) {
+    const bool more = bodeSweep.addCapture(input, output, sweepSampleRate);
+    // Retune for the next point before drawing anything
+    if (more) setDDSForSweep();
 
-    // Start oscilloscope to capture response (single shot mode with fixed data length)
-    if (isConnected) {
-        dataLength = 200;
-        if (bothChRadio) {
-            bothChRadio->setChecked(true);
-        }
-        // Add settling delay: at least 3 cycles, min 50 ms
-        int settleTimeMs = qMax(50, int(3 * 1000.0 / currentFreq));
-        QTimer::singleShot(settleTimeMs, this, [this]() {
-            onRunClicked();
-        });
-    }
+    const BodeSweep::Point& p = bodeSweep.lastPoint();
+    qDebug() << "[Bode Sweep]" << p.frequency << "Hz: gain=" << p.magnitudeDb << "dB, phase=" << p.phaseDeg
+             << "deg, in=" << p.inputAmplitude << "V, out=" << p.outputAmplitude << "V" << (p.valid ? "" : "(invalid)");
+    if (sweepProgress) sweepProgress->setValue(bodeSweep.currentIndex());
+    if (plotManager) plotManager->updateWaveform(input, output);
+    if (!more) stopSweep();
 }
 void MainWindow::stopSweep() {
     sweepRunning = false;
+    sweepSettleMs = -1;
+    bodeSweep.stop();
     sweepTimer->stop();
 
     // Update UI
@@ -2140,132 +3168,178 @@ void MainWindow::stopSweep() {
         ddsStartStopBtn->click();
     }
 
-    qDebug() << "[MainWindow] Sweep stopped. Collected" << sweepAmplitudes.size() << "data points";
+    qDebug() << "[MainWindow] Sweep stopped. Collected" << bodeSweep.points().size() << "data points";
 
     // Plot Bode plot if we have data
-    if (!sweepFrequencies.isEmpty() && !sweepAmplitudes.isEmpty()) {
-        plotBodePlot();
+    if (!bodeSweep.points().isEmpty()) {
+        plotBodePlot(bodeSweep.points());
     }
 }
-void MainWindow::plotBodePlot() {
-    qDebug() << "[MainWindow] Creating Bode plot...";
-    if (sweepFrequencies.isEmpty() || sweepInputWaves.isEmpty() || sweepOutputWaves.isEmpty()) {
-        qDebug() << "[MainWindow] Missing sweep data for Bode plot";
+void MainWindow::onAutoSetClicked() {
+    if (autoSetupRunning) {
+        qDebug() << "[MainWindow] Auto-set cancelled";
+        finishAutoSetup(AutoSetupEnd::Cancel);
         return;
     }
-    if (sweepFrequencies.size() != sweepInputWaves.size() || sweepFrequencies.size() != sweepOutputWaves.size()) {
-        qDebug() << "[MainWindow] Data size mismatch for Bode plot";
+    if (!isConnected || sweepRunning) return;
+    // Auto-set drives acquisition itself, one capture per step
+    autoSetupResume = isRunning;
+    if (isRunning) onStopClicked();
+
+    AutoSetupSettings from;
+    from.timeBase = sampleRateCombo ? sampleRateCombo->currentIndex() : 3;
+    from.gainIndex[0] = ch1GainCombo ? ch1GainCombo->currentIndex() : 0;
+    from.gainIndex[1] = ch2GainCombo ? ch2GainCombo->currentIndex() : 0;
+    from.offset[0] = ch1Offset;
+    from.offset[1] = ch2Offset;
+    from.triggerSource = trigSource;
+    AutoSetup::Config config;
+    if (ch1GainCombo) {
+        config.gains.clear();
+        for (int i = 0; i < ch1GainCombo->count(); ++i) config.gains.append(ch1GainCombo->itemData(i).toDouble());
+    }
+    if (ch1OffsetSlider) {
+        config.offsetMin = ch1OffsetSlider->minimum();
+        config.offsetMax = ch1OffsetSlider->maximum();
+    }
+    autoSetup.start(from, config);
+    autoSetupRunning = true;
+    if (autoSetBtn) autoSetBtn->setText("Cancel Auto Set");
+    showStatus("Auto set...");
+    qDebug() << "[MainWindow] Auto-set started from sample rate index" << from.timeBase;
+    applyAutoSetupSettings(autoSetup.settings());
+    captureAutoSetupStep();
+}
+void MainWindow::captureAutoSetupStep() {
+    if (!autoSetupRunning || !isConnected) return;
+    const int index = autoSetup.settings().timeBase;
+    autoSetupArmedNs = acquisitionClockNs();
+    // Auto trigger, both channels. The setup sequence only sends the
+    // commands whose values changed since the last capture.
+    serialHandler->setProtocolParams(ch1Offset, ch2Offset, trigLevel, 0, trigPolarity, index + 1);
+    serialHandler->startOscilloscopeAcquisition(1, AUTO_SETUP_SAMPLES, true);
+    autoSetupTimer->start(int(1000.0 * AUTO_SETUP_SAMPLES / timeBase(index).sampleRate) + AUTO_SETUP_TIMEOUT_MS);
+}
+void MainWindow::handleAutoSetupCapture(qint64 timestampNs, const QVector<double>& ch1, const QVector<double>& ch2) {
+    // Under way before the last change, so taken with the old settings
+    if (timestampNs < autoSetupArmedNs) return;
+    autoSetupTimer->stop();
+    // Where the ADC's ends decode to with this capture's gains and offsets
+    AdcDecoder adc;
+    adc.setParams(ch1Gain, ch1Offset, ch2Gain, ch2Offset);
+    AutoSetupChannel channels[2];
+    const QVector<double>* volts[2] = {&ch1, &ch2};
+    const ChannelMeasurements* measurements[2] = {&ch1Measurements, &ch2Measurements};
+    for (int ch = 0; ch < 2; ++ch) {
+        AutoSetupChannel& c = channels[ch];
+        c.present = !volts[ch]->isEmpty();
+        c.meas = *measurements[ch];
+        c.clipLow = adc.toVolts(AdcDecoder::Channel(ch), 0);
+        c.clipHigh = adc.toVolts(AdcDecoder::Channel(ch), 255);
+    }
+    if (plotManager) plotManager->updateWaveform(ch1, ch2);
+    if (!autoSetup.step(channels)) {
+        finishAutoSetup(AutoSetupEnd::Apply);
         return;
     }
-    sweepMagnitudes.clear();
-    sweepPhases.clear();
+    const AutoSetupSettings& next = autoSetup.settings();
+    qDebug() << "[MainWindow] Auto-set capture" << autoSetup.captures() << "-> sample rate index" << next.timeBase
+             << "gains" << next.gainIndex[0] << next.gainIndex[1] << "offsets" << next.offset[0] << next.offset[1];
+    applyAutoSetupSettings(next);
+    captureAutoSetupStep();
+}
+void MainWindow::applyAutoSetupSettings(const AutoSetupSettings& settings) {
+    // The controls only signal real changes, and their handlers send nothing
+    // while stopped; they bring the plot and the DSP worker along
+    if (sampleRateCombo) sampleRateCombo->setCurrentIndex(settings.timeBase);
+    if (ch1GainCombo) ch1GainCombo->setCurrentIndex(settings.gainIndex[0]);
+    if (ch2GainCombo) ch2GainCombo->setCurrentIndex(settings.gainIndex[1]);
+    if (ch1OffsetSlider) ch1OffsetSlider->setValue(settings.offset[0]);
+    if (ch2OffsetSlider) ch2OffsetSlider->setValue(settings.offset[1]);
+}
+void MainWindow::finishAutoSetup(AutoSetupEnd end) {
+    autoSetupRunning = false;
+    autoSetupTimer->stop();
+    if (autoSetBtn) autoSetBtn->setText("Auto Set");
+    const bool apply = end == AutoSetupEnd::Apply;
+    AutoSetupSettings s = end == AutoSetupEnd::Cancel ? autoSetup.startSettings() : autoSetup.settings();
+    // Stopped midway: the time base, gains and offsets reached so far, the trigger as it was
+    if (end == AutoSetupEnd::KeepCurrent) s.triggerSource = autoSetup.startSettings().triggerSource;
+    autoSetup.cancel();
+    applyAutoSetupSettings(s);
+
+    // Set the trigger quietly: its handlers would send the whole trigger setup
+    QRadioButton* sourceRadios[] = {autoTrigRadio, ch1TrigRadio, ch2TrigRadio, extTrigRadio};
+    if (s.triggerSource >= 0 && s.triggerSource < 4 && sourceRadios[s.triggerSource])
+        sourceRadios[s.triggerSource]->setChecked(true);
+    trigSource = s.triggerSource;
+    const double gain = trigSource == 2 ? ch2Gain : trigSource == 1 ? ch1Gain : 1.0;
+    if (apply && autoSetup.foundTone()) {
+        // Inverse of the trigger line's (trigLevel * 10 / 2048 - 10) / gain
+        const int level = qBound(0, int(std::lround((s.triggerLevel * gain + 10.0) * 2048.0 / 10.0)), 4095);
+        if (trigLevelSlider) {
+            QSignalBlocker block(trigLevelSlider);
+            trigLevelSlider->setValue(level);
+        }
+        trigLevel = level;
+        if (trigLevelEdit) trigLevelEdit->setText(QString("%1V").arg(s.triggerLevel, 0, 'f', 2));
+    }
+    if (plotManager) {
+        const double trigLine = std::round((trigLevel * 10.0 / 2048.0 - 10.0) / gain * 100.0) / 100.0;
+        plotManager->updateTriggerLevel(trigLine, trigSource == 2);
+    }
+    serialHandler->setProtocolParams(ch1Offset, ch2Offset, trigLevel, trigSource, trigPolarity, s.timeBase + 1);
+
+    if (end == AutoSetupEnd::Cancel) {
+        showStatus("Auto set cancelled");
+    } else if (end == AutoSetupEnd::KeepCurrent) {
+        showStatus(QString("Auto set stopped after %1 captures, running with the settings so far").arg(autoSetup.captures()));
+    } else if (autoSetup.foundTone()) {
+        showStatus(QString("Auto set: trigger on CH%1 at %2 V after %3 captures")
+                       .arg(trigSource).arg(s.triggerLevel, 0, 'f', 2).arg(autoSetup.captures()));
+    } else {
+        showStatus(QString("Auto set: no periodic signal, Auto trigger after %1 captures").arg(autoSetup.captures()));
+    }
+    qDebug() << "[MainWindow] Auto-set" << (apply ? "done" : end == AutoSetupEnd::KeepCurrent ? "stopped" : "abandoned") << "after" << autoSetup.captures()
+             << "captures" << (apply && !autoSetup.converged() ? "(capture limit reached)" : "");
+    if (autoSetupResume) onRunClicked();
+}
+void MainWindow::plotBodePlot(const QVector<BodeSweep::Point>& points) {
+    qDebug() << "[MainWindow] Creating Bode plot...";
+    if (points.isEmpty()) {
+        qDebug() << "[MainWindow] Missing sweep data for Bode plot";
+        return;
+    }
+    QVector<double> freqs, magnitudes, phases;
     QVector<double> invalidFreqs, invalidYs; // For marking invalid points
-    for (int i = 0; i < sweepFrequencies.size(); ++i) {
-        const QVector<double>& inWaveFull = sweepInputWaves[i];
-        const QVector<double>& outWaveFull = sweepOutputWaves[i];
-        int N = std::min(inWaveFull.size(), outWaveFull.size());
-        if (N <= 20) {
-            sweepMagnitudes.append(0.0);
-            sweepPhases.append(0.0);
-            invalidFreqs.append(sweepFrequencies[i]);
+    for (const BodeSweep::Point& p : points) {
+        if (!p.valid) {
+            invalidFreqs.append(p.frequency);
             invalidYs.append(0.0); // Mark at 0 dB
             continue;
         }
-        // Ignore first 20 points
-        QVector<double> inWave = inWaveFull.mid(20);
-        QVector<double> outWave = outWaveFull.mid(20);
-        int M = std::min(inWave.size(), outWave.size());
-        // --- Zero-crossing phase calculation ---
-        double dt = multiplier * 1e-6;
-        // Find first upward zero-crossing for both input and output
-        auto findFirstZeroCrossing = [](const QVector<double>& data) -> int {
-            for (int i = 1; i < data.size(); ++i) {
-                if (data[i-1] < 0 && data[i] >= 0) {
-                    return i;
-                }
-            }
-            return -1;
-        };
-        int inZeroIdx = findFirstZeroCrossing(inWave);
-        int outZeroIdx = findFirstZeroCrossing(outWave);
-        // Find period from input zero-crossings
-        QVector<int> inZeroIndices;
-        for (int j = 1; j < inWave.size(); ++j) {
-            if (inWave[j-1] < 0 && inWave[j] >= 0) {
-                inZeroIndices.append(j);
-            }
-        }
-        double avgPeriod = 0.0;
-        if (inZeroIndices.size() >= 2) {
-            double sumPeriods = 0.0;
-            for (int k = 1; k < inZeroIndices.size(); ++k) {
-                sumPeriods += (inZeroIndices[k] - inZeroIndices[k-1]) * dt;
-            }
-            avgPeriod = sumPeriods / (inZeroIndices.size() - 1);
-        }
-        // Amplitude/gain calculation (unchanged)
-        double inAvgMax = 0, inAvgMin = 0, outAvgMax = 0, outAvgMin = 0;
-        auto findLocalExtrema = [](const QVector<double>& data, double& avgMax, double& avgMin) {
-            QVector<double> maxs, mins;
-            int N = data.size();
-            for (int i = 1; i < N - 1; ++i) {
-                if (data[i] > data[i-1] && data[i] > data[i+1]) maxs.append(data[i]);
-                if (data[i] < data[i-1] && data[i] < data[i+1]) mins.append(data[i]);
-            }
-            avgMax = maxs.isEmpty() ? 0.0 : std::accumulate(maxs.begin(), maxs.end(), 0.0) / maxs.size();
-            avgMin = mins.isEmpty() ? 0.0 : std::accumulate(mins.begin(), mins.end(), 0.0) / mins.size();
-        };
-        findLocalExtrema(inWave, inAvgMax, inAvgMin);
-        findLocalExtrema(outWave, outAvgMax, outAvgMin);
-        double inAmp = (inAvgMax - inAvgMin) / 2.0;
-        double outAmp = (outAvgMax - outAvgMin) / 2.0;
-        double gain = (inAmp > 1e-9) ? 20.0 * log10(outAmp / inAmp) : 0.0;
-        // Phase calculation using zero-crossing
-        double phase = 0.0;
-        if (inZeroIdx >= 0 && outZeroIdx >= 0 && avgPeriod > 0.0) {
-            double deltaT = (outZeroIdx - inZeroIdx) * dt;
-            phase = (deltaT / avgPeriod) * 360.0;
-            // Wrap to [-180, 180]
-            while (phase > 180) phase -= 360;
-            while (phase < -180) phase += 360;
-        }
-        if (inAmp <= 1e-9 || outAmp <= 1e-9) {
-            // Mark as invalid
-            invalidFreqs.append(sweepFrequencies[i]);
-            invalidYs.append(0.0);
-        }
-        sweepMagnitudes.append(gain);
-        sweepPhases.append(phase);
-        qDebug() << "[MainWindow] Frequency" << sweepFrequencies[i] << "Hz: gain=" << gain << "dB, phase=" << phase << "degrees (zero-crossing)";
-    }
-    // --- Smooth Bode plot with multiple layers of moving average ---
-    auto movingAverage = [](const QVector<double>& data) {
-        QVector<double> result = data;
-        int N = data.size();
-        if (N < 3) return result;
-        for (int i = 1; i < N - 1; ++i) {
-            result[i] = (data[i - 1] + data[i] + data[i + 1]) / 3.0;
-        }
-        return result;
-    };
-    QVector<double> smoothedMagnitudes = sweepMagnitudes;
-    QVector<double> smoothedPhases = sweepPhases;
-    // Apply multiple layers (e.g., 3 times)
-    for (int filterPass = 0; filterPass < 3; ++filterPass) {
-        smoothedMagnitudes = movingAverage(smoothedMagnitudes);
-        smoothedPhases = movingAverage(smoothedPhases);
-    }
-    if (bodePlot) {
+        freqs.append(p.frequency);
+        magnitudes.append(p.magnitudeDb);
+        phases.append(p.phaseDeg);
+    }
+    if (freqs.isEmpty()) {
+        qDebug() << "[MainWindow] No valid sweep points for Bode plot";
+        return;
+    }
+    // The single-bin estimates are clean enough to plot unsmoothed
+    const QVector<double>& smoothedMagnitudes = magnitudes;
+    const QVector<double>& smoothedPhases = phases;
+    if (bodePlotWidget()) {
         bodePlot->clearGraphs();
         bodePlot->addGraph();
-        bodePlot->graph(0)->setData(sweepFrequencies, smoothedMagnitudes);
+        bodePlot->graph(0)->setData(freqs, smoothedMagnitudes);
         bodePlot->graph(0)->setPen(QPen(Qt::blue, 2));
         bodePlot->graph(0)->setName("Magnitude Response");
         bodePlot->graph(0)->setValueAxis(bodePlot->yAxis);
         bodePlot->graph(0)->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssCircle, 4));
         bodePlot->graph(0)->rescaleValueAxis(true); // Auto-scale y-axis for magnitude
         bodePlot->addGraph();
-        bodePlot->graph(1)->setData(sweepFrequencies, smoothedPhases);
+        bodePlot->graph(1)->setData(freqs, smoothedPhases);
         bodePlot->graph(1)->setPen(QPen(Qt::red, 2));
         bodePlot->graph(1)->setName("Phase Response");
         bodePlot->graph(1)->setValueAxis(bodePlot->yAxis2);
@@ -2281,7 +3355,7 @@ void MainWindow::plotBodePlot() {
         }
         bodePlot->xAxis->setLabel("Frequency (Hz)");
         bodePlot->xAxis->setScaleType(QCPAxis::stLogarithmic);
-        bodePlot->xAxis->setRange(sweepFrequencies.first(), sweepFrequencies.last());
+        bodePlot->xAxis->setRange(points.first().frequency, points.last().frequency);
         bodePlot->yAxis->setLabel("Magnitude (dB)");
         bodePlot->yAxis->setLabelColor(Qt::blue);
         bodePlot->yAxis->setTickLabelColor(Qt::blue);
@@ -2340,29 +3414,29 @@ void MainWindow::createTestBodePlot() {
     qDebug() << "[MainWindow] Creating test Bode plot...";
 
     // Create test frequency data (logarithmic sweep from 100Hz to 10kHz)
-    sweepFrequencies.clear();
-    sweepAmplitudes.clear();
-
     double startFreq = 100.0;
     double endFreq = 10000.0;
     int numPoints = 50;
 
+    QVector<BodeSweep::Point> points;
     for (int i = 0; i < numPoints; ++i) {
-        double freq = startFreq * pow(endFreq / startFreq, (double)i / (numPoints - 1));
-        sweepFrequencies.append(freq);
+        BodeSweep::Point p;
+        p.frequency = startFreq * pow(endFreq / startFreq, (double)i / (numPoints - 1));
 
         // Create a simple low-pass filter response for testing
         // H(f) = 1 / (1 + j*f/f0) where f0 = 1000 Hz
         double f0 = 1000.0;
-        double magnitude = 1.0 / sqrt(1.0 + pow(freq / f0, 2));
-        sweepAmplitudes.append(magnitude);
+        p.magnitudeDb = 20.0 * log10(1.0 / sqrt(1.0 + pow(p.frequency / f0, 2)));
+        p.phaseDeg = -atan(p.frequency / f0) * 180.0 / PI;
+        p.valid = true;
+        points.append(p);
     }
 
-    qDebug() << "[MainWindow] Created test data with" << sweepFrequencies.size() << "points";
-    qDebug() << "[MainWindow] Frequency range:" << sweepFrequencies.first() << "to" << sweepFrequencies.last() << "Hz";
+    qDebug() << "[MainWindow] Created test data with" << points.size() << "points";
+    qDebug() << "[MainWindow] Frequency range:" << points.first().frequency << "to" << points.last().frequency << "Hz";
 
     // Plot the test Bode plot
-    plotBodePlot();
+    plotBodePlot(points);
 
     showStatus("Test Bode plot created");
 }
@@ -2389,45 +3463,7 @@ void MainWindow::onStudentNameChanged() {
     studentName = studentNameEdit->text();
     readDeviceSignature();
 }
-void MainWindow::readDeviceSignature() { serialHandler->sendCommand(QByteArray(1, 'e')); }
-void MainWindow::onOscilloscopeData(const QVector<double>& ch1, const QVector<double>& ch2, const QVector<double>& xvals) {
-    // --- Low-pass filter logic ---
-    QVector<double> filteredCh1 = ch1;
-    QVector<double> filteredCh2 = ch2;
-    QVector<double> filteredX = xvals;
-    if (lpfCheckBox && lpfCheckBox->isChecked()) {
-        // Simple moving average low-pass filter (window size 5)
-        auto lowPass = [](const QVector<double>& data) {
-            QVector<double> out;
-            int N = data.size();
-            int w = 5;
-            for (int i = 0; i < N; ++i) {
-                double sum = 0;
-                int count = 0;
-                for (int j = i - w/2; j <= i + w/2; ++j) {
-                    if (j >= 0 && j < N) {
-                        sum += data[j];
-                        count++;
-                    }
-                }
-                out.append(sum / count);
-            }
-            return out;
-        };
-        filteredCh1 = lowPass(filteredCh1);
-        filteredCh2 = lowPass(filteredCh2);
-        filteredX = lowPass(filteredX); // Optional: smooth x if needed
-        // Remove first 10 points from all vectors if possible
-        if (filteredCh1.size() > 10) filteredCh1 = filteredCh1.mid(10);
-        if (filteredCh2.size() > 10) filteredCh2 = filteredCh2.mid(10);
-        if (filteredX.size() > 10) filteredX = filteredX.mid(10);
-    }
-    // Pass filtered (or original) data to PlotManager
-    plotManager->updateWaveform(filteredCh1, filteredCh2);
-    ch1Buffer = filteredCh1;
-    ch2Buffer = filteredCh2;
-    timeBuffer = filteredX;
-}
+void MainWindow::readDeviceSignature() { serialHandler->readSignature(); }
 void MainWindow::onSerialError(const QString &msg) { showStatus(msg); }
 void MainWindow::onStatusMessage(const QString &msg) { showStatus(msg); }
 void MainWindow::onTabChanged(int idx) {
@@ -2442,219 +3478,91 @@ void MainWindow::onTabChanged(int idx) {
     }
     if (idx == 2) {
         // Show Bode plot only for Bode tab
-        mainAreaLayout->insertWidget(0, bodePlot, 1);
+        mainAreaLayout->insertWidget(0, bodePlotWidget(), 1);
     } else {
         // Always show oscilloscope plot for all other tabs
         mainAreaLayout->insertWidget(0, plot, 1);
     }
 }
 
-void MainWindow::performFFT(const QVector<double>& input, QVector<double>& output) {
-    int n = input.size();
-    if (n == 0) return;
+QCustomPlot* MainWindow::bodePlotWidget() {
+    if (bodePlot) return bodePlot;
+    bodePlot = new QCustomPlot();
+    bodePlot->setMinimumHeight(300); // Increased from 200 to 300 for better visibility
+    bodePlot->xAxis->setLabel("Frequency (Hz)");
+    bodePlot->xAxis->setScaleType(QCPAxis::stLogarithmic);
 
-    std::valarray<std::complex<double>> fft_data(n);
-    for(int i=0; i<n; ++i) {
-        fft_data[i] = std::complex<double>(input[i], 0);
-    }
+    // Setup left Y-axis for magnitude
+    bodePlot->yAxis->setLabel("Magnitude (dB)");
+    bodePlot->yAxis->setLabelColor(Qt::blue);
+    bodePlot->yAxis->setTickLabelColor(Qt::blue);
+    bodePlot->yAxis->setBasePen(QPen(Qt::blue));
+    bodePlot->yAxis->setTickPen(QPen(Qt::blue));
+    bodePlot->yAxis->setSubTickPen(QPen(Qt::blue));
 
-    // Basic DFT - for a real implementation, use a proper FFT library or algorithm
-    for (int k = 0; k < n; ++k) {
-        std::complex<double> sum(0.0, 0.0);
-        for (int t = 0; t < n; ++t) {
-            double angle = 2 * PI * t * k / n;
-            sum += fft_data[t] * std::exp(std::complex<double>(0, -angle));
-        }
-        fft_data[k] = sum;
-    }
+    // Setup right Y-axis for phase (when we add phase data later)
+    bodePlot->yAxis2->setVisible(true);
+    bodePlot->yAxis2->setLabel("Phase (degrees)");
+    bodePlot->yAxis2->setLabelColor(Qt::red);
+    bodePlot->yAxis2->setTickLabelColor(Qt::red);
+    bodePlot->yAxis2->setBasePen(QPen(Qt::red));
+    bodePlot->yAxis2->setTickPen(QPen(Qt::red));
+    bodePlot->yAxis2->setSubTickPen(QPen(Qt::red));
+    // Ensure phase axis shows tick values
+    bodePlot->yAxis2->setTickLabelFont(QFont("Arial", 8));
+    bodePlot->yAxis2->setTickLength(5, 3); // Main tick length, sub-tick length
+    bodePlot->yAxis2->setNumberFormat("f"); // Show decimal format
+    bodePlot->yAxis2->setNumberPrecision(1); // Precision for tick labels
+    bodePlot->legend->setVisible(true);
 
-    output.resize(n / 2);
-    for (int i = 0; i < n / 2; ++i) {
-        output[i] = std::abs(fft_data[i]) / n;
-    }
+    bodePlot->axisRect()->setupFullAxesBox(true);
+    bodePlot->axisRect()->setMargins(QMargins(60, 20, 20, 60)); // Left, Top, Right, Bottom
+    return bodePlot;
 }
 
-void MainWindow::initializeWaveformTables()
-{
-    // Sin Table
-    sinTable = {122, 124, 127, 130, 133, 136, 139, 142, 144, 147, 150, 153, 155, 158, 161, 164, 166, 169, 172, 174,
-    177, 179, 182, 184, 187, 189, 191, 193, 196, 198, 200, 202, 204, 206, 208, 210, 212, 214, 215, 217,
-    219, 220, 222, 223, 225, 226, 227, 228, 230, 231, 232, 233, 233, 234, 235, 236, 236, 237, 237, 238,
-    238, 238, 238, 238, 239, 238, 238, 238, 238, 238, 237, 237, 236, 236, 235, 234, 233, 233, 232, 231,
-    230, 228, 227, 226, 225, 223, 222, 220, 219, 217, 215, 214, 212, 210, 208, 206, 204, 202, 200, 198,
-    196, 193, 191, 189, 187, 184, 182, 179, 177, 174, 172, 169, 166, 164, 161, 158, 155, 153, 150, 147,
-    144, 142, 139, 136, 133, 130, 127, 124, 122, 120, 117, 114, 111, 108, 105, 102, 100, 97, 94, 91,
-    89, 86, 83, 80, 78, 75, 72, 70, 67, 65, 62, 60, 57, 55, 53, 51, 48, 46, 44, 42,
-    40, 38, 36, 34, 32, 30, 29, 27, 25, 24, 22, 21, 19, 18, 17, 16, 14, 13, 12, 11,
-    11, 10, 9, 8, 8, 7, 7, 6, 6, 6, 6, 6, 5, 6, 6, 6, 6, 6, 7, 7,
-    8, 8, 9, 10, 11, 11, 12, 13, 14, 16, 17, 18, 19, 21, 22, 24, 25, 27, 29, 30,
-    32, 34, 36, 38, 40, 42, 44, 46, 48, 51, 53, 55, 57, 60, 62, 65, 67, 70, 72, 75,
-    78, 80, 83, 86, 89, 91, 94, 97, 100, 102, 105, 108, 111, 114, 117, 120};
-    // Ramp Up Table
-    rampUpTable = {5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28,
-    29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52,
-    53, 54, 55, 56, 57, 58, 59, 60, 61, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
-    77, 78, 79, 80, 81, 82, 83, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99, 100,
-    101, 102, 103, 104, 105, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119,
-    120, 121, 122, 123, 124, 125, 126, 127, 128, 128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138,
-    139, 140, 141, 142, 143, 144, 145, 146, 147, 148, 149, 150, 150, 151, 152, 153, 154, 155, 156, 157,
-    158, 159, 160, 161, 162, 163, 164, 165, 166, 167, 168, 169, 170, 171, 172, 172, 173, 174, 175, 176,
-    177, 178, 179, 180, 181, 182, 183, 184, 185, 186, 187, 188, 189, 190, 191, 192, 193, 194, 194, 195,
-    196, 197, 198, 199, 200, 201, 202, 203, 204, 205, 206, 207, 208, 209, 210, 211, 212, 213, 214, 215,
-    216, 217, 217, 218, 219, 220, 221, 222, 223, 224, 225, 226, 227, 228, 229, 230, 231, 232, 233, 234,
-    235, 236, 237, 238, 239, 239, 240, 241, 242, 243, 244, 245, 246, 247, 248, 249};
-    // Ramp Down Table
-    rampDownTable = {254, 253, 252, 251, 250, 249, 248, 247, 246, 245, 244, 243, 242, 241, 240, 239, 238, 237, 236, 235,
-    234, 234, 233, 232, 231, 230, 229, 228, 227, 226, 225, 224, 223, 222, 221, 220, 219, 218, 217, 216,
-    215, 214, 213, 212, 211, 210, 209, 208, 207, 206, 205, 204, 203, 202, 201, 200, 199, 198, 197, 196,
-    195, 194, 193, 193, 192, 191, 190, 189, 188, 187, 186, 185, 184, 183, 182, 181, 180, 179, 178, 177,
-    176, 175, 174, 173, 172, 171, 170, 169, 168, 167, 166, 165, 164, 163, 162, 161, 160, 159, 158, 157,
-    156, 155, 154, 153, 152, 151, 151, 150, 149, 148, 147, 146, 145, 144, 143, 142, 141, 140, 139, 138,
-    137, 136, 135, 134, 133, 132, 131, 130, 129, 128, 127, 126, 125, 124, 123, 122, 121, 120, 119, 118,
-    117, 116, 115, 114, 113, 112, 111, 110, 109, 109, 108, 107, 106, 105, 104, 103, 102, 101, 100, 99,
-    98, 97, 96, 95, 94, 93, 92, 91, 90, 89, 88, 87, 86, 85, 84, 83, 82, 81, 80, 79, 78, 77, 76, 75,
-    74, 73, 72, 71, 70, 69, 68, 68, 67, 66, 65, 64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51,
-    50, 49, 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 28, 27, 26,
-    26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5};
-    // Triangle Table
-    triangleTable = {5, 7, 9, 11, 13, 15, 16, 18, 20, 22, 24, 26, 28, 30, 32, 34, 36, 38, 39,
-    41, 43, 45, 47, 49, 51, 53, 55, 57, 59, 61, 62, 64, 66, 68, 70, 72, 74, 76,
-    78, 80, 82, 83, 85, 87, 89, 91, 93, 95, 97, 99, 101, 103, 105, 106, 108, 110, 112,
-    114, 116, 118, 120, 122, 124, 126, 128, 129, 131, 133, 135, 137, 139, 141, 143, 145, 147, 149,
-    150, 152, 154, 156, 158, 160, 162, 164, 166, 168, 170, 172, 173, 175, 177, 179, 181, 183, 185,
-    187, 189, 191, 193, 196, 198, 200, 202, 204, 206, 208, 210, 212, 214, 216, 217, 219, 221, 223,
-    225, 227, 229, 231, 233, 235, 237, 239, 240, 242, 244, 246, 248, 250, 248, 246, 244, 242, 240, 239,
-    237, 235, 233, 231, 229, 227, 225, 223, 221, 219, 217, 216, 214, 212, 210, 208, 206, 204, 202,
-    200, 198, 196, 194, 193, 191, 189, 187, 185, 183, 181, 179, 177, 175, 173, 172, 170, 168, 166,
-    164, 162, 160, 158, 156, 154, 152, 150, 149, 147, 145, 143, 141, 139, 137, 135, 133, 131, 129,
-    128, 126, 124, 122, 120, 118, 116, 114, 112, 110, 108, 106, 105, 103, 101, 99, 97, 95, 93,
-    91, 89, 87, 85, 83, 82, 80, 78, 76, 74, 72, 70, 68, 66, 64, 62, 61, 59, 57,
-    55, 53, 51, 49, 47, 45, 43, 41, 39, 38, 36, 34, 32, 30, 28, 26, 24, 22, 20,
-    18, 16, 15, 13, 11, 9, 7, 5};
-    // Square Table
-    squareTable = {5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-    250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250,
-    250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250,
-    250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250,
-    250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250,
-    250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250,
-    250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250};
+void MainWindow::performFFT(const QVector<double>& input, QVector<double>& output) {
+    if (input.isEmpty()) return;
+    fftEngine.magnitudeSpectrum(input, output, fftWindow);
 }
 
 // DDS Command logic
 void MainWindow::runDDS() {
-    // Ensure waveform table is filled from selection
-    onWaveformSelectionChanged(ddsWaveformCombo ? ddsWaveformCombo->currentIndex() : 0);
-    setFrequency();
     if (!serialHandler) return;
-    // Defensive: Ensure SetPeriodCmd and SamplesCmd are at least 3 bytes
-    if (SetPeriodCmd.size() < 3) SetPeriodCmd.resize(3);
-    if (SamplesCmd.size() < 3) SamplesCmd.resize(3);
-    // Set command bytes
-    SetPeriodCmd[0] = 0x70; // 'p'
-    SamplesCmd[0] = 0x4E;   // 'N'
-    // --- Debug output ---
-    qDebug() << "[DDS] SetPeriodCmd:" << SetPeriodCmd.toHex();
-    qDebug() << "[DDS] SamplesCmd:" << SamplesCmd.toHex();
-    // Send SetPeriodCmd
-    serialHandler->sendCommand(SetPeriodCmd);
-    QThread::msleep(20);
-    // Send SamplesCmd
-    serialHandler->sendCommand(SamplesCmd);
-    QThread::msleep(20);
-    // Build DDS_OutCmd
-    int safe_samples = std::min(no_of_samples, static_cast<int>(DDS_Table.size()));
-    if (safe_samples <= 0 || safe_samples > 512) {
-        qWarning() << "[DDS] Invalid sample count:" << safe_samples;
-        return;
+    const int waveformIndex = ddsWaveformCombo ? ddsWaveformCombo->currentIndex() : 0;
+    const int frequency = ddsFreqSpin ? static_cast<int>(ddsFreqSpin->value()) : 1000;
+    // Arbitrary waveforms come from a file that may have changed since
+    const bool cacheable = !(ddsWaveformCombo && ddsWaveformCombo->currentText() == "DDS Arb (1-50 kHz)");
+    const quint64 key = (quint64(quint32(waveformIndex)) << 32) | quint32(frequency);
+
+    DdsUpload upload;
+    if (cacheable && ddsCache.contains(key)) {
+        upload = ddsCache.value(key);
+    } else {
+        // Ensure waveform table is filled from selection
+        onWaveformSelectionChanged(waveformIndex);
+        if (!buildDdsUpload(DDS_Waveform, frequency, upload)) {
+            qWarning() << "[DDS] No table for frequency:" << frequency;
+            // Nothing is uploaded, so no ddsUploaded either
+            if (sweepRunning) stopSweep();
+            return;
+        }
+        if (cacheable) {
+            if (ddsCache.size() >= DDS_CACHE_LIMIT) ddsCache.clear();
+            ddsCache.insert(key, upload);
+        }
     }
-    DDS_OutCmd.resize(safe_samples + 3);
-    // Set SendWaveformCmd: 'r', 0x00, 0x00
-    DDS_OutCmd[0] = 0x72; // 'r'
-    DDS_OutCmd[1] = 0x00;
-    DDS_OutCmd[2] = 0x00;
-    for (int i = 0; i < safe_samples; ++i) {
-        DDS_OutCmd[i + 3] = DDS_Table[i];
-    }
-    // Debug output for waveform data
-    QByteArray wfBytes;
-    for (int i = 0; i < std::min(16, safe_samples); ++i) wfBytes.append((char)DDS_Table[i]);
-    qDebug() << "[DDS] DDS_Table (first 16):" << wfBytes.toHex();
-    qDebug() << "[DDS] DDS_OutCmd (first 16 bytes):" << DDS_OutCmd.left(16).toHex() << "... size:" << DDS_OutCmd.size();
-    serialHandler->sendCommand(DDS_OutCmd);
-    QThread::msleep(20);
-    // Defensive: Ensure RunDDSCmd is at least 3 bytes
-    if (RunDDSCmd.size() < 3) RunDDSCmd.resize(3);
-    // Set RunDDSCmd: 'f', 0x00, 0x00
-    RunDDSCmd[0] = 0x66; // 'f'
-    RunDDSCmd[1] = 0x00;
-    RunDDSCmd[2] = 0x00;
-    qDebug() << "[DDS] RunDDSCmd:" << RunDDSCmd.toHex();
-    serialHandler->sendCommand(RunDDSCmd);
+    Frequency = frequency;
+    // --- Debug output ---
+    qDebug() << "[DDS] SetPeriodCmd:" << upload.period.toHex();
+    qDebug() << "[DDS] SamplesCmd:" << upload.samples.toHex();
+    qDebug() << "[DDS] DDS_OutCmd (first 16 bytes):" << upload.table.left(16).toHex() << "... size:" << upload.table.size();
+    // Paced and de-duplicated on the acquisition thread; returns immediately
+    serialHandler->uploadDds(upload.period, upload.samples, upload.table, ddsRunCommand());
 }
 
 // Stubs for remaining functions
 void MainWindow::createSweepArray() {}
 void MainWindow::sendDigitalCommand() {}
-void MainWindow::averageData() {
-    // Implement averaging for 2Mbps rate like VB.NET
-    // This function interpolates/averages the data for 2Mbps rate
-
-    if (ch1Buffer.isEmpty() && ch2Buffer.isEmpty()) {
-        return;
-    }
-
-    qDebug() << "[MainWindow] Applying averaging for 2Mbps rate";
-
-    // Average CH1 data
-    if (!ch1Buffer.isEmpty()) {
-        QVector<double> tempCh1 = ch1Buffer;
-        ch1Buffer.resize(dataLength);
-
-        // First data point stays the same
-        ch1Buffer[0] = tempCh1[0];
-
-        // Average every 2 points and interpolate
-        for (int i = 1; i < dataLength; i += 2) {
-            if (i/2 + 1 < tempCh1.size()) {
-                ch1Buffer[i] = (tempCh1[i/2] + tempCh1[i/2 + 1]) / 2.0;
-            } else {
-                ch1Buffer[i] = tempCh1[i/2];
-            }
-
-            if (i + 1 < dataLength && i/2 + 1 < tempCh1.size()) {
-                ch1Buffer[i + 1] = tempCh1[i/2 + 1];
-            }
-        }
-    }
-
-    // Average CH2 data
-    if (!ch2Buffer.isEmpty()) {
-        QVector<double> tempCh2 = ch2Buffer;
-        ch2Buffer.resize(dataLength);
-
-        // First data point stays the same
-        ch2Buffer[0] = tempCh2[0];
-
-        // Average every 2 points and interpolate
-        for (int i = 1; i < dataLength; i += 2) {
-            if (i/2 + 1 < tempCh2.size()) {
-                ch2Buffer[i] = (tempCh2[i/2] + tempCh2[i/2 + 1]) / 2.0;
-            } else {
-                ch2Buffer[i] = tempCh2[i/2];
-            }
-
-            if (i + 1 < dataLength && i/2 + 1 < tempCh2.size()) {
-                ch2Buffer[i + 1] = tempCh2[i/2 + 1];
-            }
-        }
-    }
-
-    qDebug() << "[MainWindow] Averaging completed for 2Mbps rate";
-}
 
 // DDS Signal Output Helper Functions
 void MainWindow::onFrequencyTextChanged(const QString &text) {
@@ -2682,15 +3590,15 @@ void MainWindow::onWaveformSelectionChanged(int index) {
     if (!ddsWaveformCombo) return;
     QString inputText = ddsWaveformCombo->currentText();
     if (inputText == "DDS Sin (1-50 kHz)") {
-        DDS_Waveform = sinTable;
+        DDS_Waveform = ddsWaveformTable(DdsWaveform::Sine);
     } else if (inputText == "DDS Sqare(1-50 kHz)") {
-        DDS_Waveform = squareTable;
+        DDS_Waveform = ddsWaveformTable(DdsWaveform::Square);
     } else if (inputText == "DDS Tri (1-50 kHz)") {
-        DDS_Waveform = triangleTable;
+        DDS_Waveform = ddsWaveformTable(DdsWaveform::Triangle);
     } else if (inputText == "DDS RampUp (1-50 kHz)") {
-        DDS_Waveform = rampUpTable;
+        DDS_Waveform = ddsWaveformTable(DdsWaveform::RampUp);
     } else if (inputText == "DDS RampDn (1-50 kHz)") {
-        DDS_Waveform = rampDownTable;
+        DDS_Waveform = ddsWaveformTable(DdsWaveform::RampDown);
     } else if (inputText == "DDS Arb (1-50 kHz)") {
         openDDSFile();
         readCSVFileToArray();
@@ -2698,133 +3606,6 @@ void MainWindow::onWaveformSelectionChanged(int index) {
     }
 }
 
-int MainWindow::get_phase_step(int frequency, int fclock) {
-    double phase_step_temp = (frequency * pow(2, 16)) / fclock;
-    int phase_step_int = static_cast<int>(std::floor(phase_step_temp));
-    int step = nextPowerOf2(phase_step_int);
-    if (step < 1) step = 1; // Never return 0
-    return step;
-}
-
-int MainWindow::nextPowerOf2(int n) {
-    if (n == 0) return 1;
-    int count = 0;
-    while (n != 0) {
-        n = n >> 1;
-        count++;
-    }
-    return 1 << count;
-}
-
-void MainWindow::GetCount_GetIndex(int phase_accumulator, int phase_step, int dds_index, int dds_count) {
-    // Fill DDS_Table until dds_index == 256 or max 512 samples
-    int table_size = DDS_Table.size();
-    int waveform_size = DDS_Waveform.size();
-    int unique_indices = 0;
-    int last_index = 0;
-    if (table_size > 0) {
-        if (waveform_size > 0)
-            DDS_Table[0] = DDS_Waveform[0];
-        else
-            DDS_Table[0] = 0;
-    }
-    dds_count = 1;
-    dds_index = 0;
-    std::vector<bool> seen(256, false);
-    seen[0] = true;
-    unique_indices = 1;
-    while (dds_count < 512 && unique_indices < 256 && dds_count < table_size) {
-        phase_accumulator += phase_step;
-        dds_index = phase_accumulator >> 8;
-        if (dds_index >= 256) dds_index = 255;
-        if (waveform_size > 0 && dds_index < waveform_size)
-            DDS_Table[dds_count] = DDS_Waveform[dds_index];
-        else if (waveform_size > 0)
-            DDS_Table[dds_count] = DDS_Waveform.back();
-        else
-            DDS_Table[dds_count] = 0;
-        if (!seen[dds_index]) {
-            seen[dds_index] = true;
-            unique_indices++;
-        }
-        last_index = dds_index;
-        dds_count++;
-    }
-    // If we exited because of sample limit, but never reached a full cycle, forcibly complete the table with the last value
-    for (int i = dds_count; i < 512 && i < table_size; ++i) {
-        if (waveform_size > 0)
-            DDS_Table[i] = DDS_Waveform[last_index];
-        else
-            DDS_Table[i] = 0;
-    }
-    intermediate_dds_count = dds_count;
-    debug_dds_index = dds_index;
-}
-
-void MainWindow::setFrequency() {
-    // Ensure DDS_Waveform is at least 256 samples
-    if (DDS_Waveform.size() < 256)
-        DDS_Waveform.resize(256, 0);
-    // Ensure DDS_Table is at least 512 samples
-    if (DDS_Table.size() < 512)
-        DDS_Table.resize(512, 0);
-    DDS_Table.fill(0);
-    divider = 32; // initial value of timer period
-    timer_clock = 32 * 1000000; // fclk
-    fclock = timer_clock / divider; // event clock
-    Frequency = ddsFreqSpin ? static_cast<int>(ddsFreqSpin->value()) : 1000;
-    // --- Hybrid method: perfect full cycle at low freq for all waveforms ---
-    bool useCycleStretch = (Frequency < 1000);
-    if (useCycleStretch) {
-        int N = 512;
-        int waveform_size = DDS_Waveform.size();
-        for (int i = 0; i < N; ++i) {
-            int table_index = static_cast<int>(round(i * (waveform_size - 1) / double(N - 1)));
-            DDS_Table[i] = DDS_Waveform[table_index];
-        }
-        timer_period = static_cast<int>(timer_clock / (Frequency * N));
-        no_of_samples = N;
-        // Clamp as needed
-        if (timer_period > 65535) timer_period = 65535;
-        if (no_of_samples > 512) no_of_samples = 512;
-        SetPeriodCmd[1] = static_cast<char>(timer_period / 256);
-        SetPeriodCmd[2] = static_cast<char>(timer_period % 256);
-        SamplesCmd[1] = static_cast<char>(no_of_samples / 256);
-        SamplesCmd[2] = static_cast<char>(no_of_samples % 256);
-        dds_array_length = N - 1;
-        return;
-    }
-    // --- Standard DDS for all other cases ---
-    int Ph_step_Powof2 = get_phase_step(Frequency, fclock);
-    GetCount_GetIndex(0, Ph_step_Powof2, 0, 0);
-    double freq_resolution = fclock * 1.0 / pow(2, 16);
-    double fout = (fclock * 1.0) / pow(2, 16);
-    fout = (Ph_step_Powof2 * fout);
-    no_of_samples = static_cast<int>(fclock / fout);
-    divider_corrected = static_cast<int>(round(divider * (fout * 1.0 / Frequency)));
-    if (divider_corrected > 65535) divider_corrected = 65535;
-    double clock_corrected = (timer_clock / divider_corrected) * 1.0;
-    double frequency_corrected = ((Ph_step_Powof2 * clock_corrected) / pow(2, 16)) * 1.0;
-    phase_step_final = static_cast<int>((fout * pow(2, 16)) / fclock);
-    timer_period = divider_corrected;
-    dds_array_length = intermediate_dds_count - 1;
-    if (DDS_Table[dds_array_length] == 0 && dds_array_length > 0) {
-        DDS_Table[dds_array_length] = DDS_Table[dds_array_length - 1];
-    }
-    const int MAX_TIMER_PERIOD = 65535;
-    const int MAX_SAMPLES = 512;
-    if (timer_period > MAX_TIMER_PERIOD) {
-        timer_period = MAX_TIMER_PERIOD;
-    }
-    if (no_of_samples > MAX_SAMPLES) {
-        no_of_samples = MAX_SAMPLES;
-    }
-    SetPeriodCmd[1] = static_cast<char>(timer_period / 256);
-    SetPeriodCmd[2] = static_cast<char>(timer_period % 256);
-    SamplesCmd[1] = static_cast<char>(no_of_samples / 256);
-    SamplesCmd[2] = static_cast<char>(no_of_samples % 256);
-}
-
 void MainWindow::openDDSFile() {
     QString fileName = QFileDialog::getOpenFileName(this, "Open CSV File", "C:/", "CSV files (*.csv)");
     if (!fileName.isEmpty()) {
@@ -2834,60 +3615,7 @@ void MainWindow::openDDSFile() {
 
 void MainWindow::readCSVFileToArray() {
     if (strFileName.isEmpty()) return;
-    QFile file(strFileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return;
-    QTextStream in(&file);
-    int x = 0;
-    while (!in.atEnd() && x < 256) {
-        QString line = in.readLine();
-        QStringList values = line.split(",");
-        if (!values.isEmpty()) {
-            arb_data[x] = static_cast<uint8_t>(values[0].toInt());
-            x++;
-        }
-    }
-    file.close();
-}
-
-void MainWindow::autoDetectAndConnectBoard() {
-    if (isConnected) {
-        // Stop the timer once connected
-        if (portScanTimer) {
-            portScanTimer->stop();
-        }
-        return;
-    }
-
-    const quint16 TARGET_VID = 0x03EB;
-    const quint16 TARGET_PID = 0x2404;
-    const auto ports = QSerialPortInfo::availablePorts();
-    QStringList portInfoList;
-
-    for (const QSerialPortInfo &port : ports) {
-        QString info = QString("%1 (VID: %2, PID: %3)")
-            .arg(port.portName())
-            .arg(port.vendorIdentifier(), 4, 16, QChar('0'))
-            .arg(port.productIdentifier(), 4, 16, QChar('0'));
-        portInfoList << info;
-        if (port.vendorIdentifier() == TARGET_VID && port.productIdentifier() == TARGET_PID) {
-            qDebug() << "Attempting to connect to port:" << port.portName()
-                     << "VID:" << QString::number(port.vendorIdentifier(), 16)
-                     << "PID:" << QString::number(port.productIdentifier(), 16);
-            showStatus(QString("Board detected, connecting to %1...").arg(port.portName()));
-            serialHandler->openPort(port.portName());
-            return;
-        }
-    }
-
-    // Only show available ports message once, not repeatedly
-    static bool portsMessageShown = false;
-    if (!portsMessageShown && !portInfoList.isEmpty()) {
-        showStatus(QString("Available ports: %1").arg(portInfoList.join(", ")));
-        portsMessageShown = true;
-    } else if (portInfoList.isEmpty() && !portsMessageShown) {
-        showStatus("No serial ports available");
-        portsMessageShown = true;
-    }
+    readDdsCsv(strFileName, arb_data);
 }
 
 void MainWindow::onRunDDSButtonClicked() {
@@ -2928,98 +3656,71 @@ void MainWindow::readScope() {
     // ...
 }
 
-bool MainWindow::checkTriggerCondition(const QVector<double>& ch1Data, const QVector<double>& ch2Data)
+void MainWindow::configureTrigger(TriggerEngine& engine, int viewLength) const
 {
-    // For Add/Overwrite modes, we want to trigger on any significant signal activity
-    // This makes the modes more practical and usable
-
-    // Determine which channel to check for trigger
+    bool onCh2 = (ch2TrigRadio && ch2TrigRadio->isChecked());
+    double gain = onCh2 ? ch2Gain : ch1Gain;
+    // Same level the trigger line is drawn at
+    double level = (trigLevel * 10.0 / 2048.0 - 10.0) / gain;
+    level = std::round(level * 100.0) / 100.0;
+    engine.setLevel(level);
+    engine.setHysteresis(TRIGGER_HYSTERESIS_VOLTS / gain);
+    engine.setSlope((hlTrigRadio && hlTrigRadio->isChecked()) ? TriggerEngine::Slope::Falling
+                                                              : TriggerEngine::Slope::Rising);
+    int prePercent = preTriggerSpin ? preTriggerSpin->value() : 10;
+    engine.setPreTrigger(viewLength * prePercent / 100);
+    engine.setHoldoff(holdoffSpin ? holdoffSpin->value() : 0);
+}
+
+bool MainWindow::checkTriggerCondition(QVector<double>& ch1Data, QVector<double>& ch2Data)
+{
+    // Auto free-runs and External is qualified by the hardware: show every frame
     const QVector<double>* triggerData = nullptr;
     if (ch1TrigRadio && ch1TrigRadio->isChecked()) {
         triggerData = &ch1Data;
     } else if (ch2TrigRadio && ch2TrigRadio->isChecked()) {
         triggerData = &ch2Data;
     } else {
-        // Auto trigger - check both channels, use the one with more activity
-        triggerData = &ch1Data; // Default to CH1 for auto
+        triggerViewStart = 0.0;
+        return !ch1Data.isEmpty() || !ch2Data.isEmpty();
     }
 
-    if (!triggerData || triggerData->isEmpty()) {
-        qDebug() << "[MainWindow] Trigger check: No data available";
+    if (triggerData->isEmpty()) {
+        qCDebug(lcFrame) << "[MainWindow] Trigger check: No data available";
         return false;
     }
 
-    // For Add/Overwrite modes, use a simpler trigger condition:
-    // Trigger if there's significant signal variation (not just noise)
-    double minVoltage = *std::min_element(triggerData->begin(), triggerData->end());
-    double maxVoltage = *std::max_element(triggerData->begin(), triggerData->end());
-    double signalRange = maxVoltage - minVoltage;
-
-    qDebug() << "[MainWindow] Trigger check - Signal range:" << minVoltage << "to" << maxVoltage << "V (range:" << signalRange << "V)";
-
-    // Trigger if signal has significant variation (more than 0.1V peak-to-peak)
-    // This ensures we capture meaningful signals, not just noise
-    if (signalRange > 0.1) {
-        qDebug() << "[MainWindow] Trigger condition met - significant signal variation detected";
-        return true;
-    } else {
-        qDebug() << "[MainWindow] Trigger condition not met - signal variation too small (" << signalRange << "V)";
+    // Edge search over the record, then cut every channel to the same
+    // interpolated window so the trigger sits at a fixed screen position
+    const int viewLength = qMax(2, int(triggerData->size() * TRIGGER_VIEW_FRACTION));
+    configureTrigger(triggerEngine, viewLength);
+    TriggerEngine::Event event;
+    if (!triggerEngine.alignRecords(*triggerData, viewLength, ch1Data, ch2Data, event)) {
+        qCDebug(lcFrame) << "[MainWindow] Trigger condition not met - no" << (hlTrigRadio && hlTrigRadio->isChecked() ? "falling" : "rising")
+                         << "edge through" << triggerEngine.level() << "V";
         return false;
     }
+    qCDebug(lcFrame) << "[MainWindow] Triggered at sample" << event.position;
+    triggerViewStart = event.position - triggerEngine.preTriggerSamples();
+    return true;
 }
 
-// Stub for measurement update
-void MainWindow::updateMeasurements(const QVector<double>& buffer, double sampleInterval,
+// Fills a set of measurement labels from the kernel's results
+void MainWindow::updateMeasurements(const ChannelMeasurements& m,
     QLabel* pkpkLabel, QLabel* freqLabel, QLabel* meanLabel, QLabel* ampLabel, QLabel* periodLabel, QLabel* maxLabel, QLabel* minLabel) {
     if (!pkpkLabel || !freqLabel || !meanLabel || !ampLabel || !periodLabel || !maxLabel || !minLabel) return;
-    if (buffer.isEmpty()) {
-        pkpkLabel->setText("-");
-        freqLabel->setText("-");
-        meanLabel->setText("-");
-        ampLabel->setText("-");
-        periodLabel->setText("-");
-        maxLabel->setText("-");
-        minLabel->setText("-");
-        return;
-    }
-    // Pk-Pk
-    double minV = *std::min_element(buffer.begin(), buffer.end());
-    double maxV = *std::max_element(buffer.begin(), buffer.end());
-    double pkpk = maxV - minV;
-    pkpkLabel->setText(QString::number(pkpk, 'f', 3));
-    // Mean
-    double mean = std::accumulate(buffer.begin(), buffer.end(), 0.0) / buffer.size();
-    meanLabel->setText(QString::number(mean, 'f', 3));
-    // Amplitude (half of Pk-Pk)
-    double amplitude = pkpk / 2.0;
-    ampLabel->setText(QString::number(amplitude, 'f', 3));
-    // Max/Min
-    maxLabel->setText(QString::number(maxV, 'f', 3));
-    minLabel->setText(QString::number(minV, 'f', 3));
-    // Frequency/Period (zero-crossing method, fallback to '-')
-    int n = buffer.size();
-    int lastCross = -1;
-    int crossings = 0;
-    double periodSum = 0.0;
-    for (int i = 1; i < n; ++i) {
-        if ((buffer[i-1] < mean && buffer[i] >= mean) || (buffer[i-1] > mean && buffer[i] <= mean)) {
-            if (lastCross >= 0) {
-                double period = (i - lastCross) * sampleInterval;
-                periodSum += period;
-                ++crossings;
-            }
-            lastCross = i;
-        }
-    }
-    if (crossings > 0) {
-        double avgPeriod = periodSum / crossings;
-        double freq = avgPeriod > 0 ? 1.0 / avgPeriod : 0.0;
-        periodLabel->setText(QString::number(avgPeriod, 'g', 6));
-        freqLabel->setText(QString::number(freq, 'g', 6));
-    } else {
-        periodLabel->setText("-");
-        freqLabel->setText("-");
-    }
+    // Hidden labels are not worth formatting
+    auto show = [](QLabel* label, bool valid, double value, char format, int precision) {
+        if (!label->isVisible()) return;
+        label->setText(valid ? QString::number(value, format, precision) : QString("-"));
+    };
+    show(pkpkLabel, m.valid, m.pkpk, 'f', 3);
+    show(meanLabel, m.valid, m.mean, 'f', 3);
+    show(ampLabel, m.valid, m.amplitude, 'f', 3);
+    show(maxLabel, m.valid, m.max, 'f', 3);
+    show(minLabel, m.valid, m.min, 'f', 3);
+    show(periodLabel, m.periodic, m.period, 'g', 6);
+    show(freqLabel, m.periodic, m.frequency, 'g', 6);
 }
 
 // Function to set maximum data length for longer x-axis
@@ -3044,13 +3745,9 @@ double MainWindow::getYAxisRangeFromGain(double gain) const {
 
 void MainWindow::setupScope() {
     setTriggerMode();
-    QThread::msleep(20);
     selectMode();
-    QThread::msleep(20);
     computeOffsetTrigger();
-    QThread::msleep(20);
     setGainBits();
-    QThread::msleep(20);
     setSampleRate();
     firstRun = false;
 }
@@ -3192,21 +3889,10 @@ void MainWindow::applyMeasurementVisibility() {
     if (floatingMinLabel) floatingMinLabel->setVisible(currentMeasVisible.value(6, true));
 }
 
-void MainWindow::updateFloatingMeasurements(const QVector<double>& buffer, double sampleInterval) {
+void MainWindow::updateFloatingMeasurements(const ChannelMeasurements& m) {
     if (!floatingPkpkLabel || !floatingFreqLabel || !floatingMeanLabel || !floatingAmpLabel ||
         !floatingPeriodLabel || !floatingMaxLabel || !floatingMinLabel) return;
 
-    if (buffer.isEmpty()) {
-        floatingPkpkLabel->setText("-");
-        floatingFreqLabel->setText("-");
-        floatingMeanLabel->setText("-");
-        floatingAmpLabel->setText("-");
-        floatingPeriodLabel->setText("-");
-        floatingMaxLabel->setText("-");
-        floatingMinLabel->setText("-");
-        return;
-    }
-
     // Update channel label and color based on current display channel
     if (floatingMeasBox) {
         QWidget* header = floatingMeasBox->findChild<QWidget*>();
@@ -3255,96 +3941,13 @@ void MainWindow::updateFloatingMeasurements(const QVector<double>& buffer, doubl
         }
     }
 
-    // Calculate measurements
-    double minV = *std::min_element(buffer.begin(), buffer.end());
-    double maxV = *std::max_element(buffer.begin(), buffer.end());
-    double pkpk = maxV - minV;
-    double mean = std::accumulate(buffer.begin(), buffer.end(), 0.0) / buffer.size();
-    double amplitude = pkpk / 2.0;
-
-    // Update labels
-    floatingPkpkLabel->setText(QString::number(pkpk, 'f', 3));
-    floatingMeanLabel->setText(QString::number(mean, 'f', 3));
-    floatingAmpLabel->setText(QString::number(amplitude, 'f', 3));
-    floatingMaxLabel->setText(QString::number(maxV, 'f', 3));
-    floatingMinLabel->setText(QString::number(minV, 'f', 3));
-
-    // Frequency/Period calculation
-    int n = buffer.size();
-    int lastCross = -1;
-    int crossings = 0;
-    double periodSum = 0.0;
-    for (int i = 1; i < n; ++i) {
-        if ((buffer[i-1] < mean && buffer[i] >= mean) || (buffer[i-1] > mean && buffer[i] <= mean)) {
-            if (lastCross >= 0) {
-                double period = (i - lastCross) * sampleInterval;
-                periodSum += period;
-                ++crossings;
-            }
-            lastCross = i;
-        }
-    }
-    if (crossings > 0) {
-        double avgPeriod = periodSum / crossings;
-        double freq = avgPeriod > 0 ? 1.0 / avgPeriod : 0.0;
-        floatingPeriodLabel->setText(QString::number(avgPeriod, 'g', 6));
-        floatingFreqLabel->setText(QString::number(freq, 'g', 6));
-    } else {
-        floatingPeriodLabel->setText("-");
-        floatingFreqLabel->setText("-");
-    }
+    updateMeasurements(m, floatingPkpkLabel, floatingFreqLabel, floatingMeanLabel, floatingAmpLabel,
+                       floatingPeriodLabel, floatingMaxLabel, floatingMinLabel);
 }
 
-// Digital Frequency Generator logic (VB.NET style)
 void MainWindow::setDigitalFrequency(int dig_freq)
 {
-    int dig_divider = 1;
-    int dig_index = 0;
-    int dig_count = (32 * 1000000) / dig_freq; // 32 MHz clock
-
-    if (dig_count > 65535) {
-        dig_divider = 2;
-        dig_count /= 2;
-        dig_index = 1;
-        if (dig_count > 65535) {
-            dig_divider = 4;
-            dig_count /= 2;
-            dig_index = 2;
-            if (dig_count > 65535) {
-                dig_divider = 8;
-                dig_count /= 2;
-                dig_index = 3;
-                if (dig_count > 65535) {
-                    dig_divider = 64;
-                    dig_count /= 8;
-                    dig_index = 4;
-                    if (dig_count > 65535) {
-                        dig_divider = 256;
-                        dig_count /= 4;
-                        dig_index = 5;
-                        if (dig_count > 65535) {
-                            dig_divider = 1024;
-                            dig_count /= 4;
-                            dig_index = 6;
-                        }
-                    }
-                }
-            }
-        }
-    }
-
-    QByteArray setDigCountCmd = QByteArray::fromHex("630000");
-    setDigCountCmd[1] = static_cast<char>(dig_count / 256);
-    setDigCountCmd[2] = static_cast<char>(dig_count % 256);
-
-    QByteArray setDigIndexCmd = QByteArray::fromHex("640000");
-    setDigIndexCmd[1] = static_cast<char>(dig_index);
-
-    if (serialHandler) {
-        serialHandler->sendCommand(setDigCountCmd);
-        QThread::msleep(30);
-        serialHandler->sendCommand(setDigIndexCmd);
-    }
+    if (digitalIO) digitalIO->runDigitalFreq(dig_freq);
 }
 
 // --- Add/Overwrite Functionality Implementation ---
@@ -3354,9 +3957,8 @@ void MainWindow::setDigitalFrequency(int dig_freq)
 void MainWindow::resetTraceCollection() {
     qDebug() << "[MainWindow] Resetting trace collection";
 
-    // Clear collected traces
-    collectedTracesCh1.clear();
-    collectedTracesCh2.clear();
+    // Empty the pool; its storage is kept for the next set
+    tracePool.clear();
     currentTraceCount = 0;
     isCollectingTraces = false;
 
@@ -3371,175 +3973,66 @@ void MainWindow::updateTraceProgress() {
     qDebug() << "[MainWindow]" << status;
 }
 
+void MainWindow::collectTrace(const QVector<double>& ch1, const QVector<double>& ch2) {
+    if (!isCollectingTraces) {
+        // Sized once per set; a set of the same shape reuses the arena
+        tracePool.reserve(targetTraceCount, qMax(ch1.size(), ch2.size()));
+        isCollectingTraces = true;
+    }
+    tracePool.append(ch1, ch2);
+    currentTraceCount = tracePool.count();
+    updateTraceProgress();
+    if (tracePool.isFull()) processCollectedTraces();
+}
+
 void MainWindow::processCollectedTraces() {
-    qDebug() << "[MainWindow] Processing" << collectedTracesCh1.size() << "collected traces for 400-point display";
+    qDebug() << "[MainWindow] Processing" << tracePool.count() << "collected traces of" << tracePool.traceLength() << "points";
 
-    if (collectedTracesCh1.isEmpty() || collectedTracesCh2.isEmpty()) {
+    if (tracePool.isEmpty()) {
         qDebug() << "[MainWindow] No traces to process";
         resetTraceCollection();
         return;
     }
 
-    // Calculate total points
-    int totalPoints = 0;
-    for (int i = 0; i < collectedTracesCh1.size(); ++i) {
-        totalPoints += collectedTracesCh1[i].size();
+    // Buffers for measurements and export hold the traces end to end
+    tracePool.concatenate(0, ch1Buffer);
+    tracePool.concatenate(1, ch2Buffer);
+    const int N = qMax(ch1Buffer.size(), ch2Buffer.size());
+    timeBuffer.resize(N);
+    for (int i = 0; i < N; ++i) {
+        timeBuffer[i] = i * multiplier;
     }
-    qDebug() << "[MainWindow] Total points collected:" << totalPoints;
 
     if (overwriteRadio && overwriteRadio->isChecked()) {
-        // Overwrite mode: concatenate all traces into one long trace (400 points)
-        qDebug() << "[MainWindow] Processing Overwrite mode - concatenating traces for 400 points";
-
-        QVector<double> ch1Concat, ch2Concat;
-
-        // Concatenate all traces
-        for (int i = 0; i < collectedTracesCh1.size(); ++i) {
-            ch1Concat += collectedTracesCh1[i];
-            ch2Concat += collectedTracesCh2[i];
-        }
-
-        // Create time axis for concatenated data (400 points)
-        int N = ch1Concat.size();
-        QVector<double> x(N);
-        for (int i = 0; i < N; ++i) {
-            x[i] = i * multiplier;
-        }
-
-        // Plot concatenated data
+        // Overwrite mode: concatenate all traces into one long trace
         plotManager->setMode(acquisitionMode);
-        plotManager->updateWaveform(ch1Concat, ch2Concat);
-
-        // Update buffers
-        ch1Buffer = ch1Concat;
-        ch2Buffer = ch2Concat;
-        timeBuffer = x;
-
+        plotManager->updateWaveform(ch1Buffer, ch2Buffer);
         qDebug() << "[MainWindow] Overwrite mode: Plotted concatenated trace with" << N << "points";
-        showStatus(QString("Overwrite: %1 traces concatenated (%2 points total) - Run #%3").arg(collectedTracesCh1.size()).arg(N).arg(runCount));
+        showStatus(QString("Overwrite: %1 traces concatenated (%2 points total) - Run #%3").arg(tracePool.count()).arg(N).arg(runCount));
 
     } else if (addRadio && addRadio->isChecked()) {
-        // Add mode: overlay all traces for comparison (400 points total)
-        qDebug() << "[MainWindow] Processing Add mode - overlaying traces for 400 points";
-
-        // Use PlotManager's multiple trace functionality
-        plotManager->updateWaveformWithMultipleTraces(collectedTracesCh1, collectedTracesCh2);
-
-        // Update buffers with concatenated data for measurements (400 points)
-        QVector<double> ch1Concat, ch2Concat;
-        for (int i = 0; i < collectedTracesCh1.size(); ++i) {
-            ch1Concat += collectedTracesCh1[i];
-            ch2Concat += collectedTracesCh2[i];
-        }
-
-        ch1Buffer = ch1Concat;
-        ch2Buffer = ch2Concat;
-        timeBuffer.resize(ch1Buffer.size());
-        for (int i = 0; i < timeBuffer.size(); ++i) {
-            timeBuffer[i] = i * multiplier;
-        }
-
-        qDebug() << "[MainWindow] Add mode: Plotted" << collectedTracesCh1.size() << "overlaid traces (" << ch1Buffer.size() << " points total)";
-        showStatus(QString("Add: %1 traces overlaid (%2 points total) - Run #%3").arg(collectedTracesCh1.size()).arg(ch1Buffer.size()).arg(runCount));
+        // Add mode: overlay all traces as one intensity-graded layer
+        plotManager->updateTraceIntensity(tracePool);
+        qDebug() << "[MainWindow] Add mode: Plotted" << tracePool.count() << "overlaid traces (" << N << " points total)";
+        showStatus(QString("Add: %1 traces overlaid (%2 points total) - Run #%3").arg(tracePool.count()).arg(N).arg(runCount));
     }
 
-    // Reset collection state for next acquisition
+    // Reset collection state; the caller re-arms for the next set
     resetTraceCollection();
-
-    // For Add/Overwrite modes, continue running to collect more 400-point acquisitions
-    if (isRunning && isConnected) {
-        qDebug() << "[MainWindow] Continuing Add/Overwrite acquisition for next 400-point set";
-        // Start next acquisition cycle
-        QTimer::singleShot(100, this, [this]() {
-            if (isRunning && isConnected) {
-                int serialMode = (acquisitionMode == 0) ? 1 : (acquisitionMode + 1);
-                bool serialDualChannel = (acquisitionMode == 0);
-                serialHandler->startOscilloscopeAcquisition(serialMode, 200, serialDualChannel);
-            }
-        });
-    }
-}
-
-// Helper: Find best sample rate index for a given frequency (at least 20x)
-static int findSampleRateIndex(double freq) {
-    static const double sampleRates[] = {
-        2000000, 1000000, 500000, 200000, 100000, 50000, 20000, 10000, 5000, 2000, 1000, 500, 200, 100
-    };
-    for (int i = 13; i >= 0; --i) { // Start from slowest
-        if (sampleRates[i] > 9 * freq) {
-            return i;
-        }
-    }
-    return 0; // If none are > 9x, use the fastest
-}
-
-// Helper: Find local maxima/minima and their averages
-static void findLocalExtrema(const QVector<double>& data, double& avgMax, double& avgMin) {
-    QVector<double> maxs, mins;
-    int N = data.size();
-    for (int i = 1; i < N - 1; ++i) {
-        if (data[i] > data[i-1] && data[i] > data[i+1]) maxs.append(data[i]);
-        if (data[i] < data[i-1] && data[i] < data[i+1]) mins.append(data[i]);
-    }
-    avgMax = maxs.isEmpty() ? 0.0 : std::accumulate(maxs.begin(), maxs.end(), 0.0) / maxs.size();
-    avgMin = mins.isEmpty() ? 0.0 : std::accumulate(mins.begin(), mins.end(), 0.0) / mins.size();
 }
 
 // --- TRIGGER SYSTEM: VB.NET LOGIC PORT ---
+// Checks the level and draws the trigger line. The T/P/L commands go out
+// with setProtocolParams, in the setup sequence before the next capture,
+// and only when they changed
 void MainWindow::setTriggerMode() {
-    // --- VB.NET LOGIC PORT ---
-    // 1. Trigger Mode Selection
-    QByteArray trigSourceCmd;
-    trigSourceCmd.append((char)0x54); // 'T'
-    if (autoTrigRadio && autoTrigRadio->isChecked()) {
-        trigSourceCmd.append((char)0x00); // Auto
-    } else if (ch1TrigRadio && ch1TrigRadio->isChecked()) {
-        trigSourceCmd.append((char)0x01); // CH1
-    } else if (ch2TrigRadio && ch2TrigRadio->isChecked()) {
-        trigSourceCmd.append((char)0x02); // CH2
-    } else if (extTrigRadio && extTrigRadio->isChecked()) {
-        trigSourceCmd.append((char)0x03); // Ext
-    } else {
-        trigSourceCmd.append((char)0x00); // Default to Auto
-    }
-    trigSourceCmd.append((char)0x00);
-    serialHandler->sendCommand(trigSourceCmd);
-    QThread::msleep(20);
-
-    // 2. Trigger Polarity Setting
-    QByteArray trigPolarityCmd;
-    trigPolarityCmd.append((char)0x50); // 'P'
-    if (hlTrigRadio && hlTrigRadio->isChecked()) {
-        trigPolarityCmd.append((char)0x01); // H->L
-    } else if (lhTrigRadio && lhTrigRadio->isChecked()) {
-        trigPolarityCmd.append((char)0x00); // L->H
-    } else {
-        trigPolarityCmd.append((char)0x00); // Default L->H
-    }
-    trigPolarityCmd.append((char)0x00);
-    serialHandler->sendCommand(trigPolarityCmd);
-    QThread::msleep(20);
-
-    // 3. Trigger Level Calculation and Command (12-bit DAC, msb/lsb split)
     double gain = 1.0;
     if (ch1TrigRadio && ch1TrigRadio->isChecked()) gain = ch1Gain;
     else if (ch2TrigRadio && ch2TrigRadio->isChecked()) gain = ch2Gain;
     else gain = 1.0;
     int trigLevelValue = trigLevel; // 0-4095 from slider
-    // VB.NET: Trig_For_Up = 2048 + ((Ch1_Trig - 2048) / Gain) / (4 / 3)
-    int trigForUp = 2048 + static_cast<int>(((trigLevelValue - 2048) / gain) / (4.0 / 3.0));
-    if (trigForUp < 0) trigForUp = 0;
-    if (trigForUp > 4095) trigForUp = 4095;
-    int msb8 = trigForUp / 16;
-    int lsb4 = (trigForUp - msb8 * 16) * 16;
-    QByteArray setTrigValue;
-    setTrigValue.append((char)0x4C); // 'L'
-    setTrigValue.append((char)msb8);
-    setTrigValue.append((char)lsb4);
-    serialHandler->sendCommand(setTrigValue);
-    QThread::msleep(20);
-
-    // 4. Trigger Level Validation (show warning if out of range)
+
+    // Trigger Level Validation (show warning if out of range)
     double trigLine = (trigLevelValue * 10.0 / 2048.0 - 10.0) / gain;
     trigLine = std::round(trigLine * 100.0) / 100.0;
     double waveformMin = 0, waveformMax = 0;
@@ -3547,15 +4040,17 @@ void MainWindow::setTriggerMode() {
     if (ch1TrigRadio && ch1TrigRadio->isChecked() && !ch1Buffer.isEmpty()) signalData = &ch1Buffer;
     else if (ch2TrigRadio && ch2TrigRadio->isChecked() && !ch2Buffer.isEmpty()) signalData = &ch2Buffer;
     if (signalData) {
-        waveformMin = *std::min_element(signalData->begin(), signalData->end());
-        waveformMax = *std::max_element(signalData->begin(), signalData->end());
+        auto extremes = std::minmax_element(signalData->begin(), signalData->end());
+        waveformMin = *extremes.first;
+        waveformMax = *extremes.second;
         if (trigLine > waveformMax || trigLine < waveformMin) {
             QMessageBox::warning(this, "Error", "Trigger level is outside signal range. Turning OFF Trigger.");
             if (autoTrigRadio) autoTrigRadio->setChecked(true);
+            trigSource = 0; // setChecked does not emit idClicked
         }
     }
 
-    // 5. Trigger Line Drawing (on plot)
+    // Trigger Line Drawing (on plot)
     if (plotManager) {
         bool triggerOnCh2 = (ch2TrigRadio && ch2TrigRadio->isChecked());
         plotManager->updateTriggerLevel(trigLine, triggerOnCh2);
@@ -1,6 +1,5 @@
 #pragma once
 #include <QMainWindow>
-#include <QSerialPortInfo>
 #include <QTimer>
 #include <QTabWidget>
 #include <QPushButton>
@@ -18,12 +17,24 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include "qcustomplot.h"
+#include "FFTEngine.h"
+#include "AdcDecoder.h"
+#include "TriggerEngine.h"
+#include "MeasurementKernel.h"
+#include "CaptureFile.h"
+#include "BodeSweep.h"
+#include "AutoSetup.h"
+#include "DdsTable.h"
+#include "TracePool.h"
+#include "DspWorker.h"
+#include "AcquisitionManager.h"
 #include <QElapsedTimer>
 #include <QDoubleSpinBox>
 #include <QRadioButton>
 #include <QListWidget>
 #include <QProgressBar>
 #include <QButtonGroup>
+#include <QHash>
 #include <QDialog>
 #include <QToolButton>
 #include <QMouseEvent>
@@ -43,19 +54,23 @@ private:
 };
 
 class SerialHandler;
+class QThread;
 class PlotManager;
 class DDSGenerator;
 class DigitalIO;
+class FrameRecorder;
 class WaveformExporter;
+class PortWatcher;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
-    void GetCount_GetIndex(int phase_accumulator, int phase_step, int dds_index, int dds_count);
-    int get_phase_step(int frequency, int fclock);
-    int nextPowerOf2(int n);
+
+protected:
+    // Forwards the OS's device change notifications to the port watcher
+    bool nativeEvent(const QByteArray& eventType, void* message, qintptr* result) override;
 
 private slots:
     // Serial communication
@@ -63,15 +78,41 @@ private slots:
     void handleSerialConnectionStatus(bool connected);
     void handleSerialPortError(const QString &error);
     void handleSerialData(const QByteArray &data);
-    void updateSerialPortList();
+    // From the port watcher: refreshes the port list and connects to a board that appeared
+    void onPortsChanged(const QStringList& ports, const QStringList& boardPorts);
     
     // Oscilloscope controls
     void onRunClicked();
     void onStopClicked();
     void onAbortClicked();
+    // Auto-set: picks time base, gains, offsets and trigger from a few captures
+    void onAutoSetClicked();
     void onExportCSV();
+    void onRecordToggled(bool checked);
+    void onFrameRecordToggled(bool checked);
+    void onOpenCapture();
     void onModeChanged(int index);
     void onSampleRateChanged(int index);
+    void onFFTWindowChanged(int index);
+    void onPersistenceChanged(int index);
+    // Spectrum mode: applies the analyser controls on the DSP worker
+    void onSpectrumSettingsChanged();
+    void onSpectrumReady();
+    // Protocol decoding: applies the bus controls on the DSP worker
+    void onDecodeSettingsChanged();
+    void onAnnotationsReady();
+    void onExportDecodedClicked();
+    // Mask testing on the DSP worker
+    void onMaskTestToggled(bool checked);
+    void onMaskLearnClicked();
+    void onMaskLearned();
+    void onMaskLoadClicked();
+    void onMaskSaveClicked();
+    void onMaskOptionsChanged();
+    void onMaskSaveFailuresToggled(bool checked);
+    void onMaskHalted();
+    void updateMaskStatus();
+    void syncDspSettings();
     
     // Channel controls
     void onCh1GainChanged(int idx);
@@ -117,9 +158,11 @@ private slots:
     
     // Plot and display
     void updatePlot();
-    void onOscilloscopeData(const QVector<double>& ch1, const QVector<double>& ch2, const QVector<double>& xvals);
     void requestOscilloscopeData();
-    void onOscilloscopeRawDataReady(const QByteArray &ch1, const QByteArray &ch2, int dataLength, bool dualChannel);
+    void onFramesAvailable();
+    void onHistoryAvailable();
+    void plotRollWindow();
+    void onOscilloscopeFrame(const DecodedFrame& frame);
     
     // Utility
     void onSerialError(const QString &msg);
@@ -131,25 +174,57 @@ private slots:
     void onWaveformSelectionChanged(int index);
     void onRunDDSButtonClicked();
 
-    void autoDetectAndConnectBoard();
-
-    void updateMeasurements(const QVector<double>& buffer, double sampleInterval,
+    void updateMeasurements(const ChannelMeasurements& m,
         QLabel* pkpkLabel, QLabel* freqLabel, QLabel* meanLabel, QLabel* ampLabel, QLabel* periodLabel, QLabel* maxLabel, QLabel* minLabel);
-    void updateFloatingMeasurements(const QVector<double>& buffer, double sampleInterval);
+    void updateFloatingMeasurements(const ChannelMeasurements& m);
+    // Per-stage latency and frame rate overlay on the plot
+    void updatePerfOverlay();
+    QPushButton* perfOverlayBtn = nullptr;
+    QComboBox* logVerbosityCombo = nullptr;
+    QLabel* perfOverlay = nullptr;
+    QTimer* perfOverlayTimer = nullptr;
+    QElapsedTimer perfOverlayClock;
+    quint64 perfLastAcquired = 0, perfLastDisplayed = 0;
+    // Binary capture recording and read-back
+    CaptureInfo currentCaptureInfo() const;
+    CaptureFileWriter* captureWriter = nullptr;
+    // Every acquired frame, raw, with settings snapshots
+    FrameRecorder* frameRecorder = nullptr;
+    QTimer* frameRecordStatusTimer = nullptr;
+    // Mask test: the mask shown and sent to the DSP worker, and where its
+    // failing frames are recorded
+    WaveformMask mask;
+    MaskAlignment sentMaskAlignment;
+    FrameRecorder* maskFailRecorder = nullptr;
+    QTimer* maskStatusTimer = nullptr;
+    CaptureFileReader captureReader;
+    bool viewingCapture = false; // plot shows a file, not the device
+    // One kernel per channel so each keeps its own edge reference
+    MeasurementKernel ch1Meter, ch2Meter;
+    ChannelMeasurements ch1Measurements, ch2Measurements;
 
     // Add/Overwrite functionality
     void resetTraceCollection();
     void updateTraceProgress();
     void processCollectedTraces();
+    void collectTrace(const QVector<double>& ch1, const QVector<double>& ch2);
 
 private:
     void setupUi();
     void setupConnections();
     void updateUiState();
+    void updateStreamingState();
+    // Arms the next capture unless SerialHandler streams them
+    void rearmAcquisition();
+    // Adds bus events to the export log and the list on the Digital tab
+    void appendDecodeEvents(const QVector<ProtocolAnnotation>& events);
+    // The display's trigger settings, for cutting frames before the mask test
+    MaskAlignment currentMaskAlignment() const;
+    // After an auto-connected board failed to open
+    void retryAutoConnect();
     void showStatus(const QString &msg);
     void processOscilloscopeData(const QByteArray &data);
     void performFFT(const QVector<double>& input, QVector<double>& output);
-    void averageData();
     void createSweepArray();
     void sendDDSCommand();
     void sendDigitalCommand();
@@ -161,27 +236,70 @@ private:
     void sendSampleRateCommand();
     
     // Sweep helper functions
-    void createSweepFrequencyArray();
     void setDDSForSweep();
+    void captureSweepPoint();
+    void handleSweepCapture(const QVector<double>& input, const QVector<double>& output);
     void stopSweep();
-    void plotBodePlot();
+
+    // Auto-set helper functions
+    void captureAutoSetupStep();
+    void handleAutoSetupCapture(qint64 timestampNs, const QVector<double>& ch1, const QVector<double>& ch2);
+    // Puts settings on the controls, which only touches what differs
+    void applyAutoSetupSettings(const AutoSetupSettings& settings);
+    // Apply takes the result, KeepCurrent the settings reached so far with
+    // the trigger left alone, Cancel goes back to where it started
+    enum class AutoSetupEnd { Cancel, Apply, KeepCurrent };
+    void finishAutoSetup(AutoSetupEnd end);
+    void plotBodePlot(const QVector<BodeSweep::Point>& points);
     void createTestBodePlot(); // For testing Bode plot functionality
     
-    // Waveform tables (from VB.NET)
-    void initializeWaveformTables();
-    QVector<uint8_t> sinTable, squareTable, triangleTable, rampUpTable, rampDownTable;
-    
     // UI widgets - Serial Connection
     QComboBox *serialPortCombo;
+    QComboBox *linkSpeedCombo = nullptr;
     QPushButton *connectButton;
     QLabel *statusLabel;
     
     // UI widgets - Oscilloscope Controls
     QPushButton *runBtn, *stopBtn, *abortBtn, *exportBtn;
+    QPushButton *autoSetBtn = nullptr;
     QComboBox *modeCombo, *sampleRateCombo;
     QRadioButton *bothChRadio, *ch1Radio, *ch2Radio, *xyRadio, *fftCh1Radio, *fftCh2Radio;
     QRadioButton *fftBothRadio; // NEW: for FFT Both CH1 & CH2
     QRadioButton *continuousRadio, *overwriteRadio, *addRadio;
+    QRadioButton *rollRadio = nullptr;
+    QPushButton *recordBtn = nullptr;
+    QPushButton *openCaptureBtn = nullptr;
+    QPushButton *frameRecordBtn = nullptr;
+    QCheckBox *frameCompressCheckBox = nullptr;
+    QComboBox *fftWindowCombo = nullptr;
+    QComboBox *persistenceCombo = nullptr;
+    QRadioButton *spectrumRadio = nullptr;
+    QComboBox *spectrumSizeCombo = nullptr;
+    QComboBox *spectrumOverlapCombo = nullptr;
+    QComboBox *spectrumAveragingCombo = nullptr;
+    QCheckBox *spectrumPeakHoldCheckBox = nullptr;
+    QComboBox *spectrumZoomCombo = nullptr;
+    QDoubleSpinBox *spectrumCenterSpin = nullptr;
+    QComboBox *decodeProtocolCombo = nullptr;
+    QComboBox *decodeSourceCombo = nullptr;
+    QSpinBox *decodeLineSpins[4] = {nullptr, nullptr, nullptr, nullptr};
+    QLabel *decodeLineLabels[4] = {nullptr, nullptr, nullptr, nullptr};
+    QSpinBox *decodeBaudSpin = nullptr;
+    QComboBox *decodeParityCombo = nullptr;
+    QComboBox *decodeSpiModeCombo = nullptr;
+    QDoubleSpinBox *decodeThresholdSpin = nullptr;
+    QListWidget *decodeLogList = nullptr;
+    QCheckBox *maskTestCheckBox = nullptr;
+    QSpinBox *maskLearnSpin = nullptr;
+    QDoubleSpinBox *maskMarginSpin = nullptr;
+    QSpinBox *maskMarginSamplesSpin = nullptr;
+    QCheckBox *maskStopOnFailCheckBox = nullptr;
+    QPushButton *maskSaveFailuresBtn = nullptr;
+    QLabel *maskStatusLabel = nullptr;
+    QComboBox *ch1LowPassCombo = nullptr;
+    QComboBox *ch2LowPassCombo = nullptr;
+    QComboBox *ch1AverageCombo = nullptr;
+    QComboBox *ch2AverageCombo = nullptr;
     
     // UI widgets - Channel Controls
     QButtonGroup* ch1GainGroup = nullptr;
@@ -192,6 +310,8 @@ private:
     QLineEdit *ch1OffsetEdit, *ch2OffsetEdit, *trigLevelEdit;
     QRadioButton *autoTrigRadio, *ch1TrigRadio, *ch2TrigRadio, *extTrigRadio;
     QRadioButton *lhTrigRadio, *hlTrigRadio;
+    QSpinBox *preTriggerSpin = nullptr; // % of the triggered view before the trigger
+    QSpinBox *holdoffSpin = nullptr;    // samples
     
     // UI widgets - DDS Signal Generator
     QComboBox *ddsWaveformCombo;
@@ -203,6 +323,7 @@ private:
     QPushButton *digitalOutButtons[4];
     QLabel *digitalInLabels[4];
     QPushButton *readDigitalBtn;
+    QSpinBox *digitalPollSpin = nullptr; // input poll interval, 0 = off
     
     // UI widgets - Digital Frequency Generator
     QDoubleSpinBox *digFreqSpin;
@@ -212,6 +333,8 @@ private:
     // UI widgets - Sweep
     QDoubleSpinBox *sweepStartSpin, *sweepEndSpin;
     QSpinBox *sweepSamplesSpin, *sweepDelaySpin;
+    QCheckBox *sweepAdaptiveCheckBox = nullptr; // refine around features, steps = point budget
+    QSpinBox *sweepTimeBudgetSpin = nullptr;    // adaptive refinement time limit, 0 = none
     QPushButton *sweepStartBtn, *stopSweepBtn;
     QProgressBar *sweepProgress;
     
@@ -227,9 +350,12 @@ private:
     
     // Data buffers
     QVector<double> ch1Buffer, ch2Buffer, timeBuffer;
+    AdcDecoder adcDecoder;
     
     // FFT buffers
     QVector<double> ch1FFT, ch2FFT, freqBuffer;
+    FFTEngine fftEngine;
+    FFTEngine::Window fftWindow = FFTEngine::Window::Rectangular;
     
     // Accumulated data for overwrite mode
     QVector<double> accumulatedCh1, accumulatedCh2, accumulatedTime;
@@ -265,19 +391,20 @@ private:
     double ddsFrequency = 1000.0;
     double digFrequency = 10000.0;
     double sweepStartFreq = 100.0, sweepEndFreq = 10000.0;
-    int sweepSamples = 100, sweepDelay = 100;
-    int sweepIndex = 0;
-    
-    // Sweep data storage for Bode plot
-    QVector<double> sweepFrequencies;
-    QVector<double> sweepAmplitudes;
-    QVector<double> sweepPhases;
-    QVector<double> sweepMagnitudes; // in dB
-    // Add these for storing input/output waveforms for each sweep frequency
-    QVector<QVector<double>> sweepInputWaves;
-    QVector<QVector<double>> sweepOutputWaves;
-    
-    quint8 digitalOutState = 0;
+    int sweepSamples = 100, sweepDelay = 20;
+    
+    // Bode sweep: per-point gain/phase only, no stored waveforms
+    BodeSweep bodeSweep;
+    int sweepRateIndex = 0;       // UI sample-rate index of the current point
+    double sweepSampleRate = 0.0; // Sa/s of the current point
+
+    // Auto-set drives its own captures, like the sweep
+    AutoSetup autoSetup;
+    bool autoSetupRunning = false;
+    bool autoSetupResume = false;      // was running before, so runs again after
+    qint64 autoSetupArmedNs = 0;       // frames finished before this are stale
+    QTimer* autoSetupTimer = nullptr;  // gives up on a capture that never comes
+    
     QString studentName = "Student";
     QString deviceSignature = "12345";
     
@@ -287,29 +414,49 @@ private:
     
     // Managers
     SerialHandler *serialHandler;
+    QThread *acquisitionThread = nullptr;
+    QThread *dspThread = nullptr;
+    DspWorker *dspWorker = nullptr; // lives on dspThread
+    AcquisitionManager *acquisitionManager = nullptr; // every further board on the bench
+    qint64 lastFrameTimestampNs = 0; // acquisition clock of the primary's last frame
+    QVector<double> frameCh1, frameCh2; // working copies of the frame being processed
+    bool drainingFrames = false;
+    bool redrainFrames = false;
+    bool streamingActive = false; // SerialHandler re-arms captures itself
+    bool rollActive = false;      // Plotting a window of the capture history
+    bool rollDirty = false;
+    bool spectrumMode = false;    // Frames feed the DSP worker's analyser, not the plot
+    SpectrumSnapshot spectrumView;
+    // Protocol decoding
+    QVector<BusConfig> decodeBuses;          // as last sent to the DSP worker
+    QVector<ProtocolAnnotation> decodeEvents; // exported by onExportDecodedClicked
+    QVector<ProtocolAnnotation> streamOverlay; // analog stream events still in the history
+    QVector<ProtocolAnnotation> annotationScratch;
+    double triggerViewStart = 0.0; // sample of the last frame at the left edge of the view
     PlotManager *plotManager;
     DDSGenerator *ddsGenerator;
     DigitalIO *digitalIO;
     WaveformExporter *waveformExporter;
 
     // DDS Signal Output Data Members
-    QVector<uint8_t> DDS_Waveform;
-    QVector<uint8_t> DDS_Table;
+    QVector<uint8_t> DDS_Waveform; // selected waveform, one period
     QVector<uint8_t> arb_data;
-    QByteArray SetPeriodCmd;
-    QByteArray SamplesCmd;
-    QByteArray DDS_OutCmd;
-    QByteArray RunDDSCmd;
     int Frequency;
-    int divider, timer_clock, fclock, Ph_step_Powof2, intermediate_dds_count, debug_dds_index, dds_array_length, no_of_samples, divider_corrected, phase_step_final, timer_period;
     QString strFileName;
+    // Computed DDS commands keyed by (waveform index << 32 | frequency), so
+    // revisiting a setting (e.g. during a sweep) skips the table rebuild
+    QHash<quint64, DdsUpload> ddsCache;
+    int sweepSettleMs = -1; // >= 0 while a sweep step waits for its DDS upload
     // DDS Signal Output Helper Functions
-    void setFrequency();
     void runDDS();
     void openDDSFile();
     void readCSVFileToArray();
 
-    QTimer *portScanTimer;
+    PortWatcher *portWatcher = nullptr; // lives on portThread
+    QThread *portThread = nullptr;
+    QStringList boardPortsSeen; // of the last scan; only a new first one is auto-connected
+    QString autoConnectPort;    // board being auto-connected, until it opens or is given up
+    int autoConnectAttempts = 0;
     QTimer *plotRateLimitTimer;
     QString lastConnectedPort;
 
@@ -348,8 +495,17 @@ private:
     // Helper function to get Y-axis range from gain setting
     double getYAxisRangeFromGain(double gain) const;
     
-    // Trigger condition checking
-    bool checkTriggerCondition(const QVector<double>& ch1Data, const QVector<double>& ch2Data);
+    // Trigger condition checking; on a hit both channels are cut down to the
+    // trigger-aligned view
+    bool checkTriggerCondition(QVector<double>& ch1Data, QVector<double>& ch2Data);
+    void configureTrigger(TriggerEngine& engine, int viewLength) const;
+    bool plotTriggeredHistory();
+    TriggerEngine triggerEngine;
+    // Trigger scan over the capture history in roll mode
+    TriggerEngine streamTrigger;
+    quint64 streamScanIndex = 0;
+    QVector<TriggerEngine::Event> streamTriggers;
+    QVector<double> streamScratch;
 
     // State variables for oscilloscope logic
     int ch1OffsetCorrected = 0, ch2OffsetCorrected = 0, ch1TrigCorrected = 0;
@@ -416,15 +572,15 @@ private:
     // Member variables for Add/Overwrite functionality
     int targetTraceCount = 2;  // Number of traces to collect (starts at 2, increments each run)
     int currentTraceCount = 0; // Current number of collected traces
-    QVector<QVector<double>> collectedTracesCh1; // Dynamic storage for traces
-    QVector<QVector<double>> collectedTracesCh2;
+    TracePool tracePool; // Fixed-capacity storage for the traces of one set
     bool isCollectingTraces = false; // Flag to indicate trace collection mode
     int runCount = 0; // Track number of times Run has been pressed
 
     QHBoxLayout* mainAreaLayout = nullptr;
     QTabWidget* rightPanelTabs = nullptr;
     QCustomPlot* plot = nullptr;
-    QCustomPlot* bodePlot = nullptr;
+    QCustomPlot* bodePlot = nullptr; // built the first time it is shown or drawn
+    QCustomPlot* bodePlotWidget();
     QCheckBox* lpfCheckBox = nullptr;
 
     void blinkTestLED();
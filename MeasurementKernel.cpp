@@ -0,0 +1,115 @@
+#include "MeasurementKernel.h"
+#include <cmath>
+
+void MeasurementKernel::reset() {
+    haveReference = false;
+    reference = 0.0;
+    hysteresis = 0.0;
+}
+
+void MeasurementKernel::begin(double sampleInterval) {
+    dt = sampleInterval > 0.0 ? sampleInterval : 1.0;
+    count = 0;
+    minValue = maxValue = 0.0;
+    sum = sumSquares = 0.0;
+    high = false;
+    stateKnown = false;
+    previous = 0.0;
+    risingEdges = 0;
+    firstRise = lastRise = 0.0;
+    highSamples = highAtLastRise = 0;
+}
+
+void MeasurementKernel::add(const double* samples, int n) {
+    if (n <= 0) return;
+    if (count == 0) minValue = maxValue = samples[0];
+    const double upper = reference + hysteresis;
+    const double lower = reference - hysteresis;
+    for (int i = 0; i < n; ++i) {
+        const double x = samples[i];
+        if (x < minValue) minValue = x;
+        if (x > maxValue) maxValue = x;
+        sum += x;
+        sumSquares += x * x;
+
+        if (!haveReference) continue;
+        if (!stateKnown) {
+            high = x >= reference;
+            stateKnown = true;
+        } else if (!high && x >= upper) {
+            // Rising edge; interpolate where it crossed the reference
+            const double step = x - previous;
+            const double pos = (count + i - 1) + (step > 0.0 ? (reference - previous) / step : 1.0);
+            if (risingEdges == 0) {
+                firstRise = pos;
+                highSamples = 0;
+            }
+            lastRise = pos;
+            highAtLastRise = highSamples;
+            ++risingEdges;
+            high = true;
+        } else if (high && x <= lower) {
+            high = false;
+        }
+        if (high && risingEdges > 0) ++highSamples;
+        previous = x;
+    }
+    count += n;
+}
+
+void MeasurementKernel::scanEdges(const double* samples, int n) {
+    // Replays the edge part of add() once the range of this record is known
+    const long long savedCount = count;
+    const double savedMin = minValue, savedMax = maxValue, savedSum = sum, savedSq = sumSquares;
+    count = 0;
+    stateKnown = false;
+    risingEdges = 0;
+    highSamples = highAtLastRise = 0;
+    add(samples, n);
+    count = savedCount;
+    minValue = savedMin;
+    maxValue = savedMax;
+    sum = savedSum;
+    sumSquares = savedSq;
+}
+
+ChannelMeasurements MeasurementKernel::finish() {
+    ChannelMeasurements m;
+    if (count == 0) return m;
+    m.valid = true;
+    m.samples = static_cast<int>(count);
+    m.min = minValue;
+    m.max = maxValue;
+    m.mean = sum / count;
+    m.rms = std::sqrt(sumSquares / count);
+    m.pkpk = maxValue - minValue;
+    m.amplitude = m.pkpk / 2.0;
+    if (risingEdges >= 2 && lastRise > firstRise) {
+        const double periodSamples = (lastRise - firstRise) / (risingEdges - 1);
+        m.periodic = true;
+        m.period = periodSamples * dt;
+        m.frequency = 1.0 / m.period;
+        m.duty = qBound(0.0, double(highAtLastRise) / (lastRise - firstRise), 1.0);
+    }
+    // Next record measures its edges against this one's midpoint
+    reference = (maxValue + minValue) / 2.0;
+    hysteresis = m.pkpk * 0.1;
+    haveReference = true;
+    return m;
+}
+
+ChannelMeasurements MeasurementKernel::measure(const QVector<double>& samples, double sampleInterval) {
+    begin(sampleInterval);
+    add(samples.constData(), samples.size());
+    // The previous midpoint is good enough while it stays near this one
+    const double midpoint = (maxValue + minValue) / 2.0;
+    const bool referenceUsable = haveReference && std::abs(reference - midpoint) < (maxValue - minValue) * 0.1;
+    if (!referenceUsable && count > 0) {
+        // Stale or missing reference: take it from this record and rescan
+        reference = midpoint;
+        hysteresis = (maxValue - minValue) * 0.1;
+        haveReference = true;
+        scanEdges(samples.constData(), samples.size());
+    }
+    return finish();
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <QVector>
+
+// Waveform statistics for one channel, shared by the measurement panels,
+// the Bode sweep and the CSV exporter
+struct ChannelMeasurements {
+    bool valid = false;      // false until at least one sample was seen
+    int samples = 0;
+    double min = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+    double rms = 0.0;
+    double pkpk = 0.0;
+    double amplitude = 0.0;  // pkpk / 2
+    bool periodic = false;   // true once two rising edges were found
+    double period = 0.0;     // seconds
+    double frequency = 0.0;  // Hz
+    double duty = 0.0;       // fraction of each period above the midpoint, 0..1
+};
+
+// Single-pass measurement kernel. Min/max/sum/sum-of-squares and edge
+// timing are all accumulated in the same loop. Edges are taken against the
+// midpoint of the previous record (with 10 % pk-pk hysteresis), so one
+// pass is enough in steady state; only when that reference is off the new
+// record's midpoint by more than 10 % pk-pk (first record, level change) is
+// the record scanned a second time for timing. begin()/add()/finish()
+// accept a stream in blocks of any size, e.g. from the capture history.
+class MeasurementKernel {
+public:
+    void reset(); // Forget the edge reference
+
+    void begin(double sampleInterval);
+    void add(const double* samples, int count);
+    ChannelMeasurements finish();
+
+    // begin() + add() + finish() over a whole record
+    ChannelMeasurements measure(const QVector<double>& samples, double sampleInterval);
+
+private:
+    void scanEdges(const double* samples, int count);
+
+    double dt = 1.0;
+    bool haveReference = false;
+    double reference = 0.0;
+    double hysteresis = 0.0;
+
+    // Running totals for the current record
+    long long count = 0;
+    double minValue = 0.0, maxValue = 0.0;
+    double sum = 0.0, sumSquares = 0.0;
+
+    // Edge timing; positions are sample indices from begin()
+    bool high = false;
+    bool stateKnown = false;
+    double previous = 0.0;
+    int risingEdges = 0;
+    double firstRise = 0.0, lastRise = 0.0;
+    long long highSamples = 0;       // above reference since the first rise
+    long long highAtLastRise = 0;
+};
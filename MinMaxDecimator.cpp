@@ -0,0 +1,85 @@
+#include "MinMaxDecimator.h"
+#include <QtGlobal>
+#include <algorithm>
+
+void MinMaxDecimator::setData(const QVector<double>& input, double scale) {
+    sampleCount = input.size();
+    samples.resize(sampleCount);
+    for (int i = 0; i < sampleCount; ++i) {
+        samples[i] = input[i] * scale;
+    }
+
+    // Level 1 pairs raw samples; each further level pairs the one below
+    levelCount = 0;
+    int size = sampleCount;
+    while (size > 1) {
+        const int next = (size + 1) / 2;
+        if (levelCount == levels.size()) levels.append(Level());
+        Level& level = levels[levelCount];
+        level.minValues.resize(next);
+        level.maxValues.resize(next);
+        if (levelCount == 0) {
+            for (int b = 0; b < next; ++b) {
+                const double a = samples[2 * b];
+                const double c = (2 * b + 1 < size) ? samples[2 * b + 1] : a;
+                level.minValues[b] = std::min(a, c);
+                level.maxValues[b] = std::max(a, c);
+            }
+        } else {
+            const Level& below = levels[levelCount - 1];
+            for (int b = 0; b < next; ++b) {
+                const int j = 2 * b;
+                const int k = (j + 1 < size) ? j + 1 : j;
+                level.minValues[b] = std::min(below.minValues[j], below.minValues[k]);
+                level.maxValues[b] = std::max(below.maxValues[j], below.maxValues[k]);
+            }
+        }
+        ++levelCount;
+        size = next;
+    }
+}
+
+void MinMaxDecimator::clear() {
+    sampleCount = 0;
+    levelCount = 0;
+}
+
+void MinMaxDecimator::decimate(int first, int last, int maxBuckets, QVector<double>& indices, QVector<double>& values) const {
+    indices.resize(0);
+    values.resize(0);
+    if (sampleCount == 0) return;
+    first = qBound(0, first, sampleCount - 1);
+    last = qBound(0, last, sampleCount - 1);
+    if (last < first) return;
+    maxBuckets = qMax(1, maxBuckets);
+
+    const int span = last - first + 1;
+    if (span <= 2 * maxBuckets || levelCount == 0) {
+        indices.reserve(span);
+        values.reserve(span);
+        for (int i = first; i <= last; ++i) {
+            indices.append(i);
+            values.append(samples[i]);
+        }
+        return;
+    }
+
+    // Smallest power-of-two bucket that keeps the bucket count <= maxBuckets
+    int shift = 1;
+    while (shift < levelCount && (span >> shift) >= maxBuckets) ++shift;
+    const Level& level = levels[shift - 1];
+    const int bucketSize = 1 << shift;
+    const int firstBucket = first >> shift;
+    const int lastBucket = last >> shift;
+
+    indices.reserve(2 * (lastBucket - firstBucket + 1));
+    values.reserve(2 * (lastBucket - firstBucket + 1));
+    for (int b = firstBucket; b <= lastBucket; ++b) {
+        // Both extremes sit at the bucket centre: a vertical stroke less than a pixel wide
+        const double centre = std::min(b * bucketSize + (bucketSize - 1) * 0.5, double(sampleCount - 1));
+        indices.append(centre);
+        values.append(level.minValues[b]);
+        indices.append(centre);
+        values.append(level.maxValues[b]);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <QVector>
+
+// Peak-detect level-of-detail for long records. setData() builds a min/max
+// pyramid (level k holds the min and max of each 2^k-sample bucket) in
+// O(n); decimate() then picks the level whose buckets are about one pixel
+// wide for the requested index range and emits each bucket's min and max,
+// so the output size depends on the plot width, not the record length, and
+// single-sample glitches survive at every zoom level.
+class MinMaxDecimator {
+public:
+    // Copies samples (scaled by scale) and rebuilds the pyramid. Storage is
+    // reused between calls of the same or smaller length.
+    void setData(const QVector<double>& samples, double scale = 1.0);
+    void clear();
+
+    int size() const { return sampleCount; }
+    bool isEmpty() const { return sampleCount == 0; }
+
+    // Fills indices/values with points covering samples [first, last]. Spans
+    // of up to 2 * maxBuckets samples are returned raw; longer spans as one
+    // min/max pair per bucket, at most maxBuckets buckets.
+    void decimate(int first, int last, int maxBuckets, QVector<double>& indices, QVector<double>& values) const;
+
+private:
+    struct Level {
+        QVector<double> minValues;
+        QVector<double> maxValues;
+    };
+
+    int sampleCount = 0;
+    QVector<double> samples;
+    QVector<Level> levels; // levels[k - 1] has bucket size 2^k
+    int levelCount = 0;
+};
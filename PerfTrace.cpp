@@ -0,0 +1,98 @@
+#include "PerfTrace.h"
+#include <QtAlgorithms>
+
+Q_LOGGING_CATEGORY(lcFrame, "scope.frame", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcSample, "scope.sample", QtInfoMsg)
+
+void setLogVerbosity(LogVerbosity verbosity) {
+    const bool frames = verbosity != LogVerbosity::Quiet;
+    const bool samples = verbosity == LogVerbosity::Samples;
+    QLoggingCategory::setFilterRules(QString("scope.frame.debug=%1\nscope.sample.debug=%2")
+                                         .arg(frames ? "true" : "false", samples ? "true" : "false"));
+}
+
+// --- LatencyHistogram ---
+
+void LatencyHistogram::record(qint64 ns) {
+    int bucket = 0;
+    if (ns >= 4) {
+        const int msb = 63 - qCountLeadingZeroBits(quint64(ns));
+        bucket = qMin(BUCKETS - 1, msb * 4 + int((ns >> (msb - 2)) & 3));
+    } else if (ns > 0) {
+        bucket = int(ns);
+    }
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::snapshot(quint32* counts, bool reset) {
+    for (int i = 0; i < BUCKETS; ++i) {
+        counts[i] = reset ? buckets[i].exchange(0, std::memory_order_relaxed)
+                          : buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+qint64 LatencyHistogram::bucketValue(int bucket) {
+    if (bucket < 8) return bucket;
+    const int msb = bucket / 4;
+    const qint64 width = qint64(1) << (msb - 2);
+    return (4 + bucket % 4) * width + width / 2;
+}
+
+// --- PerfCounters ---
+
+PerfCounters& PerfCounters::instance() {
+    static PerfCounters counters;
+    return counters;
+}
+
+const char* PerfCounters::stageName(PerfStage stage) {
+    switch (stage) {
+    case PerfStage::Setup: return "Setup";
+    case PerfStage::CaptureAck: return "Capture ACK";
+    case PerfStage::Ch1Receive: return "CH1 receive";
+    case PerfStage::Ch2Receive: return "CH2 receive";
+    case PerfStage::Decode: return "Decode";
+    case PerfStage::Dsp: return "DSP";
+    case PerfStage::Trigger: return "Trigger";
+    case PerfStage::Plot: return "Plot";
+    case PerfStage::Replot: return "Replot";
+    case PerfStage::EndToEnd: return "End to end";
+    case PerfStage::Count: break;
+    }
+    return "";
+}
+
+void PerfCounters::replotted(qint64 startNs) {
+    const qint64 now = acquisitionClockNs();
+    record(PerfStage::Replot, now - startNs);
+    // Replots without a new frame (axis changes, overlays) are not frames
+    const qint64 frameNs = pendingFrameNs.exchange(0, std::memory_order_relaxed);
+    if (frameNs == 0) return;
+    record(PerfStage::EndToEnd, now - frameNs);
+    displayed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PerfCounters::stats(StageStats* out, bool reset) {
+    quint32 counts[LatencyHistogram::BUCKETS];
+    for (int s = 0; s < int(PerfStage::Count); ++s) {
+        histograms[s].snapshot(counts, reset);
+        StageStats& st = out[s];
+        st = StageStats();
+        for (quint32 c : counts) st.count += c;
+        if (st.count == 0) continue;
+        // Nearest-rank percentiles
+        const quint64 rank50 = (st.count + 1) / 2;
+        const quint64 rank99 = (st.count * 99 + 99) / 100;
+        quint64 seen = 0;
+        for (int i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+            if (counts[i] == 0) continue;
+            const quint64 before = seen;
+            seen += counts[i];
+            if (before < rank50 && seen >= rank50) st.p50 = LatencyHistogram::bucketValue(i);
+            if (before < rank99 && seen >= rank99) {
+                st.p99 = LatencyHistogram::bucketValue(i);
+                break;
+            }
+        }
+    }
+}
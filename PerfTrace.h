@@ -0,0 +1,108 @@
+#pragma once
+#include <QLoggingCategory>
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+#include "FrameRing.h"
+
+// Hot-path diagnostics.
+//
+// Tracing: each stage of the acquisition-to-pixel path records its latency
+// into a lock-free log-scale histogram, so any thread can record and the
+// overlay reads p50/p99 without stopping anyone. Built with
+// SCOPE_PERF_TRACE (CMake option, on by default); without it the PERF_*
+// macros compile to nothing.
+//
+// Logging: per-frame and per-sample chatter goes to the scope.frame and
+// scope.sample categories, which are off unless enabled at run time
+// (setLogVerbosity() or QT_LOGGING_RULES), so the messages cost one branch.
+Q_DECLARE_LOGGING_CATEGORY(lcFrame)
+Q_DECLARE_LOGGING_CATEGORY(lcSample)
+
+enum class LogVerbosity { Quiet, Frames, Samples };
+void setLogVerbosity(LogVerbosity verbosity);
+
+enum class PerfStage {
+    Setup,      // capture started -> capture command written
+    CaptureAck, // capture command -> device ACK
+    Ch1Receive, // data request -> CH1 complete (framed: command -> frame)
+    Ch2Receive, // CH2 request -> CH2 complete
+    Decode,     // ADC codes -> volts, per frame
+    Dsp,        // filter chains, per frame
+    Trigger,    // trigger search, per frame
+    Plot,       // graph data update, per frame
+    Replot,     // QCustomPlot render
+    EndToEnd,   // last byte in -> rendered
+    Count
+};
+
+// Latencies in ns, bucketed by octave with four sub-buckets each (12-25%
+// wide), from 1 ns up to ~18 minutes
+class LatencyHistogram {
+public:
+    static constexpr int BUCKETS = 160;
+
+    void record(qint64 ns);
+    // Snapshot of the counts, optionally zeroing them as they are read
+    void snapshot(quint32* counts, bool reset);
+    static qint64 bucketValue(int bucket); // representative ns of a bucket
+
+private:
+    std::atomic<quint32> buckets[BUCKETS] = {};
+};
+
+class PerfCounters {
+public:
+    static PerfCounters& instance();
+    static constexpr bool enabled() {
+#ifdef SCOPE_PERF_TRACE
+        return true;
+#else
+        return false;
+#endif
+    }
+    static const char* stageName(PerfStage stage);
+
+    void record(PerfStage stage, qint64 ns) { histograms[int(stage)].record(ns); }
+    void countAcquired() { acquired.fetch_add(1, std::memory_order_relaxed); }
+    // A frame went into the graphs; the next replot shows it
+    void framePlotted(qint64 timestampNs) { pendingFrameNs.store(timestampNs, std::memory_order_relaxed); }
+    void replotted(qint64 startNs);
+
+    quint64 framesAcquired() const { return acquired.load(std::memory_order_relaxed); }
+    quint64 framesDisplayed() const { return displayed.load(std::memory_order_relaxed); }
+
+    struct StageStats {
+        quint64 count = 0;
+        qint64 p50 = 0; // ns
+        qint64 p99 = 0;
+    };
+    // Since the previous call with reset = true
+    void stats(StageStats* out, bool reset);
+
+private:
+    PerfCounters() = default;
+    LatencyHistogram histograms[int(PerfStage::Count)];
+    std::atomic<quint64> acquired{0};
+    std::atomic<quint64> displayed{0};
+    std::atomic<qint64> pendingFrameNs{0};
+};
+
+#ifdef SCOPE_PERF_TRACE
+#define PERF_NOW() acquisitionClockNs()
+// Records the time since stamp under stage and restarts stamp
+#define PERF_LAP(stage, stamp) \
+    do { const qint64 perfNow_ = acquisitionClockNs(); \
+         PerfCounters::instance().record(stage, perfNow_ - (stamp)); (stamp) = perfNow_; } while (0)
+#define PERF_SINCE(stage, startNs) PerfCounters::instance().record(stage, acquisitionClockNs() - (startNs))
+#define PERF_ACQUIRED() PerfCounters::instance().countAcquired()
+#define PERF_PLOTTED(timestampNs) PerfCounters::instance().framePlotted(timestampNs)
+#define PERF_REPLOTTED(startNs) PerfCounters::instance().replotted(startNs)
+#else
+#define PERF_NOW() qint64(0)
+#define PERF_LAP(stage, stamp) ((void)0)
+#define PERF_SINCE(stage, startNs) ((void)0)
+#define PERF_ACQUIRED() ((void)0)
+#define PERF_PLOTTED(timestampNs) ((void)0)
+#define PERF_REPLOTTED(startNs) ((void)0)
+#endif
@@ -0,0 +1,77 @@
+#include "PersistenceHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Renormalise before the weighted counts lose float precision
+constexpr double MAX_WEIGHT = 1e6;
+}
+
+void PersistenceHistogram::configure(int columns, int rows, double minValue, double maxValue) {
+    columnCount = qMax(1, columns);
+    rowCount = qMax(1, rows);
+    lowValue = minValue;
+    highValue = maxValue > minValue ? maxValue : minValue + 1.0;
+    hits.resize(columnCount * rowCount);
+    clear();
+}
+
+bool PersistenceHistogram::matches(int columns, int rows, double minValue, double maxValue) const {
+    return !hits.isEmpty() && columns == columnCount && rows == rowCount
+           && minValue == lowValue && maxValue == highValue;
+}
+
+void PersistenceHistogram::clear() {
+    std::fill(hits.begin(), hits.end(), 0.0f);
+    peak = 0.0f;
+    weight = 1.0;
+}
+
+void PersistenceHistogram::addTrace(const double* samples, int count, double scale) {
+    if (count <= 0 || hits.isEmpty()) return;
+    // Row per sample in a branch-free loop the compiler can vectorise
+    if (rowScratch.size() < count) rowScratch.resize(count);
+    int* rowsOf = rowScratch.data();
+    const double rowsPerValue = scale * rowCount / (highValue - lowValue);
+    const double rowOffset = -lowValue * rowCount / (highValue - lowValue);
+    const double lastRow = rowCount - 1;
+    for (int i = 0; i < count; ++i) {
+        const double r = samples[i] * rowsPerValue + rowOffset;
+        rowsOf[i] = static_cast<int>(std::min(std::max(r, 0.0), lastRow));
+    }
+
+    // Each segment lights the rows it crosses in the column of its end sample
+    float* grid = hits.data();
+    const float w = static_cast<float>(weight);
+    const qint64 columnSpan = columnCount - 1;
+    const qint64 sampleSpan = qMax(1, count - 1);
+    int previousRow = rowsOf[0];
+    for (int i = 0; i < count; ++i) {
+        const int row = rowsOf[i];
+        const int lo = std::min(row, previousRow);
+        const int hi = std::max(row, previousRow);
+        float* cells = grid + (i * columnSpan / sampleSpan) * rowCount;
+        for (int r = lo; r <= hi; ++r) {
+            cells[r] += w;
+            peak = std::max(peak, cells[r]);
+        }
+        previousRow = row;
+    }
+}
+
+void PersistenceHistogram::decay(double factor) {
+    if (factor >= 1.0) return;
+    if (factor <= 0.0) {
+        clear();
+        return;
+    }
+    weight /= factor;
+    if (weight > MAX_WEIGHT) renormalise();
+}
+
+void PersistenceHistogram::renormalise() {
+    const float s = static_cast<float>(1.0 / weight);
+    for (float& h : hits) h *= s;
+    peak *= s;
+    weight = 1.0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <QVector>
+
+// Time-by-voltage hit counts for intensity-graded (digital phosphor)
+// waveform displays. Each trace is spread across all columns and every
+// segment between two neighbouring samples marks the rows it spans, so
+// steep edges draw as solid lines. Drawing the result costs columns x rows
+// whatever the number of traces added.
+//
+// Decay is lazy: rather than scaling every cell each frame, new hits are
+// added with a weight that grows by 1 / factor, and the grid is only
+// renormalised when that weight gets large. Fading is O(1) per frame.
+class PersistenceHistogram {
+public:
+    // Sets the grid and value range; storage is kept when the size is
+    // unchanged. Always clears the counts.
+    void configure(int columns, int rows, double minValue, double maxValue);
+    // True if configure() with these arguments would change nothing
+    bool matches(int columns, int rows, double minValue, double maxValue) const;
+    void clear();
+
+    // Adds count samples (each multiplied by scale) as one trace
+    void addTrace(const double* samples, int count, double scale = 1.0);
+    // Fades everything added so far by factor (0..1; 1 = infinite persistence)
+    void decay(double factor);
+
+    int columns() const { return columnCount; }
+    int rows() const { return rowCount; }
+    double minValue() const { return lowValue; }
+    double maxValue() const { return highValue; }
+    // Column-major: hits of column c, row r at c * rows() + r, in units of
+    // 1 / countScale(); row 0 is minValue
+    const QVector<float>& counts() const { return hits; }
+    double countScale() const { return 1.0 / weight; }
+    // Upper bound on any cell, in hits
+    double maxCount() const { return peak / weight; }
+
+private:
+    void renormalise();
+
+    int columnCount = 0;
+    int rowCount = 0;
+    double lowValue = 0.0;
+    double highValue = 1.0;
+    QVector<float> hits;
+    QVector<int> rowScratch; // per-sample rows of the trace being added
+    float peak = 0.0f;
+    double weight = 1.0;     // value one hit adds right now
+};
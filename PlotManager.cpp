@@ -2,38 +2,66 @@
 #include <QWidget>
 // You must add QCustomPlot to your project for this to work
 #include "qcustomplot.h"
+#include "PerfTrace.h"
 #include <cmath>
-#include <complex>
 #include <QLinearGradient>
 #include <QDebug>
 #include <QFont>
 #include <QBrush>
+#include <algorithm>
 
 namespace {
-const double PI = 3.14159265358979323846;
+// Scene id of the intensity-graded Add view; display modes are 0..7
+constexpr int INTENSITY_SCENE = 100;
+// Voltage resolution of the intensity view
+constexpr int INTENSITY_ROWS = 256;
+// Spectrum mode's dBV scale: its initial range, and how far below the
+// strongest bin the auto range reaches
+constexpr double SPECTRUM_MIN_DB = -120.0;
+constexpr double SPECTRUM_MAX_DB = 20.0;
+constexpr double SPECTRUM_AUTO_SPAN_DB = 120.0;
+// Bus event labels: at most this many per view, one row per bus from the top
+constexpr int MAX_ANNOTATION_LABELS = 128;
+constexpr double ANNOTATION_ROW_HEIGHT = 0.06; // axis rect fraction
+// Pens of the secondary devices' channels, CH1 and CH2 of each in turn
+const QColor EXTRA_COLORS[] = {QColor(200, 90, 0), QColor(0, 130, 200), Qt::darkGreen, Qt::darkMagenta,
+                               Qt::darkCyan, Qt::darkYellow, Qt::darkGray, QColor(140, 70, 160)};
+constexpr int EXTRA_COLOR_COUNT = sizeof(EXTRA_COLORS) / sizeof(EXTRA_COLORS[0]);
 
-// Simple, reliable DFT implementation
-QVector<double> simpleDFT(const QVector<double>& inputData) {
-    if (inputData.isEmpty()) return QVector<double>();
-    
-    int N = inputData.size();
-    QVector<double> magnitude(N/2);
-    
-    // Simple DFT calculation
-    for (int k = 0; k < N/2; ++k) {
-        double real = 0.0;
-        double imag = 0.0;
-        
-        for (int n = 0; n < N; ++n) {
-            double angle = 2.0 * PI * k * n / N;
-            real += inputData[n] * cos(angle);
-            imag += inputData[n] * sin(angle);
-            }
-        
-        magnitude[k] = sqrt(real * real + imag * imag) / N;
+// Copies hit counts into a colour map, resizing its grid only when the
+// histogram shape changed
+void writeColorMap(QCPColorMap *map, const PersistenceHistogram& histogram, const QCPRange& keyRange)
+{
+    QCPColorMapData *data = map->data();
+    if (data->keySize() != histogram.columns() || data->valueSize() != histogram.rows()) {
+        data->setSize(histogram.columns(), histogram.rows());
+    }
+    data->setRange(keyRange, QCPRange(histogram.minValue(), histogram.maxValue()));
+    const float *hits = histogram.counts().constData();
+    const double scale = histogram.countScale();
+    for (int c = 0; c < histogram.columns(); ++c) {
+        for (int r = 0; r < histogram.rows(); ++r) {
+            data->setCell(c, r, hits[c * histogram.rows() + r] * scale);
+        }
+    }
+    map->setDataRange(QCPRange(0, qMax(1.0, histogram.maxCount())));
+}
+
+// Overwrites a graph's data container in place. The container is only
+// reallocated when the point count changes, so steady-state frames write
+// samples straight into QCustomPlot's storage without intermediate vectors.
+template <typename KeyFn, typename ValueFn>
+void writeGraphData(QCPGraph *graph, int count, KeyFn key, ValueFn value)
+{
+    QSharedPointer<QCPGraphDataContainer> data = graph->data();
+    if (data->size() != count) {
+        data->set(QVector<QCPGraphData>(count), true);
+    }
+    auto it = data->begin();
+    for (int i = 0; i < count; ++i, ++it) {
+        it->key = key(i);
+        it->value = value(i);
     }
-    
-    return magnitude;
 }
 }
 
@@ -51,9 +79,73 @@ PlotManager::PlotManager(QObject *parent)
     plot->yAxis->setLabelColor(Qt::blue);
     plot->yAxis2->setTickLabelColor(Qt::red);
     plot->yAxis2->setLabelColor(Qt::red);
+#ifdef SCOPE_PERF_TRACE
+    connect(plot, &QCustomPlot::beforeReplot, this, [this]() { replotStartNs = PERF_NOW(); });
+    connect(plot, &QCustomPlot::afterReplot, this, [this]() { PERF_REPLOTTED(replotStartNs); });
+#endif
+    
+    // --- Decorations shared by every display mode, created once ---
+    // Align labels inside
+    plot->yAxis->setTickLabelSide(QCPAxis::lsInside);
+    plot->yAxis2->setTickLabelSide(QCPAxis::lsInside);
+    
+    // Display grid lines
+    plot->yAxis->grid()->setVisible(true);
+    plot->yAxis2->grid()->setVisible(true);
+    
+    // Fill axis background with gradient (white to light gray)
+    QLinearGradient gradient(0, 0, 0, 1);
+    gradient.setColorAt(0, Qt::white);
+    gradient.setColorAt(1, QColor(211, 211, 211)); // Light gray
+    gradient.setCoordinateMode(QGradient::ObjectBoundingMode);
+    plot->axisRect()->setBackground(QBrush(gradient));
+    
+    // Add text objects for branding (similar to VB.NET)
+    scopeText = new QCPItemText(plot);
+    scopeText->position->setType(QCPItemPosition::ptAxisRectRatio);
+    scopeText->position->setCoords(1.0, 0.0); // Top right
+    scopeText->setText("ScopeX");
+    scopeText->setFont(QFont("Arial", 10));
+    scopeText->setColor(Qt::black);
+    scopeText->setPositionAlignment(Qt::AlignRight | Qt::AlignTop);
+    
+    signatureText = new QCPItemText(plot);
+    signatureText->position->setType(QCPItemPosition::ptAxisRectRatio);
+    signatureText->position->setCoords(0.0, 1.0); // Bottom left
+    signatureText->setText("Student 12345"); // Replace with actual values
+    signatureText->setFont(QFont("Arial", 8));
+    signatureText->setColor(Qt::black);
+    signatureText->setPositionAlignment(Qt::AlignLeft | Qt::AlignBottom);
+    
+    // Trigger line spans the full axis rect width, so zoom/pan never needs
+    // it to be rebuilt; only its level and value axis change
+    triggerLine = new QCPItemLine(plot);
+    triggerLine->start->setTypeX(QCPItemPosition::ptAxisRectRatio);
+    triggerLine->end->setTypeX(QCPItemPosition::ptAxisRectRatio);
+    triggerLine->start->setTypeY(QCPItemPosition::ptPlotCoords);
+    triggerLine->end->setTypeY(QCPItemPosition::ptPlotCoords);
+    triggerLine->setClipToAxisRect(true);
+    triggerLine->setVisible(false);
+    
+    // Enable auto scroll range and point values
+    plot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
+    
+    // Zoom and pan pick a new decimation level for the visible range
+    connect(plot->xAxis, QOverload<const QCPRange&>::of(&QCPAxis::rangeChanged), this, [this]() {
+        if (frameUpdateActive) return;
+        if (sceneMode == 3) {
+            xyRenderer.rerender();
+        } else if (sceneMode >= 0 && sceneMode <= 2) {
+            renderDecimated();
+        } else {
+            return;
+        }
+        plot->replot(QCustomPlot::rpQueuedReplot);
+    });
 }
 
 PlotManager::~PlotManager() {
+    xyRenderer.detach();
     delete plot;
 }
 
@@ -67,6 +159,7 @@ void PlotManager::setMode(int mode) {
 
 void PlotManager::setGains(double g1, double g2) {
     ch1Gain = g1; ch2Gain = g2;
+    maskStale = true;
 }
 
 void PlotManager::setTriggerLine(bool enabled, double level, bool onCh2, QColor color) {
@@ -79,11 +172,9 @@ void PlotManager::setTriggerLine(bool enabled, double level, bool onCh2, QColor
 void PlotManager::updateTriggerLevel(double level, bool onCh2) {
     triggerLevel = level;
     triggerOnCh2 = onCh2;
-    // Clear existing trigger lines
-    plot->clearItems();
-    // Redraw trigger line
+    // Move the existing trigger line; coalesces with the frame's waveform replot
     plotTriggerLine();
-    plot->replot();
+    plot->replot(QCustomPlot::rpQueuedReplot);
 }
 
 void PlotManager::setDisplayMode(int mode) {
@@ -92,7 +183,8 @@ void PlotManager::setDisplayMode(int mode) {
 
 void PlotManager::setXAxisTitle(const QString& title) { 
     xAxisTitle = title; 
-    if (plot) {
+    // XY and DFT scenes label the x axis themselves
+    if (plot && sceneMode >= 0 && sceneMode <= 2) {
         plot->xAxis->setLabel(title); 
     }
 }
@@ -103,7 +195,7 @@ void PlotManager::setY2AxisTitle(const QString& title) { plot->yAxis2->setLabel(
 
 void PlotManager::setDataLength(int len) { dataLength = len; }
 
-void PlotManager::setMultiplier(double m) { multiplier = m; }
+void PlotManager::setMultiplier(double m) { multiplier = m; maskStale = true; }
 
 void PlotManager::setMaxDFT(double m) { maxDFT = m; }
 
@@ -113,347 +205,483 @@ void PlotManager::setAutoYRangeEnabled(bool enabled) {
     autoYRangeEnabled = enabled;
 }
 
-void PlotManager::updateWaveform(const QVector<double>& ch1, const QVector<double>& ch2)
+void PlotManager::setFFTWindow(FFTEngine::Window window) { fftWindow = window; }
+
+void PlotManager::buildScene(int mode)
 {
-    if (!plot) return;
-    
-    // Clear previous graphs and items
+    // Drop whatever graphs or intensity layers a previous mode left behind
     plot->clearGraphs();
-    plot->clearItems();
-    
-    // Hide all axes initially
-    plot->yAxis->setVisible(false);
-    plot->yAxis2->setVisible(false);
-    
-    // Set default axis colors
+    primaryGraph = nullptr;
+    secondaryGraph = nullptr;
+    ch1PeakGraph = nullptr;
+    ch2PeakGraph = nullptr;
+    xyRenderer.detach();
+    for (QCPItemText *label : annotationLabels) label->setVisible(false);
+    extraGraphs.clear();
+    maskGraphs.clear();
+    if (ch1Intensity) plot->removePlottable(ch1Intensity);
+    if (ch2Intensity) plot->removePlottable(ch2Intensity);
+    ch1Intensity = nullptr;
+    ch2Intensity = nullptr;
+
+    // Default axis colors, overridden per mode below
     plot->yAxis->setTickLabelColor(Qt::red);
     plot->yAxis->setLabelColor(Qt::red);
     plot->yAxis2->setTickLabelColor(Qt::blue);
     plot->yAxis2->setLabelColor(Qt::blue);
-    
-    // Align labels inside
-    plot->yAxis->setTickLabelSide(QCPAxis::lsInside);
-    plot->yAxis2->setTickLabelSide(QCPAxis::lsInside);
-    
-    // Display grid lines
-    plot->yAxis->grid()->setVisible(true);
-    plot->yAxis2->grid()->setVisible(true);
-    
-    // Fill axis background with gradient (white to light gray)
-    QLinearGradient gradient(0, 0, 0, 1);
-    gradient.setColorAt(0, Qt::white);
-    gradient.setColorAt(1, QColor(211, 211, 211)); // Light gray
-    gradient.setCoordinateMode(QGradient::ObjectBoundingMode);
-    plot->axisRect()->setBackground(QBrush(gradient));
-    
-    // Add text objects for branding (similar to VB.NET)
-    QCPItemText *scopeText = new QCPItemText(plot);
-    scopeText->position->setType(QCPItemPosition::ptAxisRectRatio);
-    scopeText->position->setCoords(1.0, 0.0); // Top right
-    scopeText->setText("ScopeX");
-    scopeText->setFont(QFont("Arial", 10));
-    scopeText->setColor(Qt::black);
-    scopeText->setPositionAlignment(Qt::AlignRight | Qt::AlignTop);
-    
-    QCPItemText *signatureText = new QCPItemText(plot);
-    signatureText->position->setType(QCPItemPosition::ptAxisRectRatio);
-    signatureText->position->setCoords(0.0, 1.0); // Bottom left
-    signatureText->setText("Student 12345"); // Replace with actual values
-    signatureText->setFont(QFont("Arial", 8));
-    signatureText->setColor(Qt::black);
-    signatureText->setPositionAlignment(Qt::AlignLeft | Qt::AlignBottom);
-    
-    // Enable auto scroll range and point values
-    plot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
-    
-    // Mode-specific plotting logic (exactly as in VB.NET)
-    if (currentMode == 0) { // Both Channels (BothCh_Display_RadioButton)
-        // Ensure we have 2 graphs for both channels
-        plot->addGraph(); // CH1
-        plot->addGraph(); // CH2
-        
-        QVector<double> x(ch1.size());
-        QVector<double> ch1_shifted(ch1.size()), ch2_shifted(ch2.size());
-        for (int i = 0; i < x.size(); ++i) {
-            x[i] = i * multiplier;
-            ch1_shifted[i] = ch1[i] * ch1Gain;
-            ch2_shifted[i] = ch2[i] * ch2Gain;
-        }
-        
-        // CH1 data
-        plot->graph(0)->setData(x, ch1_shifted);
-        plot->graph(0)->setPen(QPen(Qt::red, 2));
-        plot->graph(0)->setVisible(true);
-        plot->graph(0)->setValueAxis(plot->yAxis);
-        
-        // CH2 data
-        plot->graph(1)->setData(x, ch2_shifted);
-        plot->graph(1)->setPen(QPen(Qt::blue, 2));
-        plot->graph(1)->setVisible(true);
-        plot->graph(1)->setValueAxis(plot->yAxis2);
-        
-        // Axis setup
+
+    switch (mode) {
+    case 0: // Both Channels (BothCh_Display_RadioButton)
+        primaryGraph = plot->addGraph(plot->xAxis, plot->yAxis);
+        primaryGraph->setPen(QPen(Qt::red, 2));
+        secondaryGraph = plot->addGraph(plot->xAxis, plot->yAxis2);
+        secondaryGraph->setPen(QPen(Qt::blue, 2));
         plot->xAxis->setLabel(xAxisTitle);
         plot->yAxis->setLabel("Ch1 Volts");
         plot->yAxis2->setLabel("Ch2 Volts");
         plot->yAxis->setVisible(true);
         plot->yAxis2->setVisible(true);
-        plot->yAxis2->setTickLabelColor(Qt::blue);
-        plot->yAxis2->setLabelColor(Qt::blue);
-        
-        // Set Y-axis ranges based on gains (exactly as VB.NET)
-        double ch1Range = 10.0 / ch1Gain;
-        double ch2Range = 10.0 / ch2Gain;
-        plot->yAxis->setRange(-ch1Range, ch1Range);
-        plot->yAxis2->setRange(-ch2Range, ch2Range);
-        
-        // Set X-axis range
-        if (x.size() > 1) {
-            plot->xAxis->setRange(0, (x.size() - 1) * multiplier);
-        } else {
-            plot->xAxis->setRange(0, 1);
-        }
-        
-        // Auto-scale if enabled
-        if (autoYRangeEnabled) {
-            plot->graph(0)->rescaleValueAxis(true);
-            plot->graph(1)->rescaleValueAxis(true);
-        }
-        
-    } else if (currentMode == 1) { // CH1 only (CH1_Display_RadioButton)
-        // Ensure we have 1 graph for CH1
-        plot->addGraph();
-        
-        QVector<double> x(ch1.size()), ch1_shifted(ch1.size());
-        for (int i = 0; i < x.size(); ++i) {
-            x[i] = i * multiplier;
-            ch1_shifted[i] = ch1[i] * ch1Gain;
-        }
-        
-        plot->graph(0)->setData(x, ch1_shifted);
-        plot->graph(0)->setPen(QPen(Qt::red, 2));
-        plot->graph(0)->setVisible(true);
-        plot->graph(0)->setValueAxis(plot->yAxis);
-        
-        // Axis setup
+        break;
+    case 1: // CH1 only (CH1_Display_RadioButton)
+        primaryGraph = plot->addGraph(plot->xAxis, plot->yAxis);
+        primaryGraph->setPen(QPen(Qt::red, 2));
         plot->xAxis->setLabel(xAxisTitle);
         plot->yAxis->setLabel("Ch1 Volts");
         plot->yAxis->setVisible(true);
         plot->yAxis2->setVisible(false);
-        plot->yAxis->setTickLabelColor(Qt::red);
-        plot->yAxis->setLabelColor(Qt::red);
-        
-        // Set Y-axis range based on CH1 gain
-        double ch1Range = 10.0 / ch1Gain;
-        plot->yAxis->setRange(-ch1Range, ch1Range);
-        
-        // Set X-axis range
-        if (x.size() > 1) {
-            plot->xAxis->setRange(0, (x.size() - 1) * multiplier);
-        } else {
-            plot->xAxis->setRange(0, 1);
-        }
-        
-        // Auto-scale if enabled
-        if (autoYRangeEnabled) {
-            plot->graph(0)->rescaleValueAxis(true);
-        }
-        
-    } else if (currentMode == 2) { // CH2 only (CH2_Display_RadioButton)
-        // Ensure we have 1 graph for CH2
-        plot->addGraph();
-        
-        QVector<double> x(ch2.size()), ch2_shifted(ch2.size());
-        for (int i = 0; i < x.size(); ++i) {
-            x[i] = i * multiplier;
-            ch2_shifted[i] = ch2[i] * ch2Gain;
-        }
-        
-        plot->graph(0)->setData(x, ch2_shifted);
-        plot->graph(0)->setPen(QPen(Qt::blue, 2));
-        plot->graph(0)->setVisible(true);
-        plot->graph(0)->setValueAxis(plot->yAxis2);
-        
-        // Axis setup
+        break;
+    case 2: // CH2 only (CH2_Display_RadioButton)
+        primaryGraph = plot->addGraph(plot->xAxis, plot->yAxis2);
+        primaryGraph->setPen(QPen(Qt::blue, 2));
         plot->xAxis->setLabel(xAxisTitle);
         plot->yAxis2->setLabel("Ch2 Volts");
         plot->yAxis->setVisible(false);
         plot->yAxis2->setVisible(true);
-        plot->yAxis2->setTickLabelColor(Qt::blue);
-        plot->yAxis2->setLabelColor(Qt::blue);
+        break;
+    case 3: // XY mode (XY_Display_RadioButton)
+        xyRenderer.attach(plot->xAxis, plot->yAxis, Qt::darkGreen);
+        plot->xAxis->setLabel("Ch1 Volts");
+        plot->yAxis->setLabel("Ch2 Volts");
+        plot->yAxis->setVisible(true);
+        plot->yAxis2->setVisible(false);
+        break;
+    case 4: // DFT CH1 (DFT_CH1_Display_RadioButton)
+        primaryGraph = plot->addGraph(plot->xAxis, plot->yAxis);
+        primaryGraph->setPen(QPen(Qt::red, 2));
+        plot->xAxis->setLabel("Frequency (Hz)");
+        plot->yAxis->setLabel("Ch1 Magnitude");
+        plot->yAxis->setVisible(true);
+        plot->yAxis2->setVisible(false);
+        break;
+    case 5: // DFT CH2 (DFT_CH2_Display_RadioButton)
+        primaryGraph = plot->addGraph(plot->xAxis, plot->yAxis);
+        primaryGraph->setPen(QPen(Qt::blue, 2));
+        plot->xAxis->setLabel("Frequency (Hz)");
+        plot->yAxis->setLabel("Ch2 Magnitude");
+        plot->yAxis->setVisible(true);
+        plot->yAxis2->setVisible(false);
+        plot->yAxis->setTickLabelColor(Qt::blue);
+        plot->yAxis->setLabelColor(Qt::blue);
+        break;
+    case 6: // FFT Both CH1 & CH2
+        primaryGraph = plot->addGraph(plot->xAxis, plot->yAxis);
+        primaryGraph->setPen(QPen(Qt::red, 2));
+        secondaryGraph = plot->addGraph(plot->xAxis, plot->yAxis);
+        secondaryGraph->setPen(QPen(Qt::blue, 2));
+        plot->xAxis->setLabel("Frequency (Hz)");
+        plot->yAxis->setLabel("Magnitude");
+        plot->yAxis->setVisible(true);
+        plot->yAxis2->setVisible(false);
+        plot->yAxis->setTickLabelColor(Qt::black);
+        plot->yAxis->setLabelColor(Qt::black);
+        break;
+    case 7: // Spectrum analyser, both channels
+        primaryGraph = plot->addGraph(plot->xAxis, plot->yAxis);
+        primaryGraph->setPen(QPen(Qt::red, 1));
+        secondaryGraph = plot->addGraph(plot->xAxis, plot->yAxis);
+        secondaryGraph->setPen(QPen(Qt::blue, 1));
+        ch1PeakGraph = plot->addGraph(plot->xAxis, plot->yAxis);
+        ch1PeakGraph->setPen(QPen(QColor(255, 0, 0, 110), 1));
+        ch2PeakGraph = plot->addGraph(plot->xAxis, plot->yAxis);
+        ch2PeakGraph->setPen(QPen(QColor(0, 0, 255, 110), 1));
+        plot->xAxis->setLabel("Frequency (Hz)");
+        plot->yAxis->setLabel("dBV");
+        plot->yAxis->setRange(SPECTRUM_MIN_DB, SPECTRUM_MAX_DB);
+        plot->yAxis->setVisible(true);
+        plot->yAxis2->setVisible(false);
+        plot->yAxis->setTickLabelColor(Qt::black);
+        plot->yAxis->setLabelColor(Qt::black);
+        spectrumLastHz = -1.0;
+        break;
+    default:
+        plot->yAxis->setVisible(false);
+        plot->yAxis2->setVisible(false);
+        break;
+    }
+    sceneMode = mode;
+    buildExtraGraphs();
+    buildMaskGraphs();
+}
+
+void PlotManager::buildExtraGraphs()
+{
+    for (QCPGraph *graph : extraGraphs) plot->removeGraph(graph);
+    extraGraphs.clear();
+    if (sceneMode < 0 || sceneMode > 2 || !primaryGraph) return;
+    for (int i = 0; i < extraLod.size(); ++i) {
+        QCPGraph *graph = plot->addGraph(plot->xAxis, primaryGraph->valueAxis());
+        graph->setPen(QPen(EXTRA_COLORS[i % EXTRA_COLOR_COUNT], 1));
+        extraGraphs.append(graph);
+    }
+}
+
+// Two dashed limits per masked channel, on that channel's axis and scaled
+// like its trace
+void PlotManager::buildMaskGraphs()
+{
+    for (QCPGraph *graph : maskGraphs) plot->removeGraph(graph);
+    maskGraphs.clear();
+    maskStale = false;
+    if (sceneMode < 0 || sceneMode > 2 || !primaryGraph) return;
+    const double m = multiplier > 0 ? multiplier : 1.0;
+    for (int ch = 0; ch < 2; ++ch) {
+        const WaveformMask::Envelope& envelope = mask.envelope(ch);
+        if (envelope.isEmpty() || (sceneMode == 1 && ch == 1) || (sceneMode == 2 && ch == 0)) continue;
+        const double gain = ch == 0 ? ch1Gain : ch2Gain;
+        const QColor color = ch == 0 ? QColor(255, 0, 0, 140) : QColor(0, 0, 255, 140);
+        for (const QVector<double> *limit : {&envelope.lower, &envelope.upper}) {
+            QCPGraph *graph = plot->addGraph(plot->xAxis, ch == 0 ? plot->yAxis : plot->yAxis2);
+            graph->setPen(QPen(color, 1, Qt::DashLine));
+            writeGraphData(graph, limit->size(), [m](int i) { return i * m; },
+                           [&](int i) { return (*limit)[i] * gain; });
+            maskGraphs.append(graph);
+        }
+    }
+}
+
+void PlotManager::setMask(const WaveformMask& newMask)
+{
+    mask = newMask;
+    if (!plot) return;
+    buildMaskGraphs();
+    plot->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void PlotManager::setExtraChannelCount(int count)
+{
+    if (count == extraLod.size()) return;
+    extraLod.resize(count);
+    buildExtraGraphs();
+    renderDecimated();
+    plot->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void PlotManager::setExtraChannel(int index, const QVector<double>& samples)
+{
+    if (index < 0 || index >= extraLod.size()) return;
+    // Same scaling as the channel whose axis they share
+    extraLod[index].setData(samples, sceneMode == 2 ? ch2Gain : ch1Gain);
+    if (frameUpdateActive || index >= extraGraphs.size()) return;
+    renderDecimated();
+    plot->replot(QCustomPlot::rpQueuedReplot);
+}
+
+// Time-domain graphs only ever hold the decimated view of the visible x
+// range, about two points per horizontal pixel however long the record is
+void PlotManager::renderDecimated()
+{
+    if (sceneMode < 0 || sceneMode > 2 || !primaryGraph) return;
+    const QCPRange range = plot->xAxis->range();
+    const double m = multiplier > 0 ? multiplier : 1.0;
+    int pixels = plot->axisRect()->width();
+    if (pixels <= 0) pixels = 1000; // Not laid out yet
+    
+    auto render = [&](QCPGraph *graph, const MinMaxDecimator& lod) {
+        // One sample of margin on each side keeps the line running off the edges
+        const double lo = qBound(-1.0, std::floor(range.lower / m) - 1, double(lod.size()));
+        const double hi = qBound(-1.0, std::ceil(range.upper / m) + 1, double(lod.size()));
+        lod.decimate(int(lo), int(hi), pixels, lodIndices, lodValues);
+        writeGraphData(graph, lodIndices.size(), [&](int i) { return lodIndices[i] * m; },
+                       [&](int i) { return lodValues[i]; });
+    };
+    if (sceneMode == 0) {
+        render(primaryGraph, ch1Lod);
+        render(secondaryGraph, ch2Lod);
+    } else {
+        render(primaryGraph, sceneMode == 1 ? ch1Lod : ch2Lod);
+    }
+    for (int i = 0; i < extraGraphs.size() && i < extraLod.size(); ++i) {
+        render(extraGraphs[i], extraLod[i]);
+    }
+}
+
+void PlotManager::updateWaveform(const QVector<double>& ch1, const QVector<double>& ch2)
+{
+    if (!plot) return;
+    if (persistenceSeconds != 0.0 && currentMode >= 0 && currentMode <= 2) {
+        renderPersistence(ch1, ch2);
+        return;
+    }
+    
+    // Graphs, labels and axes persist between frames; only rebuild them
+    // when the display mode changes
+    if (sceneMode != currentMode) {
+        buildScene(currentMode);
+    } else if (maskStale) {
+        buildMaskGraphs();
+    }
+    // Setting the x range below would otherwise re-render from the slot
+    frameUpdateActive = true;
+    
+    if (currentMode == 0) { // Both Channels
+        ch1Lod.setData(ch1, ch1Gain);
+        ch2Lod.setData(ch2, ch2Gain);
+        const int n = ch1.size();
         
-        // Set Y-axis range based on CH2 gain
+        // Set Y-axis ranges based on gains (exactly as VB.NET)
+        double ch1Range = 10.0 / ch1Gain;
         double ch2Range = 10.0 / ch2Gain;
+        plot->yAxis->setRange(-ch1Range, ch1Range);
         plot->yAxis2->setRange(-ch2Range, ch2Range);
-        
-        // Set X-axis range
-        if (x.size() > 1) {
-            plot->xAxis->setRange(0, (x.size() - 1) * multiplier);
-        } else {
-            plot->xAxis->setRange(0, 1);
-        }
+        plot->xAxis->setRange(0, n > 1 ? (n - 1) * multiplier : 1);
+        renderDecimated();
         
         // Auto-scale if enabled
         if (autoYRangeEnabled) {
-            plot->graph(0)->rescaleValueAxis(true);
+            primaryGraph->rescaleValueAxis(true);
+            secondaryGraph->rescaleValueAxis(true);
         }
         
-    } else if (currentMode == 3) { // XY mode (XY_Display_RadioButton)
-        // Ensure we have 1 graph for XY mode
-        plot->addGraph();
-        
-        int N = std::min(ch1.size(), ch2.size());
-        QVector<double> x(N), y(N);
-        for (int i = 0; i < N; ++i) {
-            x[i] = ch1[i] * ch1Gain; // CH1 as X
-            y[i] = ch2[i] * ch2Gain; // CH2 as Y
-        }
+    } else if (currentMode == 1 || currentMode == 2) { // Single channel
+        const QVector<double>& ch = (currentMode == 1) ? ch1 : ch2;
+        const double gain = (currentMode == 1) ? ch1Gain : ch2Gain;
+        (currentMode == 1 ? ch1Lod : ch2Lod).setData(ch, gain);
+        const int n = ch.size();
         
-        plot->graph(0)->setData(x, y);
-        plot->graph(0)->setPen(QPen(Qt::darkGreen, 2));
-        plot->graph(0)->setVisible(true);
-        plot->graph(0)->setValueAxis(plot->yAxis);
+        // Set Y-axis range based on the channel gain
+        double range = 10.0 / gain;
+        primaryGraph->valueAxis()->setRange(-range, range);
+        plot->xAxis->setRange(0, n > 1 ? (n - 1) * multiplier : 1);
+        renderDecimated();
         
-        // Axis setup for XY mode
-        plot->xAxis->setLabel("Ch1 Volts");
-        plot->yAxis->setLabel("Ch2 Volts");
-        plot->yAxis->setVisible(true);
-        plot->yAxis2->setVisible(false);
-        plot->yAxis->setTickLabelColor(Qt::red);
-        plot->yAxis->setLabelColor(Qt::red);
+        if (autoYRangeEnabled) {
+            primaryGraph->rescaleValueAxis(true);
+        }
         
-        // Set ranges based on gains (exactly as VB.NET)
+    } else if (currentMode == 3) { // XY mode
+        // Set ranges based on gains (exactly as VB.NET); the renderer
+        // decimates for them, so they go first
         double ch1Range = 10.0 / ch1Gain;
         double ch2Range = 10.0 / ch2Gain;
         plot->xAxis->setRange(-ch1Range, ch1Range);
         plot->yAxis->setRange(-ch2Range, ch2Range);
+        xyRenderer.update(ch1, ch2, ch1Gain, ch2Gain);
         
-        // Auto-scale if enabled
         if (autoYRangeEnabled) {
-            plot->graph(0)->rescaleValueAxis(true);
+            xyRenderer.curve()->rescaleValueAxis(true);
         }
         
-    } else if (currentMode == 4) { // DFT CH1 (DFT_CH1_Display_RadioButton)
-        // Ensure we have 1 graph for DFT
-        plot->addGraph();
+    } else if (currentMode == 4 || currentMode == 5) { // DFT CH1 / CH2
+        const QVector<double>& ch = (currentMode == 4) ? ch1 : ch2;
+        QVector<double>& spectrum = (currentMode == 4) ? spectrumCh1 : spectrumCh2;
+        fftEngine.magnitudeSpectrum(ch, spectrum, fftWindow);
+        const int bins = spectrum.size();
+        const double binWidth = ch.isEmpty() ? 0.0 : maxFrequency / ch.size();
+        writeGraphData(primaryGraph, bins, [binWidth](int i) { return i * binWidth; },
+                       [&](int i) { return spectrum[i]; });
         
-        QVector<double> mag = simpleDFT(ch1);
-        if (!mag.isEmpty()) {
-            QVector<double> freq(mag.size());
-            for (int i = 0; i < freq.size(); ++i) {
-                freq[i] = i * (maxFrequency / ch1.size());
-            }
-            
-            plot->graph(0)->setData(freq, mag);
-            plot->graph(0)->setPen(QPen(Qt::red, 2));
-            plot->graph(0)->setVisible(true);
-            plot->graph(0)->setValueAxis(plot->yAxis);
-            
-            // Axis setup for DFT
-            plot->xAxis->setLabel("Frequency (Hz)");
-            plot->yAxis->setLabel("Ch1 Magnitude");
-            plot->yAxis->setVisible(true);
-            plot->yAxis2->setVisible(false);
-            plot->yAxis->setTickLabelColor(Qt::red);
-            plot->yAxis->setLabelColor(Qt::red);
-            
-            // Set ranges for DFT
-            plot->xAxis->setRange(0, maxFrequency / 2);
+        plot->xAxis->setRange(0, maxFrequency / 2);
         plot->yAxis->setRange(0, maxDFT);
-        }
-        
-        // Auto-scale if enabled
-        if (autoYRangeEnabled && !mag.isEmpty()) {
-            double maxMag = *std::max_element(mag.begin(), mag.end());
+        if (autoYRangeEnabled && bins > 0) {
+            double maxMag = *std::max_element(spectrum.begin(), spectrum.end());
             plot->yAxis->setRange(0, maxMag * 1.1);
         }
         
-    } else if (currentMode == 5) { // DFT CH2 (DFT_CH2_Display_RadioButton)
-        // Ensure we have 1 graph for DFT
-        plot->addGraph();
-        
-        QVector<double> mag = simpleDFT(ch2);
-        if (!mag.isEmpty()) {
-            QVector<double> freq(mag.size());
-            for (int i = 0; i < freq.size(); ++i) {
-                freq[i] = i * (maxFrequency / ch2.size());
-            }
-            
-            plot->graph(0)->setData(freq, mag);
-            plot->graph(0)->setPen(QPen(Qt::blue, 2));
-            plot->graph(0)->setVisible(true);
-            plot->graph(0)->setValueAxis(plot->yAxis);
-            
-            // Axis setup for DFT
-            plot->xAxis->setLabel("Frequency (Hz)");
-            plot->yAxis->setLabel("Ch2 Magnitude");
-            plot->yAxis->setVisible(true);
-            plot->yAxis2->setVisible(false);
-            plot->yAxis->setTickLabelColor(Qt::blue);
-            plot->yAxis->setLabelColor(Qt::blue);
-            
-            // Set ranges for DFT
-            plot->xAxis->setRange(0, maxFrequency / 2);
-        plot->yAxis->setRange(0, maxDFT);
-        }
-        
-        // Auto-scale if enabled
-        if (autoYRangeEnabled && !mag.isEmpty()) {
-            double maxMag = *std::max_element(mag.begin(), mag.end());
-            plot->yAxis->setRange(0, maxMag * 1.1);
-        }
-        
-    } else if (currentMode == 6) { // NEW: FFT Both CH1 & CH2
-        // Ensure we have 2 graphs for both FFTs
-        plot->addGraph(); // CH1 FFT
-        plot->addGraph(); // CH2 FFT
-        QVector<double> mag1 = simpleDFT(ch1);
-        QVector<double> mag2 = simpleDFT(ch2);
-        QVector<double> freq1(mag1.size()), freq2(mag2.size());
-        for (int i = 0; i < freq1.size(); ++i) freq1[i] = i * (maxFrequency / ch1.size());
-        for (int i = 0; i < freq2.size(); ++i) freq2[i] = i * (maxFrequency / ch2.size());
-        plot->graph(0)->setData(freq1, mag1);
-        plot->graph(0)->setPen(QPen(Qt::red, 2));
-        plot->graph(0)->setVisible(true);
-        plot->graph(0)->setValueAxis(plot->yAxis);
-        plot->graph(1)->setData(freq2, mag2);
-        plot->graph(1)->setPen(QPen(Qt::blue, 2));
-        plot->graph(1)->setVisible(true);
-        plot->graph(1)->setValueAxis(plot->yAxis);
-        // Axis setup for DFT Both
-        plot->xAxis->setLabel("Frequency (Hz)");
-        plot->yAxis->setLabel("Magnitude");
-        plot->yAxis->setVisible(true);
-        plot->yAxis2->setVisible(false);
-        plot->yAxis->setTickLabelColor(Qt::black);
-        plot->yAxis->setLabelColor(Qt::black);
-        // Set ranges for DFT Both
-        double maxF = std::max(maxFrequency / 2, std::max(freq1.last(), freq2.last()));
+    } else if (currentMode == 6) { // FFT Both CH1 & CH2
+        fftEngine.magnitudeSpectrum(ch1, spectrumCh1, fftWindow);
+        fftEngine.magnitudeSpectrum(ch2, spectrumCh2, fftWindow);
+        const double binWidth1 = ch1.isEmpty() ? 0.0 : maxFrequency / ch1.size();
+        const double binWidth2 = ch2.isEmpty() ? 0.0 : maxFrequency / ch2.size();
+        writeGraphData(primaryGraph, spectrumCh1.size(), [binWidth1](int i) { return i * binWidth1; },
+                       [this](int i) { return spectrumCh1[i]; });
+        writeGraphData(secondaryGraph, spectrumCh2.size(), [binWidth2](int i) { return i * binWidth2; },
+                       [this](int i) { return spectrumCh2[i]; });
+        
+        double maxF = maxFrequency / 2;
+        if (!spectrumCh1.isEmpty()) maxF = std::max(maxF, (spectrumCh1.size() - 1) * binWidth1);
+        if (!spectrumCh2.isEmpty()) maxF = std::max(maxF, (spectrumCh2.size() - 1) * binWidth2);
         plot->xAxis->setRange(0, maxF);
         double maxMag = 0;
-        if (!mag1.isEmpty()) maxMag = std::max(maxMag, *std::max_element(mag1.begin(), mag1.end()));
-        if (!mag2.isEmpty()) maxMag = std::max(maxMag, *std::max_element(mag2.begin(), mag2.end()));
+        if (!spectrumCh1.isEmpty()) maxMag = std::max(maxMag, *std::max_element(spectrumCh1.begin(), spectrumCh1.end()));
+        if (!spectrumCh2.isEmpty()) maxMag = std::max(maxMag, *std::max_element(spectrumCh2.begin(), spectrumCh2.end()));
         plot->yAxis->setRange(0, maxMag * 1.1);
-        // Auto-scale if enabled
         if (autoYRangeEnabled) {
-            plot->graph(0)->rescaleValueAxis(true);
-            plot->graph(1)->rescaleValueAxis(true);
+            primaryGraph->rescaleValueAxis(true);
+            secondaryGraph->rescaleValueAxis(true);
         }
     }
     
-    // Always show trigger level line if enabled
+    frameUpdateActive = false;
+    
+    // Trigger level line is only kept on the waveform when enabled
     if (triggerLineEnabled) {
         plotTriggerLine();
+    } else {
+        triggerLine->setVisible(false);
     }
     
-    // Make sure the graph gets redrawn
-    plot->replot();
+    // One coalesced redraw for everything updated this frame
+    plot->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void PlotManager::updateSpectrum(const SpectrumSnapshot& snapshot)
+{
+    if (!plot || currentMode != 7) return;
+    if (sceneMode != currentMode) {
+        buildScene(currentMode);
+    }
+    const double firstHz = snapshot.firstHz, binHz = snapshot.binHz;
+    auto write = [&](QCPGraph *graph, const QVector<double>& db) {
+        writeGraphData(graph, db.size(), [=](int i) { return firstHz + i * binHz; }, [&](int i) { return db[i]; });
+    };
+    write(primaryGraph, snapshot.average[0]);
+    write(secondaryGraph, snapshot.average[1]);
+    write(ch1PeakGraph, snapshot.peak[0]);
+    write(ch2PeakGraph, snapshot.peak[1]);
+
+    // Refit the x axis only when the band changes, so zoom and pan survive updates
+    const int bins = std::max(snapshot.average[0].size(), snapshot.average[1].size());
+    const double lastHz = firstHz + (bins > 0 ? bins - 1 : 0) * binHz;
+    if (bins > 1 && (firstHz != spectrumFirstHz || lastHz != spectrumLastHz)) {
+        spectrumFirstHz = firstHz;
+        spectrumLastHz = lastHz;
+        plot->xAxis->setRange(firstHz, lastHz);
+    }
+    if (autoYRangeEnabled && bins > 0) {
+        double maxDb = SPECTRUM_MIN_DB;
+        for (const QVector<double>& db : {snapshot.average[0], snapshot.average[1], snapshot.peak[0], snapshot.peak[1]}) {
+            if (!db.isEmpty()) maxDb = std::max(maxDb, *std::max_element(db.begin(), db.end()));
+        }
+        const double top = std::ceil((maxDb + 10.0) / 10.0) * 10.0;
+        plot->yAxis->setRange(top - SPECTRUM_AUTO_SPAN_DB, top);
+    }
+    triggerLine->setVisible(false);
+    plot->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void PlotManager::setAnnotations(const QVector<ProtocolAnnotation>& annotations, double firstSample, int sampleCount)
+{
+    if (!plot) return;
+    int shown = 0;
+    if (currentMode >= 0 && currentMode <= 2) {
+        const double m = multiplier > 0 ? multiplier : 1.0;
+        const double lastSample = firstSample + sampleCount;
+        for (const ProtocolAnnotation& a : annotations) {
+            if (shown == MAX_ANNOTATION_LABELS) break;
+            const double middle = 0.5 * (double(a.startSample) + double(a.endSample));
+            if (middle < firstSample || middle > lastSample) continue;
+            if (shown == annotationLabels.size()) {
+                QCPItemText *label = new QCPItemText(plot);
+                label->position->setTypeX(QCPItemPosition::ptPlotCoords);
+                label->position->setTypeY(QCPItemPosition::ptAxisRectRatio);
+                label->position->setAxes(plot->xAxis, plot->yAxis);
+                label->setPositionAlignment(Qt::AlignHCenter | Qt::AlignTop);
+                label->setFont(QFont("Arial", 8));
+                label->setPadding(QMargins(2, 1, 2, 1));
+                label->setBrush(QBrush(QColor(255, 255, 224, 220)));
+                label->setPen(QPen(Qt::darkGray));
+                annotationLabels.append(label);
+            }
+            QCPItemText *label = annotationLabels[shown++];
+            const bool error = a.kind == ProtocolAnnotation::ParityError || a.kind == ProtocolAnnotation::FramingError
+                               || a.kind == ProtocolAnnotation::Nack;
+            label->setColor(error ? Qt::red : Qt::black);
+            label->setText(annotationText(a));
+            label->position->setCoords((middle - firstSample) * m, 0.02 + a.bus * ANNOTATION_ROW_HEIGHT);
+            label->setVisible(true);
+        }
+    }
+    for (int i = shown; i < annotationLabels.size(); ++i) annotationLabels[i]->setVisible(false);
+}
+
+void PlotManager::clearAnnotations()
+{
+    for (QCPItemText *label : annotationLabels) label->setVisible(false);
+    plot->replot(QCustomPlot::rpQueuedReplot);
+}
+
+// Digital phosphor view of the time-domain modes: each frame is added to
+// the hit histograms, which fade with the persistence time constant
+void PlotManager::renderPersistence(const QVector<double>& ch1, const QVector<double>& ch2)
+{
+    if (sceneMode != INTENSITY_SCENE) buildIntensityScene();
+    frameUpdateActive = true;
+
+    // Decay by the real time between frames so the fade does not depend on the frame rate
+    double factor = 1.0;
+    if (persistenceClock.isValid() && persistenceSeconds > 0.0) {
+        factor = std::exp(-persistenceClock.elapsed() / (1000.0 * persistenceSeconds));
+    }
+    persistenceClock.start();
+
+    int pixels = plot->axisRect()->width();
+    if (pixels <= 0) pixels = 1000; // Not laid out yet
+    const int n = (currentMode == 2) ? ch2.size() : ch1.size();
+    const double xSpan = n > 1 ? (n - 1) * multiplier : 1.0;
+    // A new time base starts the accumulation over
+    const bool restart = xSpan != persistenceSpan;
+    persistenceSpan = xSpan;
+
+    auto render = [&](bool show, const QVector<double>& ch, QCPColorMap *map, PersistenceHistogram& histogram, double gain) {
+        map->setVisible(show && !ch.isEmpty());
+        map->valueAxis()->setVisible(show);
+        if (!map->visible()) return;
+        const double range = 10.0 / gain;
+        // Cells about one pixel wide however long the record is
+        const int columns = qMin(ch.size(), pixels);
+        if (restart || !histogram.matches(columns, INTENSITY_ROWS, -range, range)) {
+            histogram.configure(columns, INTENSITY_ROWS, -range, range);
+        } else {
+            histogram.decay(factor);
+        }
+        histogram.addTrace(ch.constData(), ch.size(), gain);
+        writeColorMap(map, histogram, QCPRange(0, xSpan));
+        map->valueAxis()->setRange(-range, range);
+    };
+    render(currentMode != 2, ch1, ch1Intensity, ch1Histogram, ch1Gain);
+    render(currentMode != 1, ch2, ch2Intensity, ch2Histogram, ch2Gain);
+    plot->xAxis->setRange(0, xSpan);
+    frameUpdateActive = false;
+
+    if (triggerLineEnabled) {
+        plotTriggerLine();
+    } else {
+        triggerLine->setVisible(false);
+    }
+    plot->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void PlotManager::setPersistence(double seconds)
+{
+    persistenceSeconds = seconds;
+    xyRenderer.setPersistence(seconds);
+    clearPersistence();
+}
+
+void PlotManager::clearPersistence()
+{
+    persistenceSpan = -1.0;
+    persistenceClock.invalidate();
+    xyRenderer.clearPersistence();
+    // Back to the graphs on the next frame when persistence was turned off
+    if (persistenceSeconds == 0.0 && sceneMode == INTENSITY_SCENE) sceneMode = -1;
 }
 
 void PlotManager::plotFFT(const QVector<double>& ch) {
     if (ch.isEmpty()) return;
+    sceneMode = -1; // Restyles graph(0); rebuild the scene on the next frame
     
-    QVector<double> mag = simpleDFT(ch);
+    QVector<double> mag = fftEngine.magnitudeSpectrum(ch, fftWindow);
     if (mag.isEmpty()) return;
     
     QVector<double> x(mag.size());
@@ -474,59 +702,32 @@ void PlotManager::plotFFT(const QVector<double>& ch) {
     plot->yAxis->setRange(0, *std::max_element(mag.begin(), mag.end()) * 1.1);
 }
 
-void PlotManager::plotXY(const QVector<double>& ch1, const QVector<double>& ch2) {
-    // Ensure we have 1 graph for XY mode
-    if (plot->graphCount() < 1) plot->addGraph();
-    while (plot->graphCount() > 1) plot->removeGraph(plot->graphCount() - 1);
-    
-    int N = std::min(ch1.size(), ch2.size());
-    QVector<double> x(N), y(N);
-    for (int i = 0; i < N; ++i) { x[i] = ch1[i]; y[i] = ch2[i]; }
-    plot->graph(0)->setData(x, y);
-    plot->graph(0)->setVisible(true);
-    plot->xAxis->setLabel("CH1");
-    plot->yAxis->setLabel("CH2");
-    plot->xAxis->setRange(*std::min_element(x.begin(), x.end()), *std::max_element(x.begin(), x.end()));
-    plot->yAxis->setRange(*std::min_element(y.begin(), y.end()), *std::max_element(y.begin(), y.end()));
-}
-
 void PlotManager::plotTriggerLine() {
     // Don't draw trigger line if trigger level is not set or if plot is not ready
     if (qIsNaN(triggerLevel) || !plot || plot->xAxis->range().size() <= 0) {
+        if (triggerLine) triggerLine->setVisible(false);
         return;
     }
     
-    QCPItemLine *line = new QCPItemLine(plot);
-    if (triggerOnCh2) {
-        line->start->setCoords(plot->xAxis->range().lower, triggerLevel);
-        line->end->setCoords(plot->xAxis->range().upper, triggerLevel);
-        line->setPen(QPen(triggerColor, 2, Qt::DashLine));
-        line->setClipToAxisRect(true);
-        line->start->setType(QCPItemPosition::ptPlotCoords);
-        line->end->setType(QCPItemPosition::ptPlotCoords);
-        line->start->setAxes(plot->xAxis, plot->yAxis2);
-        line->end->setAxes(plot->xAxis, plot->yAxis2);
-    } else {
-        line->start->setCoords(plot->xAxis->range().lower, triggerLevel);
-        line->end->setCoords(plot->xAxis->range().upper, triggerLevel);
-        line->setPen(QPen(triggerColor, 2, Qt::DashLine));
-        line->setClipToAxisRect(true);
-        line->start->setType(QCPItemPosition::ptPlotCoords);
-        line->end->setType(QCPItemPosition::ptPlotCoords);
-        line->start->setAxes(plot->xAxis, plot->yAxis);
-        line->end->setAxes(plot->xAxis, plot->yAxis);
-    }
+    QCPAxis *valueAxis = triggerOnCh2 ? plot->yAxis2 : plot->yAxis;
+    triggerLine->start->setAxes(plot->xAxis, valueAxis);
+    triggerLine->end->setAxes(plot->xAxis, valueAxis);
+    triggerLine->start->setCoords(0.0, triggerLevel);
+    triggerLine->end->setCoords(1.0, triggerLevel);
+    triggerLine->setPen(QPen(triggerColor, 2, Qt::DashLine));
+    triggerLine->setVisible(true);
 }
 
 void PlotManager::plotData(QCustomPlot *plot, const QVector<double>& ch1, const QVector<double>& ch2, const QVector<double>& xvals) {
-    qDebug() << "[PlotManager] plotData: Received CH1 size:" << ch1.size() << "CH2 size:" << ch2.size() << "X size:" << xvals.size();
-    qDebug() << "[PlotManager] plotData: CH1 first 5 values:" << (ch1.size() >= 5 ? QVector<double>(ch1.begin(), ch1.begin() + 5) : ch1);
-    qDebug() << "[PlotManager] plotData: CH2 first 5 values:" << (ch2.size() >= 5 ? QVector<double>(ch2.begin(), ch2.begin() + 5) : ch2);
-    qDebug() << "[PlotManager] plotData: X first 5 values:" << (xvals.size() >= 5 ? QVector<double>(xvals.begin(), xvals.begin() + 5) : xvals);
+    qCDebug(lcFrame) << "[PlotManager] plotData: Received CH1 size:" << ch1.size() << "CH2 size:" << ch2.size() << "X size:" << xvals.size();
+    qCDebug(lcSample) << "[PlotManager] plotData: CH1 first 5 values:" << (ch1.size() >= 5 ? QVector<double>(ch1.begin(), ch1.begin() + 5) : ch1);
+    qCDebug(lcSample) << "[PlotManager] plotData: CH2 first 5 values:" << (ch2.size() >= 5 ? QVector<double>(ch2.begin(), ch2.begin() + 5) : ch2);
+    qCDebug(lcSample) << "[PlotManager] plotData: X first 5 values:" << (xvals.size() >= 5 ? QVector<double>(xvals.begin(), xvals.begin() + 5) : xvals);
     
     lastCh1 = ch1;
     lastCh2 = ch2;
     lastX = xvals;
+    sceneMode = -1; // Restyles the graphs; rebuild the scene on the next frame
     // Defensive: Ensure at least two graphs exist
     while (plot->graphCount() < 2) plot->addGraph();
     plot->graph(0)->setData(xvals, ch1);
@@ -548,7 +749,7 @@ void PlotManager::plotData(QCustomPlot *plot, const QVector<double>& ch1, const
     // Set fixed x-axis range to prevent fluctuations
     double fixedXRange = 1000.0; // Fixed 1000 μs range
     plot->xAxis->setRange(0, fixedXRange);
-    qDebug() << "[PlotManager] plotData: Set X range to 0 to" << fixedXRange << "Y range to" << plot->yAxis->range().lower << "to" << plot->yAxis->range().upper;
+    qCDebug(lcFrame) << "[PlotManager] plotData: Set X range to 0 to" << fixedXRange << "Y range to" << plot->yAxis->range().lower << "to" << plot->yAxis->range().upper;
     plot->replot();
 }
 
@@ -556,137 +757,66 @@ QVector<QVector<double>> PlotManager::getData() const {
     return {lastX, lastCh1, lastCh2};
 }
 
-double PlotManager::getYAxisRangeFromGain(double gain) const {
-    // Convert gain to voltage range based on UI gain settings
-    // Gain values: 0.5=±20V, 1.0=±10V, 2.0=±5V, 4.0=±2.5V, 8.0=±1.25V, 16.0=±0.625V
-    if (gain <= 0.5) return 20.0;      // ±20V
-    else if (gain <= 1.0) return 10.0; // ±10V
-    else if (gain <= 2.0) return 5.0;  // ±5V
-    else if (gain <= 4.0) return 2.5;  // ±2.5V
-    else if (gain <= 8.0) return 1.25; // ±1.25V
-    else return 0.625;                 // ±0.625V
+// One colour-mapped layer per channel replaces the graphs, however many
+// traces are overlaid
+void PlotManager::buildIntensityScene()
+{
+    buildScene(-1);
+    auto makeLayer = [this](QCPAxis *valueAxis, const QColor& color) {
+        QCPColorMap *map = new QCPColorMap(plot->xAxis, valueAxis);
+        QCPColorGradient gradient;
+        gradient.clearColorStops();
+        gradient.setColorStopAt(0.0, QColor(color.red(), color.green(), color.blue(), 0));
+        gradient.setColorStopAt(0.001, QColor(color.red(), color.green(), color.blue(), 60));
+        gradient.setColorStopAt(1.0, color);
+        gradient.setColorInterpolation(QCPColorGradient::ciRGB);
+        map->setGradient(gradient);
+        map->setInterpolate(false);
+        map->setTightBoundary(true);
+        return map;
+    };
+    ch1Intensity = makeLayer(plot->yAxis, Qt::red);
+    ch2Intensity = makeLayer(plot->yAxis2, Qt::blue);
+    plot->xAxis->setLabel(xAxisTitle);
+    plot->yAxis->setLabel("Ch1 Volts");
+    plot->yAxis2->setLabel("Ch2 Volts");
+    plot->yAxis->setVisible(true);
+    plot->yAxis2->setVisible(true);
+    sceneMode = INTENSITY_SCENE;
+    // Whatever was accumulated belongs to the previous scene
+    persistenceSpan = -1.0;
 }
 
-void PlotManager::updateWaveformWithMultipleTraces(const QVector<QVector<double>>& ch1Traces, const QVector<QVector<double>>& ch2Traces) {
-    // Clear existing graphs
-    plot->clearGraphs();
-    
-    // Setup plot appearance
-    plot->legend->setVisible(true);
-    plot->xAxis->grid()->setVisible(true);
-    plot->yAxis->grid()->setVisible(true);
-    plot->yAxis2->grid()->setVisible(true);
-    QLinearGradient bg(0,0,0,400);
-    bg.setColorAt(0, Qt::white);
-    bg.setColorAt(1, QColor(220,220,220));
-    plot->setBackground(bg);
-    
-    // Ensure dual-axis setup is properly configured
-    plot->yAxis2->setVisible(true);
-    plot->yAxis2->setTickLabels(true);
-    plot->yAxis2->setSubTicks(true);
-    plot->yAxis2->setTickLabelFont(QFont("Arial", 8));
-    plot->yAxis2->setLabelFont(QFont("Arial", 10));
-    
-    // Set axis colors
-    plot->yAxis->setTickLabelColor(Qt::blue);
-    plot->yAxis->setLabelColor(Qt::blue);
-    plot->yAxis->setBasePen(QPen(Qt::blue));
-    plot->yAxis->setTickPen(QPen(Qt::blue));
-    plot->yAxis->setSubTickPen(QPen(Qt::blue));
-    
-    plot->yAxis2->setTickLabelColor(Qt::red);
-    plot->yAxis2->setLabelColor(Qt::red);
-    plot->yAxis2->setBasePen(QPen(Qt::red));
-    plot->yAxis2->setTickPen(QPen(Qt::red));
-    plot->yAxis2->setSubTickPen(QPen(Qt::red));
-    
-    // Define colors for different traces
-    QVector<QColor> colors = {
-        Qt::blue, Qt::red, Qt::green, Qt::magenta, Qt::cyan, 
-        Qt::darkBlue, Qt::darkRed, Qt::darkGreen, Qt::darkMagenta, Qt::darkCyan
-    };
-    
-    int maxSize = 0;
-    double ch1Min = 0, ch1Max = 0, ch2Min = 0, ch2Max = 0;
-    bool ch1DataFound = false, ch2DataFound = false;
-    
-    // Add CH1 traces
-    for (int i = 0; i < ch1Traces.size(); ++i) {
-        plot->addGraph();
-        int graphIndex = plot->graphCount() - 1;
-        
-        QVector<double> x(ch1Traces[i].size());
-        QVector<double> ch1_shifted(ch1Traces[i].size());
-        for (int j = 0; j < x.size(); ++j) {
-            x[j] = j * multiplier;
-            ch1_shifted[j] = ch1Traces[i][j] * ch1Gain;
-        }
-        
-        plot->graph(graphIndex)->setData(x, ch1_shifted);
-        plot->graph(graphIndex)->setPen(QPen(colors[i % colors.size()], 2));
-        plot->graph(graphIndex)->setVisible(true);
-        plot->graph(graphIndex)->setValueAxis(plot->yAxis);
-        plot->graph(graphIndex)->setName(QString("CH1 Trace %1").arg(i + 1));
-        
-        // Track min/max for CH1 axis scaling
-        if (!ch1DataFound) {
-            ch1Min = ch1Max = ch1_shifted[0];
-            ch1DataFound = true;
-        }
-        for (double val : ch1_shifted) {
-            ch1Min = qMin(ch1Min, val);
-            ch1Max = qMax(ch1Max, val);
-        }
-        
-        maxSize = qMax(maxSize, x.size());
-    }
-    
-    // Add CH2 traces
-    for (int i = 0; i < ch2Traces.size(); ++i) {
-        plot->addGraph();
-        int graphIndex = plot->graphCount() - 1;
-        
-        QVector<double> x(ch2Traces[i].size());
-        QVector<double> ch2_shifted(ch2Traces[i].size());
-        for (int j = 0; j < x.size(); ++j) {
-            x[j] = j * multiplier;
-            ch2_shifted[j] = ch2Traces[i][j] * ch2Gain; // Use CH2 gain
-        }
-        
-        plot->graph(graphIndex)->setData(x, ch2_shifted);
-        plot->graph(graphIndex)->setPen(QPen(colors[(i + ch1Traces.size()) % colors.size()], 2, Qt::DashLine));
-        plot->graph(graphIndex)->setVisible(true);
-        plot->graph(graphIndex)->setValueAxis(plot->yAxis2); // Use CH2 axis (yAxis2)
-        plot->graph(graphIndex)->setName(QString("CH2 Trace %1").arg(i + 1));
-        
-        // Track min/max for CH2 axis scaling
-        if (!ch2DataFound) {
-            ch2Min = ch2Max = ch2_shifted[0];
-            ch2DataFound = true;
-        }
-        for (double val : ch2_shifted) {
-            ch2Min = qMin(ch2Min, val);
-            ch2Max = qMax(ch2Max, val);
+void PlotManager::updateTraceIntensity(const TracePool& pool)
+{
+    if (!plot || pool.isEmpty()) return;
+    if (sceneMode != INTENSITY_SCENE) buildIntensityScene();
+    frameUpdateActive = true;
+    // The pool is redrawn from scratch; persistence would resume from it
+    persistenceSpan = -1.0;
+
+    const int n = pool.traceLength();
+    const double xSpan = n > 1 ? (n - 1) * multiplier : 1.0;
+    auto render = [&](int channel, QCPColorMap *map, PersistenceHistogram& histogram, double gain) {
+        map->setVisible(pool.hasChannel(channel));
+        if (!pool.hasChannel(channel)) return;
+        const double range = 10.0 / gain;
+        histogram.configure(n, INTENSITY_ROWS, -range, range);
+        for (int t = 0; t < pool.count(); ++t) {
+            histogram.addTrace(pool.trace(channel, t), n, gain);
         }
-        
-        maxSize = qMax(maxSize, x.size());
+        writeColorMap(map, histogram, QCPRange(0, xSpan));
+        map->valueAxis()->setRange(-range, range);
+    };
+    render(0, ch1Intensity, ch1Histogram, ch1Gain);
+    render(1, ch2Intensity, ch2Histogram, ch2Gain);
+    plot->xAxis->setRange(0, xSpan);
+    frameUpdateActive = false;
+
+    if (triggerLineEnabled) {
+        plotTriggerLine();
+    } else {
+        triggerLine->setVisible(false);
     }
-    
-    // Set axis labels and ranges
-    plot->xAxis->setLabel("Time (μs)");
-    plot->yAxis->setLabel("CH1 Volts");
-    plot->yAxis2->setLabel("CH2 Volts");
-    
-    // Set x-axis range to 0-100μs (fixed range for comparison)
-    plot->xAxis->setRange(0, 100);
-    
-    // Set Y-axis ranges based on CH1's gain (as requested by user)
-    double ch1Range = getYAxisRangeFromGain(ch1Gain);
-    plot->yAxis->setRange(-ch1Range, ch1Range);
-    plot->yAxis2->setRange(-ch1Range, ch1Range);
-    
-    // Always show trigger level line
-    plotTriggerLine();
-    plot->replot();
+    plot->replot(QCustomPlot::rpQueuedReplot);
 } 
\ No newline at end of file
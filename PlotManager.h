@@ -2,8 +2,21 @@
 #include <QObject>
 #include <QVector>
 #include <QColor>
+#include <QElapsedTimer>
+#include "FFTEngine.h"
+#include "MinMaxDecimator.h"
+#include "PersistenceHistogram.h"
+#include "ProtocolDecoder.h"
+#include "SpectrumAnalyzer.h"
+#include "TracePool.h"
+#include "WaveformMask.h"
+#include "XYRenderer.h"
 
 class QCustomPlot;
+class QCPGraph;
+class QCPColorMap;
+class QCPItemLine;
+class QCPItemText;
 class QWidget;
 
 class PlotManager : public QObject {
@@ -13,12 +26,31 @@ public:
     ~PlotManager();
     QWidget* plotWidget() const;
     void updateWaveform(const QVector<double>& ch1, const QVector<double>& ch2);
-    void updateWaveformWithMultipleTraces(const QVector<QVector<double>>& ch1Traces, const QVector<QVector<double>>& ch2Traces);
+    // Add mode: all traces of the pool as one intensity-graded layer per channel
+    void updateTraceIntensity(const TracePool& pool);
+    // Digital phosphor for the time-domain modes: frames accumulate into a
+    // hit histogram that fades with this time constant. 0 = off, < 0 = infinite.
+    void setPersistence(double seconds);
+    void clearPersistence();
+    // Channels of secondary devices, in volts, drawn on the primary value
+    // axis of the time-domain views
+    void setExtraChannelCount(int count);
+    void setExtraChannel(int index, const QVector<double>& samples);
     void setMode(int mode);
     void setGains(double ch1Gain, double ch2Gain);
     void setTriggerLine(bool enabled, double level, bool onCh2, QColor color = Qt::magenta);
     void updateTriggerLevel(double level, bool onCh2 = false);
-    void setDisplayMode(int mode); // 0=Both, 1=CH1, 2=CH2, 3=XY, 4=DFT1, 5=DFT2
+    void setDisplayMode(int mode); // 0=Both, 1=CH1, 2=CH2, 3=XY, 4=DFT1, 5=DFT2, 6=DFT12, 7=Spectrum
+    // Spectrum mode: averaged (and peak-held) spectra from the DSP worker, dBV
+    void updateSpectrum(const SpectrumSnapshot& snapshot);
+    // Bus events labelled over the time-domain views with the next update.
+    // Positions are in samples; the view shows sampleCount of them from
+    // firstSample, which is at x = 0.
+    void setAnnotations(const QVector<ProtocolAnnotation>& annotations, double firstSample, int sampleCount);
+    void clearAnnotations();
+    // Mask limits, dashed over the time-domain views from the next update;
+    // an empty mask removes them
+    void setMask(const WaveformMask& mask);
     void setXAxisTitle(const QString& title);
     void setYAxisTitle(const QString& title);
     void setY2AxisTitle(const QString& title);
@@ -30,6 +62,7 @@ public:
     QVector<QVector<double>> getData() const;
     void plotTriggerLine();
     void setAutoYRangeEnabled(bool enabled);
+    void setFFTWindow(FFTEngine::Window window);
     // TODO: Add methods for updating plots, modes, etc.
 private:
     QCustomPlot *plot;
@@ -45,8 +78,46 @@ private:
     double maxFrequency = 1.0;
     QString xAxisTitle = "Time (μs)"; // Default X-axis title
     QVector<double> lastCh1, lastCh2, lastX;
+    // Persistent scene, rebuilt only when the display mode changes
+    int sceneMode = -1;
+    QCPGraph *primaryGraph = nullptr;
+    QCPGraph *secondaryGraph = nullptr;
+    QCPItemText *scopeText = nullptr;
+    QCPItemText *signatureText = nullptr;
+    QCPItemLine *triggerLine = nullptr;
+    // Labels of the bus events, reused from frame to frame
+    QVector<QCPItemText*> annotationLabels;
+    WaveformMask mask;
+    QVector<QCPGraph*> maskGraphs;
+    bool maskStale = false; // gains or time base changed since drawn
+    // Spectrum mode's peak hold traces
+    QCPGraph *ch1PeakGraph = nullptr;
+    QCPGraph *ch2PeakGraph = nullptr;
+    double spectrumFirstHz = 0.0, spectrumLastHz = -1.0; // x range last fitted
+    QVector<double> spectrumCh1, spectrumCh2;
+    // Min/max level-of-detail for the time-domain modes
+    MinMaxDecimator ch1Lod, ch2Lod;
+    QVector<double> lodIndices, lodValues;
+    XYRenderer xyRenderer;
+    QVector<MinMaxDecimator> extraLod;
+    QVector<QCPGraph*> extraGraphs;
+    // Intensity layers of the Add view
+    QCPColorMap *ch1Intensity = nullptr;
+    QCPColorMap *ch2Intensity = nullptr;
+    PersistenceHistogram ch1Histogram, ch2Histogram;
+    double persistenceSeconds = 0.0;
+    double persistenceSpan = -1.0; // x span the histograms were built for
+    QElapsedTimer persistenceClock;
+    bool frameUpdateActive = false;
     bool autoYRangeEnabled = true;
+    FFTEngine fftEngine;
+    FFTEngine::Window fftWindow = FFTEngine::Window::Rectangular;
+    qint64 replotStartNs = 0; // traced render in progress
+    void buildScene(int mode);
+    void buildExtraGraphs();
+    void buildMaskGraphs();
+    void renderDecimated();
+    void buildIntensityScene();
+    void renderPersistence(const QVector<double>& ch1, const QVector<double>& ch2);
     void plotFFT(const QVector<double>& ch);
-    void plotXY(const QVector<double>& ch1, const QVector<double>& ch2);
-    double getYAxisRangeFromGain(double gain) const;
 }; 
\ No newline at end of file
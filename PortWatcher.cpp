@@ -0,0 +1,58 @@
+#include "PortWatcher.h"
+#include <QDebug>
+#include <QFileSystemWatcher>
+#include <QSerialPortInfo>
+#include <QThread>
+#include <QTimer>
+
+namespace {
+// A plugged device raises several notifications, and its port may only be
+// listed a little after the first
+constexpr int SETTLE_MS = 300;
+}
+
+PortWatcher::PortWatcher(quint16 boardVid, quint16 boardPid, QObject* parent)
+    : QObject(parent), vid(boardVid), pid(boardPid) {}
+
+void PortWatcher::start() {
+    settleTimer = new QTimer(this);
+    settleTimer->setSingleShot(true);
+    settleTimer->setInterval(SETTLE_MS);
+    connect(settleTimer, &QTimer::timeout, this, &PortWatcher::scan);
+#ifndef Q_OS_WIN
+    // Device nodes come and go with the hardware
+    devWatcher = new QFileSystemWatcher(this);
+    if (devWatcher->addPath("/dev")) {
+        connect(devWatcher, &QFileSystemWatcher::directoryChanged, this, &PortWatcher::rescan);
+    } else {
+        qWarning() << "[PortWatcher] Cannot watch /dev; ports are only rescanned on request";
+    }
+#endif
+    scan();
+}
+
+void PortWatcher::rescan() {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, &PortWatcher::rescan, Qt::QueuedConnection);
+        return;
+    }
+    if (settleTimer) settleTimer->start();
+}
+
+void PortWatcher::scan() {
+    QStringList ports;
+    QStringList boards;
+    for (const QSerialPortInfo& info : QSerialPortInfo::availablePorts()) {
+        ports.append(info.portName());
+        if (info.hasVendorIdentifier() && info.hasProductIdentifier()
+            && info.vendorIdentifier() == vid && info.productIdentifier() == pid) {
+            boards.append(info.portName());
+        }
+    }
+    if (scanned && ports == lastPorts && boards == lastBoards) return;
+    scanned = true;
+    lastPorts = ports;
+    lastBoards = boards;
+    qDebug() << "[PortWatcher] Ports:" << ports << "boards:" << boards;
+    emit portsChanged(ports, boards);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <QObject>
+#include <QStringList>
+
+class QFileSystemWatcher;
+class QTimer;
+
+// Serial port discovery off the GUI thread. Enumerating ports can take
+// hundreds of milliseconds (SetupAPI on Windows), so it runs on the
+// watcher's own thread, once at start and then only when devices change:
+// elsewhere it watches /dev itself; on Windows the window receiving
+// WM_DEVICECHANGE forwards it to rescan(). Bursts of notifications make one
+// scan, and portsChanged is only emitted when the list differs.
+class PortWatcher : public QObject {
+    Q_OBJECT
+public:
+    // Ports carrying these USB ids are reported as the boards'
+    PortWatcher(quint16 boardVid, quint16 boardPid, QObject* parent = nullptr);
+
+public slots:
+    // On the watcher's thread: the first scan, then watching
+    void start();
+    // Thread-safe; scans once the notifications settle
+    void rescan();
+
+signals:
+    // boardPorts are the ones with the board's ids, in listing order
+    void portsChanged(const QStringList& ports, const QStringList& boardPorts);
+
+private:
+    void scan();
+
+    quint16 vid;
+    quint16 pid;
+    QFileSystemWatcher* devWatcher = nullptr;
+    QTimer* settleTimer = nullptr;
+    bool scanned = false;
+    QStringList lastPorts;
+    QStringList lastBoards;
+};
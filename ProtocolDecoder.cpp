@@ -0,0 +1,245 @@
+#include "ProtocolDecoder.h"
+#include <cmath>
+
+namespace {
+inline bool lineLevel(quint8 sample, int line) {
+    return line >= 0 && (sample >> line) & 1;
+}
+
+QString hex(quint32 value) {
+    return "0x" + QString::number(value, 16).toUpper().rightJustified(2, '0');
+}
+}
+
+QString annotationText(const ProtocolAnnotation& a) {
+    switch (a.kind) {
+    case ProtocolAnnotation::Start: return "S";
+    case ProtocolAnnotation::Stop: return "P";
+    case ProtocolAnnotation::Address:
+        return QString(a.value & 1 ? "R " : "W ") + hex(a.value >> 1);
+    case ProtocolAnnotation::Data:
+        if (a.value >= 0x20 && a.value < 0x7F) return QString("%1 '%2'").arg(hex(a.value)).arg(QChar(char(a.value)));
+        return hex(a.value);
+    case ProtocolAnnotation::Word:
+        return hex(a.value) + "/" + hex(a.value2);
+    case ProtocolAnnotation::Ack: return "ACK";
+    case ProtocolAnnotation::Nack: return "NACK";
+    case ProtocolAnnotation::ParityError: return hex(a.value) + " parity!";
+    case ProtocolAnnotation::FramingError: return hex(a.value) + " framing!";
+    }
+    return hex(a.value);
+}
+
+const char* annotationKindName(ProtocolAnnotation::Kind kind) {
+    switch (kind) {
+    case ProtocolAnnotation::Start: return "start";
+    case ProtocolAnnotation::Stop: return "stop";
+    case ProtocolAnnotation::Address: return "address";
+    case ProtocolAnnotation::Data: return "data";
+    case ProtocolAnnotation::Word: return "word";
+    case ProtocolAnnotation::Ack: return "ack";
+    case ProtocolAnnotation::Nack: return "nack";
+    case ProtocolAnnotation::ParityError: return "parity_error";
+    case ProtocolAnnotation::FramingError: return "framing_error";
+    }
+    return "unknown";
+}
+
+// --- UART ---
+
+UartDecoder::UartDecoder(const Config& config, double sampleRate) : cfg(config) {
+    cfg.dataBits = qBound(5, cfg.dataBits, 9);
+    cfg.stopBits = qBound(1, cfg.stopBits, 2);
+    samplesPerBit = cfg.baud > 0.0 && sampleRate > 0.0 ? sampleRate / cfg.baud : 1.0;
+    reset();
+}
+
+void UartDecoder::reset() {
+    previous = true;
+    bit = -1;
+}
+
+void UartDecoder::decode(const quint8* lines, int count, quint64 position, QVector<ProtocolAnnotation>& out) {
+    const int parityBits = cfg.parity == Parity::None ? 0 : 1;
+    const int lastBit = cfg.dataBits + parityBits + cfg.stopBits; // index of the last stop bit
+    for (int i = 0; i < count; ++i) {
+        const bool level = lineLevel(lines[i], cfg.rxLine) != cfg.inverted;
+        const quint64 index = position + i;
+        if (bit < 0) {
+            // Idle: a falling edge starts a frame; its bits are read mid-bit from here
+            if (previous && !level) {
+                bit = 0;
+                frameStart = index;
+                nextSample = index + 0.5 * samplesPerBit;
+                value = 0;
+                ones = 0;
+                parityBad = false;
+                framingBad = false;
+            }
+            previous = level;
+            continue;
+        }
+        previous = level;
+        if (double(index) < nextSample) continue;
+        nextSample += samplesPerBit;
+        if (bit == 0) {
+            if (level) bit = -1; // glitch, not a start bit
+            else bit = 1;
+            continue;
+        }
+        const int n = bit - 1; // 0-based past the start bit
+        if (n < cfg.dataBits) {
+            if (level) {
+                value |= 1u << n;
+                ++ones;
+            }
+        } else if (n < cfg.dataBits + parityBits) {
+            const bool even = ((ones + (level ? 1 : 0)) & 1) == 0;
+            parityBad = (cfg.parity == Parity::Even) != even;
+        } else if (!level) {
+            framingBad = true;
+        }
+        if (bit < lastBit) {
+            ++bit;
+            continue;
+        }
+        ProtocolAnnotation a;
+        a.startSample = frameStart;
+        a.endSample = index;
+        a.value = value;
+        a.kind = framingBad ? ProtocolAnnotation::FramingError
+               : parityBad ? ProtocolAnnotation::ParityError : ProtocolAnnotation::Data;
+        out.append(a);
+        // A low stop bit (break or wrong baud) must go high again before
+        // the next falling edge counts as a start
+        bit = -1;
+    }
+}
+
+// --- SPI ---
+
+SpiDecoder::SpiDecoder(const Config& config) : cfg(config) {
+    cfg.bitsPerWord = qBound(1, cfg.bitsPerWord, 32);
+    const bool cpol = cfg.mode & 2, cpha = cfg.mode & 1;
+    // Modes 0 and 3 sample on the rising edge, 1 and 2 on the falling one
+    sampleOnRising = cpol == cpha;
+    reset();
+}
+
+void SpiDecoder::reset() {
+    clockKnown = false;
+    bits = 0;
+}
+
+void SpiDecoder::decode(const quint8* lines, int count, quint64 position, QVector<ProtocolAnnotation>& out) {
+    for (int i = 0; i < count; ++i) {
+        const quint8 s = lines[i];
+        const bool clock = lineLevel(s, cfg.clockLine);
+        const bool selected = cfg.selectLine < 0 || lineLevel(s, cfg.selectLine) != cfg.selectActiveLow;
+        if (!selected) {
+            bits = 0; // deselecting ends a word, complete or not
+            previousClock = clock;
+            clockKnown = true;
+            continue;
+        }
+        const bool edge = clockKnown && clock != previousClock && clock == sampleOnRising;
+        previousClock = clock;
+        clockKnown = true;
+        if (!edge) continue;
+        if (bits == 0) {
+            wordStart = position + i;
+            mosi = 0;
+            miso = 0;
+        }
+        const int shift = cfg.msbFirst ? cfg.bitsPerWord - 1 - bits : bits;
+        if (lineLevel(s, cfg.mosiLine)) mosi |= 1u << shift;
+        if (lineLevel(s, cfg.misoLine)) miso |= 1u << shift;
+        if (++bits < cfg.bitsPerWord) continue;
+        ProtocolAnnotation a;
+        a.startSample = wordStart;
+        a.endSample = position + i;
+        a.value = mosi;
+        a.value2 = miso;
+        a.kind = ProtocolAnnotation::Word;
+        out.append(a);
+        bits = 0;
+    }
+}
+
+// --- I2C ---
+
+I2cDecoder::I2cDecoder(const Config& config) : cfg(config) {
+    reset();
+}
+
+void I2cDecoder::reset() {
+    state = State::Idle;
+    known = false;
+    bits = 0;
+}
+
+void I2cDecoder::decode(const quint8* lines, int count, quint64 position, QVector<ProtocolAnnotation>& out) {
+    for (int i = 0; i < count; ++i) {
+        const bool scl = lineLevel(lines[i], cfg.sclLine);
+        const bool sda = lineLevel(lines[i], cfg.sdaLine);
+        const quint64 index = position + i;
+        if (!known) {
+            previousScl = scl;
+            previousSda = sda;
+            known = true;
+            continue;
+        }
+        if (scl && previousScl && sda != previousSda) {
+            // SDA moving while SCL is high: start (falling) or stop (rising)
+            ProtocolAnnotation a;
+            a.startSample = a.endSample = index;
+            a.kind = sda ? ProtocolAnnotation::Stop : ProtocolAnnotation::Start;
+            out.append(a);
+            state = sda ? State::Idle : State::Address;
+            bits = 0;
+            byte = 0;
+        } else if (scl && !previousScl && state != State::Idle) {
+            if (bits == 0) byteStart = index;
+            if (bits < 8) {
+                byte = (byte << 1) | (sda ? 1 : 0);
+                ++bits;
+            } else {
+                ProtocolAnnotation a;
+                a.startSample = byteStart;
+                a.endSample = index;
+                a.value = byte;
+                a.kind = state == State::Address ? ProtocolAnnotation::Address : ProtocolAnnotation::Data;
+                out.append(a);
+                ProtocolAnnotation ack;
+                ack.startSample = ack.endSample = index;
+                ack.kind = sda ? ProtocolAnnotation::Nack : ProtocolAnnotation::Ack;
+                out.append(ack);
+                state = State::Data;
+                bits = 0;
+                byte = 0;
+            }
+        }
+        previousScl = scl;
+        previousSda = sda;
+    }
+}
+
+// --- Analog to logic ---
+
+void LogicSlicer::setLevels(double threshold, double hysteresis) {
+    high = threshold + 0.5 * std::fabs(hysteresis);
+    low = threshold - 0.5 * std::fabs(hysteresis);
+}
+
+void LogicSlicer::slice(const double* volts, int count, quint8 mask, quint8* lines) {
+    if (count <= 0) return;
+    if (!known) {
+        level = volts[0] >= 0.5 * (high + low);
+        known = true;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (volts[i] > high) level = true;
+        else if (volts[i] < low) level = false;
+        lines[i] = level ? quint8(lines[i] | mask) : quint8(lines[i] & ~mask);
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+// One decoded bus event. Sample positions count in the stream the decoder
+// was fed (from the start of the frame, or of the capture history while
+// streaming); timeNs is on the acquisition clock.
+struct ProtocolAnnotation {
+    enum Kind : quint8 {
+        Start,        // I2C start or repeated start
+        Stop,         // I2C stop
+        Address,      // I2C address byte: 7-bit address << 1 | R/W
+        Data,         // UART or I2C byte
+        Word,         // SPI word: value MOSI, value2 MISO
+        Ack,
+        Nack,
+        ParityError,  // UART byte with a bad parity bit
+        FramingError  // UART byte whose stop bit was low
+    };
+
+    quint64 startSample = 0;
+    quint64 endSample = 0;
+    qint64 timeNs = 0;
+    quint32 value = 0;
+    quint32 value2 = 0;
+    Kind kind = Data;
+    quint8 bus = 0; // index of the bus among the decoders configured
+};
+
+// Short label for plots and exports, e.g. "0x41 'A'", "W 0x50", "ACK"
+QString annotationText(const ProtocolAnnotation& annotation);
+const char* annotationKindName(ProtocolAnnotation::Kind kind);
+
+// Incremental bus decoder. Input is one logic sample per byte, bit n being
+// line n; blocks of any size follow each other with the state machine
+// carried over, so a word split across two blocks decodes once. Every
+// decoder does constant work per sample.
+class ProtocolDecoder {
+public:
+    virtual ~ProtocolDecoder() = default;
+    virtual const char* name() const = 0;
+    // The next sample does not follow the last one: partial words are dropped
+    virtual void reset() = 0;
+    // position is the stream index of lines[0]; events are appended to out
+    virtual void decode(const quint8* lines, int count, quint64 position, QVector<ProtocolAnnotation>& out) = 0;
+};
+
+// Asynchronous serial, LSB first, sampled at the middle of each bit
+class UartDecoder : public ProtocolDecoder {
+public:
+    enum class Parity { None, Even, Odd };
+    struct Config {
+        int rxLine = 0;
+        double baud = 9600.0;
+        int dataBits = 8;     // 5..9
+        Parity parity = Parity::None;
+        int stopBits = 1;     // 1 or 2
+        bool inverted = false; // idle low
+    };
+
+    UartDecoder(const Config& config, double sampleRate);
+    const char* name() const override { return "UART"; }
+    void reset() override;
+    void decode(const quint8* lines, int count, quint64 position, QVector<ProtocolAnnotation>& out) override;
+
+private:
+    Config cfg;
+    double samplesPerBit;
+    bool previous = true;  // line level, idle when true
+    int bit = -1;          // -1 idle, 0 start, then data, parity and stop bits
+    double nextSample = 0; // stream index of the next bit's middle
+    quint64 frameStart = 0;
+    quint32 value = 0;
+    int ones = 0;
+    bool parityBad = false;
+    bool framingBad = false;
+};
+
+// Clocked serial with optional MISO and chip select, any of the four modes
+class SpiDecoder : public ProtocolDecoder {
+public:
+    struct Config {
+        int clockLine = 0;
+        int mosiLine = 1;
+        int misoLine = -1;    // -1: not connected
+        int selectLine = -1;  // -1: always selected
+        int mode = 0;         // CPOL << 1 | CPHA
+        int bitsPerWord = 8;  // 1..32
+        bool msbFirst = true;
+        bool selectActiveLow = true;
+    };
+
+    explicit SpiDecoder(const Config& config);
+    const char* name() const override { return "SPI"; }
+    void reset() override;
+    void decode(const quint8* lines, int count, quint64 position, QVector<ProtocolAnnotation>& out) override;
+
+private:
+    Config cfg;
+    bool sampleOnRising;
+    bool previousClock = false;
+    bool clockKnown = false;
+    int bits = 0;
+    quint32 mosi = 0;
+    quint32 miso = 0;
+    quint64 wordStart = 0;
+};
+
+// Two-wire bus: start/stop conditions, address and data bytes with their ACK bit
+class I2cDecoder : public ProtocolDecoder {
+public:
+    struct Config {
+        int sclLine = 0;
+        int sdaLine = 1;
+    };
+
+    explicit I2cDecoder(const Config& config);
+    const char* name() const override { return "I2C"; }
+    void reset() override;
+    void decode(const quint8* lines, int count, quint64 position, QVector<ProtocolAnnotation>& out) override;
+
+private:
+    enum class State { Idle, Address, Data };
+
+    Config cfg;
+    State state = State::Idle;
+    bool known = false;
+    bool previousScl = true;
+    bool previousSda = true;
+    int bits = 0;       // 0..7 byte bits, 8 = ACK bit next
+    quint32 byte = 0;
+    quint64 byteStart = 0;
+};
+
+// Turns volts into a logic line with hysteresis; the level is kept across blocks
+class LogicSlicer {
+public:
+    void setLevels(double threshold, double hysteresis);
+    void reset() { known = false; }
+    // Sets or clears mask in lines[i] for every sample
+    void slice(const double* volts, int count, quint8 mask, quint8* lines);
+
+private:
+    double high = 1.5;
+    double low = 1.3;
+    bool level = false;
+    bool known = false;
+};
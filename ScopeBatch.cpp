@@ -0,0 +1,388 @@
+// Headless batch analysis of capture files (.oscap) and frame recordings
+// (.oscrec). Every file is cut into tasks, which a pool of worker threads
+// pulls from a shared queue: a capture file into segments of records that
+// read the memory-mapped file independently, a recording (sequential,
+// chunk-compressed) into one task per file. Each task runs its own
+// AdcDecoder and CaptureAnalysis (measurements, averaged FFT, CH2/CH1
+// transfer function); the partial results of a file are merged in task
+// order once everything is done, so the output is the same for any number
+// of threads. Writes summary.csv and, where there is a stimulus, bode.csv,
+// plus a spectrum CSV per file on request.
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "AdcDecoder.h"
+#include "CaptureAnalysis.h"
+#include "CaptureFile.h"
+#include "FrameRecording.h"
+
+namespace {
+constexpr char CAPTURE_SUFFIX[] = "oscap";
+constexpr char RECORDING_SUFFIX[] = "oscrec";
+
+struct InputFile {
+    QString path;
+    bool recording = false;
+    qint64 bytes = 0;
+    std::unique_ptr<CaptureFileReader> capture; // shared read-only by its segments
+    quint64 records = 0;                        // capture files: records analysed
+    int recordLength = 0;
+    QString error;
+};
+
+// One device's share of a file
+struct Part {
+    int device = 0;
+    CaptureAnalysis analysis;
+};
+
+struct Task {
+    int file = 0;
+    quint64 firstRecord = 0; // capture files only
+    quint64 recordCount = 0;
+    quint64 gapRecords = 0;  // capture records skipped for spanning lost samples
+    QVector<Part> parts;
+    QString error;
+};
+
+CaptureAnalysis& partFor(QVector<Part>& parts, int device, FFTEngine::Window window) {
+    for (Part& part : parts) {
+        if (part.device == device) return part.analysis;
+    }
+    parts.append(Part());
+    parts.last().device = device;
+    parts.last().analysis.setWindow(window);
+    return parts.last().analysis;
+}
+
+void runCaptureSegment(const InputFile& input, Task& task, FFTEngine::Window window) {
+    const CaptureFileReader& reader = *input.capture;
+    const CaptureInfo& info = reader.info();
+    AdcDecoder decoder;
+    decoder.setParams(info.ch1Gain, info.ch1Offset, info.ch2Gain, info.ch2Offset);
+    CaptureAnalysis& analysis = partFor(task.parts, 0, window);
+    QVector<quint8> raw(input.recordLength);
+    QVector<double> volts[2];
+    for (quint64 r = 0; r < task.recordCount; ++r) {
+        const quint64 first = (task.firstRecord + r) * quint64(input.recordLength);
+        // Samples either side of a gap are not a record
+        if (!reader.isContiguous(first, input.recordLength)) {
+            ++task.gapRecords;
+            continue;
+        }
+        for (int ch = 0; ch < 2; ++ch) {
+            volts[ch].clear();
+            if (!reader.hasChannel(ch)) continue;
+            if (!reader.read(ch, first, input.recordLength, raw.data())) {
+                task.error = QString("read failed at sample %1").arg(first);
+                return;
+            }
+            volts[ch].resize(input.recordLength);
+            decoder.decode(static_cast<AdcDecoder::Channel>(ch), raw.constData(), input.recordLength, volts[ch].data());
+        }
+        analysis.addRecord(volts[0], volts[1], info.sampleRate);
+    }
+}
+
+void runRecording(const InputFile& input, Task& task, FFTEngine::Window window) {
+    FrameRecordingReader reader;
+    if (!reader.open(input.path)) {
+        task.error = "not a frame recording";
+        return;
+    }
+    AdcDecoder decoder;
+    FrameRecordingReader::Record record;
+    QVector<double> ch1, ch2;
+    while (reader.next(record)) {
+        const CaptureInfo& settings = reader.settings();
+        decoder.setParams(settings.ch1Gain, settings.ch1Offset, settings.ch2Gain, settings.ch2Offset);
+        decoder.decode(AdcDecoder::Ch1, record.frame.ch1, ch1);
+        decoder.decode(AdcDecoder::Ch2, record.frame.ch2, ch2);
+        partFor(task.parts, record.device, window).addRecord(ch1, ch2, settings.sampleRate);
+        ++task.recordCount;
+    }
+}
+
+// Files named on the command line, and the captures and recordings in any
+// directories named
+QStringList expandInputs(const QStringList& args) {
+    QStringList files;
+    const QStringList filters = {QString("*.") + CAPTURE_SUFFIX, QString("*.") + RECORDING_SUFFIX};
+    for (const QString& arg : args) {
+        if (!QFileInfo(arg).isDir()) {
+            files.append(arg);
+            continue;
+        }
+        QStringList found;
+        QDirIterator it(arg, filters, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) found.append(it.next());
+        found.sort();
+        files += found;
+    }
+    return files;
+}
+
+bool parseWindow(const QString& name, FFTEngine::Window& window) {
+    const QString w = name.toLower();
+    if (w == "rect" || w == "rectangular") window = FFTEngine::Window::Rectangular;
+    else if (w == "hann") window = FFTEngine::Window::Hann;
+    else if (w == "blackman") window = FFTEngine::Window::Blackman;
+    else if (w == "flattop") window = FFTEngine::Window::FlatTop;
+    else return false;
+    return true;
+}
+
+// Appended to a file's label and output names when it holds several devices
+QString deviceSuffix(int device, bool multiDevice) {
+    return multiDevice ? QString("_dev%1").arg(device) : QString();
+}
+
+QString fileLabel(const QString& path, int device, bool multiDevice) {
+    return QFileInfo(path).fileName() + deviceSuffix(device, multiDevice);
+}
+
+// Names for per-file outputs: the path below the inputs' common directory
+// without its suffix, separators made underscores, so files of the same
+// name in different directories stay apart. Any clash left (a.scap next to
+// a.srec) is resolved with the input's number.
+QStringList outputStems(const QStringList& paths) {
+    QStringList absolute;
+    for (const QString& path : paths) absolute.append(QFileInfo(path).absoluteFilePath());
+    QString root = absolute.isEmpty() ? QString() : QFileInfo(absolute.first()).absolutePath();
+    for (const QString& path : absolute) {
+        while (!root.isEmpty() && !path.startsWith(root.endsWith('/') ? root : root + '/')) {
+            const QString parent = QFileInfo(root).path();
+            root = parent == root ? QString() : parent; // another drive
+        }
+    }
+    QStringList stems;
+    QHash<QString, int> uses;
+    for (const QString& path : absolute) {
+        QString stem = root.isEmpty() ? path : QDir(root).relativeFilePath(path);
+        const QString suffix = QFileInfo(stem).suffix();
+        if (!suffix.isEmpty()) stem.chop(suffix.size() + 1);
+        stem.replace('/', '_').replace(':', '_');
+        stems.append(stem);
+        ++uses[stem];
+    }
+    for (int i = 0; i < stems.size(); ++i) {
+        if (uses.value(stems[i]) > 1) stems[i] = QString("%1_%2").arg(i + 1).arg(stems[i]);
+    }
+    return stems;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("scope_batch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Batch measurements, spectra and transfer functions of capture files and frame recordings");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Capture files (.oscap), frame recordings (.oscrec) or directories of them.", "inputs...");
+    QCommandLineOption jobsOption("jobs", "Worker threads (default: one per core).", "n",
+                                  QString::number(QThread::idealThreadCount()));
+    QCommandLineOption recordOption("record", "Samples per analysed record of a capture file (default 4096).", "n", "4096");
+    QCommandLineOption segmentOption("segment", "Capture records per task (default 64).", "n", "64");
+    QCommandLineOption windowOption("window", "FFT window: rect, hann, blackman or flattop (default hann).", "name", "hann");
+    QCommandLineOption outOption("out", "Directory for the CSV tables (default: current).", "dir", ".");
+    QCommandLineOption spectraOption("spectra", "Also write each file's averaged spectrum as <name>_spectrum.csv, <name> being its path below the inputs' common directory.");
+    QCommandLineOption verboseOption("verbose", "Keep the engines' debug output.");
+    parser.addOptions({jobsOption, recordOption, segmentOption, windowOption, outOption, spectraOption, verboseOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (!parser.isSet(verboseOption)) QLoggingCategory::setFilterRules("*.debug=false");
+
+    const int jobs = parser.value(jobsOption).toInt();
+    const int recordLength = parser.value(recordOption).toInt();
+    const int segment = parser.value(segmentOption).toInt();
+    FFTEngine::Window window = FFTEngine::Window::Hann;
+    if (jobs <= 0 || recordLength < 2 || segment <= 0 || !parseWindow(parser.value(windowOption), window)) {
+        err << "Invalid --jobs, --record, --segment or --window\n";
+        return 1;
+    }
+    const QStringList paths = expandInputs(parser.positionalArguments());
+    if (paths.isEmpty()) {
+        err << "No input files\n";
+        return 1;
+    }
+    const QStringList stems = outputStems(paths);
+    const QDir outDir(parser.value(outOption));
+    if (!outDir.exists() && !QDir().mkpath(outDir.path())) {
+        err << "Cannot create " << outDir.path() << "\n";
+        return 1;
+    }
+
+    // Open the captures up front (only their block headers are read) and
+    // cut everything into tasks
+    std::vector<InputFile> inputs(paths.size());
+    std::vector<Task> tasks;
+    for (int f = 0; f < paths.size(); ++f) {
+        InputFile& input = inputs[f];
+        input.path = paths[f];
+        input.bytes = QFileInfo(input.path).size();
+        input.recording = QFileInfo(input.path).suffix().compare(RECORDING_SUFFIX, Qt::CaseInsensitive) == 0;
+        if (input.recording) {
+            Task task;
+            task.file = f;
+            tasks.push_back(std::move(task));
+            continue;
+        }
+        input.capture = std::make_unique<CaptureFileReader>();
+        if (!input.capture->open(input.path)) {
+            input.error = "not a capture file";
+            continue;
+        }
+        // Captures shorter than a record are analysed as one
+        const quint64 samples = input.capture->sampleCount();
+        input.recordLength = int(std::min<quint64>(recordLength, samples));
+        input.records = input.recordLength >= 2 ? samples / input.recordLength : 0;
+        for (quint64 first = 0; first < input.records; first += segment) {
+            Task task;
+            task.file = f;
+            task.firstRecord = first;
+            task.recordCount = std::min<quint64>(segment, input.records - first);
+            tasks.push_back(std::move(task));
+        }
+    }
+    // Recordings cannot be split, so they start first and the capture
+    // segments fill in around them
+    std::vector<int> order(tasks.size());
+    for (int i = 0; i < int(order.size()); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        const InputFile& fa = inputs[tasks[a].file];
+        const InputFile& fb = inputs[tasks[b].file];
+        if (fa.recording != fb.recording) return fa.recording;
+        return fa.recording && fa.bytes > fb.bytes;
+    });
+
+    QElapsedTimer clock;
+    clock.start();
+    std::atomic<int> next{0};
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+    const int workers = std::min<int>(jobs, int(tasks.size()));
+    for (int w = 0; w < workers; ++w) {
+        pool.start([&]() {
+            for (int i = next.fetch_add(1); i < int(order.size()); i = next.fetch_add(1)) {
+                Task& task = tasks[order[i]];
+                const InputFile& input = inputs[task.file];
+                if (input.recording) runRecording(input, task, window);
+                else runCaptureSegment(input, task, window);
+            }
+        });
+    }
+    pool.waitForDone();
+    const double seconds = clock.elapsed() / 1000.0;
+
+    // Merge each file's parts in task order
+    struct FileResult {
+        QVector<Part> parts;
+        quint64 records = 0;
+        quint64 gapRecords = 0;
+    };
+    std::vector<FileResult> results(inputs.size());
+    for (const Task& task : tasks) {
+        InputFile& input = inputs[task.file];
+        if (!task.error.isEmpty() && input.error.isEmpty()) input.error = task.error;
+        FileResult& result = results[task.file];
+        result.records += task.recordCount - task.gapRecords;
+        result.gapRecords += task.gapRecords;
+        for (const Part& part : task.parts) {
+            auto it = std::find_if(result.parts.begin(), result.parts.end(),
+                                   [&part](const Part& p) { return p.device == part.device; });
+            if (it == result.parts.end()) result.parts.append(part);
+            else it->analysis.merge(part.analysis);
+        }
+    }
+
+    QFile summaryFile(outDir.filePath("summary.csv"));
+    QFile bodeFile(outDir.filePath("bode.csv"));
+    if (!summaryFile.open(QIODevice::WriteOnly | QIODevice::Text) ||
+        !bodeFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        err << "Cannot write to " << outDir.path() << "\n";
+        return 1;
+    }
+    QTextStream summary(&summaryFile);
+    QTextStream bode(&bodeFile);
+    summary << "file,device,channel,records,periodic_records,min_v,max_v,mean_v,rms_v,pkpk_v,"
+               "frequency_hz,duty,peak_frequency_hz,peak_magnitude_v\n";
+    bode << "file,device,frequency_hz,magnitude_db,phase_deg,records\n";
+
+    out << QString("%1 %2 %3 %4 %5 %6 %7\n")
+               .arg("file", -32).arg("ch", 3).arg("records", 8).arg("pk-pk V", 9)
+               .arg("rms V", 9).arg("freq Hz", 11).arg("peak Hz", 11);
+    int failed = 0;
+    quint64 totalRecords = 0;
+    for (int f = 0; f < int(inputs.size()); ++f) {
+        const InputFile& input = inputs[f];
+        const FileResult& result = results[f];
+        if (!input.error.isEmpty()) {
+            err << input.path << ": " << input.error << "\n";
+            ++failed;
+            continue;
+        }
+        totalRecords += result.records;
+        if (result.gapRecords > 0) {
+            err << input.path << ": " << result.gapRecords << " record(s) spanning lost samples skipped\n";
+        }
+        const bool multiDevice = result.parts.size() > 1;
+        for (const Part& part : result.parts) {
+            const QString label = fileLabel(input.path, part.device, multiDevice);
+            for (int ch = 0; ch < 2; ++ch) {
+                const CaptureAnalysis::ChannelSummary s = part.analysis.channel(ch);
+                if (s.records == 0) continue;
+                out << QString("%1 %2 %3 %4 %5 %6 %7\n")
+                           .arg(label.left(32), -32).arg(QString("CH%1").arg(ch + 1), 3).arg(s.records, 8)
+                           .arg(s.pkpk, 9, 'f', 3).arg(s.rms, 9, 'f', 3)
+                           .arg(s.periodicRecords > 0 ? QString::number(s.frequency, 'g', 6) : QString("-"), 11)
+                           .arg(QString::number(s.peakFrequency, 'g', 6), 11);
+                summary << input.path << "," << part.device << "," << ch + 1 << "," << s.records << ","
+                        << s.periodicRecords << "," << s.min << "," << s.max << "," << s.mean << "," << s.rms << ","
+                        << s.pkpk << "," << s.frequency << "," << s.duty << "," << s.peakFrequency << ","
+                        << s.peakMagnitude << "\n";
+            }
+            for (const CaptureAnalysis::TransferPoint& p : part.analysis.transfer()) {
+                bode << input.path << "," << part.device << "," << p.frequency << "," << p.magnitudeDb << ","
+                     << p.phaseDeg << "," << p.records << "\n";
+            }
+            if (!parser.isSet(spectraOption)) continue;
+            QFile spectrumFile(outDir.filePath(stems[f] + deviceSuffix(part.device, multiDevice) + "_spectrum.csv"));
+            if (!spectrumFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+                err << "Cannot write " << spectrumFile.fileName() << "\n";
+                continue;
+            }
+            QTextStream spectrum(&spectrumFile);
+            const QVector<double> spectra[2] = {part.analysis.spectrum(0), part.analysis.spectrum(1)};
+            const double binHz = part.analysis.spectrumBinHz();
+            spectrum << "frequency_hz,ch1_v,ch2_v\n";
+            const int bins = std::max(spectra[0].size(), spectra[1].size());
+            for (int i = 0; i < bins; ++i) {
+                spectrum << i * binHz;
+                for (const QVector<double>& s : spectra) {
+                    spectrum << ",";
+                    if (i < s.size()) spectrum << s[i];
+                }
+                spectrum << "\n";
+            }
+        }
+    }
+    err << QString("%1 file(s), %2 records in %3 s on %4 thread(s)\n")
+               .arg(int(inputs.size()) - failed).arg(totalRecords).arg(seconds, 0, 'f', 2).arg(workers);
+    return failed > 0 ? 2 : 0;
+}
@@ -0,0 +1,380 @@
+// Acquisition-to-pixel benchmark. Runs the application's data path with a
+// SimulatedDevice on the far end of the link, on the same threads the
+// application uses: SerialHandler (acquisition thread) -> DspWorker (DSP
+// thread) -> measurements, trigger and PlotManager (GUI thread) -> replot,
+// for every combination of display mode, record length and sample rate
+// asked for. Each run reports frames/s, end-to-end latency, heap
+// allocations per displayed frame, the CPU time per displayed frame of the
+// process and of each of the three threads (acquisition, DSP, GUI; the
+// simulated device runs on the acquisition thread and is counted there),
+// and the per-stage latencies from PerfTrace, as a table on stdout and
+// optionally as CSV.
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QWidget>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include "DspWorker.h"
+#include "MeasurementKernel.h"
+#include "PerfTrace.h"
+#include "PlotManager.h"
+#include "SerialHandler.h"
+#include "SimulatedDevice.h"
+#include "TimeBase.h"
+#include "TriggerEngine.h"
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#endif
+
+namespace {
+std::atomic<quint64> heapAllocations{0};
+
+const char* const MODE_NAMES[] = {"Both", "CH1", "CH2", "XY", "DFT1", "DFT2", "DFT12"};
+constexpr int MODE_COUNT = sizeof(MODE_NAMES) / sizeof(MODE_NAMES[0]);
+// Channels each display mode captures, as MainWindow::onModeChanged sets
+// them: 0 = both, 1 = CH1, 2 = CH2
+constexpr int MODE_CAPTURE[] = {0, 1, 2, 0, 1, 2, 0};
+constexpr int WARMUP_MS = 500;
+constexpr double TRIGGER_VIEW_FRACTION = 0.5; // as in MainWindow
+constexpr int PLOT_WIDTH = 1024;
+constexpr int PLOT_HEIGHT = 600;
+
+struct Scenario {
+    int displayMode = 0;
+    int recordLength = 0;
+    int rateIndex = 0; // UI index, see TimeBase
+};
+
+struct Result {
+    quint64 acquired = 0;
+    quint64 displayed = 0;
+    double seconds = 0.0;
+    quint64 allocations = 0;
+    double cpuSeconds = 0.0;
+    double acquisitionCpuSeconds = 0.0;
+    double dspCpuSeconds = 0.0;
+    double guiCpuSeconds = 0.0;
+    PerfCounters::StageStats stages[int(PerfStage::Count)];
+};
+
+QVector<int> parseList(const QString& text, bool* ok) {
+    QVector<int> values;
+    *ok = true;
+    for (const QString& item : text.split(',', Qt::SkipEmptyParts)) {
+        bool itemOk = false;
+        values.append(item.trimmed().toInt(&itemOk));
+        *ok = *ok && itemOk;
+    }
+    return values;
+}
+
+// CPU time of the calling thread
+double threadCpuSeconds() {
+#ifdef Q_OS_WIN
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)) return 0.0;
+    const auto ticks = [](const FILETIME& t) { return (quint64(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+    return (ticks(kernel) + ticks(user)) * 1e-7; // 100 ns units
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0.0;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// CPU time of the thread an object lives on, read on that thread
+double threadCpuSeconds(QObject* onThread) {
+    double seconds = 0.0;
+    QMetaObject::invokeMethod(onThread, [&seconds]() { seconds = threadCpuSeconds(); }, Qt::BlockingQueuedConnection);
+    return seconds;
+}
+
+void waitMs(int ms) {
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+// The GUI thread's share of a frame, as MainWindow::onOscilloscopeFrame
+// does it: measure, trigger, update the graphs; the replot follows from the
+// event loop
+class FrameSink : public QObject {
+public:
+    FrameSink(DspWorker* dsp, PlotManager* plots, double sampleInterval)
+        : dsp(dsp), plots(plots), sampleInterval(sampleInterval) {
+        trigger.setLevel(0.0);
+    }
+
+    void drain() {
+        DecodedFrameRing& ring = dsp->output();
+        ring.clearNotified();
+        while (const DecodedFrame* frame = ring.peek()) {
+            // Copies, so the slot goes back to the worker untouched
+            copySamples(ch1, frame->ch1);
+            copySamples(ch2, frame->ch2);
+            const qint64 timestampNs = frame->timestampNs;
+            ring.release();
+            show(timestampNs);
+        }
+    }
+
+private:
+    static void copySamples(QVector<double>& dst, const QVector<double>& src) {
+        dst.resize(src.size());
+        std::copy(src.constData(), src.constData() + src.size(), dst.data());
+    }
+
+    void show(qint64 timestampNs) {
+        if (!ch1.isEmpty()) meters[0].measure(ch1, sampleInterval);
+        if (!ch2.isEmpty()) meters[1].measure(ch2, sampleInterval);
+        [[maybe_unused]] qint64 stageNs = PERF_NOW();
+        const QVector<double>& source = ch1.isEmpty() ? ch2 : ch1;
+        const int viewLength = qMax(2, int(source.size() * TRIGGER_VIEW_FRACTION));
+        trigger.setPreTrigger(viewLength / 10);
+        TriggerEngine::Event event;
+        trigger.alignRecords(source, viewLength, ch1, ch2, event);
+        PERF_LAP(PerfStage::Trigger, stageNs);
+        plots->updateWaveform(ch1, ch2);
+        PERF_LAP(PerfStage::Plot, stageNs);
+        PERF_PLOTTED(timestampNs);
+    }
+
+    DspWorker* dsp;
+    PlotManager* plots;
+    double sampleInterval;
+    MeasurementKernel meters[2];
+    TriggerEngine trigger;
+    QVector<double> ch1, ch2;
+};
+
+Result runScenario(const Scenario& scenario, SimulatedDevice::Config config, int seconds) {
+    const int capture = MODE_CAPTURE[scenario.displayMode];
+    const int serialMode = capture == 0 ? 1 : capture + 1;
+    const bool dualChannel = capture == 0;
+    const double rate = timeBase(scenario.rateIndex).sampleRate;
+    config.recordLength = scenario.recordLength;
+
+    QThread acquisitionThread;
+    QThread dspThread;
+    SerialHandler* handler = new SerialHandler();
+    handler->moveToThread(&acquisitionThread);
+    QObject::connect(&acquisitionThread, &QThread::finished, handler, &QObject::deleteLater);
+    DspWorker* dsp = new DspWorker(handler->frameRing());
+    dsp->moveToThread(&dspThread);
+    QObject::connect(&dspThread, &QThread::finished, dsp, &QObject::deleteLater);
+    QObject::connect(handler, &SerialHandler::framesAvailable, dsp, &DspWorker::processFrames);
+    acquisitionThread.start();
+    dspThread.start();
+
+    PlotManager plots;
+    plots.setDisplayMode(scenario.displayMode);
+    plots.setDataLength(dualChannel ? 200 : 400);
+    plots.setMultiplier(1e6 / rate); // us per sample
+    plots.setMaxFrequency(rate / 2.0);
+    plots.plotWidget()->resize(PLOT_WIDTH, PLOT_HEIGHT);
+    plots.plotWidget()->show();
+    FrameSink* sink = new FrameSink(dsp, &plots, 1.0 / rate);
+    QObject::connect(dsp, &DspWorker::framesReady, sink, [sink]() { sink->drain(); });
+
+    handler->connectSimulated(config);
+    handler->setProtocolParams(0, 0, 0, 0, 0, scenario.rateIndex + 1); // device index is 1-based
+    handler->setStreaming(true);
+    handler->startOscilloscopeAcquisition(serialMode, dualChannel ? 200 : 400, dualChannel);
+
+    waitMs(WARMUP_MS);
+    PerfCounters& perf = PerfCounters::instance();
+    PerfCounters::StageStats warmup[int(PerfStage::Count)];
+    perf.stats(warmup, true);
+    const quint64 acquiredBefore = perf.framesAcquired();
+    const quint64 displayedBefore = perf.framesDisplayed();
+    const quint64 allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+    // Process CPU time on POSIX; wall time where clock() is (Windows)
+    const std::clock_t cpuBefore = std::clock();
+    const double acquisitionCpuBefore = threadCpuSeconds(handler);
+    const double dspCpuBefore = threadCpuSeconds(dsp);
+    const double guiCpuBefore = threadCpuSeconds();
+    QElapsedTimer elapsed;
+    elapsed.start();
+    waitMs(seconds * 1000);
+
+    Result result;
+    result.seconds = elapsed.nsecsElapsed() * 1e-9;
+    result.cpuSeconds = double(std::clock() - cpuBefore) / CLOCKS_PER_SEC;
+    result.acquisitionCpuSeconds = threadCpuSeconds(handler) - acquisitionCpuBefore;
+    result.dspCpuSeconds = threadCpuSeconds(dsp) - dspCpuBefore;
+    result.guiCpuSeconds = threadCpuSeconds() - guiCpuBefore;
+    result.allocations = heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+    result.acquired = perf.framesAcquired() - acquiredBefore;
+    result.displayed = perf.framesDisplayed() - displayedBefore;
+    perf.stats(result.stages, true);
+
+    handler->setStreaming(false);
+    handler->resetAcquisitionState();
+    // Closed before its thread goes, behind the two calls queued above
+    QMetaObject::invokeMethod(handler, [handler]() { handler->disconnectPort(); }, Qt::BlockingQueuedConnection);
+    // The DSP worker reads the handler's frame ring, so it stops first
+    dspThread.quit();
+    dspThread.wait();
+    acquisitionThread.quit();
+    acquisitionThread.wait();
+    delete sink;
+    return result;
+}
+
+QString formatMs(qint64 ns) {
+    return QString::number(ns / 1e6, 'f', 3);
+}
+}
+
+#if defined(__GLIBC__)
+// Every heap allocation in the process, Qt's containers included: they
+// allocate with malloc, not operator new
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void* malloc(size_t size) noexcept {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+extern "C" void* calloc(size_t count, size_t size) noexcept {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+extern "C" void* realloc(void* ptr, size_t size) noexcept {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+#else
+// Elsewhere only operator new can be counted portably
+void* operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+#endif
+
+int main(int argc, char *argv[])
+{
+    // Rendering needs a GUI platform, not a screen
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    QApplication::setApplicationName("scope_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Acquisition-to-pixel benchmark against a simulated device");
+    parser.addHelpOption();
+    QCommandLineOption secondsOption("seconds", "Measured seconds per run (default 3).", "s", "3");
+    QCommandLineOption modesOption("modes", "Display modes: 0=Both 1=CH1 2=CH2 3=XY 4=DFT1 5=DFT2 6=DFT12.", "list", "0,1,3,4,6");
+    QCommandLineOption lengthsOption("lengths", "Samples per channel per frame; 0 = protocol default (200 dual, 400 single).", "list", "100,200,400");
+    QCommandLineOption ratesOption("rates", "Sample rate indexes: 0=2 MS/s ... 13=100 S/s.", "list", "0,4,10");
+    QCommandLineOption baudOption("baud", "Simulated link speed in baud; 0 = unthrottled.", "baud", "921600");
+    QCommandLineOption legacyOption("legacy", "Use the ACK + 'D' request protocol; record lengths are then fixed.");
+    QCommandLineOption instantOption("instant-capture", "Captures complete at once instead of taking the sampling time.");
+    QCommandLineOption replayOption("replay", "Loop the frames of a recording (.oscrec) instead of synthetic sines.", "file");
+    QCommandLineOption csvOption("csv", "Also write the results as CSV.", "file");
+    QCommandLineOption verboseOption("verbose", "Keep the application's debug output.");
+    parser.addOptions({secondsOption, modesOption, lengthsOption, ratesOption, baudOption, legacyOption,
+                       instantOption, replayOption, csvOption, verboseOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (!PerfCounters::enabled()) {
+        err << "scope_bench needs SCOPE_PERF_TRACE for the stage timings\n";
+        return 1;
+    }
+    if (!parser.isSet(verboseOption)) QLoggingCategory::setFilterRules("*.debug=false");
+
+    bool modesOk = false, lengthsOk = false, ratesOk = false;
+    const QVector<int> modes = parseList(parser.value(modesOption), &modesOk);
+    const QVector<int> lengths = parseList(parser.value(lengthsOption), &lengthsOk);
+    const QVector<int> rates = parseList(parser.value(ratesOption), &ratesOk);
+    const bool modesValid = modesOk && std::all_of(modes.begin(), modes.end(), [](int m) { return m >= 0 && m < MODE_COUNT; });
+    const bool ratesValid = ratesOk && std::all_of(rates.begin(), rates.end(), [](int r) { return r >= 0 && r < TIME_BASE_COUNT; });
+    const bool lengthsValid = lengthsOk && std::all_of(lengths.begin(), lengths.end(), [](int l) { return l >= 0 && l <= 400; });
+    const int seconds = parser.value(secondsOption).toInt();
+    if (!modesValid || !ratesValid || !lengthsValid || seconds <= 0) {
+        err << "Invalid --modes, --lengths, --rates or --seconds\n";
+        return 1;
+    }
+
+    SimulatedDevice::Config config;
+    config.linkBaud = parser.value(baudOption).toInt();
+    config.framed = !parser.isSet(legacyOption);
+    config.realTimeCapture = !parser.isSet(instantOption);
+    config.replayPath = parser.value(replayOption);
+    // The legacy reads have fixed lengths
+    const QVector<int> runLengths = config.framed ? lengths : QVector<int>{0};
+
+    QFile csvFile;
+    QTextStream csv;
+    if (parser.isSet(csvOption)) {
+        csvFile.setFileName(parser.value(csvOption));
+        if (!csvFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            err << "Cannot write " << csvFile.fileName() << "\n";
+            return 1;
+        }
+        csv.setDevice(&csvFile);
+        csv << "mode,length,sample_rate,frames_acquired,frames_displayed,fps,allocs_per_frame,cpu_ms_per_frame,"
+               "acquisition_cpu_ms_per_frame,dsp_cpu_ms_per_frame,gui_cpu_ms_per_frame";
+        for (int s = 0; s < int(PerfStage::Count); ++s) {
+            const QString name = PerfCounters::stageName(PerfStage(s));
+            csv << "," << name << "_p50_ms," << name << "_p99_ms";
+        }
+        csv << "\n";
+    }
+
+    out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10 %11 %12 %13\n")
+               .arg("mode", -6).arg("length", 6).arg("rate", 9).arg("fps", 8)
+               .arg("e2e p50", 9).arg("e2e p99", 9).arg("allocs/f", 9).arg("cpu ms/f", 9)
+               .arg("acq ms/f", 9).arg("dsp ms/f", 9).arg("gui ms/f", 9)
+               .arg("plot p50", 9).arg("replot p50", 10);
+    for (int mode : modes) {
+        for (int length : runLengths) {
+            for (int rateIndex : rates) {
+                const Result r = runScenario({mode, length, rateIndex}, config, seconds);
+                const double frames = qMax<quint64>(1, r.displayed);
+                const PerfCounters::StageStats& e2e = r.stages[int(PerfStage::EndToEnd)];
+                const QString lengthText = length > 0 ? QString::number(length) : QString("auto");
+                out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10 %11 %12 %13\n")
+                           .arg(MODE_NAMES[mode], -6).arg(lengthText, 6).arg(timeBase(rateIndex).sampleRate, 9, 'g', 3)
+                           .arg(r.displayed / r.seconds, 8, 'f', 1)
+                           .arg(formatMs(e2e.p50), 9).arg(formatMs(e2e.p99), 9)
+                           .arg(r.allocations / frames, 9, 'f', 1).arg(r.cpuSeconds * 1e3 / frames, 9, 'f', 3)
+                           .arg(r.acquisitionCpuSeconds * 1e3 / frames, 9, 'f', 3)
+                           .arg(r.dspCpuSeconds * 1e3 / frames, 9, 'f', 3)
+                           .arg(r.guiCpuSeconds * 1e3 / frames, 9, 'f', 3)
+                           .arg(formatMs(r.stages[int(PerfStage::Plot)].p50), 9)
+                           .arg(formatMs(r.stages[int(PerfStage::Replot)].p50), 10);
+                out.flush();
+                if (csv.device()) {
+                    csv << MODE_NAMES[mode] << "," << length << "," << timeBase(rateIndex).sampleRate << ","
+                        << r.acquired << "," << r.displayed << "," << r.displayed / r.seconds << ","
+                        << r.allocations / frames << "," << r.cpuSeconds * 1e3 / frames << ","
+                        << r.acquisitionCpuSeconds * 1e3 / frames << "," << r.dspCpuSeconds * 1e3 / frames << ","
+                        << r.guiCpuSeconds * 1e3 / frames;
+                    for (const PerfCounters::StageStats& stage : r.stages) {
+                        csv << "," << formatMs(stage.p50) << "," << formatMs(stage.p99);
+                    }
+                    csv << "\n";
+                }
+            }
+        }
+    }
+    return 0;
+}
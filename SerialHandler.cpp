@@ -1,57 +1,194 @@
 #include "SerialHandler.h"
+#include "FrameRecording.h"
+#include "PerfTrace.h"
 #include <QSerialPortInfo>
 #include <QTimer>
 #include <QDebug>
 #include <QThread>
+#include <cstring>
 
 // --- Add: Timeout for each acquisition state ---
 static constexpr int STATE_TIMEOUT_MS = 5000; // Increased from 2000ms to 5000ms
+// --- Settling time the device needs between the capture ACK and the data request ---
+static constexpr int DATA_REQUEST_DELAY_MS = 100;
+// --- Gap the firmware needs between DDS commands ---
+static constexpr int DDS_STEP_MS = 20;
+// --- Hardware streaming ---
+// Start: 'X',1,mode. Firmware that can stream answers 'X' and then sends
+// blocks of [0xA5 0x5A mask count] followed by count CH1 bytes (mask bit 0)
+// and/or count CH2 bytes (mask bit 1). Stop: 'X',0,0.
+static constexpr int STREAM_NEGOTIATE_TIMEOUT_MS = 250;
+static constexpr int STREAM_HEADER_BYTES = 4;
+static constexpr int HISTORY_SAMPLES = 1 << 22; // ~2 s per channel at 2 MS/s
+// --- Framed protocol ---
+// Firmware that lists "proto=2" in its 'e' signature (optionally with
+// "baud=<max>" and "usb") answers 'C',1,seq with a single frame once the
+// capture is done, instead of an ACK followed by 'D' requests per channel:
+//   0xA5 0xC3 type seq len(u16 LE) payload crc(u16 LE)
+// The CRC-16/CCITT-FALSE covers type through payload. Capture payload is
+// [mask] then the CH1 and/or CH2 bytes. 'B',index,0 asks for BAUD_RATES[index];
+// the device answers with a BaudAck frame at the old rate, then switches,
+// and returns to the default rate by itself if it hears nothing within
+// BAUD_REVERT_MS.
+static constexpr int DEFAULT_BAUD = 115200;
+static constexpr int BAUD_RATES[] = {115200, 230400, 460800, 921600, 1000000, 2000000};
+static constexpr int BAUD_RATE_COUNT = sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]);
+static constexpr int SIGNATURE_TIMEOUT_MS = 300; // also the quiet gap that ends a reply without newline
+static constexpr int BAUD_ACK_TIMEOUT_MS = 200;
+static constexpr int BAUD_REVERT_MS = 1200;
+static constexpr quint8 FRAME_SYNC1 = 0xA5;
+static constexpr quint8 FRAME_SYNC2 = 0xC3;
+static constexpr quint8 FRAME_CAPTURE = 0x01;
+static constexpr quint8 FRAME_BAUD_ACK = 0x02;
+static constexpr int FRAME_HEADER_BYTES = 6;
+static constexpr int FRAME_OVERHEAD_BYTES = FRAME_HEADER_BYTES + 2;
+static constexpr int MAX_FRAME_PAYLOAD = 1 + 2 * 400;
+static constexpr int MAX_FRAME_RETRIES = 3;
+// A full frame ring is warned about on the first drop and every this many after
+static constexpr int DROP_WARNING_INTERVAL = 100;
+// --- Side commands (digital I/O) between captures ---
+static constexpr int AUX_TIMEOUT_MS = 100;
 
-SerialHandler::SerialHandler(QObject *parent) : QObject(parent) {
+static quint16 crc16(const char *data, int length) {
+    quint16 crc = 0xFFFF;
+    for (int i = 0; i < length; ++i) {
+        crc ^= static_cast<quint16>(static_cast<quint8>(data[i])) << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? static_cast<quint16>((crc << 1) ^ 0x1021) : static_cast<quint16>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+SerialHandler::SerialHandler(QObject *parent) : QObject(parent), history(HISTORY_SAMPLES) {
     serial = new QSerialPort(this);
+    link = serial;
     connect(serial, &QSerialPort::readyRead, this, &SerialHandler::handleReadyRead);
     connect(serial, &QSerialPort::errorOccurred, this, &SerialHandler::handleError);
     // Add timer for timeouts
     timeoutTimer = new QTimer(this);
     timeoutTimer->setSingleShot(true);
     connect(timeoutTimer, &QTimer::timeout, this, [this]() {
+        if (acqState == AcquisitionState::NegotiatingStream) {
+            streamNegotiationFailed();
+            return;
+        }
+        if (acqState == AcquisitionState::WaitingForAux) {
+            qWarning() << "[SerialHandler] No reply to side command" << auxInFlight.toHex();
+            finishAux(QByteArray());
+            return;
+        }
         qWarning() << "SerialHandler: Timeout in state" << (int)acqState;
-        if (serial && serial->isOpen()) {
-            serial->readAll();
+        // The frame parser resyncs by itself; the legacy protocol has to start clean
+        if (!framedProtocol && link->isOpen()) {
+            link->readAll();
             qDebug() << "[SerialHandler] Cleared serial buffer on timeout.";
         }
         emit errorOccurred(tr("Timeout waiting for data (state %1)").arg((int)acqState));
-        resetAcquisitionState();
+        // The device may have missed part of the setup; resend all of it next time
+        invalidateDeviceSetup();
+        finishAcquisition();
     });
+    requestDelayTimer = new QTimer(this);
+    requestDelayTimer->setSingleShot(true);
+    connect(requestDelayTimer, &QTimer::timeout, this, &SerialHandler::sendDataRequest);
+    ddsTimer = new QTimer(this);
+    ddsTimer->setSingleShot(true);
+    connect(ddsTimer, &QTimer::timeout, this, &SerialHandler::sendNextDdsStep);
+    handshakeTimer = new QTimer(this);
+    handshakeTimer->setSingleShot(true);
+    connect(handshakeTimer, &QTimer::timeout, this, &SerialHandler::handleHandshakeTimeout);
+    framePayload.reserve(MAX_FRAME_PAYLOAD);
+    scratchFrame.ch1.reserve(400);
+    scratchFrame.ch2.reserve(400);
+    rxBuffer.reserve(64 * 1024);
 }
 
 SerialHandler::~SerialHandler() {
     disconnectPort();
 }
 
-bool SerialHandler::connectPort(const QString &portName) {
-    if (serial->isOpen()) serial->close();
+void SerialHandler::connectPort(const QString &portName) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, portName]() { connectPort(portName); }, Qt::QueuedConnection);
+        return;
+    }
+    closeLink();
     serial->setPortName(portName);
-    serial->setBaudRate(115200);
+    serial->setBaudRate(DEFAULT_BAUD);
     serial->setDataBits(QSerialPort::Data8);
     serial->setParity(QSerialPort::NoParity);
     serial->setStopBits(QSerialPort::OneStop);
     serial->setFlowControl(QSerialPort::NoFlowControl);
+    resetLinkState();
     if (serial->open(QIODevice::ReadWrite)) {
         qDebug() << "Serial port opened successfully:" << portName;
         emit statusMessage(tr("Serial port opened: %1").arg(portName));
         emit connectionStatus(true);
-        return true;
+        readSignature();
     } else {
         qDebug() << "Failed to open serial port:" << portName << serial->errorString();
         emit errorOccurred(tr("Failed to open serial port: %1").arg(portName));
         emit connectionStatus(false);
-        return false;
     }
 }
 
+void SerialHandler::connectSimulated(const SimulatedDevice::Config &config) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, config]() { connectSimulated(config); }, Qt::QueuedConnection);
+        return;
+    }
+    closeLink();
+    simulated = new SimulatedDevice(config, this);
+    connect(simulated, &QIODevice::readyRead, this, &SerialHandler::handleReadyRead);
+    link = simulated;
+    resetLinkState();
+    simulated->open(QIODevice::ReadWrite);
+    qDebug() << "[SerialHandler] Simulated device connected, link speed" << config.linkBaud << "baud";
+    emit statusMessage(tr("Simulated device connected"));
+    emit connectionStatus(true);
+    readSignature();
+}
+
+// Closes whichever link is open and goes back to the serial port
+void SerialHandler::closeLink() {
+    if (link->isOpen()) link->close();
+    if (simulated) {
+        delete simulated;
+        simulated = nullptr;
+    }
+    link = serial;
+}
+
+void SerialHandler::resetLinkState() {
+    invalidateDeviceSetup();
+    hardwareStreamSupport = -1;
+    linkState = LinkState::Ready;
+    handshakeTimer->stop();
+    afterHandshake = nullptr;
+    signature.clear();
+    signaturePending = false;
+    linkNegotiated = false;
+    framedProtocol = false;
+    nativeUsb = false;
+    rxBuffer.clear();
+    auxQueue.clear();
+    afterAux = nullptr;
+    ddsSteps.clear();
+    ddsSentPeriod.clear();
+    ddsSentSamples.clear();
+    ddsSentTable.clear();
+}
+
 void SerialHandler::disconnectPort() {
-    if (serial->isOpen()) serial->close();
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this]() { disconnectPort(); }, Qt::QueuedConnection);
+        return;
+    }
+    linkState = LinkState::Ready;
+    handshakeTimer->stop();
+    afterHandshake = nullptr;
+    closeLink();
     emit statusMessage(tr("Serial port closed"));
 }
 
@@ -80,13 +217,18 @@ void SerialHandler::setOffset(int ch1Offset, int ch2Offset) {
 }
 
 void SerialHandler::setTrigger(int trigLevel) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, trigLevel]() { setTrigger(trigLevel); }, Qt::QueuedConnection);
+        return;
+    }
     this->trigLevel = trigLevel;
-    if (serial->isOpen()) {
+    if (link->isOpen()) {
         QByteArray trigLevelCmd(3, 0);
         trigLevelCmd[0] = 0x4C; // 'L'
         trigLevelCmd[1] = (trigLevel >> 8) & 0xFF;
         trigLevelCmd[2] = trigLevel & 0xFF;
-        serial->write(trigLevelCmd);
+        link->write(trigLevelCmd);
+        sentTrigLevel = trigLevel;
         qDebug() << "[SerialHandler] Sent Trigger Level Command:" << trigLevelCmd.toHex();
     }
 }
@@ -107,15 +249,286 @@ void SerialHandler::setStudentName(const QString &name) {
 }
 
 void SerialHandler::readSignature() {
-    // Send command to read device signature
-    // ...
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this]() { readSignature(); }, Qt::QueuedConnection);
+        return;
+    }
+    // A handshake in progress emits the signature when it gets it
+    if (!link->isOpen() || handshaking()) return;
+    if (acquisitionInProgress || acqState != AcquisitionState::Idle || streaming) {
+        // The reply would land in the middle of a capture: read it once the
+        // capture ends, or report what we know if captures never stop
+        if (!streaming) signaturePending = true;
+        else if (!signature.isEmpty()) emit signatureReceived(QString::fromLatin1(signature));
+        return;
+    }
+    signaturePending = false;
+    rxBuffer.clear();
+    linkState = LinkState::ReadingSignature;
+    link->write(QByteArray(1, 'e'));
+    handshakeTimer->start(SIGNATURE_TIMEOUT_MS);
+}
+
+void SerialHandler::setMaxBaudRate(int baud) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, baud]() { setMaxBaudRate(baud); }, Qt::QueuedConnection);
+        return;
+    }
+    // Takes effect at the next connect
+    maxBaudRate = baud;
+}
+
+// Bytes that arrive while negotiating: signature text, or a BaudAck frame
+void SerialHandler::handleHandshakeData() {
+    rxBuffer.append(link->readAll());
+    if (linkState == LinkState::ChangingBaud) {
+        parseFrames();
+        return;
+    }
+    if (linkState != LinkState::ReadingSignature && linkState != LinkState::VerifyingBaud) {
+        rxBuffer.clear(); // garbage while the rates disagree
+        return;
+    }
+    const int end = rxBuffer.indexOf('\n');
+    if (end < 0) {
+        handshakeTimer->start(SIGNATURE_TIMEOUT_MS);
+        return;
+    }
+    const QByteArray text = rxBuffer.left(end);
+    rxBuffer.remove(0, end + 1);
+    handleSignature(text);
+}
+
+void SerialHandler::handleHandshakeTimeout() {
+    switch (linkState) {
+    case LinkState::ReadingSignature:
+    case LinkState::VerifyingBaud:
+        if (!rxBuffer.isEmpty()) {
+            // Reply without a line ending
+            const QByteArray text = rxBuffer;
+            rxBuffer.clear();
+            handleSignature(text);
+        } else if (linkState == LinkState::VerifyingBaud) {
+            // Nothing at the new rate; wait for the device to fall back
+            qWarning() << "[SerialHandler] No reply at" << BAUD_RATES[targetBaudIndex] << "baud, reverting to" << DEFAULT_BAUD;
+            serial->setBaudRate(DEFAULT_BAUD);
+            linkState = LinkState::WaitingForRevert;
+            handshakeTimer->start(BAUD_REVERT_MS);
+        } else {
+            qDebug() << "[SerialHandler] No signature reply.";
+            linkNegotiated = true;
+            finishHandshake();
+        }
+        break;
+    case LinkState::ChangingBaud:
+        qDebug() << "[SerialHandler] Baud change not acknowledged; staying at" << linkBaudRate();
+        finishHandshake();
+        break;
+    case LinkState::WaitingForRevert:
+        finishHandshake();
+        break;
+    case LinkState::Ready:
+        break;
+    }
+}
+
+void SerialHandler::handleSignature(const QByteArray &text) {
+    handshakeTimer->stop();
+    signature = text.trimmed();
+    emit signatureReceived(QString::fromLatin1(signature));
+    bool framed = false;
+    bool usb = false;
+    int baud = 0;
+    for (const QByteArray &token : signature.split(' ')) {
+        if (token == "proto=2") framed = true;
+        else if (token == "usb") usb = true;
+        else if (token.startsWith("baud=")) baud = token.mid(5).toInt();
+    }
+    if (linkState == LinkState::VerifyingBaud) {
+        if (!framed) qWarning() << "[SerialHandler] Unexpected signature after baud change:" << signature;
+        finishHandshake();
+        return;
+    }
+    if (linkNegotiated) {
+        // Plain re-read on an established link
+        linkState = LinkState::Ready;
+        return;
+    }
+    linkNegotiated = true;
+    framedProtocol = framed;
+    nativeUsb = framed && usb;
+    deviceMaxBaud = baud;
+    if (framedProtocol && !nativeUsb) {
+        const int cap = maxBaudRate > 0 ? qMin(maxBaudRate, deviceMaxBaud) : deviceMaxBaud;
+        targetBaudIndex = 0;
+        for (int i = 0; i < BAUD_RATE_COUNT; ++i) {
+            if (BAUD_RATES[i] <= cap) targetBaudIndex = i;
+        }
+        if (BAUD_RATES[targetBaudIndex] > linkBaudRate()) {
+            QByteArray cmd(3, 0);
+            cmd[0] = 0x42; // 'B'
+            cmd[1] = static_cast<char>(targetBaudIndex);
+            cmd[2] = 0x00;
+            link->write(cmd);
+            linkState = LinkState::ChangingBaud;
+            handshakeTimer->start(BAUD_ACK_TIMEOUT_MS);
+            return;
+        }
+    }
+    finishHandshake();
+}
+
+void SerialHandler::finishHandshake() {
+    linkState = LinkState::Ready;
+    handshakeTimer->stop();
+    rxBuffer.clear();
+    QString description;
+    if (!framedProtocol) description = tr("legacy protocol, %1 baud").arg(linkBaudRate());
+    else if (nativeUsb) description = tr("framed protocol, native USB");
+    else description = tr("framed protocol, %1 baud").arg(linkBaudRate());
+    if (simulated) description += tr(", simulated");
+    qDebug() << "[SerialHandler] Link:" << description;
+    emit statusMessage(tr("Link: %1").arg(description));
+    auto start = std::move(afterHandshake);
+    afterHandshake = nullptr;
+    // Side commands queued meanwhile go first
+    if (flushAux()) {
+        afterAux = std::move(start);
+        return;
+    }
+    if (start) start();
 }
 
 void SerialHandler::sendCommand(const QByteArray &cmd) {
-    if (serial->isOpen()) {
-        serial->write(cmd);
-        serial->waitForBytesWritten(100);
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, cmd]() { sendCommand(cmd); }, Qt::QueuedConnection);
+        return;
+    }
+    // QSerialPort flushes from the event loop; no need to block on the write
+    if (link->isOpen()) {
+        link->write(cmd);
+        // A raw T/P/L/F/S command changes state the setup sequence tracks
+        if (!cmd.isEmpty()) {
+            switch (cmd[0]) {
+            case 0x54: sentTrigSource = -1; break;
+            case 0x50: sentTrigPolarity = -1; break;
+            case 0x4C: sentTrigLevel = -1; break;
+            case 0x46: sentMode = -1; break;
+            case 0x53: sentSampleRateIdx = -1; break;
+            case 0x70: ddsSentPeriod.clear(); break;
+            case 0x4E: ddsSentSamples.clear(); break;
+            case 0x72: ddsSentTable.clear(); break;
+            default: break;
+            }
+        }
+    }
+}
+
+void SerialHandler::queueAuxCommand(const QByteArray &cmd, int replyBytes, bool latestWins) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { queueAuxCommand(cmd, replyBytes, latestWins); }, Qt::QueuedConnection);
+        return;
+    }
+    if (!link->isOpen() || cmd.isEmpty()) return;
+    bool replaced = false;
+    if (latestWins) {
+        for (AuxCommand &queued : auxQueue) {
+            if (queued.cmd[0] == cmd[0]) {
+                queued = {cmd, replyBytes};
+                replaced = true;
+                break;
+            }
+        }
+    }
+    if (!replaced) auxQueue.append({cmd, replyBytes});
+    if (acqState == AcquisitionState::Idle && !handshaking()) flushAux();
+}
+
+// Writes queued side commands up to and including the first one that
+// expects a reply; true if that reply is now awaited
+bool SerialHandler::flushAux() {
+    QByteArray batch;
+    while (!auxQueue.isEmpty()) {
+        const AuxCommand aux = auxQueue.takeFirst();
+        batch.append(aux.cmd);
+        if (aux.replyBytes > 0) {
+            // Nothing else is outstanding, so anything still buffered is stale
+            rxBuffer.clear();
+            link->write(batch);
+            auxInFlight = aux.cmd;
+            acqState = AcquisitionState::WaitingForAux;
+            bytesNeeded = aux.replyBytes;
+            timeoutTimer->start(AUX_TIMEOUT_MS);
+            return true;
+        }
     }
+    if (!batch.isEmpty()) link->write(batch);
+    return false;
+}
+
+void SerialHandler::finishAux(const QByteArray &reply) {
+    timeoutTimer->stop();
+    acqState = AcquisitionState::Idle;
+    bytesNeeded = 0;
+    const QByteArray cmd = auxInFlight;
+    auxInFlight.clear();
+    emit auxReplyReceived(cmd, reply);
+    if (flushAux()) return;
+    if (signaturePending) {
+        // The held-back capture follows the signature instead
+        afterHandshake = std::move(afterAux);
+        afterAux = nullptr;
+        readSignature();
+        return;
+    }
+    if (afterAux) {
+        auto resume = std::move(afterAux);
+        afterAux = nullptr;
+        resume();
+    }
+}
+
+void SerialHandler::uploadDds(const QByteArray &periodCmd, const QByteArray &samplesCmd,
+                              const QByteArray &tableCmd, const QByteArray &runCmd) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { uploadDds(periodCmd, samplesCmd, tableCmd, runCmd); }, Qt::QueuedConnection);
+        return;
+    }
+    // Anything still queued from an earlier upload is superseded
+    ddsSteps.clear();
+    ddsStep = 0;
+    if (periodCmd != ddsSentPeriod) ddsSteps.append(periodCmd);
+    if (samplesCmd != ddsSentSamples) ddsSteps.append(samplesCmd);
+    if (tableCmd != ddsSentTable) ddsSteps.append(tableCmd);
+    ddsSteps.append(runCmd);
+    qDebug() << "[SerialHandler] DDS upload queued:" << ddsSteps.size() << "commands";
+    // Keep the pacing gap if a step went out just now
+    if (!ddsTimer->isActive()) sendNextDdsStep();
+}
+
+void SerialHandler::sendNextDdsStep() {
+    if (ddsStep >= ddsSteps.size()) return;
+    if (!link->isOpen()) {
+        // Nothing more goes out; whoever waits for the upload has to know
+        qWarning() << "[SerialHandler] Port not open, DDS upload dropped with" << ddsSteps.size() - ddsStep
+                   << "commands left";
+        ddsSteps.clear();
+        ddsStep = 0;
+        emit ddsUploadFailed();
+        return;
+    }
+    const QByteArray cmd = ddsSteps[ddsStep++];
+    link->write(cmd);
+    // Remember what the device now holds
+    switch (cmd[0]) {
+    case 0x70: ddsSentPeriod = cmd; break;
+    case 0x4E: ddsSentSamples = cmd; break;
+    case 0x72: ddsSentTable = cmd; break;
+    default: break;
+    }
+    // Also holds off the first command of the next upload
+    ddsTimer->start(DDS_STEP_MS);
+    if (ddsStep == ddsSteps.size()) emit ddsUploaded();
 }
 
 // --- Asynchronous setup sequence ---
@@ -129,7 +542,32 @@ void SerialHandler::sendSetupSequence() {
     handleSetupStep();
 }
 
+// Only resend setup commands whose value differs from what the device already
+// has; when nothing changed the capture goes out without any 50ms gaps
+bool SerialHandler::setupStepNeeded(int step) const {
+    switch (step) {
+    case 0:
+    case 1:
+        return false; // Offset commands are disabled
+    case 2: return trigSource != sentTrigSource;
+    case 3: return trigPolarity != sentTrigPolarity;
+    case 4: return trigLevel != sentTrigLevel;
+    case 5: return acqMode != sentMode;
+    case 6: return sampleRateIdx != sentSampleRateIdx;
+    default: return true;
+    }
+}
+
+void SerialHandler::invalidateDeviceSetup() {
+    sentTrigSource = -1;
+    sentTrigPolarity = -1;
+    sentTrigLevel = -1;
+    sentMode = -1;
+    sentSampleRateIdx = -1;
+}
+
 void SerialHandler::handleSetupStep() {
+    while (setupStep < 7 && !setupStepNeeded(setupStep)) setupStep++;
     switch (setupStep) {
     case 0: {
         // Offset CH1 - TEMPORARILY DISABLED TO TEST
@@ -139,7 +577,7 @@ void SerialHandler::handleSetupStep() {
         // offsetCmd[1] = (ch1Offset >> 8) & 0xFF;
         // offsetCmd[2] = ch1Offset & 0xFF;
         // qDebug() << "[SerialHandler] Sending CH1 offset command:" << offsetCmd.toHex() << "value:" << ch1Offset;
-        // serial->write(offsetCmd);
+        // link->write(offsetCmd);
         break;
     }
     case 1: {
@@ -150,7 +588,7 @@ void SerialHandler::handleSetupStep() {
         // offsetCmd[1] = (ch2Offset >> 8) & 0xFF;
         // offsetCmd[2] = ch2Offset & 0xFF;
         // qDebug() << "[SerialHandler] Sending CH2 offset command:" << offsetCmd.toHex() << "value:" << ch2Offset;
-        // serial->write(offsetCmd);
+        // link->write(offsetCmd);
         break;
     }
     case 2: {
@@ -159,7 +597,8 @@ void SerialHandler::handleSetupStep() {
         trigSourceCmd[0] = 0x54; // 'T'
         trigSourceCmd[1] = trigSource; // Use actual trigger source value
         trigSourceCmd[2] = 0x00;
-        serial->write(trigSourceCmd);
+        link->write(trigSourceCmd);
+        sentTrigSource = trigSource;
         break;
     }
     case 3: {
@@ -168,7 +607,8 @@ void SerialHandler::handleSetupStep() {
         trigPolarityCmd[0] = 0x50; // 'P'
         trigPolarityCmd[1] = trigPolarity; // Use actual trigger polarity value
         trigPolarityCmd[2] = 0x00;
-        serial->write(trigPolarityCmd);
+        link->write(trigPolarityCmd);
+        sentTrigPolarity = trigPolarity;
         break;
     }
     case 4: {
@@ -177,7 +617,8 @@ void SerialHandler::handleSetupStep() {
         trigLevelCmd[0] = 0x4C; // 'L'
         trigLevelCmd[1] = (trigLevel >> 8) & 0xFF;
         trigLevelCmd[2] = trigLevel & 0xFF;
-        serial->write(trigLevelCmd);
+        link->write(trigLevelCmd);
+        sentTrigLevel = trigLevel;
         break;
     }
     case 5: {
@@ -186,7 +627,8 @@ void SerialHandler::handleSetupStep() {
         modeCmd[0] = 0x46;
         modeCmd[1] = acqMode;
         modeCmd[2] = 0x00;
-        serial->write(modeCmd);
+        link->write(modeCmd);
+        sentMode = acqMode;
         break;
     }
     case 6: {
@@ -197,19 +639,36 @@ void SerialHandler::handleSetupStep() {
         srCmd[0] = 0x53;
         srCmd[1] = deviceIndex;
         srCmd[2] = 0x00;
-        serial->write(srCmd);
+        link->write(srCmd);
+        sentSampleRateIdx = sampleRateIdx;
         qDebug() << "[SerialHandler] Sent sample rate command:" << srCmd.toHex() << "UI index:" << sampleRateIdx << "device index:" << deviceIndex;
         break;
     }
     case 7: {
+        if (historyStreamRequested && hardwareStreamSupport != 0) {
+            // Ask the firmware to stream instead of capturing once
+            sendStreamCommand(true);
+            acqState = AcquisitionState::NegotiatingStream;
+            bytesNeeded = 1;
+            timeoutTimer->start(STREAM_NEGOTIATE_TIMEOUT_MS);
+            qDebug() << "[SerialHandler] Setup complete, requested hardware streaming.";
+            return;
+        }
+        if (framedProtocol) {
+            sendFramedCapture();
+            PERF_LAP(PerfStage::Setup, perfStageNs);
+            qCDebug(lcFrame) << "[SerialHandler] Setup complete, sent framed capture command.";
+            return;
+        }
         // All setup done, send capture command
         QByteArray cmd;
         cmd.append((char)0x43); cmd.append((char)0x00); cmd.append((char)0x00);
-        serial->write(cmd);
+        link->write(cmd);
         acqState = AcquisitionState::WaitingForDone;
         bytesNeeded = 1;
         timeoutTimer->start(STATE_TIMEOUT_MS);
-        qDebug() << "[SerialHandler] Setup complete, sent capture command.";
+        PERF_LAP(PerfStage::Setup, perfStageNs);
+        qCDebug(lcFrame) << "[SerialHandler] Setup complete, sent capture command.";
         return;
     }
     default:
@@ -220,137 +679,495 @@ void SerialHandler::handleSetupStep() {
 }
 
 void SerialHandler::startOscilloscopeAcquisition(int mode, int dataLength, bool dualChannel) {
-    if (acquisitionInProgress) {
-        qDebug() << "[SerialHandler] Acquisition already in progress, ignoring new request.";
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, mode, dataLength, dualChannel]() {
+            startOscilloscopeAcquisition(mode, dataLength, dualChannel);
+        }, Qt::QueuedConnection);
         return;
     }
-    acquisitionInProgress = true;
+    if (handshaking()) {
+        afterHandshake = [this, mode, dataLength, dualChannel]() {
+            startOscilloscopeAcquisition(mode, dataLength, dualChannel);
+        };
+        return;
+    }
+    if (acqState == AcquisitionState::WaitingForAux) {
+        afterAux = [this, mode, dataLength, dualChannel]() {
+            startOscilloscopeAcquisition(mode, dataLength, dualChannel);
+        };
+        return;
+    }
+    if (acquisitionInProgress) {
+        // The newest request has the settings the caller wants
+        qCDebug(lcFrame) << "[SerialHandler] Acquisition in progress, restarting it with the new request.";
+    }
     resetAcquisitionState();
+    acquisitionInProgress = true;
     acqMode = mode;
     acqDataLength = dataLength;
     acqDualChannel = dualChannel;
-    qDebug() << "[SerialHandler] Starting acquisition: mode=" << mode << ", len=" << dataLength << ", dual=" << dualChannel;
+    perfStageNs = PERF_NOW();
+    qCDebug(lcFrame) << "[SerialHandler] Starting acquisition: mode=" << mode << ", len=" << dataLength << ", dual=" << dualChannel;
     sendSetupSequence();
 }
 
 void SerialHandler::handleReadyRead() {
-    while (serial->bytesAvailable() > 0) {
+    if (handshaking()) {
+        handleHandshakeData();
+        return;
+    }
+    if (acqState == AcquisitionState::WaitingForAux) {
+        rxBuffer.append(link->readAll());
+        if (rxBuffer.size() < bytesNeeded) return;
+        const QByteArray reply = rxBuffer.left(bytesNeeded);
+        rxBuffer.remove(0, bytesNeeded);
+        finishAux(reply);
+        return;
+    }
+    if (acqState == AcquisitionState::Streaming) {
+        rxBuffer.append(link->readAll());
+        parseStreamBlocks();
+        return;
+    }
+    if (acqState == AcquisitionState::NegotiatingStream) {
+        QByteArray reply = link->read(1);
+        if (reply.isEmpty()) return;
+        if (reply[0] != 0x58) { // 'X'
+            link->readAll();
+            streamNegotiationFailed();
+            return;
+        }
+        hardwareStreamSupport = 1;
+        acqState = AcquisitionState::Streaming;
+        rxBuffer.clear();
+        emit hardwareStreamingStatus(true);
+        qDebug() << "[SerialHandler] Hardware streaming active.";
+        rxBuffer.append(link->readAll());
+        parseStreamBlocks();
+        return;
+    }
+    if (framedProtocol) {
+        // Everything goes through the frame parser, even while idle
+        rxBuffer.append(link->readAll());
+        parseFrames();
+        return;
+    }
+    while (link->bytesAvailable() > 0) {
         if (acqState == AcquisitionState::Idle) {
-            qDebug() << "[SerialHandler] Idle state, ignoring data. Bytes available:" << serial->bytesAvailable();
-            serial->readAll(); // Clear buffer
+            qCDebug(lcFrame) << "[SerialHandler] Idle state, ignoring data. Bytes available:" << link->bytesAvailable();
+            link->readAll(); // Clear buffer
             return;
         }
         if (acqState == AcquisitionState::WaitingForDone) {
-            qDebug() << "[SerialHandler] WaitingForDone: bytesAvailable=" << serial->bytesAvailable() << ", bytesNeeded=" << bytesNeeded;
-            if (serial->bytesAvailable() < bytesNeeded) {
-                qDebug() << "[SerialHandler] Not enough bytes for ACK yet.";
+            qCDebug(lcSample) << "[SerialHandler] WaitingForDone: bytesAvailable=" << link->bytesAvailable() << ", bytesNeeded=" << bytesNeeded;
+            if (link->bytesAvailable() < bytesNeeded) {
+                qCDebug(lcSample) << "[SerialHandler] Not enough bytes for ACK yet.";
                 return;
             }
-            if (bytesNeeded <= 0 || serial->bytesAvailable() < bytesNeeded) {
-                qWarning() << "[SerialHandler] Defensive: Attempted to read more bytes than available for ACK! bytesNeeded=" << bytesNeeded << ", bytesAvailable=" << serial->bytesAvailable();
+            if (bytesNeeded <= 0 || link->bytesAvailable() < bytesNeeded) {
+                qWarning() << "[SerialHandler] Defensive: Attempted to read more bytes than available for ACK! bytesNeeded=" << bytesNeeded << ", bytesAvailable=" << link->bytesAvailable();
                 return;
             }
-            QByteArray ack = serial->read(bytesNeeded);
-            qDebug() << "[SerialHandler] Got ACK:" << ack.toHex();
+            QByteArray ack = link->read(bytesNeeded);
+            PERF_LAP(PerfStage::CaptureAck, perfStageNs);
+            qCDebug(lcFrame) << "[SerialHandler] Got ACK:" << ack.toHex();
             // Accept any 1-byte acknowledgment for robustness
-            // Now request data based on mode
-            ch1Raw.clear();
-            ch2Raw.clear();
-            // --- PATCH: Add delay and clear buffer before data request ---
-            serial->readAll(); // Clear any leftover bytes
-            QThread::msleep(100); // Wait 100ms before sending data request
-            // --- END PATCH ---
-            QByteArray dcmd;
-            if (acqDualChannel) { 
-                dcmd.append((char)0x44); dcmd.append((char)0x01); dcmd.append((char)0x00); // D,1,0 for dual channel
-                bytesNeeded = 200;
-                acqState = AcquisitionState::WaitingForCh1;
-                qDebug() << "[SerialHandler] Sent dual-channel CH1 read command, waiting for" << bytesNeeded << "bytes.";
-            }
-            else if (acqMode == 2) { 
-                dcmd.append((char)0x44); dcmd.append((char)0x03); dcmd.append((char)0x00); // D,3,0 for CH1 only
-                bytesNeeded = 400;
-                acqState = AcquisitionState::WaitingForCh1;
-                qDebug() << "[SerialHandler] Sent CH1-only read command, waiting for" << bytesNeeded << "bytes.";
-            }
-            else if (acqMode == 3) { 
-                dcmd.append((char)0x44); dcmd.append((char)0x04); dcmd.append((char)0x00); // D,4,0 for CH2 only
-                bytesNeeded = 400;
-                acqState = AcquisitionState::WaitingForCh2; // Directly wait for CH2 data
-                qDebug() << "[SerialHandler] Sent CH2-only read command, waiting for" << bytesNeeded << "bytes.";
-            }
-            qDebug() << "[SerialHandler] Sending data request command:" << dcmd.toHex() << "for mode" << acqMode;
-            serial->write(dcmd); serial->waitForBytesWritten(100);
-            timeoutTimer->start(STATE_TIMEOUT_MS);
+            link->readAll(); // Clear any leftover bytes
+            // Give the device time before the data request without blocking the thread
+            acqState = AcquisitionState::WaitingToRequest;
+            requestDelayTimer->start(DATA_REQUEST_DELAY_MS);
+            return;
+        }
+        if (acqState == AcquisitionState::WaitingToRequest) {
+            // Nothing is expected until the data request goes out
+            link->readAll();
             return;
         }
         if (acqState == AcquisitionState::WaitingForCh1) {
-            qDebug() << "[SerialHandler] WaitingForCh1: bytesAvailable=" << serial->bytesAvailable() << ", bytesNeeded=" << bytesNeeded;
-            if (serial->bytesAvailable() < bytesNeeded) {
-                qDebug() << "[SerialHandler] Not enough bytes for CH1 yet. Waiting for" << (bytesNeeded - serial->bytesAvailable()) << "more bytes.";
-                // Add a small delay to allow more data to arrive
-                QThread::msleep(10);
+            qCDebug(lcSample) << "[SerialHandler] WaitingForCh1: bytesAvailable=" << link->bytesAvailable() << ", bytesNeeded=" << bytesNeeded;
+            if (link->bytesAvailable() < bytesNeeded) {
+                qCDebug(lcSample) << "[SerialHandler] Not enough bytes for CH1 yet. Waiting for" << (bytesNeeded - link->bytesAvailable()) << "more bytes.";
+                // readyRead fires again once more data has arrived
                 return;
             }
-            if (bytesNeeded <= 0 || serial->bytesAvailable() < bytesNeeded) {
-                qWarning() << "[SerialHandler] Defensive: Attempted to read more bytes than available for CH1! bytesNeeded=" << bytesNeeded << ", bytesAvailable=" << serial->bytesAvailable();
+            if (bytesNeeded <= 0 || link->bytesAvailable() < bytesNeeded) {
+                qWarning() << "[SerialHandler] Defensive: Attempted to read more bytes than available for CH1! bytesNeeded=" << bytesNeeded << ", bytesAvailable=" << link->bytesAvailable();
                 return;
             }
-            ch1Raw = serial->read(bytesNeeded);
-            qDebug() << "[SerialHandler] Got CH1 data, len=" << ch1Raw.size();
-            if (ch1Raw.size() > 0) {
-                qDebug() << "[SerialHandler] CH1 first 5 bytes:" << ch1Raw.left(5).toHex();
-            }
+            // Read straight into the preallocated ring slot
+            pendingFrame->ch1.resize(bytesNeeded);
+            link->read(pendingFrame->ch1.data(), bytesNeeded);
+            PERF_LAP(PerfStage::Ch1Receive, perfStageNs);
+            qCDebug(lcFrame) << "[SerialHandler] Got CH1 data, len=" << pendingFrame->ch1.size();
             if (acqDualChannel) {
                 // Now request CH2 data
                 QByteArray dcmd; dcmd.append((char)0x44); dcmd.append((char)0x02); dcmd.append((char)0x00); // D,2,0
-                serial->write(dcmd); serial->waitForBytesWritten(100);
+                link->write(dcmd);
                 bytesNeeded = 200;
                 acqState = AcquisitionState::WaitingForCh2;
                 timeoutTimer->start(STATE_TIMEOUT_MS);
-                qDebug() << "[SerialHandler] Sent CH2 read command, waiting for 200 bytes.";
+                qCDebug(lcFrame) << "[SerialHandler] Sent CH2 read command, waiting for 200 bytes.";
             } else if (acqMode == 2) {
-                // CH1-only mode - emit CH1 data in ch1 parameter
+                // CH1-only mode - publish CH1 data in ch1, empty ch2
                 acqState = AcquisitionState::Complete;
                 timeoutTimer->stop();
-                emit oscilloscopeRawDataReady(ch1Raw, QByteArray(), acqDataLength, false);
-                resetAcquisitionState();
+                pendingFrame->ch2.resize(0);
+                publishFrame(false);
+                finishAcquisition();
             }
             // Note: CH2-only mode (acqMode == 3) goes directly to WaitingForCh2 state
             return;
         }
         if (acqState == AcquisitionState::WaitingForCh2) {
-            qDebug() << "[SerialHandler] WaitingForCh2: bytesAvailable=" << serial->bytesAvailable() << ", bytesNeeded=" << bytesNeeded;
-            if (serial->bytesAvailable() < bytesNeeded) {
-                qDebug() << "[SerialHandler] Not enough bytes for CH2 yet.";
+            qCDebug(lcSample) << "[SerialHandler] WaitingForCh2: bytesAvailable=" << link->bytesAvailable() << ", bytesNeeded=" << bytesNeeded;
+            if (link->bytesAvailable() < bytesNeeded) {
+                qCDebug(lcSample) << "[SerialHandler] Not enough bytes for CH2 yet.";
                 return;
             }
-            if (bytesNeeded <= 0 || serial->bytesAvailable() < bytesNeeded) {
-                qWarning() << "[SerialHandler] Defensive: Attempted to read more bytes than available for CH2! bytesNeeded=" << bytesNeeded << ", bytesAvailable=" << serial->bytesAvailable();
+            if (bytesNeeded <= 0 || link->bytesAvailable() < bytesNeeded) {
+                qWarning() << "[SerialHandler] Defensive: Attempted to read more bytes than available for CH2! bytesNeeded=" << bytesNeeded << ", bytesAvailable=" << link->bytesAvailable();
                 return;
             }
-            ch2Raw = serial->read(bytesNeeded);
-            qDebug() << "[SerialHandler] Got CH2 data, len=" << ch2Raw.size();
-            if (ch2Raw.size() > 0) {
-                qDebug() << "[SerialHandler] CH2 first 5 bytes:" << ch2Raw.left(5).toHex();
-            }
+            pendingFrame->ch2.resize(bytesNeeded);
+            link->read(pendingFrame->ch2.data(), bytesNeeded);
+            PERF_LAP(PerfStage::Ch2Receive, perfStageNs);
+            qCDebug(lcFrame) << "[SerialHandler] Got CH2 data, len=" << pendingFrame->ch2.size();
             acqState = AcquisitionState::Complete;
             timeoutTimer->stop();
             if (acqDualChannel) {
-                // Dual channel mode - emit both CH1 and CH2 data
-            emit oscilloscopeRawDataReady(ch1Raw, ch2Raw, acqDataLength, true);
+                // Dual channel mode - publish both CH1 and CH2 data
+                publishFrame(true);
             } else if (acqMode == 3) {
-                // CH2-only mode - emit CH2 data in ch2 parameter, empty ch1
-                emit oscilloscopeRawDataReady(QByteArray(), ch2Raw, acqDataLength, false);
+                // CH2-only mode - publish CH2 data in ch2, empty ch1
+                pendingFrame->ch1.resize(0);
+                publishFrame(false);
             }
-            resetAcquisitionState();
+            finishAcquisition();
             return;
         }
         // Catch-all: unexpected state/data
-        qWarning() << "[SerialHandler] Unexpected state or data. State:" << (int)acqState << ", bytesAvailable=" << serial->bytesAvailable();
-        serial->readAll(); // Clear buffer to avoid infinite loop
+        qWarning() << "[SerialHandler] Unexpected state or data. State:" << (int)acqState << ", bytesAvailable=" << link->bytesAvailable();
+        link->readAll(); // Clear buffer to avoid infinite loop
+        return;
+    }
+}
+
+void SerialHandler::sendDataRequest() {
+    if (acqState != AcquisitionState::WaitingToRequest) return;
+    link->readAll(); // Clear any leftover bytes
+    // Claim a ring slot for this frame; if the GUI has fallen behind, the
+    // frame is still read (to keep the protocol in step) but then dropped
+    pendingFrame = frames.beginWrite();
+    if (!pendingFrame) {
+        pendingFrame = &scratchFrame;
+    }
+    QByteArray dcmd;
+    if (acqDualChannel) {
+        dcmd.append((char)0x44); dcmd.append((char)0x01); dcmd.append((char)0x00); // D,1,0 for dual channel
+        bytesNeeded = 200;
+        acqState = AcquisitionState::WaitingForCh1;
+        qCDebug(lcFrame) << "[SerialHandler] Sent dual-channel CH1 read command, waiting for" << bytesNeeded << "bytes.";
+    }
+    else if (acqMode == 2) {
+        dcmd.append((char)0x44); dcmd.append((char)0x03); dcmd.append((char)0x00); // D,3,0 for CH1 only
+        bytesNeeded = 400;
+        acqState = AcquisitionState::WaitingForCh1;
+        qCDebug(lcFrame) << "[SerialHandler] Sent CH1-only read command, waiting for" << bytesNeeded << "bytes.";
+    }
+    else if (acqMode == 3) {
+        dcmd.append((char)0x44); dcmd.append((char)0x04); dcmd.append((char)0x00); // D,4,0 for CH2 only
+        bytesNeeded = 400;
+        acqState = AcquisitionState::WaitingForCh2; // Directly wait for CH2 data
+        qCDebug(lcFrame) << "[SerialHandler] Sent CH2-only read command, waiting for" << bytesNeeded << "bytes.";
+    }
+    qCDebug(lcFrame) << "[SerialHandler] Sending data request command:" << dcmd.toHex() << "for mode" << acqMode;
+    link->write(dcmd);
+    perfStageNs = PERF_NOW();
+    timeoutTimer->start(STATE_TIMEOUT_MS);
+}
+
+void SerialHandler::sendFramedCapture() {
+    if (!pendingFrame) {
+        pendingFrame = frames.beginWrite();
+        if (!pendingFrame) pendingFrame = &scratchFrame;
+    }
+    // A new sequence number lets a late frame for an abandoned request be told apart
+    ++captureSeq;
+    QByteArray cmd(3, 0);
+    cmd[0] = 0x43; // 'C'
+    cmd[1] = 0x01; // answer with a frame
+    cmd[2] = static_cast<char>(captureSeq);
+    link->write(cmd);
+    acqState = AcquisitionState::WaitingForFrame;
+    timeoutTimer->start(STATE_TIMEOUT_MS);
+}
+
+// Handles every complete frame in rxBuffer. A CRC failure mid-capture asks
+// for the capture again straight away rather than waiting for the timeout.
+void SerialHandler::parseFrames() {
+    quint8 type = 0;
+    quint8 seq = 0;
+    while (takeFrame(type, seq, framePayload)) {
+        handleFrame(type, seq, framePayload);
+    }
+    if (frameCorrupted && acqState == AcquisitionState::WaitingForFrame && frameRetries < MAX_FRAME_RETRIES) {
+        ++frameRetries;
+        qWarning() << "[SerialHandler] Corrupted frame, requesting the capture again (" << frameRetries << ")";
+        sendFramedCapture();
+    }
+    frameCorrupted = false;
+}
+
+// Removes the first valid frame from rxBuffer into payload. Bytes in front
+// of it that don't start a valid frame are dropped one at a time, so a
+// corrupted frame costs only itself; an incomplete one is left in place.
+bool SerialHandler::takeFrame(quint8 &type, quint8 &seq, QByteArray &payload) {
+    const char *buf = rxBuffer.constData();
+    const int size = rxBuffer.size();
+    int pos = 0;
+    bool found = false;
+    while (size - pos >= FRAME_OVERHEAD_BYTES) {
+        if (static_cast<quint8>(buf[pos]) != FRAME_SYNC1 || static_cast<quint8>(buf[pos + 1]) != FRAME_SYNC2) {
+            ++pos;
+            continue;
+        }
+        const quint8 frameType = static_cast<quint8>(buf[pos + 2]);
+        const int length = static_cast<quint8>(buf[pos + 4]) | (static_cast<quint8>(buf[pos + 5]) << 8);
+        if ((frameType != FRAME_CAPTURE && frameType != FRAME_BAUD_ACK) || length > MAX_FRAME_PAYLOAD) {
+            ++pos;
+            continue;
+        }
+        const int frameBytes = FRAME_OVERHEAD_BYTES + length;
+        if (size - pos < frameBytes) break;
+        const quint16 sent = static_cast<quint8>(buf[pos + frameBytes - 2])
+                           | (static_cast<quint8>(buf[pos + frameBytes - 1]) << 8);
+        if (crc16(buf + pos + 2, FRAME_HEADER_BYTES - 2 + length) != sent) {
+            ++crcErrors;
+            frameCorrupted = true;
+            qWarning() << "[SerialHandler] Frame CRC mismatch, resyncing. Total CRC errors:" << crcErrors;
+            ++pos;
+            continue;
+        }
+        type = frameType;
+        seq = static_cast<quint8>(buf[pos + 3]);
+        payload.resize(length);
+        std::memcpy(payload.data(), buf + pos + FRAME_HEADER_BYTES, length);
+        pos += frameBytes;
+        found = true;
+        break;
+    }
+    if (pos > 0) rxBuffer.remove(0, pos);
+    return found;
+}
+
+void SerialHandler::handleFrame(quint8 type, quint8 seq, const QByteArray &payload) {
+    if (type == FRAME_BAUD_ACK) {
+        if (linkState != LinkState::ChangingBaud) return;
+        // The device switches once the ack is out; confirm at the new rate
+        serial->setBaudRate(BAUD_RATES[targetBaudIndex]);
+        rxBuffer.clear();
+        linkState = LinkState::VerifyingBaud;
+        link->write(QByteArray(1, 'e'));
+        handshakeTimer->start(SIGNATURE_TIMEOUT_MS);
+        return;
+    }
+    if (acqState != AcquisitionState::WaitingForFrame || seq != captureSeq) {
+        qCDebug(lcFrame) << "[SerialHandler] Ignoring stale frame, seq" << seq;
+        return;
+    }
+    const int expectedMask = acqDualChannel ? 0x03 : (acqMode == 3 ? 0x02 : 0x01);
+    const int channels = acqDualChannel ? 2 : 1;
+    const int count = (payload.size() - 1) / channels;
+    if (payload.isEmpty() || static_cast<quint8>(payload[0]) != expectedMask
+        || count <= 0 || 1 + count * channels != payload.size()) {
+        qWarning() << "[SerialHandler] Capture frame does not match the request, mask" << (payload.isEmpty() ? -1 : int(static_cast<quint8>(payload[0])));
+        frameCorrupted = true;
         return;
     }
+    const char *data = payload.constData() + 1;
+    pendingFrame->ch1.resize((expectedMask & 0x01) ? count : 0);
+    pendingFrame->ch2.resize((expectedMask & 0x02) ? count : 0);
+    if (expectedMask & 0x01) {
+        std::memcpy(pendingFrame->ch1.data(), data, count);
+        data += count;
+    }
+    if (expectedMask & 0x02) std::memcpy(pendingFrame->ch2.data(), data, count);
+    acqState = AcquisitionState::Complete;
+    timeoutTimer->stop();
+    frameCorrupted = false;
+    // A framed capture arrives in one piece, ACK and both channels together
+    PERF_LAP(PerfStage::Ch1Receive, perfStageNs);
+    publishFrame(acqDualChannel);
+    finishAcquisition();
+}
+
+void SerialHandler::publishFrame(bool dualChannel) {
+    pendingFrame->dataLength = acqDataLength;
+    pendingFrame->dualChannel = dualChannel;
+    pendingFrame->timestampNs = acquisitionClockNs();
+    PERF_ACQUIRED();
+    if (frameRecorder) frameRecorder->record(*pendingFrame, recorderDevice);
+    if (historyStreamRequested || recording) {
+        const bool hasCh1 = !pendingFrame->ch1.isEmpty();
+        const bool hasCh2 = !pendingFrame->ch2.isEmpty();
+        const int count = hasCh1 ? pendingFrame->ch1.size() : pendingFrame->ch2.size();
+        if (history.append(hasCh1 ? pendingFrame->ch1.constData() : nullptr,
+                           hasCh2 ? pendingFrame->ch2.constData() : nullptr, count)
+            && historyStreamRequested) {
+            emit historyAvailable();
+        }
+    }
+    if (historyStreamRequested) {
+        // Request/response fallback for streaming: frames feed the history only.
+        // The ring slot was never committed; the next acquisition reuses it
+    } else if (pendingFrame == &scratchFrame) {
+        frames.noteDropped();
+        const int dropped = frames.droppedFrames();
+        qCDebug(lcFrame) << "[SerialHandler] Frame ring full, dropped frame. Total dropped:" << dropped;
+        if (dropped % DROP_WARNING_INTERVAL == 1)
+            qWarning() << "[SerialHandler] Frame ring full, frames are being dropped. Total dropped:" << dropped;
+    } else if (frames.commitWrite()) {
+        emit framesAvailable();
+    }
+    pendingFrame = nullptr;
+}
+
+// Ends the current acquisition; in streaming mode the next capture is armed
+// straight away with the same mode, overlapping the GUI's decode and plot
+void SerialHandler::finishAcquisition() {
+    int mode = acqMode;
+    int dataLength = acqDataLength;
+    bool dualChannel = acqDualChannel;
+    resetAcquisitionState();
+    if (signaturePending && !streaming) {
+        // Side commands queued meanwhile go out after the signature
+        readSignature();
+        return;
+    }
+    // Side commands queued during the capture go out in the gap
+    if (!auxQueue.isEmpty() && flushAux()) {
+        if (streaming) {
+            afterAux = [this, mode, dataLength, dualChannel]() {
+                startOscilloscopeAcquisition(mode, dataLength, dualChannel);
+            };
+        }
+        return;
+    }
+    if (streaming && link->isOpen()) {
+        startOscilloscopeAcquisition(mode, dataLength, dualChannel);
+    }
+}
+
+void SerialHandler::startHardwareStreaming(int mode) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, mode]() { startHardwareStreaming(mode); }, Qt::QueuedConnection);
+        return;
+    }
+    if (handshaking()) {
+        afterHandshake = [this, mode]() { startHardwareStreaming(mode); };
+        return;
+    }
+    if (acqState == AcquisitionState::WaitingForAux) {
+        afterAux = [this, mode]() { startHardwareStreaming(mode); };
+        return;
+    }
+    historyStreamRequested = true;
+    // A lost stream (timeout) or the request/response fallback re-arms itself
+    streaming = true;
+    history.reset();
+    resetAcquisitionState();
+    acqMode = mode;
+    acqDualChannel = (mode == 1);
+    acqDataLength = acqDualChannel ? 200 : 400;
+    acquisitionInProgress = true;
+    qDebug() << "[SerialHandler] Starting hardware streaming: mode=" << mode;
+    sendSetupSequence();
+}
+
+void SerialHandler::setRecording(bool enabled) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, enabled]() { setRecording(enabled); }, Qt::QueuedConnection);
+        return;
+    }
+    recording = enabled;
+}
+
+void SerialHandler::setFrameRecorder(FrameRecorder *recorder, int device) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setFrameRecorder(recorder, device); }, Qt::QueuedConnection);
+        return;
+    }
+    frameRecorder = recorder;
+    recorderDevice = device;
+}
+
+void SerialHandler::stopHardwareStreaming() {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this]() { stopHardwareStreaming(); }, Qt::QueuedConnection);
+        return;
+    }
+    historyStreamRequested = false;
+    streaming = false;
+    resetAcquisitionState();
+}
+
+void SerialHandler::sendStreamCommand(bool start) {
+    QByteArray cmd(3, 0);
+    cmd[0] = 0x58; // 'X'
+    cmd[1] = start ? 0x01 : 0x00;
+    cmd[2] = start ? acqMode : 0x00;
+    if (link->isOpen()) link->write(cmd);
+}
+
+void SerialHandler::streamNegotiationFailed() {
+    qDebug() << "[SerialHandler] Firmware does not stream, falling back to pipelined captures.";
+    // Whatever the device made of the request, don't leave it streaming
+    sendStreamCommand(false);
+    hardwareStreamSupport = 0;
+    emit hardwareStreamingStatus(false);
+    finishAcquisition();
+}
+
+// Consumes every complete block in rxBuffer. Bytes that don't start a valid
+// header are skipped one at a time until the stream is back in sync.
+void SerialHandler::parseStreamBlocks() {
+    const char* buf = rxBuffer.constData();
+    const int size = rxBuffer.size();
+    int pos = 0;
+    bool wake = false;
+    while (size - pos >= STREAM_HEADER_BYTES) {
+        if (static_cast<quint8>(buf[pos]) != 0xA5 || static_cast<quint8>(buf[pos + 1]) != 0x5A) {
+            ++pos;
+            continue;
+        }
+        const quint8 chMask = static_cast<quint8>(buf[pos + 2]);
+        const int count = static_cast<quint8>(buf[pos + 3]);
+        const int channels = ((chMask & 0x01) ? 1 : 0) + ((chMask & 0x02) ? 1 : 0);
+        if (count == 0 || channels == 0) {
+            ++pos;
+            continue;
+        }
+        const int blockBytes = STREAM_HEADER_BYTES + channels * count;
+        if (size - pos < blockBytes) break;
+        const char* payload = buf + pos + STREAM_HEADER_BYTES;
+        const char* ch1 = (chMask & 0x01) ? payload : nullptr;
+        const char* ch2 = (chMask & 0x02) ? payload + ((chMask & 0x01) ? count : 0) : nullptr;
+        wake |= history.append(ch1, ch2, count);
+        pos += blockBytes;
+    }
+    if (pos > 0) rxBuffer.remove(0, pos);
+    // Watchdog: a stalled stream is restarted through the timeout handler
+    timeoutTimer->start(STATE_TIMEOUT_MS);
+    if (wake) emit historyAvailable();
+}
+
+void SerialHandler::setStreaming(bool enabled) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, enabled]() { setStreaming(enabled); }, Qt::QueuedConnection);
+        return;
+    }
+    streaming = enabled;
+    qDebug() << "[SerialHandler] Streaming" << (enabled ? "enabled" : "disabled");
 }
 
 void SerialHandler::handleError(QSerialPort::SerialPortError error) {
@@ -366,6 +1183,10 @@ void SerialHandler::processData(const QByteArray &data) {
 
 // --- Add: Setters for protocol parameters (to be called from MainWindow) ---
 void SerialHandler::setProtocolParams(int ch1Off, int ch2Off, int trigLvl, int trigSrc, int trigPol, int srIdx) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { setProtocolParams(ch1Off, ch2Off, trigLvl, trigSrc, trigPol, srIdx); }, Qt::QueuedConnection);
+        return;
+    }
     ch1Offset = ch1Off;
     ch2Offset = ch2Off;
     trigLevel = trigLvl;
@@ -376,13 +1197,31 @@ void SerialHandler::setProtocolParams(int ch1Off, int ch2Off, int trigLvl, int t
 }
 
 void SerialHandler::resetAcquisitionState() {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this]() { resetAcquisitionState(); }, Qt::QueuedConnection);
+        return;
+    }
+    if (handshaking()) {
+        // Nothing is running yet; just forget a deferred start
+        afterHandshake = nullptr;
+        return;
+    }
+    // A framed link keeps partial frames; the parser skips what is stale
+    if (acqState == AcquisitionState::Streaming || !framedProtocol) rxBuffer.clear();
+    if (acqState == AcquisitionState::Streaming) {
+        sendStreamCommand(false);
+    }
     acqState = AcquisitionState::Idle;
     acqDataLength = 200;
     acqDualChannel = true;
-    ch1Raw.clear();
-    ch2Raw.clear();
+    // An unpublished slot is simply reused by the next acquisition
+    pendingFrame = nullptr;
     bytesNeeded = 0;
+    frameRetries = 0;
+    afterAux = nullptr;
+    auxInFlight.clear();
     acqMode = 1;
     timeoutTimer->stop();
+    requestDelayTimer->stop();
     acquisitionInProgress = false;
 } 
\ No newline at end of file
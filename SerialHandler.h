@@ -4,9 +4,12 @@
 #include <QVector>
 #include <QByteArray>
 #include <QTimer>
+#include <functional>
+#include "FrameRing.h"
+#include "CaptureHistory.h"
+#include "SimulatedDevice.h"
 
-static int findSampleRateIndex(double freq);
-static void findLocalExtrema(const QVector<double>& data, double& avgMax, double& avgMin);
+class FrameRecorder;
 
 class SerialHandler : public QObject {
     Q_OBJECT
@@ -14,7 +17,12 @@ public:
     explicit SerialHandler(QObject *parent = nullptr);
     ~SerialHandler();
 
-    bool connectPort(const QString &portName);
+    // All public methods may be called from any thread; calls made from outside
+    // the acquisition thread are queued onto it.
+    void connectPort(const QString &portName);
+    // Talks to a SimulatedDevice instead of a serial port, until the next
+    // connectPort() or disconnectPort()
+    void connectSimulated(const SimulatedDevice::Config &config);
     void disconnectPort();
     void startAcquisition();
     void stopAcquisition();
@@ -24,8 +32,28 @@ public:
     void setSampleRate(int rateIdx);
     void setMode(int modeIdx);
     void setStudentName(const QString &name);
+    // Sends 'e' and emits signatureReceived(). Right after connectPort() this
+    // is also the link handshake: firmware whose signature advertises the
+    // framed protocol is switched to it, and to a faster baud rate if it
+    // offers one. Acquisitions requested meanwhile start once it is done.
     void readSignature();
+    // Highest baud rate the handshake may switch to; 0 = whatever the device offers
+    void setMaxBaudRate(int baud);
     void sendCommand(const QByteArray &cmd);
+    // DDS output: the period ('p'), sample count ('N') and table ('r')
+    // commands followed by run ('f'), paced by a timer instead of sleeps. A
+    // new upload replaces whatever steps of the previous one are still
+    // queued, and commands identical to what the device already holds are
+    // skipped, so re-running an unchanged setup is a single 'f' write.
+    void uploadDds(const QByteArray &periodCmd, const QByteArray &samplesCmd,
+                   const QByteArray &tableCmd, const QByteArray &runCmd);
+    // Side commands (digital I/O and the like). Written straight away when
+    // no capture is in flight, otherwise in the gap after the current one,
+    // so they never land in the middle of a capture. Reply-less commands
+    // queued together go out in one write. With replyBytes > 0 the next
+    // capture waits for the reply (auxReplyReceived) or AUX_TIMEOUT_MS.
+    // latestWins replaces a still-queued command with the same opcode.
+    void queueAuxCommand(const QByteArray &cmd, int replyBytes = 0, bool latestWins = false);
     void openPort(const QString &portName) { connectPort(portName); }
     void closePort() { disconnectPort(); }
 
@@ -33,9 +61,14 @@ public:
     enum class AcquisitionState {
         Idle,
         WaitingForDone,
+        WaitingToRequest,
         WaitingForCh1,
         WaitingForCh2,
-        Complete
+        Complete,
+        NegotiatingStream,
+        Streaming,
+        WaitingForFrame,
+        WaitingForAux
     };
 
     void startOscilloscopeAcquisition(int mode, int dataLength, bool dualChannel);
@@ -44,9 +77,37 @@ public:
     // --- Add: Set protocol parameters from MainWindow ---
     void setProtocolParams(int ch1Off, int ch2Off, int trigLvl, int trigSrc, int trigPol, int srIdx);
 
+    // Streaming run mode: re-arm the next capture as soon as a frame's bytes
+    // are in, without waiting for the GUI to decode and plot it
+    void setStreaming(bool enabled);
+
+    // Completed frames, consumed lock-free by the GUI thread
+    FrameRing& frameRing() { return frames; }
+
+    // Hardware-timed streaming into captureHistory(). Asks the firmware for
+    // back-to-back sample blocks; if it does not answer, falls back to
+    // pipelined request/response captures that are appended to the same
+    // history, so readers see one continuous (if gappy) record either way.
+    void startHardwareStreaming(int mode);
+    void stopHardwareStreaming();
+    CaptureHistory& captureHistory() { return history; }
+    // While recording, request/response captures are also appended to the
+    // history so a CaptureFileWriter can drain them; streamed blocks always are
+    void setRecording(bool enabled);
+    // Every frame published from now on is also copied to recorder (which
+    // never blocks); nullptr detaches. device is stored with each frame.
+    void setFrameRecorder(FrameRecorder *recorder, int device = 0);
+
 signals:
     void oscilloscopeDataReady(const QVector<double>& ch1, const QVector<double>& ch2, const QVector<double>& xvals);
-    void oscilloscopeRawDataReady(const QByteArray &ch1, const QByteArray &ch2, int dataLength, bool dualChannel);
+    void framesAvailable();
+    void historyAvailable();
+    void ddsUploaded(); // the run command of the latest DDS upload went out
+    void ddsUploadFailed(); // the latest DDS upload was dropped, the port not being open
+    void signatureReceived(const QString &signature);
+    // Emitted on the acquisition thread; reply is empty on timeout
+    void auxReplyReceived(const QByteArray &cmd, const QByteArray &reply);
+    void hardwareStreamingStatus(bool active); // false = firmware lacks streaming, using fallback
     void errorOccurred(const QString &msg);
     void statusMessage(const QString &msg);
     void connectionStatus(bool connected);
@@ -57,12 +118,41 @@ private slots:
     void handleReadyRead();
     void handleError(QSerialPort::SerialPortError error);
     void handleSetupStep();
+    void sendDataRequest();
+    void sendNextDdsStep();
 
 private:
     void processData(const QByteArray &data);
     void sendSetupSequence();
+    void publishFrame(bool dualChannel);
+    void finishAcquisition();
+    bool setupStepNeeded(int step) const;
+    void invalidateDeviceSetup();
+    void sendStreamCommand(bool start);
+    void streamNegotiationFailed();
+    void parseStreamBlocks();
+    // --- Framed protocol ---
+    enum class LinkState { Ready, ReadingSignature, ChangingBaud, VerifyingBaud, WaitingForRevert };
+    bool handshaking() const { return linkState != LinkState::Ready; }
+    void handleHandshakeData();
+    void handleHandshakeTimeout();
+    void handleSignature(const QByteArray &text);
+    void finishHandshake();
+    void sendFramedCapture();
+    void parseFrames();
+    bool takeFrame(quint8 &type, quint8 &seq, QByteArray &payload);
+    void handleFrame(quint8 type, quint8 seq, const QByteArray &payload);
+    // --- Side commands between captures ---
+    bool flushAux();
+    void finishAux(const QByteArray &reply);
+    // --- Link: the serial port or a simulated device ---
+    void closeLink();
+    void resetLinkState();
+    int linkBaudRate() const { return simulated ? simulated->baudRate() : serial->baudRate(); }
     QSerialPort *serial;
-    QByteArray rxBuffer;
+    SimulatedDevice *simulated = nullptr;
+    QIODevice *link = nullptr; // every read and write goes through here
+    QByteArray rxBuffer; // Unparsed stream bytes
     bool running = false;
     // Add all protocol state as needed
     // Oscilloscope state machine variables
@@ -70,8 +160,13 @@ private:
     int acqMode = 1;
     int acqDataLength = 200;
     bool acqDualChannel = true;
-    QByteArray ch1Raw, ch2Raw;
     int bytesNeeded = 0;
+    // --- Frame hand-off to the GUI thread ---
+    FrameRing frames;
+    AcquisitionFrame* pendingFrame = nullptr; // ring slot being filled
+    AcquisitionFrame scratchFrame;            // used when the ring is full
+    // --- Non-blocking delay between ACK and data request ---
+    QTimer* requestDelayTimer = nullptr;
     // --- Protocol parameters ---
     int ch1Offset = 0;
     int ch2Offset = 0;
@@ -84,6 +179,52 @@ private:
     // --- Asynchronous setup sequence ---
     int setupStep = 0;
     QTimer* setupTimer = nullptr;
+    // --- Last setup values the device acknowledged (-1 = unknown) ---
+    int sentTrigSource = -1;
+    int sentTrigPolarity = -1;
+    int sentTrigLevel = -1;
+    int sentMode = -1;
+    int sentSampleRateIdx = -1;
+    // --- Paced DDS upload queue ---
+    QTimer* ddsTimer = nullptr;
+    QVector<QByteArray> ddsSteps;
+    int ddsStep = 0;
+    QByteArray ddsSentPeriod, ddsSentSamples, ddsSentTable; // empty = unknown
+    // --- Streaming run mode ---
+    bool streaming = false;
+    // --- Hardware streaming into the capture history ---
+    CaptureHistory history;
+    bool historyStreamRequested = false;
+    bool recording = false;
+    qint64 perfStageNs = 0; // start of the stage being traced
+    FrameRecorder* frameRecorder = nullptr;
+    int recorderDevice = 0;
+    int hardwareStreamSupport = -1; // -1 = not yet asked, 0 = no, 1 = yes
+    // --- Link protocol negotiated from the signature ---
+    LinkState linkState = LinkState::Ready;
+    QTimer* handshakeTimer = nullptr;
+    std::function<void()> afterHandshake; // acquisition requested mid-handshake
+    QByteArray signature;
+    bool linkNegotiated = false;
+    bool framedProtocol = false; // captures come back as one CRC-checked frame
+    bool nativeUsb = false;      // baud rate is irrelevant on a USB CDC link
+    int maxBaudRate = 0;
+    int deviceMaxBaud = 0;
+    int targetBaudIndex = 0;
+    quint8 captureSeq = 0;
+    int frameRetries = 0;
+    bool frameCorrupted = false; // a CRC failure in the last parse
+    quint64 crcErrors = 0;
+    QByteArray framePayload;
+    // --- Side commands between captures ---
+    struct AuxCommand {
+        QByteArray cmd;
+        int replyBytes = 0;
+    };
+    QVector<AuxCommand> auxQueue;
+    QByteArray auxInFlight;             // command whose reply is awaited
+    std::function<void()> afterAux;     // capture held back by the reply
     // --- Prevent multiple simultaneous acquisitions ---
     bool acquisitionInProgress = false;
+    bool signaturePending = false;      // re-read asked for during a capture
 }; 
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include "SimulatedDevice.h"
+#include "TimeBase.h"
+#include <QDebug>
+#include <QTimer>
+#include <cmath>
+#include <cstring>
+
+namespace {
+constexpr int MAX_CHANNEL_SAMPLES = 400;
+constexpr char SIGNATURE[] = "Simulated oscilloscope";
+constexpr char CAPTURE_ACK = 'D';
+// Framed protocol, as parsed by SerialHandler
+constexpr quint8 FRAME_SYNC1 = 0xA5;
+constexpr quint8 FRAME_SYNC2 = 0xC3;
+constexpr quint8 FRAME_CAPTURE = 0x01;
+// Streaming blocks: 0xA5 0x5A mask count, then the samples
+constexpr int STREAM_BLOCK_SAMPLES = 200;
+// Streamed bytes the link has not carried yet beyond which blocks are
+// skipped, as the firmware's FIFO would overflow
+constexpr int STREAM_BACKLOG_BYTES = 16 * 1024;
+constexpr int PUMP_INTERVAL_MS = 1;
+
+// CRC-16/CCITT-FALSE, as checked by SerialHandler
+quint16 crc16(const char* data, int length) {
+    quint16 crc = 0xFFFF;
+    for (int i = 0; i < length; ++i) {
+        crc ^= static_cast<quint16>(static_cast<quint8>(data[i])) << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? static_cast<quint16>((crc << 1) ^ 0x1021) : static_cast<quint16>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Copies a recorded channel into out, cut or padded to count with mid-scale
+void fitSamples(const QByteArray& src, int count, QByteArray& out) {
+    out.resize(count);
+    const int copied = qMin(count, int(src.size()));
+    std::memcpy(out.data(), src.constData(), copied);
+    if (copied < count) std::memset(out.data() + copied, 0x80, count - copied);
+}
+}
+
+SimulatedDevice::SimulatedDevice(const Config& config, QObject* parent)
+    : QIODevice(parent), config(config) {
+    pumpTimer = new QTimer(this);
+    pumpTimer->setTimerType(Qt::PreciseTimer);
+    pumpTimer->setInterval(config.linkBaud > 0 ? PUMP_INTERVAL_MS : 0);
+    connect(pumpTimer, &QTimer::timeout, this, &SimulatedDevice::pump);
+    captureTimer = new QTimer(this);
+    captureTimer->setTimerType(Qt::PreciseTimer);
+    captureTimer->setSingleShot(true);
+    connect(captureTimer, &QTimer::timeout, this, &SimulatedDevice::finishCapture);
+    // Steady state never reallocates
+    commands.reserve(4 * 1024);
+    outgoing.reserve(64 * 1024);
+    incoming.reserve(64 * 1024);
+    ch1.reserve(MAX_CHANNEL_SAMPLES);
+    ch2.reserve(MAX_CHANNEL_SAMPLES);
+    frame.reserve(16 + 2 * MAX_CHANNEL_SAMPLES);
+}
+
+bool SimulatedDevice::open(OpenMode openMode) {
+    if (!config.replayPath.isEmpty() && !replay.open(config.replayPath)) {
+        qWarning() << "[SimulatedDevice] Cannot replay" << config.replayPath << "- using synthetic waveforms";
+    }
+    clock.start();
+    // Reads come straight out of incoming
+    return QIODevice::open(openMode | QIODevice::Unbuffered);
+}
+
+void SimulatedDevice::close() {
+    pumpTimer->stop();
+    captureTimer->stop();
+    streamActive = false;
+    commands.clear();
+    outgoing.clear();
+    incoming.clear();
+    replay.close();
+    QIODevice::close();
+}
+
+qint64 SimulatedDevice::bytesAvailable() const {
+    return incoming.size() + QIODevice::bytesAvailable();
+}
+
+qint64 SimulatedDevice::readData(char* data, qint64 maxSize) {
+    const int count = int(qMin<qint64>(maxSize, incoming.size()));
+    std::memcpy(data, incoming.constData(), count);
+    incoming.remove(0, count);
+    return count;
+}
+
+qint64 SimulatedDevice::writeData(const char* data, qint64 size) {
+    commands.append(data, int(size));
+    int pos = 0;
+    while (pos < commands.size()) {
+        const int length = commandLength(static_cast<quint8>(commands[pos]));
+        if (length == 0) {
+            // Not a command; the firmware skips it too
+            ++pos;
+            continue;
+        }
+        if (commands.size() - pos < length) break;
+        handleCommand(commands.constData() + pos, length);
+        pos += length;
+    }
+    commands.remove(0, pos);
+    emit bytesWritten(size);
+    return size;
+}
+
+int SimulatedDevice::commandLength(quint8 opcode) const {
+    switch (opcode) {
+    case 'e': case 'i': case 'A':
+        return 1;
+    case 'h':
+        return 2;
+    case 'r':
+        return 3 + ddsSamples;
+    case 'C': case 'D': case 'T': case 'P': case 'L': case 'F': case 'S': case 'X':
+    case 'G': case 'O': case 'o': case 't': case 'p': case 'N': case 'f': case 'B': case 'c': case 'd':
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+// Replies are only queued here; they reach the reader from the pump, never
+// from inside its own write
+void SimulatedDevice::handleCommand(const char* cmd, int length) {
+    const quint8 arg1 = length > 1 ? static_cast<quint8>(cmd[1]) : 0;
+    const quint8 arg2 = length > 2 ? static_cast<quint8>(cmd[2]) : 0;
+    switch (cmd[0]) {
+    case 'e': {
+        QByteArray text(SIGNATURE);
+        if (config.framed) text.append(" proto=2 usb");
+        text.append('\n');
+        transmit(text.constData(), text.size());
+        break;
+    }
+    case 'F':
+        mode = (arg1 >= 1 && arg1 <= 3) ? arg1 : 1;
+        break;
+    case 'S':
+        sampleRateIndex = arg1;
+        break;
+    case 'N':
+        ddsSamples = arg1 * 256 + arg2;
+        break;
+    case 'h':
+        outputs = arg1;
+        break;
+    case 'i': {
+        const char reply[2] = {'I', static_cast<char>(outputs & 0x0F)};
+        transmit(reply, 2);
+        break;
+    }
+    case 'C':
+        startCapture(arg1 == 1, arg2);
+        break;
+    case 'D':
+        // 1/2: CH1/CH2 of a dual capture, 3/4: CH1/CH2 alone
+        if (!captureReady) break;
+        if (arg1 == 1) sendChannel(ch1, 200);
+        else if (arg1 == 2) sendChannel(ch2, 200);
+        else if (arg1 == 3) sendChannel(ch1, 400);
+        else if (arg1 == 4) sendChannel(ch2, 400);
+        break;
+    case 'X':
+        if (arg1 == 0) {
+            streamActive = false;
+        } else if (config.streaming) {
+            mode = (arg2 >= 1 && arg2 <= 3) ? arg2 : 1;
+            transmit("X", 1);
+            streamActive = true;
+            streamStartNs = clock.nsecsElapsed();
+            streamedSamples = 0;
+        }
+        break;
+    case 'A':
+        captureTimer->stop();
+        streamActive = false;
+        outgoing.clear();
+        break;
+    default:
+        // Trigger, gains, offsets, DDS and the rest only change analogue
+        // settings the synthetic signal does not model. 'B' is never sent:
+        // the signature advertises native USB.
+        break;
+    }
+}
+
+double SimulatedDevice::sampleRate() const {
+    // 'S' is 1-based; the board falls back to its fastest rate
+    const int index = sampleRateIndex - 1;
+    return timeBase((index >= 0 && index < TIME_BASE_COUNT) ? index : 0).sampleRate;
+}
+
+void SimulatedDevice::startCapture(bool framed, quint8 seq) {
+    captureFramed = framed;
+    captureSeq = seq;
+    captureReady = false;
+    if (framed && config.recordLength > 0) captureCount = qBound(1, config.recordLength, MAX_CHANNEL_SAMPLES);
+    else captureCount = mode == 1 ? 200 : 400;
+    const int captureMs = config.realTimeCapture ? int(std::ceil(captureCount * 1000.0 / sampleRate())) : 0;
+    captureTimer->start(captureMs);
+}
+
+void SimulatedDevice::finishCapture() {
+    fillChannels(captureCount);
+    captureReady = true;
+    if (captureFramed) sendCaptureFrame();
+    else transmit(&CAPTURE_ACK, 1);
+}
+
+void SimulatedDevice::fillChannels(int count) {
+    const bool wantCh1 = mode != 3;
+    const bool wantCh2 = mode != 2;
+    const bool replayed = replay.isOpen() && replayFrame();
+    if (replayed) {
+        const AcquisitionFrame& recorded = replayRecord.frame;
+        if (wantCh1) {
+            if (recorded.ch1.isEmpty()) synthesize(0, count, ch1);
+            else fitSamples(recorded.ch1, count, ch1);
+        }
+        if (wantCh2) {
+            if (recorded.ch2.isEmpty()) synthesize(1, count, ch2);
+            else fitSamples(recorded.ch2, count, ch2);
+        }
+    } else {
+        if (wantCh1) synthesize(0, count, ch1);
+        if (wantCh2) synthesize(1, count, ch2);
+    }
+    if (!wantCh1) ch1.resize(0);
+    if (!wantCh2) ch2.resize(0);
+    sampleClock += count;
+}
+
+void SimulatedDevice::synthesize(int channel, int count, QByteArray& out) {
+    out.resize(count);
+    const double rate = sampleRate();
+    const double w = 2.0 * M_PI * (channel == 0 ? config.ch1Frequency : config.ch2Frequency) / rate;
+    for (int i = 0; i < count; ++i) {
+        noiseState = noiseState * 1664525u + 1013904223u;
+        const double noise = ((noiseState >> 8) / double(1 << 24) * 2.0 - 1.0) * config.noise;
+        const double code = 128.0 + config.amplitude * std::sin(w * double(sampleClock + i)) + noise;
+        out[i] = static_cast<char>(qBound(0, int(std::lround(code)), 255));
+    }
+}
+
+// Next recorded frame, looping at the end of the file
+bool SimulatedDevice::replayFrame() {
+    if (replay.next(replayRecord)) return true;
+    return replay.rewind() && replay.next(replayRecord);
+}
+
+void SimulatedDevice::sendChannel(const QByteArray& samples, int count) {
+    const int copied = qMin(count, int(samples.size()));
+    transmit(samples.constData(), copied);
+    // A read that does not match the capture gets mid-scale padding
+    static const QByteArray padding(MAX_CHANNEL_SAMPLES, char(0x80));
+    if (copied < count) transmit(padding.constData(), count - copied);
+}
+
+void SimulatedDevice::sendCaptureFrame() {
+    const quint8 mask = mode == 1 ? 0x03 : (mode == 3 ? 0x02 : 0x01);
+    const int length = 1 + ch1.size() + ch2.size();
+    frame.resize(0);
+    frame.append(char(FRAME_SYNC1));
+    frame.append(char(FRAME_SYNC2));
+    frame.append(char(FRAME_CAPTURE));
+    frame.append(char(captureSeq));
+    frame.append(char(length & 0xFF));
+    frame.append(char(length >> 8));
+    frame.append(char(mask));
+    frame.append(ch1);
+    frame.append(ch2);
+    const quint16 crc = crc16(frame.constData() + 2, frame.size() - 2);
+    frame.append(char(crc & 0xFF));
+    frame.append(char(crc >> 8));
+    transmit(frame.constData(), frame.size());
+}
+
+// Blocks for the samples taken since streaming started, skipping those the
+// link could not take
+void SimulatedDevice::streamBlocks(qint64 nowNs) {
+    const qint64 taken = qint64((nowNs - streamStartNs) * 1e-9 * sampleRate());
+    while (streamedSamples + STREAM_BLOCK_SAMPLES <= taken) {
+        if (outgoing.size() > STREAM_BACKLOG_BYTES) {
+            streamedSamples = taken - taken % STREAM_BLOCK_SAMPLES;
+            break;
+        }
+        fillChannels(STREAM_BLOCK_SAMPLES);
+        const quint8 mask = mode == 1 ? 0x03 : (mode == 3 ? 0x02 : 0x01);
+        frame.resize(0);
+        frame.append(char(0xA5));
+        frame.append(char(0x5A));
+        frame.append(char(mask));
+        frame.append(char(STREAM_BLOCK_SAMPLES));
+        frame.append(ch1);
+        frame.append(ch2);
+        transmit(frame.constData(), frame.size());
+        streamedSamples += STREAM_BLOCK_SAMPLES;
+    }
+}
+
+void SimulatedDevice::transmit(const char* data, int length) {
+    if (length <= 0) return;
+    outgoing.append(data, length);
+    if (!pumpTimer->isActive()) {
+        lastPumpNs = clock.nsecsElapsed();
+        credit = 0.0;
+        pumpTimer->start();
+    }
+}
+
+// Moves as many bytes onto the wire as the link speed allows since the last run
+void SimulatedDevice::pump() {
+    const qint64 now = clock.nsecsElapsed();
+    if (streamActive) streamBlocks(now);
+    int bytes = outgoing.size();
+    if (config.linkBaud > 0) {
+        credit += (now - lastPumpNs) * 1e-9 * (config.linkBaud / 10.0);
+        bytes = qMin(bytes, int(credit));
+        credit -= bytes;
+    }
+    lastPumpNs = now;
+    if (bytes > 0) {
+        incoming.append(outgoing.constData(), bytes);
+        outgoing.remove(0, bytes);
+        emit readyRead();
+    }
+    if (outgoing.isEmpty()) {
+        // An idle link saves up no credit
+        credit = 0.0;
+        if (!streamActive) pumpTimer->stop();
+    }
+}
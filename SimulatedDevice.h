@@ -0,0 +1,94 @@
+#pragma once
+#include <QIODevice>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QtGlobal>
+#include "FrameRecording.h"
+
+class QTimer;
+
+// The board's end of the serial link, in software, for running the
+// acquisition path without hardware. Commands written to it are parsed like
+// the firmware does ('T'/'P'/'L'/'F'/'S' setup, 'C' capture, 'D' reads, 'X'
+// streaming, 'e' signature, digital I/O and DDS) and the replies come back
+// paced at the configured link speed, so SerialHandler sees the same byte
+// timing a real port would give it. Captures are synthetic sines with a
+// little noise, or frames looped from a FrameRecorder file.
+class SimulatedDevice : public QIODevice {
+    Q_OBJECT
+public:
+    struct Config {
+        int linkBaud = 115200;        // replies flow at linkBaud / 10 bytes/s; 0 = unthrottled
+        bool framed = true;           // advertise the framed protocol (as native USB)
+        int recordLength = 0;         // samples per channel of a framed capture; 0 = 200 dual, 400 single
+        bool realTimeCapture = true;  // a capture takes as long as sampling it would
+        bool streaming = true;        // answer 'X' with sample blocks
+        QString replayPath;           // frame recording to loop; empty = synthetic
+        double ch1Frequency = 1000.0; // synthetic sines, Hz
+        double ch2Frequency = 1500.0;
+        double amplitude = 100.0;     // ADC codes, around mid-scale
+        double noise = 2.0;           // ADC codes, peak
+    };
+
+    explicit SimulatedDevice(const Config& config, QObject* parent = nullptr);
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+    int baudRate() const { return config.linkBaud; }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 size) override;
+
+private:
+    int commandLength(quint8 opcode) const;
+    void handleCommand(const char* cmd, int length);
+    void startCapture(bool framed, quint8 seq);
+    void finishCapture();
+    void sendCaptureFrame();
+    void sendChannel(const QByteArray& samples, int count);
+    void fillChannels(int count);
+    void synthesize(int channel, int count, QByteArray& out);
+    bool replayFrame();
+    double sampleRate() const;
+    void streamBlocks(qint64 nowNs);
+    void transmit(const char* data, int length);
+    void pump();
+
+    Config config;
+    QTimer* pumpTimer = nullptr;
+    QTimer* captureTimer = nullptr;
+    QElapsedTimer clock;
+    qint64 lastPumpNs = 0;
+    double credit = 0.0; // bytes the link may still carry this tick
+
+    QByteArray commands; // written, not yet parsed
+    QByteArray outgoing; // replies not yet on the wire
+    QByteArray incoming; // on the wire, waiting to be read
+
+    // Device state set by the commands
+    int mode = 1;            // 'F': 1 = dual, 2 = CH1, 3 = CH2
+    int sampleRateIndex = 4; // 'S', 1-based
+    int ddsSamples = 0;      // 'N', length of the 'r' table
+    quint8 outputs = 0;      // 'h', looped back onto the inputs
+
+    // Capture in progress or last completed
+    bool captureFramed = false;
+    quint8 captureSeq = 0;
+    bool captureReady = false;
+    int captureCount = 0;    // samples per channel
+    QByteArray ch1, ch2;
+    QByteArray frame;        // framed reply or stream block being assembled
+    qint64 sampleClock = 0;  // synthetic time base, in samples
+    quint32 noiseState = 1;
+    FrameRecordingReader replay;
+    FrameRecordingReader::Record replayRecord;
+
+    // 'X' streaming
+    bool streamActive = false;
+    qint64 streamStartNs = 0;
+    qint64 streamedSamples = 0;
+};
@@ -0,0 +1,239 @@
+#include "SpectrumAnalyzer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double PI = 3.14159265358979323846;
+constexpr int MIN_FFT = 64;
+constexpr int MAX_FFT = 65536;
+constexpr int MAX_ZOOM = 256;
+constexpr double MAX_OVERLAP = 0.95;
+// Zoom low-pass length per unit of decimation; enough for ~70 dB of
+// alias rejection away from the band edges
+constexpr int TAPS_PER_DECIMATION = 8;
+// The mixer's oscillator is a rotating phasor, pulled back onto the unit
+// circle this often
+constexpr int OSCILLATOR_RENORMALIZE = 1024;
+// Shortest record still worth a zero-padded segment
+constexpr int MIN_PARTIAL = 16;
+constexpr double MIN_POWER = 1e-20; // -200 dBV
+
+int powerOfTwoIn(int n, int lo, int hi) {
+    n = qBound(lo, n, hi);
+    int p = lo;
+    while (p < n) p <<= 1;
+    return p;
+}
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer() {
+    setConfig(Config());
+}
+
+void SpectrumAnalyzer::setConfig(const Config& config) {
+    cfg = config;
+    cfg.fftSize = powerOfTwoIn(config.fftSize, MIN_FFT, MAX_FFT);
+    cfg.overlap = qBound(0.0, config.overlap, MAX_OVERLAP);
+    cfg.averages = qMax(1, config.averages);
+    cfg.zoomFactor = powerOfTwoIn(config.zoomFactor, 1, MAX_ZOOM);
+    hop = qMax(1, int(std::lround(cfg.fftSize * (1.0 - cfg.overlap))));
+    pendingReal.reserve(cfg.fftSize);
+    pendingZoom.reserve(cfg.fftSize);
+    designFilter();
+    reset();
+}
+
+void SpectrumAnalyzer::setSampleRate(double samplesPerSecond) {
+    sampleRate = samplesPerSecond > 0.0 ? samplesPerSecond : 1.0;
+    designFilter();
+    reset();
+}
+
+// Windowed-sinc (Blackman) low-pass at the decimated Nyquist frequency
+void SpectrumAnalyzer::designFilter() {
+    rotation = std::polar(1.0, -2.0 * PI * cfg.zoomCenter / sampleRate);
+    if (cfg.zoomFactor == 1) {
+        taps.clear();
+        delay.clear();
+        return;
+    }
+    const int n = TAPS_PER_DECIMATION * cfg.zoomFactor + 1;
+    const double cutoff = 0.5 / cfg.zoomFactor; // cycles per input sample
+    const int middle = n / 2;
+    taps.resize(n);
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i) {
+        const double t = i - middle;
+        const double sinc = t == 0 ? 2.0 * cutoff : std::sin(2.0 * PI * cutoff * t) / (PI * t);
+        const double x = 2.0 * PI * i / (n - 1);
+        taps[i] = sinc * (0.42 - 0.5 * std::cos(x) + 0.08 * std::cos(2.0 * x));
+        sum += taps[i];
+    }
+    for (double& tap : taps) tap /= sum; // unity gain at the zoom centre
+    delay.resize(2 * n);
+}
+
+void SpectrumAnalyzer::reset() {
+    breakStream();
+    power.clear();
+    peak.clear();
+    segments = 0;
+}
+
+void SpectrumAnalyzer::breakStream() {
+    pendingReal.clear();
+    pendingZoom.clear();
+    segmentsThisRecord = 0;
+    delay.fill(Complex());
+    delayPos = 0;
+    warmup = qMax(0, int(taps.size()) - 1);
+    decimPhase = 0;
+    oscillator = Complex(1.0, 0.0);
+    sinceRenormalize = 0;
+}
+
+int SpectrumAnalyzer::add(const double* samples, int count) {
+    if (count <= 0) return 0;
+    const quint64 before = segments;
+    if (cfg.zoomFactor > 1) addZoom(samples, count);
+    else addReal(samples, count);
+    return int(segments - before);
+}
+
+int SpectrumAnalyzer::addRecord(const double* samples, int count) {
+    const quint64 before = segments;
+    breakStream();
+    add(samples, count);
+    flushPartial();
+    breakStream();
+    return int(segments - before);
+}
+
+int SpectrumAnalyzer::maxRecordZoom(int recordLength) {
+    int zoom = 1;
+    while (zoom < MAX_ZOOM) {
+        const int next = 2 * zoom;
+        // The first TAPS_PER_DECIMATION * next inputs only fill the filter
+        if ((recordLength - TAPS_PER_DECIMATION * next) / next < MIN_PARTIAL) break;
+        zoom = next;
+    }
+    return zoom;
+}
+
+void SpectrumAnalyzer::addReal(const double* samples, int count) {
+    while (count > 0) {
+        const int take = qMin(count, cfg.fftSize - int(pendingReal.size()));
+        pendingReal.append(samples, take);
+        samples += take;
+        count -= take;
+        if (pendingReal.size() < cfg.fftSize) break;
+        segment(pendingReal.constData(), cfg.fftSize);
+        pendingReal.remove(0, hop);
+    }
+}
+
+void SpectrumAnalyzer::addZoom(const double* samples, int count) {
+    const int n = taps.size();
+    const double* h = taps.constData();
+    for (int i = 0; i < count; ++i) {
+        // Mix the zoom centre down to 0 Hz
+        const Complex z = samples[i] * oscillator;
+        oscillator *= rotation;
+        if (++sinceRenormalize == OSCILLATOR_RENORMALIZE) {
+            oscillator /= std::abs(oscillator);
+            sinceRenormalize = 0;
+        }
+        delay[delayPos] = z;
+        delay[delayPos + n] = z;
+        delayPos = delayPos + 1 == n ? 0 : delayPos + 1;
+        if (warmup > 0) {
+            --warmup;
+            continue;
+        }
+        // Only every zoomFactor-th output of the filter is needed
+        if (++decimPhase < cfg.zoomFactor) continue;
+        decimPhase = 0;
+        const Complex* d = delay.constData() + delayPos; // last n inputs, oldest first
+        Complex y;
+        for (int k = 0; k < n; ++k) y += h[k] * d[k];
+        pendingZoom.append(y);
+        if (pendingZoom.size() == cfg.fftSize) {
+            segment(pendingZoom.constData(), cfg.fftSize);
+            pendingZoom.remove(0, hop);
+        }
+    }
+}
+
+void SpectrumAnalyzer::flushPartial() {
+    if (segmentsThisRecord > 0) return;
+    if (cfg.zoomFactor > 1) {
+        if (pendingZoom.size() >= MIN_PARTIAL) segment(pendingZoom.constData(), pendingZoom.size());
+    } else if (pendingReal.size() >= MIN_PARTIAL) {
+        segment(pendingReal.constData(), pendingReal.size());
+    }
+}
+
+// Windows length samples, zero-pads them to fftSize and averages in the
+// power spectrum: the positive half for real input, the whole band
+// (negative frequencies first) when zoomed
+template <typename T>
+void SpectrumAnalyzer::segment(const T* samples, int length) {
+    const int n = cfg.fftSize;
+    const QVector<double>& w = fft.windowCoefficients(length, cfg.window);
+    double coherentGain = 0.0;
+    work.resize(n);
+    for (int i = 0; i < length; ++i) {
+        work[i] = Complex(samples[i]) * w[i];
+        coherentGain += w[i];
+    }
+    std::fill(work.begin() + length, work.end(), Complex());
+    if (coherentGain <= 0.0) coherentGain = length;
+    fft.transform(work);
+
+    const double scale = 1.0 / (coherentGain * coherentGain);
+    if (cfg.zoomFactor > 1) {
+        segmentPower.resize(n);
+        for (int k = 0; k < n; ++k) segmentPower[k] = std::norm(work[(k + n / 2) & (n - 1)]) * scale;
+    } else {
+        segmentPower.resize(n / 2);
+        for (int k = 0; k < n / 2; ++k) segmentPower[k] = std::norm(work[k]) * scale;
+    }
+    accumulate();
+    ++segmentsThisRecord;
+}
+
+void SpectrumAnalyzer::accumulate() {
+    if (power.size() != segmentPower.size()) {
+        power = segmentPower;
+        peak = cfg.peakHold ? segmentPower : QVector<double>();
+        segments = 1;
+        return;
+    }
+    ++segments;
+    // Running mean, which the exponential average stays until it has seen
+    // its time constant's worth of segments
+    const quint64 span = cfg.averaging == Averaging::Linear ? segments : qMin<quint64>(segments, cfg.averages);
+    const double weight = 1.0 / double(span);
+    for (int k = 0; k < power.size(); ++k) power[k] += (segmentPower[k] - power[k]) * weight;
+    if (cfg.peakHold) {
+        for (int k = 0; k < peak.size(); ++k) peak[k] = std::max(peak[k], segmentPower[k]);
+    }
+}
+
+double SpectrumAnalyzer::firstBinHz() const {
+    return cfg.zoomFactor > 1 ? cfg.zoomCenter - sampleRate / (2.0 * cfg.zoomFactor) : 0.0;
+}
+
+double SpectrumAnalyzer::binHz() const {
+    return sampleRate / cfg.zoomFactor / cfg.fftSize;
+}
+
+void SpectrumAnalyzer::averageDb(QVector<double>& out) const {
+    out.resize(power.size());
+    for (int k = 0; k < power.size(); ++k) out[k] = 10.0 * std::log10(std::max(power[k], MIN_POWER));
+}
+
+void SpectrumAnalyzer::peakDb(QVector<double>& out) const {
+    out.resize(peak.size());
+    for (int k = 0; k < peak.size(); ++k) out[k] = 10.0 * std::log10(std::max(peak[k], MIN_POWER));
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <QVector>
+#include <QtGlobal>
+#include <complex>
+#include "FFTEngine.h"
+
+// Averaged spectra of both channels, as the DSP worker publishes them
+struct SpectrumSnapshot {
+    QVector<double> average[2]; // dBV per bin; empty if the channel is not analysed
+    QVector<double> peak[2];    // peak hold, dBV; empty when off
+    double firstHz = 0.0;       // frequency of bin 0
+    double binHz = 0.0;
+    quint64 segments = 0;       // segments averaged so far (CH1, else CH2)
+};
+
+// Welch spectrum estimate of one channel. Samples arrive in blocks of any
+// size; every fftSize of them (overlapping by the configured fraction)
+// make a windowed segment whose power spectrum is averaged in, linearly
+// over everything since reset() or exponentially over about `averages`
+// segments, with an optional peak hold. Magnitudes are normalised by the
+// window's coherent gain like FFTEngine::magnitudeSpectrum, so a tone
+// reads the same here as in the single-frame DFT view.
+//
+// Zoom: with zoomFactor > 1 the input is mixed down by zoomCenter,
+// low-pass filtered and decimated by zoomFactor before the transform, so
+// the same fftSize covers a band sampleRate / zoomFactor wide around
+// zoomCenter at zoomFactor times the resolution, for the cost of a
+// filter tap per sample plus one transform per (decimated) segment.
+class SpectrumAnalyzer {
+public:
+    enum class Averaging { Linear, Exponential };
+
+    struct Config {
+        int fftSize = 4096;       // power of two, 64..65536
+        double overlap = 0.5;     // fraction of a segment shared with the next, 0..0.95
+        FFTEngine::Window window = FFTEngine::Window::Hann;
+        Averaging averaging = Averaging::Exponential;
+        int averages = 8;         // exponential time constant, in segments
+        bool peakHold = false;
+        int zoomFactor = 1;       // power of two, 1 (off)..256
+        double zoomCenter = 0.0;  // Hz
+    };
+
+    SpectrumAnalyzer();
+
+    // Both restart the averages
+    void setConfig(const Config& config);
+    void setSampleRate(double samplesPerSecond);
+    const Config& config() const { return cfg; }
+
+    // Forgets the averages and any partial segment
+    void reset();
+    // The next sample does not follow the last one (a new capture):
+    // partial segments and filter state are dropped, the averages kept
+    void breakStream();
+
+    // Contiguous samples; returns the number of segments completed
+    int add(const double* samples, int count);
+    // One self-contained capture. Records shorter than a segment are
+    // windowed over their own length and zero-padded, which averages fine
+    // but resolves no better than the record length.
+    int addRecord(const double* samples, int count);
+    // Largest zoomFactor that still leaves a record this long a segment
+    // once the zoom filter has warmed up on it
+    static int maxRecordZoom(int recordLength);
+
+    quint64 segmentCount() const { return segments; }
+    int binCount() const { return power.size(); }
+    double firstBinHz() const;
+    double binHz() const;
+    // dBV per bin, of the average and of the peak hold; empty until the first segment
+    void averageDb(QVector<double>& out) const;
+    void peakDb(QVector<double>& out) const;
+
+private:
+    typedef std::complex<double> Complex;
+
+    void designFilter();
+    void addReal(const double* samples, int count);
+    void addZoom(const double* samples, int count);
+    void flushPartial();
+    template <typename T> void segment(const T* samples, int length);
+    void accumulate();
+
+    Config cfg;
+    double sampleRate = 1.0;
+    FFTEngine fft;
+
+    // Samples waiting for a full segment
+    QVector<double> pendingReal;
+    QVector<Complex> pendingZoom;
+    int hop = 0;
+    int segmentsThisRecord = 0;
+
+    // Zoom front end: mixer, FIR low-pass (delay line stored twice so the
+    // taps read one contiguous run) and decimator
+    QVector<double> taps;
+    QVector<Complex> delay;
+    int delayPos = 0;
+    int warmup = 0;       // inputs still to come before the delay line is full
+    int decimPhase = 0;
+    Complex oscillator{1.0, 0.0}; // exp(-j 2 pi zoomCenter t)
+    Complex rotation{1.0, 0.0};   // its step per input sample
+    int sinceRenormalize = 0;
+
+    QVector<Complex> work;
+    QVector<double> segmentPower;
+    QVector<double> power; // averaged, V^2 per bin
+    QVector<double> peak;
+    quint64 segments = 0;
+};
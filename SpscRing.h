@@ -0,0 +1,62 @@
+#pragma once
+#include <QVector>
+#include <atomic>
+
+// Single-producer/single-consumer ring of preallocated slots used to hand
+// data between two threads without locks. The producer fills the slot
+// returned by beginWrite() in place and then publishes it with
+// commitWrite(); the consumer reads peek() and hands the slot back with
+// release(). Slots are reused as they are, so buffers inside them keep
+// their capacity and steady-state traffic does not allocate.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(int capacity = 8) {
+        // Round up to a power of two so indices can wrap with a mask
+        int size = 1;
+        while (size < capacity) size <<= 1;
+        slots.resize(size);
+        mask = static_cast<unsigned>(size - 1);
+        // Raw pointer so neither side ever goes through QVector's detach check
+        slotData = slots.data();
+    }
+
+    // Producer side
+    T* beginWrite() { // nullptr when the ring is full
+        unsigned h = head.load(std::memory_order_relaxed);
+        unsigned t = tail.load(std::memory_order_acquire);
+        if (h - t >= static_cast<unsigned>(slots.size())) return nullptr;
+        return &slotData[h & mask];
+    }
+    bool commitWrite() { // true if the consumer needs a wake-up
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return !notifyPending.exchange(true, std::memory_order_acq_rel);
+    }
+    void noteDropped() { dropped.fetch_add(1, std::memory_order_relaxed); }
+
+    // Consumer side
+    const T* peek() const { // nullptr when the ring is empty
+        unsigned t = tail.load(std::memory_order_relaxed);
+        unsigned h = head.load(std::memory_order_acquire);
+        if (t == h) return nullptr;
+        return &slotData[t & mask];
+    }
+    void release() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    void clearNotified() { notifyPending.store(false, std::memory_order_release); }
+
+    int droppedFrames() const { return dropped.load(std::memory_order_relaxed); }
+    int capacity() const { return slots.size(); }
+
+protected:
+    // For preallocating slot contents before either side runs
+    QVector<T>& storage() { return slots; }
+
+private:
+    QVector<T> slots;
+    T* slotData = nullptr;
+    unsigned mask = 0;
+    std::atomic<unsigned> head{0}; // next slot to publish (producer)
+    std::atomic<unsigned> tail{0}; // next slot to consume (consumer)
+    std::atomic<bool> notifyPending{false};
+    std::atomic<int> dropped{0};
+};
@@ -0,0 +1,33 @@
+#include "TimeBase.h"
+
+namespace {
+const TimeBase TIME_BASES[TIME_BASE_COUNT] = {
+    {2000000, 0.5, 1000000, "Time(uSec)"},
+    {1000000, 1.0, 500000, "Time(uSec)"},
+    {500000, 2.0, 250000, "Time(uSec)"},
+    {200000, 5.0, 100000, "Time(uSec)"},
+    {100000, 10.0, 50000, "Time(uSec)"},
+    {50000, 20.0, 25000, "Time(uSec)"},
+    {20000, 50.0, 10000, "Time(uSec)"},
+    {10000, 100.0, 5000, "Time(uSec)"},
+    {5000, 200.0, 2500, "Time(uSec)"},
+    {2000, 500.0, 1000, "Time(uSec)"},
+    {1000, 1000.0, 500, "Time(mSec)"},
+    {500, 2000.0, 250, "Time(mSec)"},
+    {200, 5000.0, 100, "Time(mSec)"},
+    {100, 10000.0, 50, "Time(mSec)"},
+};
+constexpr int FALLBACK_INDEX = 3;
+constexpr double MIN_SAMPLES_PER_PERIOD = 9.0;
+} // namespace
+
+const TimeBase& timeBase(int index) {
+    return TIME_BASES[(index >= 0 && index < TIME_BASE_COUNT) ? index : FALLBACK_INDEX];
+}
+
+int timeBaseForTone(double frequency) {
+    for (int i = TIME_BASE_COUNT - 1; i >= 0; --i) {
+        if (TIME_BASES[i].sampleRate > MIN_SAMPLES_PER_PERIOD * frequency) return i;
+    }
+    return 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// The board's sample rates, by UI index: 0 is the fastest (2 MS/s), 13
+// the slowest (100 S/s). The device's 'S' command takes the index plus one.
+struct TimeBase {
+    double sampleRate;     // samples/s per channel
+    double multiplier;     // us per sample, the x-axis scale
+    double maxFrequency;   // Nyquist, Hz
+    const char* axisTitle; // x-axis heading, as in the VB.NET application
+};
+
+constexpr int TIME_BASE_COUNT = 14;
+
+// Settings of a UI index; out of range gives 200 kS/s, as the UI always did
+const TimeBase& timeBase(int index);
+// Slowest rate sampling a tone of frequency Hz more than nine times a
+// period; the fastest if none does
+int timeBaseForTone(double frequency);
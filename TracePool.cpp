@@ -0,0 +1,38 @@
+#include "TracePool.h"
+#include <algorithm>
+
+void TracePool::reserve(int traces, int traceLen) {
+    traces = qMax(0, traces);
+    traceLen = qMax(0, traceLen);
+    if (traces != traceCapacity || traceLen != length) {
+        traceCapacity = traces;
+        length = traceLen;
+        arena.resize(2 * traceCapacity * length);
+    }
+    stored = 0;
+    channelSeen[0] = channelSeen[1] = false;
+}
+
+bool TracePool::append(const QVector<double>& ch1, const QVector<double>& ch2) {
+    if (isFull()) return false;
+    const QVector<double>* inputs[2] = {&ch1, &ch2};
+    for (int ch = 0; ch < 2; ++ch) {
+        const QVector<double>& in = *inputs[ch];
+        double* slot = arena.data() + channelOffset(ch) + stored * length;
+        const int n = qMin(in.size(), length);
+        std::copy(in.constData(), in.constData() + n, slot);
+        std::fill(slot + n, slot + length, n > 0 ? in[n - 1] : 0.0);
+        if (n > 0) channelSeen[ch] = true;
+    }
+    ++stored;
+    return true;
+}
+
+void TracePool::concatenate(int channel, QVector<double>& out) const {
+    if (!hasChannel(channel)) {
+        out.clear();
+        return;
+    }
+    out.resize(stored * length);
+    std::copy(channelData(channel), channelData(channel) + out.size(), out.data());
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <QVector>
+
+// Fixed-capacity store for one Add/Overwrite acquisition set. Both channels
+// live in a single arena of 2 x traces x length samples, sized once by
+// reserve(); append() copies a trace into its slot in place, and since a
+// channel's traces are back to back the concatenated record is just a view
+// of the arena. Once the pool is sized, collecting and clearing allocate
+// nothing.
+class TracePool {
+public:
+    // Sizes the arena; keeps the storage when the shape is unchanged.
+    // Always empties the pool.
+    void reserve(int traces, int length);
+    void clear() {
+        stored = 0;
+        channelSeen[0] = channelSeen[1] = false;
+    }
+
+    // Copies one trace per channel into the next slot. Shorter traces are
+    // padded with their last sample, longer ones cut; an empty channel is
+    // stored as zeros. False if the pool is already full.
+    bool append(const QVector<double>& ch1, const QVector<double>& ch2);
+
+    int capacity() const { return traceCapacity; }
+    int traceLength() const { return length; }
+    int count() const { return stored; }
+    bool isEmpty() const { return stored == 0; }
+    bool isFull() const { return stored >= traceCapacity; }
+    // False if no trace stored since the last clear() had data for the channel
+    bool hasChannel(int channel) const { return channelSeen[channel]; }
+
+    // count() x traceLength() samples of a channel, oldest trace first
+    const double* channelData(int channel) const { return arena.constData() + channelOffset(channel); }
+    const double* trace(int channel, int index) const { return channelData(channel) + index * length; }
+    // Copies the stored traces of a channel end to end; reuses out's storage
+    void concatenate(int channel, QVector<double>& out) const;
+
+private:
+    int channelOffset(int channel) const { return channel * traceCapacity * length; }
+
+    QVector<double> arena; // CH1 traces, then CH2 traces
+    int traceCapacity = 0;
+    int length = 0;
+    int stored = 0;
+    bool channelSeen[2] = {false, false};
+};
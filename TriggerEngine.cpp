@@ -0,0 +1,93 @@
+#include "TriggerEngine.h"
+#include <cmath>
+
+void TriggerEngine::reset() {
+    armed = false;
+    havePrevious = false;
+    previous = 0.0;
+    nextAllowed = 0;
+}
+
+int TriggerEngine::process(const double* samples, int count, qint64 firstIndex, QVector<Event>& events) {
+    int found = 0;
+    // Work in "rising" terms; a falling trigger is a rising one on -x
+    const double sign = (slope == Slope::Rising) ? 1.0 : -1.0;
+    const double level = sign * triggerLevel;
+    const double armBelow = level - hysteresis;
+    double prev = sign * previous;
+    bool isArmed = armed;
+    int start = 0;
+    if (!havePrevious && count > 0) {
+        prev = sign * samples[0];
+        isArmed = prev < armBelow;
+        start = 1;
+    }
+    for (int i = start; i < count; ++i) {
+        const double x = sign * samples[i];
+        if (!isArmed) {
+            if (x < armBelow) isArmed = true;
+        } else if (x >= level && prev < level) {
+            const qint64 index = firstIndex + i;
+            if (index >= nextAllowed) {
+                Event event;
+                event.sample = index;
+                const double step = x - prev;
+                const double fraction = step > 0.0 ? (level - prev) / step : 1.0;
+                event.position = (index - 1) + fraction;
+                events.append(event);
+                ++found;
+                nextAllowed = index + qMax(1, holdoff);
+            }
+            isArmed = false;
+        }
+        prev = x;
+    }
+    if (count > 0) {
+        previous = sign * prev;
+        havePrevious = true;
+    }
+    armed = isArmed;
+    return found;
+}
+
+bool TriggerEngine::findInRecord(const QVector<double>& samples, int length, Event& event) {
+    reset();
+    QVector<Event> events;
+    process(samples.constData(), samples.size(), 0, events);
+    const int post = length - preTrigger;
+    for (const Event& e : events) {
+        // Need one extra sample either side for the interpolated window
+        if (e.position - preTrigger >= 0.0 && e.position + post <= samples.size() - 1) {
+            event = e;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TriggerEngine::extractWindow(const double* src, int srcCount, qint64 srcFirstIndex,
+                                  const Event& event, int length, QVector<double>& out) const {
+    out.resize(length);
+    const double origin = event.position - preTrigger - srcFirstIndex;
+    const double base = std::floor(origin);
+    const double frac = origin - base;
+    const qint64 first = static_cast<qint64>(base);
+    for (int j = 0; j < length; ++j) {
+        qint64 a = first + j;
+        qint64 b = a + 1;
+        a = qBound<qint64>(0, a, srcCount - 1);
+        b = qBound<qint64>(0, b, srcCount - 1);
+        out[j] = src[a] + (src[b] - src[a]) * frac;
+    }
+}
+
+bool TriggerEngine::alignRecords(const QVector<double>& source, int length,
+                                 QVector<double>& ch1, QVector<double>& ch2, Event& event) {
+    if (!findInRecord(source, length, event)) return false;
+    for (QVector<double>* channel : {&ch1, &ch2}) {
+        if (channel->isEmpty()) continue;
+        extractWindow(channel->constData(), channel->size(), 0, event, length, window);
+        channel->swap(window);
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <QVector>
+#include <QtGlobal>
+
+// Software edge trigger over decoded samples. process() is a single pass
+// that keeps its state between calls, so a continuous stream can be fed in
+// arbitrary blocks and crossings that straddle two blocks are still found.
+// Hysteresis: the trigger only re-arms once the signal has gone back past
+// level -/+ hysteresis, so noise riding on a slow edge fires once. Trigger
+// positions are interpolated between the two samples either side of the
+// level, which keeps the displayed waveform from jittering by a sample.
+class TriggerEngine {
+public:
+    enum class Slope { Rising, Falling };
+
+    struct Event {
+        qint64 sample = 0;   // Index of the first sample past the level
+        double position = 0; // Interpolated crossing, in (sample - 1, sample]
+    };
+
+    void setLevel(double level) { triggerLevel = level; }
+    void setHysteresis(double h) { hysteresis = qMax(0.0, h); }
+    void setSlope(Slope s) { slope = s; }
+    // Samples shown before the trigger point
+    void setPreTrigger(int samples) { preTrigger = qMax(0, samples); }
+    // Minimum spacing between accepted triggers, in samples
+    void setHoldoff(int samples) { holdoff = qMax(0, samples); }
+
+    double level() const { return triggerLevel; }
+    double hysteresisWidth() const { return hysteresis; }
+    Slope edge() const { return slope; }
+    int preTriggerSamples() const { return preTrigger; }
+
+    // Forgets the stream state (arming, holdoff, previous sample)
+    void reset();
+
+    // Scans count samples whose first sample has stream index firstIndex and
+    // appends every accepted trigger to events. Returns the number found.
+    int process(const double* samples, int count, qint64 firstIndex, QVector<Event>& events);
+
+    // One-shot search in a self-contained record: the first trigger that
+    // leaves preTrigger samples before it and length - preTrigger after it
+    bool findInRecord(const QVector<double>& samples, int length, Event& event);
+
+    // Resamples length points starting preTrigger samples before the event,
+    // so the trigger lands exactly on index preTrigger. src[0] has stream
+    // index srcFirstIndex.
+    void extractWindow(const double* src, int srcCount, qint64 srcFirstIndex,
+                       const Event& event, int length, QVector<double>& out) const;
+
+    // findInRecord() on source, then extractWindow() on every non-empty
+    // channel in place, so all of them share the trigger position. source
+    // may be ch1 or ch2. The channels are left alone if there is no trigger.
+    bool alignRecords(const QVector<double>& source, int length,
+                      QVector<double>& ch1, QVector<double>& ch2, Event& event);
+
+private:
+    double triggerLevel = 0.0;
+    double hysteresis = 0.0;
+    Slope slope = Slope::Rising;
+    int preTrigger = 0;
+    int holdoff = 0;
+
+    bool armed = false;
+    bool havePrevious = false;
+    double previous = 0.0;
+    qint64 nextAllowed = 0;
+    QVector<double> window; // alignRecords() scratch, reused between records
+};
@@ -1,4 +1,6 @@
 #include "WaveformExporter.h"
+#include "CaptureFile.h"
+#include "AdcDecoder.h"
 #include <QFileDialog>
 #include <QFile>
 #include <QTextStream>
@@ -7,6 +9,30 @@
 
 WaveformExporter::WaveformExporter(QObject *parent) : QObject(parent) {}
 
+namespace {
+void writeMeasurementLine(QTextStream &out, const QString &name, const ChannelMeasurements &m) {
+    if (!m.valid) return;
+    out << "# " << name << ": Vpp=" << QString::number(m.pkpk, 'f', 3)
+        << " Mean=" << QString::number(m.mean, 'f', 3)
+        << " RMS=" << QString::number(m.rms, 'f', 3);
+    if (m.periodic) {
+        out << " Freq(Hz)=" << QString::number(m.frequency, 'g', 6)
+            << " Duty(%)=" << QString::number(m.duty * 100.0, 'f', 1);
+    }
+    out << "\n";
+}
+}
+
+void WaveformExporter::setMeasurements(const ChannelMeasurements &ch1, const ChannelMeasurements &ch2) {
+    ch1Measurements = ch1;
+    ch2Measurements = ch2;
+}
+
+void WaveformExporter::setExtraChannels(const QVector<DeviceChannel> &channels, qint64 referenceNs) {
+    extraChannels = channels;
+    extraReferenceNs = referenceNs;
+}
+
 void WaveformExporter::exportToCSV(const QVector<double> &ch1Data, 
                                    const QVector<double> &ch2Data, 
                                    const QVector<double> &timeData,
@@ -34,10 +60,22 @@ void WaveformExporter::exportToCSV(const QVector<double> &ch1Data,
     out << "# Data Points: " << ch1Data.size() << "\n";
     out << "# Time Unit: microseconds\n";
     out << "# Voltage Unit: Volts\n";
+    writeMeasurementLine(out, "CH1", ch1Measurements);
+    writeMeasurementLine(out, "CH2", ch2Measurements);
+    for (const DeviceChannel &channel : extraChannels) {
+        if (channel.samples.isEmpty()) continue;
+        out << "# " << channel.name << ": Offset(ms)="
+            << QString::number((channel.timestampNs - extraReferenceNs) / 1e6, 'f', 3) << "\n";
+        writeMeasurementLine(out, channel.name, channel.measurements);
+    }
     out << "\n";
     
     // Write data headers
-    out << "Time(us),CH1(V),CH2(V)\n";
+    out << "Time(us),CH1(V),CH2(V)";
+    for (const DeviceChannel &channel : extraChannels) {
+        if (!channel.samples.isEmpty()) out << "," << channel.name << "(V)";
+    }
+    out << "\n";
     
     // Write data rows
     int maxRows = qMax(ch1Data.size(), qMax(ch2Data.size(), timeData.size()));
@@ -48,7 +86,14 @@ void WaveformExporter::exportToCSV(const QVector<double> &ch1Data,
         
         out << QString::number(time, 'f', 3) << ","
             << QString::number(ch1, 'f', 3) << ","
-            << QString::number(ch2, 'f', 3) << "\n";
+            << QString::number(ch2, 'f', 3);
+        // Extra channels may be shorter; their missing rows stay empty
+        for (const DeviceChannel &channel : extraChannels) {
+            if (channel.samples.isEmpty()) continue;
+            out << ",";
+            if (i < channel.samples.size()) out << QString::number(channel.samples[i], 'f', 3);
+        }
+        out << "\n";
     }
     
     // If FFT data is available, add it to the same file
@@ -76,6 +121,63 @@ void WaveformExporter::exportToCSV(const QVector<double> &ch1Data,
     qDebug() << "[WaveformExporter] Successfully exported data to:" << fileName;
 }
 
+void WaveformExporter::exportCaptureToCSV(const CaptureFileReader &capture) {
+    if (!capture.isOpen()) return;
+    QString fileName = QFileDialog::getSaveFileName(nullptr, tr("Export Capture to CSV"), "", tr("CSV Files (*.csv)"));
+    if (fileName.isEmpty()) {
+        qDebug() << "[WaveformExporter] Export cancelled by user";
+        return;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qDebug() << "[WaveformExporter] Failed to open file for writing:" << fileName;
+        return;
+    }
+
+    QTextStream out(&file);
+    const CaptureInfo &info = capture.info();
+    const quint64 total = capture.sampleCount();
+
+    out << "# Oscilloscope Capture Export\n";
+    out << "# Source: " << capture.fileName() << "\n";
+    out << "# Recorded: " << QDateTime::fromMSecsSinceEpoch(info.startTime).toString("yyyy-MM-dd hh:mm:ss") << "\n";
+    out << "# Sample Rate: " << QString::number(info.sampleRate, 'g', 6) << " Sa/s\n";
+    out << "# Gains: CH1=" << info.ch1Gain << " CH2=" << info.ch2Gain << "\n";
+    out << "# Data Points: " << total << "\n";
+    // Rows are in file order; time runs on across a gap
+    if (!capture.gaps().isEmpty()) {
+        out << "# Samples lost before rows:";
+        for (quint64 gap : capture.gaps()) out << " " << gap;
+        out << "\n";
+    }
+    out << "# Time Unit: microseconds\n";
+    out << "# Voltage Unit: Volts\n";
+    out << "\n";
+    out << "Time(us),CH1(V),CH2(V)\n";
+
+    // Decode block by block so the capture never has to fit in memory
+    AdcDecoder decoder;
+    decoder.setParams(info.ch1Gain, info.ch1Offset, info.ch2Gain, info.ch2Offset);
+    const int chunk = 65536;
+    const double sampleMicros = info.sampleRate > 0.0 ? 1e6 / info.sampleRate : 1.0;
+    QVector<quint8> raw(chunk);
+    QVector<double> ch1(chunk, 0.0), ch2(chunk, 0.0);
+    for (quint64 first = 0; first < total; first += chunk) {
+        const int n = static_cast<int>(qMin<quint64>(chunk, total - first));
+        if (capture.read(0, first, n, raw.data())) decoder.decode(AdcDecoder::Ch1, raw.constData(), n, ch1.data());
+        if (capture.read(1, first, n, raw.data())) decoder.decode(AdcDecoder::Ch2, raw.constData(), n, ch2.data());
+        for (int i = 0; i < n; ++i) {
+            out << QString::number((first + i) * sampleMicros, 'f', 3) << ","
+                << QString::number(ch1[i], 'f', 3) << ","
+                << QString::number(ch2[i], 'f', 3) << "\n";
+        }
+    }
+
+    file.close();
+    qDebug() << "[WaveformExporter] Converted capture to:" << fileName;
+}
+
 void WaveformExporter::exportToCSV(const QVector<QVector<double>> &data) {
     QString fileName = QFileDialog::getSaveFileName(nullptr, tr("Export CSV"), "", tr("CSV Files (*.csv)"));
     if (fileName.isEmpty()) return;
@@ -91,4 +193,38 @@ void WaveformExporter::exportToCSV(const QVector<QVector<double>> &data) {
     file.close();
 }
 
-WaveformExporter::~WaveformExporter() {} 
\ No newline at end of file
+WaveformExporter::~WaveformExporter() {} 
+
+void WaveformExporter::exportAnnotationsToCSV(const QVector<ProtocolAnnotation> &annotations, const QVector<BusConfig> &buses) {
+    if (annotations.isEmpty()) return;
+    QString fileName = QFileDialog::getSaveFileName(nullptr, tr("Export Decoded Events to CSV"), "", tr("CSV Files (*.csv)"));
+    if (fileName.isEmpty()) {
+        qDebug() << "[WaveformExporter] Export cancelled by user";
+        return;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qDebug() << "[WaveformExporter] Failed to open file for writing:" << fileName;
+        return;
+    }
+
+    QTextStream out(&file);
+    out << "# Decoded Bus Events\n";
+    out << "# Exported: " << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss") << "\n";
+    out << "# Events: " << annotations.size() << "\n";
+    out << "# Time Unit: seconds from the first event\n";
+    out << "\n";
+    out << "Time(s),Bus,Protocol,Event,Value,Value2,Text\n";
+    const qint64 originNs = annotations.first().timeNs;
+    for (const ProtocolAnnotation &a : annotations) {
+        const char *protocol = a.bus < buses.size() ? protocolName(buses[a.bus].protocol) : "?";
+        out << QString::number((a.timeNs - originNs) * 1e-9, 'f', 9) << ","
+            << a.bus << "," << protocol << "," << annotationKindName(a.kind) << ","
+            << a.value << "," << (a.kind == ProtocolAnnotation::Word ? QString::number(a.value2) : QString()) << ","
+            << "\"" << annotationText(a).replace('"', "\"\"") << "\"\n";
+    }
+
+    file.close();
+    qDebug() << "[WaveformExporter] Exported" << annotations.size() << "decoded events to:" << fileName;
+}
\ No newline at end of file
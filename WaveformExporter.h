@@ -1,6 +1,11 @@
 #pragma once
 #include <QObject>
 #include <QVector>
+#include "AcquisitionManager.h"
+#include "BusDecoder.h"
+#include "MeasurementKernel.h"
+
+class CaptureFileReader;
 
 class WaveformExporter : public QObject {
     Q_OBJECT
@@ -16,7 +21,26 @@ public:
                      const QVector<double> &ch2FFT = QVector<double>(),
                      const QVector<double> &freqData = QVector<double>());
     
+    // Summary written into the header of the next exportToCSV call
+    void setMeasurements(const ChannelMeasurements &ch1, const ChannelMeasurements &ch2);
+    // Secondary devices' channels, written as extra columns by the next
+    // exportToCSV call. referenceNs is the timestamp of the primary frame;
+    // each channel's offset from it goes into the header.
+    void setExtraChannels(const QVector<DeviceChannel> &channels, qint64 referenceNs);
+
+    // Converts a whole binary capture to CSV, a block at a time
+    void exportCaptureToCSV(const CaptureFileReader &capture);
+
+    // Decoded bus events, one row each; buses names their protocols
+    void exportAnnotationsToCSV(const QVector<ProtocolAnnotation> &annotations, const QVector<BusConfig> &buses);
+
     // Legacy method for compatibility
     void exportToCSV(const QVector<QVector<double>> &data);
     // TODO: Add CSV export methods
+
+private:
+    ChannelMeasurements ch1Measurements;
+    ChannelMeasurements ch2Measurements;
+    QVector<DeviceChannel> extraChannels;
+    qint64 extraReferenceNs = 0;
 }; 
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "WaveformMask.h"
+#include <QDebug>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Branch-free, so the compiler turns it into packed compares
+int countOutside(const double* v, const double* lower, const double* upper, int n) {
+    int outside = 0;
+    for (int i = 0; i < n; ++i) outside += int(v[i] < lower[i]) | int(v[i] > upper[i]);
+    return outside;
+}
+
+int firstOutside(const double* v, const double* lower, const double* upper, int n) {
+    for (int i = 0; i < n; ++i) {
+        if (v[i] < lower[i] || v[i] > upper[i]) return i;
+    }
+    return -1;
+}
+
+// Sliding min (or max) over the samples within radius of each one
+void dilate(QVector<double>& values, int radius, bool maximum, QVector<double>& scratch) {
+    const int n = values.size();
+    if (radius <= 0 || n == 0) return;
+    scratch = values;
+    for (int i = 0; i < n; ++i) {
+        const int first = qMax(0, i - radius);
+        const int last = qMin(n - 1, i + radius);
+        double v = scratch[first];
+        for (int j = first + 1; j <= last; ++j) v = maximum ? qMax(v, scratch[j]) : qMin(v, scratch[j]);
+        values[i] = v;
+    }
+}
+}
+
+void WaveformMask::clear() {
+    for (Envelope& envelope : envelopes) {
+        envelope.lower.clear();
+        envelope.upper.clear();
+    }
+    recordLength = 0;
+    learned = 0;
+}
+
+bool WaveformMask::setEnvelope(int channel, const QVector<double>& lower, const QVector<double>& upper) {
+    if (channel < 0 || channel > 1 || lower.size() != upper.size()) return false;
+    const Envelope& other = envelopes[channel ^ 1];
+    if (!other.isEmpty() && other.lower.size() != lower.size()) return false;
+    envelopes[channel].lower = lower;
+    envelopes[channel].upper = upper;
+    recordLength = isEmpty() ? 0 : qMax(envelopes[0].lower.size(), envelopes[1].lower.size());
+    return true;
+}
+
+void WaveformMask::beginLearning() {
+    clear();
+}
+
+bool WaveformMask::learn(const QVector<double>& ch1, const QVector<double>& ch2) {
+    const QVector<double>* channels[2] = {&ch1, &ch2};
+    const int n = qMax(ch1.size(), ch2.size());
+    if (n == 0) return false;
+    // Every golden record has to be the same length as the first
+    if (learned > 0 && n != recordLength) return false;
+    for (int ch = 0; ch < 2; ++ch) {
+        const QVector<double>& v = *channels[ch];
+        if (!v.isEmpty() && v.size() != n) return false;
+    }
+    for (int ch = 0; ch < 2; ++ch) {
+        const QVector<double>& v = *channels[ch];
+        if (v.isEmpty()) continue;
+        Envelope& envelope = envelopes[ch];
+        if (envelope.isEmpty()) {
+            envelope.lower = v;
+            envelope.upper = v;
+            continue;
+        }
+        double* lower = envelope.lower.data();
+        double* upper = envelope.upper.data();
+        for (int i = 0; i < n; ++i) {
+            lower[i] = qMin(lower[i], v[i]);
+            upper[i] = qMax(upper[i], v[i]);
+        }
+    }
+    recordLength = n;
+    ++learned;
+    return true;
+}
+
+void WaveformMask::finishLearning(double marginVolts, int marginSamples) {
+    const double margin = std::fabs(marginVolts);
+    for (Envelope& envelope : envelopes) {
+        if (envelope.isEmpty()) continue;
+        dilate(envelope.lower, marginSamples, false, scratch);
+        dilate(envelope.upper, marginSamples, true, scratch);
+        for (double& v : envelope.lower) v -= margin;
+        for (double& v : envelope.upper) v += margin;
+    }
+}
+
+MaskResult WaveformMask::test(const QVector<double>& ch1, const QVector<double>& ch2) const {
+    MaskResult result;
+    const QVector<double>* channels[2] = {&ch1, &ch2};
+    for (int ch = 0; ch < 2; ++ch) {
+        const Envelope& envelope = envelopes[ch];
+        if (envelope.isEmpty()) continue;
+        const QVector<double>& v = *channels[ch];
+        const int n = qMin(int(v.size()), recordLength);
+        // A missing channel counts as outside everywhere
+        int outside = qAbs(int(v.size()) - recordLength);
+        int first = outside > 0 ? n : -1;
+        const int overlapping = countOutside(v.constData(), envelope.lower.constData(), envelope.upper.constData(), n);
+        if (overlapping > 0) first = firstOutside(v.constData(), envelope.lower.constData(), envelope.upper.constData(), n);
+        outside += overlapping;
+        if (outside == 0) continue;
+        result.violations += outside;
+        result.failedChannels |= quint8(1 << ch);
+        if (result.firstViolation < 0 || first < result.firstViolation) result.firstViolation = first;
+    }
+    return result;
+}
+
+bool WaveformMask::save(const QString& path) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "[WaveformMask] Cannot write" << path;
+        return false;
+    }
+    QTextStream out(&file);
+    out << "# Waveform mask, " << recordLength << " samples\n";
+    out << "Sample,CH1 Lower,CH1 Upper,CH2 Lower,CH2 Upper\n";
+    for (int i = 0; i < recordLength; ++i) {
+        out << i;
+        for (const Envelope& envelope : envelopes) {
+            if (envelope.isEmpty()) out << ",,";
+            else out << "," << QString::number(envelope.lower[i], 'g', 9) << "," << QString::number(envelope.upper[i], 'g', 9);
+        }
+        out << "\n";
+    }
+    return out.status() == QTextStream::Ok;
+}
+
+bool WaveformMask::load(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "[WaveformMask] Cannot read" << path;
+        return false;
+    }
+    QVector<double> columns[4];
+    bool present[2] = {true, true};
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) continue;
+        const QStringList cells = line.split(',');
+        bool numeric = false;
+        cells[0].toInt(&numeric);
+        if (!numeric) continue; // column titles
+        for (int c = 0; c < 4; ++c) {
+            bool ok = false;
+            const double v = c + 1 < cells.size() ? cells[c + 1].trimmed().toDouble(&ok) : 0.0;
+            // A channel is loaded only if every row has both of its limits
+            if (!ok) present[c / 2] = false;
+            columns[c].append(v);
+        }
+    }
+    clear();
+    for (int ch = 0; ch < 2; ++ch) {
+        if (present[ch] && !columns[2 * ch].isEmpty()) setEnvelope(ch, columns[2 * ch], columns[2 * ch + 1]);
+    }
+    if (isEmpty()) {
+        qWarning() << "[WaveformMask] No mask limits in" << path;
+        return false;
+    }
+    return true;
+}
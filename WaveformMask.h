@@ -0,0 +1,60 @@
+#pragma once
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+// Outcome of testing one record against a mask
+struct MaskResult {
+    int violations = 0;         // samples outside the envelope, both channels
+    int firstViolation = -1;    // index of the earliest one
+    quint8 failedChannels = 0;  // bit 0 CH1, bit 1 CH2
+    bool pass() const { return violations == 0; }
+};
+
+// Tolerance envelope for pass/fail testing: sample i of a channel passes if
+// it lies in [lower[i], upper[i]]. A channel without an envelope is not
+// tested. The envelope is learned from golden records (the min and max of
+// all of them at each sample, widened by a margin in volts and by a number
+// of samples either side, which absorbs trigger jitter) or loaded from a
+// CSV file written by save().
+//
+// test() is one branch-free pass per channel that the compiler vectorises;
+// only failing records are scanned again for the first violation.
+class WaveformMask {
+public:
+    struct Envelope {
+        QVector<double> lower;
+        QVector<double> upper;
+        bool isEmpty() const { return lower.isEmpty(); }
+    };
+
+    void clear();
+    bool isEmpty() const { return envelopes[0].isEmpty() && envelopes[1].isEmpty(); }
+    // Samples of the records it applies to; 0 if empty
+    int length() const { return recordLength; }
+    const Envelope& envelope(int channel) const { return envelopes[channel & 1]; }
+    // Both vectors the same length as any other channel's; false otherwise
+    bool setEnvelope(int channel, const QVector<double>& lower, const QVector<double>& upper);
+
+    // Learning: clears the mask, then every learn() widens it to cover one
+    // more golden record (empty channels skipped) until finishLearning()
+    void beginLearning();
+    bool learn(const QVector<double>& ch1, const QVector<double>& ch2);
+    int learnedRecords() const { return learned; }
+    void finishLearning(double marginVolts, int marginSamples);
+
+    // Records of another length than the mask's fail on every sample of
+    // the difference, as they come from a different time base
+    MaskResult test(const QVector<double>& ch1, const QVector<double>& ch2) const;
+
+    // Columns Sample, CH1 Lower, CH1 Upper, CH2 Lower, CH2 Upper; an
+    // untested channel's cells are left empty
+    bool save(const QString& path) const;
+    bool load(const QString& path);
+
+private:
+    Envelope envelopes[2];
+    int recordLength = 0;
+    int learned = 0;
+    QVector<double> scratch;
+};
@@ -0,0 +1,157 @@
+#include "XYRenderer.h"
+#include "qcustomplot.h"
+#include <cmath>
+
+namespace {
+// Points drawn per frame at most, before pixel deduplication
+constexpr int XY_MAX_POINTS = 8192;
+// Earlier frames kept on screen while persistence is on
+constexpr int XY_PERSISTENCE_FRAMES = 16;
+// Opacity of the newest ghost, and the one below which ghosts are hidden
+constexpr double GHOST_ALPHA = 0.6;
+constexpr double MIN_GHOST_ALPHA = 0.03;
+
+QCPCurve* makeCurve(QCPAxis* keyAxis, QCPAxis* valueAxis, const QPen& pen)
+{
+    QCPCurve* curve = new QCPCurve(keyAxis, valueAxis);
+    curve->setPen(pen);
+    // Frames are rewritten in place; keep the capacity between them
+    curve->data()->setAutoSqueeze(false);
+    return curve;
+}
+}
+
+void XYRenderer::attach(QCPAxis* key, QCPAxis* value, const QColor& c)
+{
+    detach();
+    keyAxis = key;
+    valueAxis = value;
+    color = c;
+    // Ghosts first, so the live frame is drawn on top of them
+    ghosts.resize(XY_PERSISTENCE_FRAMES);
+    ghostTimes.fill(0, XY_PERSISTENCE_FRAMES);
+    for (QCPCurve*& ghost : ghosts) {
+        ghost = makeCurve(keyAxis, valueAxis, QPen(color, 1));
+        ghost->setVisible(false);
+    }
+    nextGhost = 0;
+    live = makeCurve(keyAxis, valueAxis, QPen(color, 2));
+    if (!clock.isValid()) clock.start();
+}
+
+void XYRenderer::detach()
+{
+    if (!live) return;
+    QCustomPlot* plot = live->parentPlot();
+    for (QCPCurve* ghost : ghosts) plot->removePlottable(ghost);
+    plot->removePlottable(live);
+    ghosts.clear();
+    live = nullptr;
+}
+
+void XYRenderer::setPersistence(double seconds)
+{
+    persistenceSeconds = seconds;
+    clearPersistence();
+}
+
+void XYRenderer::clearPersistence()
+{
+    for (QCPCurve* ghost : ghosts) {
+        ghost->data()->clear();
+        ghost->setVisible(false);
+    }
+}
+
+void XYRenderer::update(const QVector<double>& ch1, const QVector<double>& ch2, double ch1Gain, double ch2Gain)
+{
+    if (!live) return;
+    if (persistenceSeconds != 0.0 && !live->data()->isEmpty()) retireLive();
+    const int n = qMin(ch1.size(), ch2.size());
+    xs.resize(n);
+    ys.resize(n);
+    for (int i = 0; i < n; ++i) {
+        xs[i] = ch1[i] * ch1Gain;
+        ys[i] = ch2[i] * ch2Gain;
+    }
+    render();
+    fadeGhosts();
+}
+
+void XYRenderer::rerender()
+{
+    if (live) render();
+}
+
+// Writes the newest frame into the live curve's container, skipping
+// points on the same pixel as the previous one
+void XYRenderer::render()
+{
+    QCPCurveDataContainer& data = *live->data();
+    const int n = xs.size();
+    const int stride = qMax(1, (n + XY_MAX_POINTS - 1) / XY_MAX_POINTS);
+    const int maxPoints = (n + stride - 1) / stride;
+    while (data.size() < maxPoints) data.add(QCPCurveData(data.size(), 0.0, 0.0));
+
+    const QCPRange keys = keyAxis->range();
+    const QCPRange values = valueAxis->range();
+    int width = keyAxis->axisRect()->width();
+    int height = keyAxis->axisRect()->height();
+    if (width <= 0 || height <= 0) { // Not laid out yet
+        width = 1000;
+        height = 600;
+    }
+    const double keyPixels = keys.size() > 0 ? width / keys.size() : 1.0;
+    const double valuePixels = values.size() > 0 ? height / values.size() : 1.0;
+
+    auto it = data.begin();
+    int count = 0;
+    double lastX = 0.0, lastY = 0.0;
+    for (int i = 0; i < n; i += stride) {
+        const double px = std::floor((xs[i] - keys.lower) * keyPixels);
+        const double py = std::floor((ys[i] - values.lower) * valuePixels);
+        if (count > 0 && px == lastX && py == lastY) continue;
+        lastX = px;
+        lastY = py;
+        it->t = count++;
+        it->key = xs[i];
+        it->value = ys[i];
+        ++it;
+    }
+    data.removeAfter(count - 1); // t is the point index
+}
+
+// Moves the live frame into the oldest ghost; the ghost's storage becomes
+// the live one
+void XYRenderer::retireLive()
+{
+    if (ghosts.isEmpty()) return;
+    QCPCurve* ghost = ghosts[nextGhost];
+    QSharedPointer<QCPCurveDataContainer> storage = ghost->data();
+    ghost->setData(live->data());
+    live->setData(storage);
+    ghostTimes[nextGhost] = clock.elapsed();
+    nextGhost = (nextGhost + 1) % ghosts.size();
+}
+
+// Real time since each ghost was live sets its opacity, so the fade does
+// not depend on the frame rate
+void XYRenderer::fadeGhosts()
+{
+    const qint64 now = clock.elapsed();
+    for (int i = 0; i < ghosts.size(); ++i) {
+        QCPCurve* ghost = ghosts[i];
+        double alpha = 0.0;
+        if (persistenceSeconds < 0.0) {
+            alpha = GHOST_ALPHA;
+        } else if (persistenceSeconds > 0.0) {
+            alpha = GHOST_ALPHA * std::exp(-(now - ghostTimes[i]) / (1000.0 * persistenceSeconds));
+        }
+        const bool show = alpha >= MIN_GHOST_ALPHA && !ghost->data()->isEmpty();
+        ghost->setVisible(show);
+        if (!show) continue;
+        QColor faded = color;
+        faded.setAlphaF(alpha);
+        ghost->setPen(QPen(faded, 1));
+    }
+}
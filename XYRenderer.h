@@ -0,0 +1,55 @@
+#pragma once
+#include <QColor>
+#include <QElapsedTimer>
+#include <QVector>
+
+class QCPAxis;
+class QCPCurve;
+
+// XY (Lissajous) view of CH1 against CH2. One QCPCurve holds the newest
+// frame and is overwritten in place, so a steady stream of frames never
+// allocates. Points that land on the same pixel as the one before are
+// dropped, and records over a fixed point budget are strided first, so the
+// drawing cost follows the plot size rather than the record length.
+//
+// With persistence on, the previous frames stay on screen as a ring of
+// ghost curves that fade with the configured time constant. Frames move
+// through the ring by swapping data containers, not by copying points.
+class XYRenderer {
+public:
+    // Creates the curves on these axes (CH1 on key, CH2 on value)
+    void attach(QCPAxis* keyAxis, QCPAxis* valueAxis, const QColor& color);
+    // Removes the curves from their plot, e.g. when the display mode
+    // changes. The plot owns them, so this must run while it still exists.
+    void detach();
+    bool isAttached() const { return live != nullptr; }
+    QCPCurve* curve() const { return live; }
+
+    // Fade time constant in seconds: 0 = off, < 0 = earlier frames never fade
+    void setPersistence(double seconds);
+    void clearPersistence();
+
+    // Draws the samples (times their gain) against each other for the
+    // axes' current ranges
+    void update(const QVector<double>& ch1, const QVector<double>& ch2, double ch1Gain, double ch2Gain);
+    // Re-decimates the newest frame after a zoom or pan
+    void rerender();
+
+private:
+    void render();
+    void retireLive();
+    void fadeGhosts();
+
+    QCPAxis* keyAxis = nullptr;
+    QCPAxis* valueAxis = nullptr;
+    QColor color;
+    QCPCurve* live = nullptr;
+    QVector<QCPCurve*> ghosts;  // earlier frames, oldest at nextGhost
+    QVector<qint64> ghostTimes; // when each was the live frame, ms on clock
+    int nextGhost = 0;
+    double persistenceSeconds = 0.0;
+    QElapsedTimer clock;
+
+    // Newest frame, scaled, kept for re-decimation
+    QVector<double> xs, ys;
+};